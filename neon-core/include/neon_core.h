@@ -3,10 +3,23 @@
 #ifndef NEON_CORE_H_INCLUDED
 #define NEON_CORE_H_INCLUDED
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <unordered_map>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
 namespace neon {
    typedef unsigned long long uint64;
    typedef   signed long long int64;
@@ -33,8 +46,17 @@ namespace neon {
       static inline float sin(const float radians);
    };
 
+   struct hash {
+      static uint64 fnv1a(const void *data, const uint64 size, const uint64 seed = 0xcbf29ce484222325ull);
+      static uint64 fnv1a(const string &text, const uint64 seed = 0xcbf29ce484222325ull);
+   };
+
+   // note: signed 64-bit nanosecond ticks from a monotonic clock
    struct time {
       static time now();
+      static time from_seconds(const double seconds);
+      static time from_milliseconds(const double milliseconds);
+      static time from_microseconds(const double microseconds);
 
       time();
       explicit time(int64 tick);
@@ -49,18 +71,74 @@ namespace neon {
       bool operator==(const time &rhs) const;
       bool operator!=(const time &rhs) const;
 
-      float as_seconds() const;
-      float as_milliseconds() const;
+      double as_seconds() const;
+      double as_milliseconds() const;
+      double as_microseconds() const;
+      int64 as_nanoseconds() const;
 
       int64 tick_;
    };
 
+   // note: raw cpu timestamp counter for micro-timing, a lot cheaper than
+   //       time::now(). cycles are converted with a rate calibrated against
+   //       time::now(), so conversions get more precise as the program runs.
+   struct cycle_counter {
+      static inline uint64 now();
+      static double nanoseconds_per_cycle();
+      static time to_time(const uint64 cycles);
+
+      cycle_counter();
+
+      void reset();
+      uint64 elapsed_cycles() const;
+      time elapsed() const;
+
+      uint64 start_;
+   };
+
+   // note: fixed set of worker threads for fork-join work. parallel_for()
+   //       hands out indices until all are done, the calling thread helps
+   //       out and the call returns when the last job finished. jobs get
+   //       the index and the slot of the thread running them, slot 0 is
+   //       always the caller so per-thread data needs worker_count() + 1.
+   struct thread_pool {
+      typedef std::function<void(uint32 index, uint32 slot)> job;
+
+      static uint32 default_worker_count();
+
+      thread_pool();
+      ~thread_pool();
+
+      bool create(uint32 worker_count);
+      void destroy();
+
+      uint32 worker_count() const;
+      void parallel_for(uint32 count, const job &function);
+
+      void work(uint32 slot);
+      void run(const job &function, uint32 count, uint32 slot);
+
+      dynamic_array<std::thread> workers_;
+      std::mutex mutex_;
+      std::condition_variable wake_;
+      std::condition_variable done_;
+      const job *job_;
+      uint32 count_;
+      std::atomic<uint32> next_;
+      std::atomic<uint32> remaining_;
+      uint32 active_;
+      uint32 generation_;
+      bool running_;
+   };
+
    struct file_system {
       static bool exists(const string &filename);
       static bool read_file_content(const string &filename, dynamic_array<uint8> &content);
       static bool write_file_content(const string &filename, const dynamic_array<uint8> &content, bool allow_overwrite);
       static bool remove_file(const string &filename);
       static bool create_directory(const string &name);
+      static bool remove_directory(const string &name);
+      static string create_temporary_directory(const string &prefix);
       static string get_app_directory();
       static string get_save_directory(const string &app_name);
 
@@ -104,6 +182,7 @@ namespace neon {
       bool is_down(keycode index) const;
       bool is_pressed(keycode index) const;
       bool is_released(keycode index) const;
+      void clear_edges();
 
       struct keystate {
          bool down_;
@@ -125,6 +204,7 @@ namespace neon {
       bool is_down(mouse_button index) const;
       bool is_pressed(mouse_button index) const;
       bool is_released(mouse_button index) const;
+      void clear_edges();
 
       int32 x_;
       int32 y_;
@@ -149,8 +229,127 @@ namespace neon {
       static bool get_desktop_display_mode(display_mode &mode);
       static bool get_display_mode(display_mode &mode);
       static void set_display_mode(const display_mode &mode);
+      static bool set_swap_interval(int32 interval);
    };
 
+   enum benchmark_section {
+      BENCHMARK_SECTION_UPDATE,
+      BENCHMARK_SECTION_CULL,
+      BENCHMARK_SECTION_SUBMIT,
+      BENCHMARK_SECTION_SWAP,
+      BENCHMARK_SECTION_COUNT,
+   };
+
+   // note: when enabled the application runs with a fixed deltatime, skips
+   //       the warmup frames and then records per-section cpu timings for
+   //       frame_count_ frames. the platform layer times the swap and stops
+   //       the loop once the benchmark is finished. named timings are per
+   //       frame values that arrive from elsewhere, e.g. gpu timer queries,
+   //       and are summarized the same way as the sections.
+   struct benchmark {
+      struct sample {
+         double sections_[BENCHMARK_SECTION_COUNT];
+         double total_;
+      };
+
+      struct metric {
+         string name_;
+         double value_;
+      };
+
+      struct timing {
+         string name_;
+         dynamic_array<double> values_;
+      };
+
+      static const char *section_name(benchmark_section section);
+
+      benchmark();
+
+      bool parse_argument(int argc, char **argv, int &index);
+      void configure(uint32 warmup_frames, uint32 frame_count, const time &fixed_deltatime);
+
+      bool is_enabled() const;
+      bool is_measuring() const;
+      bool is_finished() const;
+
+      void begin_frame();
+      void end_frame();
+      void begin(benchmark_section section);
+      void end(benchmark_section section);
+      void add_metric(const string &name, double value);
+      void add_timing(const string &name, double milliseconds);
+
+      string report_json() const;
+      string report_csv() const;
+      bool write_report() const;
+
+      bool enabled_;
+      uint32 warmup_frames_;
+      uint32 frame_count_;
+      uint32 frame_;
+      time fixed_deltatime_;
+      string report_filename_;
+      time frame_start_;
+      time section_start_[BENCHMARK_SECTION_COUNT];
+      sample current_;
+      dynamic_array<sample> samples_;
+      dynamic_array<metric> metrics_;
+      dynamic_array<timing> timings_;
+   };
+
+   // note: paces the main loop. the platform layer calls mark_presented()
+   //       after the swap and then wait(), which sleeps until shortly before
+   //       the next deadline and spins the rest. the sleep margin adapts to
+   //       how late the os wakes us up. a target rate of zero leaves pacing
+   //       to vsync or runs unlimited. latency is measured from the input
+   //       sample at the start of the frame until the swap returned.
+   struct frame_pacer {
+      struct statistics {
+         statistics();
+
+         time frame_time_;
+         time latency_;
+         time average_latency_;
+         time max_latency_;
+         uint32 missed_deadlines_;
+      };
+
+      frame_pacer();
+      ~frame_pacer();
+
+      bool parse_argument(int argc, char **argv, int &index);
+      void set_target_rate(const double frames_per_second);
+      void set_vsync(bool enabled);
+      bool apply();
+
+      void mark_input();
+      void mark_presented();
+      void wait();
+
+      // note: fixed-timestep accumulator, accumulate() returns how many
+      //       steps to simulate and alpha() how far the remainder is into
+      //       the next one. steps above max_steps are dropped.
+      void set_fixed_step(const time &step, uint32 max_steps);
+      uint32 accumulate(const time &deltatime);
+      double alpha() const;
+
+      time target_interval_;
+      time deadline_;
+      time sleep_margin_;
+      bool vsync_;
+      time input_;
+      time presented_;
+      time fixed_step_;
+      time accumulator_;
+      uint32 max_steps_;
+      statistics statistics_;
+   };
+
+   // note: frame() runs update() zero or more times with a fixed deltatime,
+   //       as many as the accumulated frame time covers, then render() once
+   //       with how far the leftover time is into the next step. pressed and
+   //       released edges are kept until an update has seen them.
    struct application {
       static application *create(int &width, int &height, string &title);
 
@@ -161,12 +360,18 @@ namespace neon {
       void shut();
       bool frame();
 
+      // note: called for command line arguments the platform layer does not know
+      virtual bool parse_argument(int argc, char **argv, int &index);
+
       virtual bool enter() = 0;
       virtual void exit() = 0;
-      virtual bool tick(const time &dt) = 0;
+      virtual bool update(const time &deltatime) = 0;
+      virtual void render(const double alpha) = 0;
 
       keyboard keyboard_;
       mouse mouse_;
+      benchmark benchmark_;
+      frame_pacer pacer_;
       time start_;
       time current_;
    };
@@ -195,6 +400,14 @@ namespace neon {
       int32 height_;
       uint8 *data_;
    };
+
+   inline uint64 cycle_counter::now() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+      return __rdtsc();
+#else
+      return (uint64)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+   }
 } // !neon
 
 #endif //!NEON_CORE_H_INCLUDED
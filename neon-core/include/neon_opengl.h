@@ -78,6 +78,7 @@ typedef unsigned char GLubyte;
 #define GL_DEPTH_TEST                     0x0B71
 #define GL_DEPTH_FUNC                     0x0B74
 #define GL_BLEND                          0x0BE2
+#define GL_SCISSOR_TEST                   0x0C11
 #define GL_TEXTURE_2D                     0x0DE1
 #define GL_BYTE                           0x1400
 #define GL_UNSIGNED_BYTE                  0x1401
@@ -120,11 +121,14 @@ typedef unsigned char GLubyte;
    GLF(void, glTexParameteriv, GLenum target, GLenum pname, const GLint *params) \
    GLF(void, glTexImage2D, GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels) \
    GLF(void, glDrawBuffer, GLenum buf) \
+   GLF(void, glReadBuffer, GLenum src) \
+   GLF(void, glReadPixels, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels) \
    GLF(void, glClear, GLbitfield mask) \
    GLF(void, glClearColor, GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) \
    GLF(void, glClearStencil, GLint s) \
    GLF(void, glClearDepth, GLdouble depth) \
    GLF(void, glDepthMask, GLboolean flag) \
+   GLF(void, glColorMask, GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha) \
    GLF(void, glDisable, GLenum cap) \
    GLF(void, glEnable, GLenum cap) \
    GLF(void, glBlendFunc, GLenum sfactor, GLenum dfactor) \
@@ -134,6 +138,8 @@ typedef unsigned char GLubyte;
    GLF(GLboolean, glIsEnabled, GLenum cap) \
    GLF(void, glDepthRange, GLdouble n, GLdouble f) \
    GLF(void, glViewport, GLint x, GLint y, GLsizei width, GLsizei height) \
+   GLF(void, glFinish, void) \
+   GLF(void, glFlush, void) \
    GLF(const GLubyte *, glGetString, GLenum name)
 GL_FUNCLIST_1_0;
 
@@ -143,7 +149,10 @@ typedef double GLclampd;
 #define GL_DOUBLE                         0x140A
 #define GL_RGB8                           0x8051
 #define GL_RGBA8                          0x8058
+#define GL_RGB10_A2                       0x8059
+#define GL_TEXTURE_BINDING_2D             0x8069
 #define GL_VERTEX_ARRAY                   0x8074
+#define GL_POLYGON_OFFSET_FILL            0x8037
 
 #define GL_FUNCLIST_1_1 \
    GLF(void, glDrawArrays, GLenum mode, GLint first, GLsizei count) \
@@ -151,6 +160,8 @@ typedef double GLclampd;
    GLF(void, glBindTexture, GLenum target, GLuint texture) \
    GLF(void, glDeleteTextures, GLsizei n, const GLuint *textures) \
    GLF(void, glGenTextures, GLsizei n, GLuint *textures) \
+   GLF(void, glPolygonOffset, GLfloat factor, GLfloat units) \
+   GLF(void, glTexSubImage2D, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *pixels) \
    GLF(GLboolean, glIsTexture, GLuint texture) 
 GL_FUNCLIST_1_1;
 
@@ -158,6 +169,7 @@ GL_FUNCLIST_1_1;
 #define GL_TEXTURE_WRAP_R                 0x8072
 #define GL_BGR                            0x80E0
 #define GL_BGRA                           0x80E1
+#define GL_UNSIGNED_INT_2_10_10_10_REV    0x8368
 #define GL_CLAMP_TO_EDGE                  0x812F
 #define GL_TEXTURE_MIN_LOD                0x813A
 #define GL_TEXTURE_MAX_LOD                0x813B
@@ -236,8 +248,12 @@ typedef ptrdiff_t GLintptr;
 #define GL_ARRAY_BUFFER                   0x8892
 #define GL_ELEMENT_ARRAY_BUFFER           0x8893
 #define GL_STREAM_DRAW                    0x88E0
+#define GL_STREAM_READ                    0x88E1
 #define GL_STATIC_DRAW                    0x88E4
 #define GL_DYNAMIC_DRAW                   0x88E8
+#define GL_QUERY_RESULT                   0x8866
+#define GL_QUERY_RESULT_AVAILABLE         0x8867
+#define GL_SAMPLES_PASSED                 0x8914
 
 #define GL_FUNCLIST_1_5 \
    GLF(void, glBindBuffer, GLenum target, GLuint buffer) \
@@ -247,7 +263,13 @@ typedef ptrdiff_t GLintptr;
    GLF(void, glBufferData, GLenum target, GLsizeiptr size, const void *data, GLenum usage) \
    GLF(void, glBufferSubData, GLenum target, GLintptr offset, GLsizeiptr size, const void *data) \
    GLF(void*, glMapBuffer, GLenum target, GLenum access) \
-   GLF(GLboolean, glUnmapBuffer, GLenum target) 
+   GLF(GLboolean, glUnmapBuffer, GLenum target) \
+   GLF(void, glGenQueries, GLsizei n, GLuint *ids) \
+   GLF(void, glDeleteQueries, GLsizei n, const GLuint *ids) \
+   GLF(void, glBeginQuery, GLenum target, GLuint id) \
+   GLF(void, glEndQuery, GLenum target) \
+   GLF(void, glGetQueryObjectiv, GLuint id, GLenum pname, GLint *params) \
+   GLF(void, glGetQueryObjectuiv, GLuint id, GLenum pname, GLuint *params) 
 GL_FUNCLIST_1_5;
 
 // GL_VERSION_2_0
@@ -337,6 +359,8 @@ GL_FUNCLIST_2_0;
 #define GL_SRGB8_ALPHA8                   0x8C43
 #define GL_COMPRESSED_SRGB                0x8C48
 #define GL_COMPRESSED_SRGB_ALPHA          0x8C49
+#define GL_PIXEL_PACK_BUFFER              0x88EB
+#define GL_PIXEL_UNPACK_BUFFER            0x88EC
 
 #define GL_FUNCLIST_2_1
 GL_FUNCLIST_2_1;
@@ -360,6 +384,9 @@ typedef unsigned short GLhalf;
 #define GL_DEPTH_STENCIL                  0x84F9
 #define GL_UNSIGNED_INT_24_8              0x84FA
 #define GL_DEPTH24_STENCIL8               0x88F0
+#define GL_RGBA32F                        0x8814
+#define GL_R16UI                          0x8234
+#define GL_RG32UI                         0x823C
 #define GL_READ_FRAMEBUFFER               0x8CA8
 #define GL_DRAW_FRAMEBUFFER               0x8CA9
 #define GL_FRAMEBUFFER_COMPLETE           0x8CD5
@@ -375,11 +402,21 @@ typedef unsigned short GLhalf;
 #define GL_FRAMEBUFFER                    0x8D40
 #define GL_RENDERBUFFER                   0x8D41
 #define GL_FRAMEBUFFER_SRGB               0x8DB9
+#define GL_QUERY_WAIT                     0x8E13
+#define GL_QUERY_NO_WAIT                  0x8E14
+#define GL_QUERY_BY_REGION_WAIT           0x8E15
+#define GL_QUERY_BY_REGION_NO_WAIT        0x8E16
+#define GL_MAP_READ_BIT                   0x0001
+#define GL_MAP_WRITE_BIT                  0x0002
+#define GL_MAP_INVALIDATE_BUFFER_BIT      0x0008
 
 #define GL_FUNCLIST_3_0 \
    GLF(const GLubyte *, glGetStringi, GLenum name, GLuint index) \
+   GLF(void *, glMapBufferRange, GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) \
    GLF(void, glBindBufferRange, GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) \
    GLF(void, glBindBufferBase, GLenum target, GLuint index, GLuint buffer) \
+   GLF(void, glBeginConditionalRender, GLuint id, GLenum mode) \
+   GLF(void, glEndConditionalRender, void) \
    GLF(void, glUniform1uiv, GLint location, GLsizei count, const GLuint *value) \
    GLF(void, glUniform2uiv, GLint location, GLsizei count, const GLuint *value) \
    GLF(void, glUniform3uiv, GLint location, GLsizei count, const GLuint *value) \
@@ -407,16 +444,35 @@ GL_FUNCLIST_3_0;
 
 // GL_VERSION_3_1
 #define GL_UNIFORM_BUFFER                 0x8A11
+#define GL_TEXTURE_BUFFER                 0x8C2A
+#define GL_COPY_READ_BUFFER               0x8F36
+#define GL_COPY_WRITE_BUFFER              0x8F37
+#define GL_PRIMITIVE_RESTART              0x8F9D
+#define GL_PRIMITIVE_RESTART_INDEX        0x8F9E
 
 #define GL_FUNCLIST_3_1 \
    GLF(void, glDrawArraysInstanced, GLenum mode, GLint first, GLsizei count, GLsizei instancecount) \
    GLF(void, glDrawElementsInstanced, GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount) \
+   GLF(void, glCopyBufferSubData, GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size) \
    GLF(void, glTexBuffer, GLenum target, GLenum internalformat, GLuint buffer) \
+   GLF(void, glPrimitiveRestartIndex, GLuint index) \
    GLF(void, glUniformBlockBinding, GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding) 
 GL_FUNCLIST_3_1;
 
 // GL_VERSION_3_2
+#include <stdint.h>
+typedef uint64_t GLuint64;
+typedef int64_t GLint64;
+typedef struct __GLsync *GLsync;
 #define GL_CONTEXT_CORE_PROFILE_BIT       0x00000001
+#define GL_SYNC_FLUSH_COMMANDS_BIT        0x00000001
+#define GL_SYNC_GPU_COMMANDS_COMPLETE     0x9117
+#define GL_ALREADY_SIGNALED               0x911A
+#define GL_TIMEOUT_EXPIRED                0x911B
+#define GL_CONDITION_SATISFIED            0x911C
+#define GL_WAIT_FAILED                    0x911D
+#define GL_MAX_SAMPLES                    0x8D57
+#define GL_TEXTURE_2D_MULTISAMPLE         0x9100
 
 #define GL_FUNCLIST_3_2 \
    GLF(void, glDrawElementsBaseVertex, GLenum mode, GLsizei count, GLenum type, const void *indices, GLint basevertex) \
@@ -424,19 +480,46 @@ GL_FUNCLIST_3_1;
    GLF(void, glDrawElementsInstancedBaseVertex, GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount, GLint basevertex) \
    GLF(void, glMultiDrawElementsBaseVertex, GLenum mode, const GLsizei *count, GLenum type, const void *const*indices, GLsizei drawcount, const GLint *basevertex) \
    GLF(void, glFramebufferTexture, GLenum target, GLenum attachment, GLuint texture, GLint level) \
-   GLF(void, glTexImage2DMultisample, GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height, GLboolean fixedsamplelocations) 
+   GLF(void, glTexImage2DMultisample, GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height, GLboolean fixedsamplelocations) \
+   GLF(GLsync, glFenceSync, GLenum condition, GLbitfield flags) \
+   GLF(GLenum, glClientWaitSync, GLsync sync, GLbitfield flags, GLuint64 timeout) \
+   GLF(void, glDeleteSync, GLsync sync) 
 GL_FUNCLIST_3_2;
 
 // GL_VERSION_3_3
+#define GL_TIME_ELAPSED                   0x88BF
+#define GL_ANY_SAMPLES_PASSED             0x8C2F
+#define GL_TIMESTAMP                      0x8E28
+
 #define GL_FUNCLIST_3_3 \
    GLF(void, glGenSamplers, GLsizei count, GLuint *samplers) \
    GLF(void, glDeleteSamplers, GLsizei count, const GLuint *samplers) \
    GLF(GLboolean, glIsSampler, GLuint sampler) \
    GLF(void, glBindSampler, GLuint unit, GLuint sampler) \
    GLF(void, glSamplerParameteri, GLuint sampler, GLenum pname, GLint param) \
-   GLF(void, glVertexAttribDivisor, GLuint index, GLuint divisor) 
+   GLF(void, glVertexAttribDivisor, GLuint index, GLuint divisor) \
+   GLF(void, glQueryCounter, GLuint id, GLenum target) \
+   GLF(void, glGetQueryObjecti64v, GLuint id, GLenum pname, GLint64 *params) \
+   GLF(void, glGetQueryObjectui64v, GLuint id, GLenum pname, GLuint64 *params) 
 GL_FUNCLIST_3_3;
 
+// GL_ARB_get_program_binary
+//   - core in 4.1, loaded as an optional extension, check the function pointers before use
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH          0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS     0x87FE
+#define GL_PROGRAM_BINARY_FORMATS         0x87FF
+
+#define GL_FUNCLIST_ARB_get_program_binary \
+   GLF(void, glGetProgramBinary, GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary) \
+   GLF(void, glProgramBinary, GLuint program, GLenum binaryFormat, const void *binary, GLsizei length) \
+   GLF(void, glProgramParameteri, GLuint program, GLenum pname, GLint value) 
+GL_FUNCLIST_ARB_get_program_binary;
+
+// GL_ARB_pipeline_statistics_query
+//   - core in 4.6, query targets only, a begin query that raises GL_INVALID_ENUM means no support
+#define GL_VERTEX_SHADER_INVOCATIONS      0x82F0
+
 #undef GLF
 
 #ifdef __cplusplus
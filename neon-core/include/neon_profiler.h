@@ -0,0 +1,111 @@
+// neon_profiler.h
+
+#ifndef NEON_PROFILER_H_INCLUDED
+#define NEON_PROFILER_H_INCLUDED
+
+#include "neon_core.h"
+#include <atomic>
+
+// note: build with NEON_PROFILER=0 to compile all zones and frame markers out
+#if !defined(NEON_PROFILER)
+#define NEON_PROFILER 1
+#endif
+
+#define NEON_PROFILE_CONCAT_(a, b) a##b
+#define NEON_PROFILE_CONCAT(a, b) NEON_PROFILE_CONCAT_(a, b)
+
+#if NEON_PROFILER
+#define NEON_PROFILE_SCOPE(name) neon::profiler::scope NEON_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define NEON_PROFILE_FRAME() neon::profiler::frame_marker()
+#else
+#define NEON_PROFILE_SCOPE(name) do {} while (0)
+#define NEON_PROFILE_FRAME() do {} while (0)
+#endif
+
+namespace neon {
+   // note: zones are recorded when they close into a ring owned by the
+   //       calling thread, only that thread writes to it so recording is a
+   //       store plus a release of the write index. readers copy the ring
+   //       and drop entries the writer lapped in the meantime. zone names
+   //       must be string literals, only the pointer is stored.
+   struct profiler {
+      static constexpr uint32 RING_CAPACITY = 1 << 14;
+      static constexpr uint32 FRAME_CAPACITY = 1 << 10;
+
+      struct zone {
+         const char *name_;
+         uint64 begin_;
+         uint64 end_;
+         uint32 depth_;
+      };
+
+      struct thread_ring {
+         thread_ring();
+
+         uint32 thread_id_;
+         uint32 depth_;
+         std::atomic<uint64> write_;
+         thread_ring *next_;
+         zone zones_[RING_CAPACITY];
+      };
+
+      struct summary {
+         const char *name_;
+         uint32 depth_;
+         uint32 count_;
+         uint64 first_;
+         double milliseconds_;
+      };
+
+      struct scope {
+         explicit scope(const char *name);
+         ~scope();
+
+         thread_ring *ring_;
+         const char *name_;
+         uint64 begin_;
+      };
+
+      static thread_ring *local_ring();
+      static thread_ring *register_thread();
+
+      static void frame_marker();
+      static void summarize(dynamic_array<summary> &result);
+      static bool write_chrome_trace(const string &filename);
+
+      static thread_local thread_ring *ring_;
+   };
+
+   inline profiler::thread_ring *profiler::local_ring() {
+      thread_ring *ring = ring_;
+      if (!ring) {
+         ring = register_thread();
+      }
+
+      return ring;
+   }
+
+   inline profiler::scope::scope(const char *name)
+      : ring_(local_ring())
+      , name_(name)
+   {
+      ring_->depth_++;
+      begin_ = cycle_counter::now();
+   }
+
+   inline profiler::scope::~scope() {
+      const uint64 end = cycle_counter::now();
+      const uint32 depth = --ring_->depth_;
+      const uint64 write = ring_->write_.load(std::memory_order_relaxed);
+
+      zone &entry = ring_->zones_[write & (RING_CAPACITY - 1)];
+      entry.name_ = name_;
+      entry.begin_ = begin_;
+      entry.end_ = end;
+      entry.depth_ = depth;
+
+      ring_->write_.store(write + 1, std::memory_order_release);
+   }
+} // !neon
+
+#endif // !NEON_PROFILER_H_INCLUDED
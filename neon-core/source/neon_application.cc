@@ -1,16 +1,30 @@
 // neon_application.cc
 
 #include "neon_core.h"
+#include "neon_profiler.h"
 
 namespace neon {
    application::application()
    {
    }
 
+   bool application::parse_argument(int, char **, int &) {
+      return false;
+   }
+
    bool application::init() {
       start_ = time::now();
       current_ = start_;
 
+      // note: benchmarks run as fast as they can
+      if (benchmark_.is_enabled()) {
+         pacer_.set_target_rate(0.0);
+         pacer_.set_vsync(false);
+         pacer_.set_fixed_step(benchmark_.fixed_deltatime_, 1);
+      }
+
+      pacer_.apply();
+
       if (!enter()) {
          return false;
       }
@@ -23,14 +37,34 @@ namespace neon {
    }
 
    bool application::frame() {
+      NEON_PROFILE_FRAME();
+      NEON_PROFILE_SCOPE("application::frame");
+
+      // note: the platform layer processed input right before calling us
+      pacer_.mark_input();
+
       const time now = time::now();
-      time deltatime_ = now - current_;
+      time deltatime = now - current_;
       current_ = now;
 
-      if (!tick(deltatime_)) {
-         return false;
+      // note: benchmarks simulate exactly one fixed step per frame so runs are repeatable
+      if (benchmark_.is_enabled()) {
+         deltatime = benchmark_.fixed_deltatime_;
+         benchmark_.begin_frame();
+      }
+
+      const uint32 steps = pacer_.accumulate(deltatime);
+      for (uint32 step = 0; step < steps; step++) {
+         if (!update(pacer_.fixed_step_)) {
+            return false;
+         }
+
+         keyboard_.clear_edges();
+         mouse_.clear_edges();
       }
 
+      render(pacer_.alpha());
+
       return true;
    }
 } // !neon
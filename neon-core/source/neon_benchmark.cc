@@ -0,0 +1,347 @@
+// neon_benchmark.cc
+
+#include "neon_core.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace neon {
+   namespace {
+      const char *benchmark_section_names[BENCHMARK_SECTION_COUNT] =
+      {
+         "update",
+         "cull",
+         "submit",
+         "swap",
+      };
+
+      bool parse_uint32(const char *text, uint32 &value) {
+         char *end = nullptr;
+         const long long result = strtoll(text, &end, 10);
+         if (*end != '\0' || result < 0) {
+            return false;
+         }
+
+         value = (uint32)result;
+         return true;
+      }
+
+      struct summary {
+         double mean_;
+         double min_;
+         double p50_;
+         double p90_;
+         double p95_;
+         double p99_;
+         double max_;
+      };
+
+      // note: nearest-rank percentiles, values must be sorted
+      double percentile(const dynamic_array<double> &values, double fraction) {
+         if (values.empty()) {
+            return 0.0;
+         }
+
+         size_t rank = (size_t)(fraction * (double)values.size() + 0.5);
+         if (rank < 1) {
+            rank = 1;
+         }
+         if (rank > values.size()) {
+            rank = values.size();
+         }
+
+         return values[rank - 1];
+      }
+
+      summary summarize(dynamic_array<double> values) {
+         summary result = {};
+         if (values.empty()) {
+            return result;
+         }
+
+         std::sort(values.begin(), values.end());
+
+         double total = 0.0;
+         for (double value : values) {
+            total += value;
+         }
+
+         result.mean_ = total / (double)values.size();
+         result.min_ = values.front();
+         result.p50_ = percentile(values, 0.50);
+         result.p90_ = percentile(values, 0.90);
+         result.p95_ = percentile(values, 0.95);
+         result.p99_ = percentile(values, 0.99);
+         result.max_ = values.back();
+
+         return result;
+      }
+
+      dynamic_array<double> collect(const dynamic_array<benchmark::sample> &samples, int section) {
+         dynamic_array<double> result;
+         result.reserve(samples.size());
+         for (auto &sample : samples) {
+            result.push_back(section < BENCHMARK_SECTION_COUNT ? sample.sections_[section] : sample.total_);
+         }
+
+         return result;
+      }
+   } // !anon
+
+   // static
+   const char *benchmark::section_name(benchmark_section section) {
+      return benchmark_section_names[section];
+   }
+
+   benchmark::benchmark()
+      : enabled_(false)
+      , warmup_frames_(60)
+      , frame_count_(600)
+      , frame_(0)
+      , fixed_deltatime_(time::from_seconds(1.0 / 60.0))
+      , report_filename_("benchmark.json")
+      , current_{}
+   {
+   }
+
+   bool benchmark::parse_argument(int argc, char **argv, int &index) {
+      const char *argument = argv[index];
+      const bool has_value = index + 1 < argc;
+
+      if (strcmp(argument, "--benchmark") == 0) {
+         enabled_ = true;
+         return true;
+      }
+      else if (strcmp(argument, "--warmup") == 0 && has_value) {
+         return parse_uint32(argv[++index], warmup_frames_);
+      }
+      else if (strcmp(argument, "--benchmark-frames") == 0 && has_value) {
+         return parse_uint32(argv[++index], frame_count_) && frame_count_ > 0;
+      }
+      else if (strcmp(argument, "--fixed-dt") == 0 && has_value) {
+         char *end = nullptr;
+         const double milliseconds = strtod(argv[++index], &end);
+         if (*end != '\0' || milliseconds <= 0.0) {
+            return false;
+         }
+
+         fixed_deltatime_ = time::from_milliseconds(milliseconds);
+         return true;
+      }
+      else if (strcmp(argument, "--report") == 0 && has_value) {
+         report_filename_ = argv[++index];
+         return true;
+      }
+
+      return false;
+   }
+
+   void benchmark::configure(uint32 warmup_frames, uint32 frame_count, const time &fixed_deltatime) {
+      enabled_ = true;
+      warmup_frames_ = warmup_frames;
+      frame_count_ = frame_count;
+      fixed_deltatime_ = fixed_deltatime;
+      frame_ = 0;
+      samples_.clear();
+      timings_.clear();
+   }
+
+   bool benchmark::is_enabled() const {
+      return enabled_;
+   }
+
+   bool benchmark::is_measuring() const {
+      return enabled_ && frame_ >= warmup_frames_ && !is_finished();
+   }
+
+   bool benchmark::is_finished() const {
+      return enabled_ && samples_.size() >= frame_count_;
+   }
+
+   void benchmark::begin_frame() {
+      if (!enabled_) {
+         return;
+      }
+
+      if (samples_.empty()) {
+         samples_.reserve(frame_count_);
+      }
+
+      current_ = {};
+      frame_start_ = time::now();
+   }
+
+   void benchmark::end_frame() {
+      if (!enabled_) {
+         return;
+      }
+
+      current_.total_ = (time::now() - frame_start_).as_milliseconds();
+      if (is_measuring()) {
+         samples_.push_back(current_);
+      }
+
+      frame_++;
+   }
+
+   void benchmark::begin(benchmark_section section) {
+      if (!enabled_) {
+         return;
+      }
+
+      section_start_[section] = time::now();
+   }
+
+   void benchmark::end(benchmark_section section) {
+      if (!enabled_) {
+         return;
+      }
+
+      // note: sections may be entered several times per frame
+      current_.sections_[section] += (time::now() - section_start_[section]).as_milliseconds();
+   }
+
+   void benchmark::add_metric(const string &name, double value) {
+      for (auto &item : metrics_) {
+         if (item.name_ == name) {
+            item.value_ = value;
+            return;
+         }
+      }
+
+      metrics_.push_back({ name, value });
+   }
+
+   void benchmark::add_timing(const string &name, double milliseconds) {
+      if (!is_measuring()) {
+         return;
+      }
+
+      for (auto &item : timings_) {
+         if (item.name_ == name) {
+            item.values_.push_back(milliseconds);
+            return;
+         }
+      }
+
+      timings_.push_back({ name, { milliseconds } });
+   }
+
+   string benchmark::report_json() const {
+      string result;
+      char line[512] = {};
+
+      snprintf(line, sizeof(line),
+               "{\n  \"frames\": %u,\n  \"warmup_frames\": %u,\n  \"fixed_deltatime_ms\": %.3f,\n  \"sections\": {\n",
+               (uint32)samples_.size(),
+               warmup_frames_,
+               fixed_deltatime_.as_milliseconds());
+      result += line;
+
+      for (int section = 0; section <= BENCHMARK_SECTION_COUNT; section++) {
+         const char *name = section < BENCHMARK_SECTION_COUNT ? benchmark_section_names[section] : "total";
+         const summary stats = summarize(collect(samples_, section));
+         snprintf(line, sizeof(line),
+                  "    \"%s\": { \"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+                  name,
+                  stats.mean_,
+                  stats.min_,
+                  stats.p50_,
+                  stats.p90_,
+                  stats.p95_,
+                  stats.p99_,
+                  stats.max_,
+                  section < BENCHMARK_SECTION_COUNT ? "," : "");
+         result += line;
+      }
+
+      result += "  },\n  \"timings\": {";
+      for (size_t index = 0; index < timings_.size(); index++) {
+         const summary stats = summarize(timings_[index].values_);
+         snprintf(line, sizeof(line),
+                  "%s\n    \"%s\": { \"count\": %u, \"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+                  index ? "," : "",
+                  timings_[index].name_.c_str(),
+                  (uint32)timings_[index].values_.size(),
+                  stats.mean_,
+                  stats.min_,
+                  stats.p50_,
+                  stats.p90_,
+                  stats.p95_,
+                  stats.p99_,
+                  stats.max_);
+         result += line;
+      }
+      result += timings_.empty() ? "},\n" : "\n  },\n";
+
+      result += "  \"metrics\": {";
+      for (size_t index = 0; index < metrics_.size(); index++) {
+         snprintf(line, sizeof(line), "%s\n    \"%s\": %.4f", index ? "," : "", metrics_[index].name_.c_str(), metrics_[index].value_);
+         result += line;
+      }
+      result += metrics_.empty() ? "},\n" : "\n  },\n";
+
+      result += "  \"frame_times_ms\": [";
+      for (size_t index = 0; index < samples_.size(); index++) {
+         snprintf(line, sizeof(line), "%s%.4f", index ? ", " : "", samples_[index].total_);
+         result += line;
+      }
+      result += "]\n}\n";
+
+      return result;
+   }
+
+   string benchmark::report_csv() const {
+      string result = "section,mean,min,p50,p90,p95,p99,max\n";
+      char line[256] = {};
+
+      for (int section = 0; section <= BENCHMARK_SECTION_COUNT; section++) {
+         const char *name = section < BENCHMARK_SECTION_COUNT ? benchmark_section_names[section] : "total";
+         const summary stats = summarize(collect(samples_, section));
+         snprintf(line, sizeof(line), "%s,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+                  name,
+                  stats.mean_,
+                  stats.min_,
+                  stats.p50_,
+                  stats.p90_,
+                  stats.p95_,
+                  stats.p99_,
+                  stats.max_);
+         result += line;
+      }
+
+      for (auto &item : timings_) {
+         const summary stats = summarize(item.values_);
+         snprintf(line, sizeof(line), "%s,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+                  item.name_.c_str(),
+                  stats.mean_,
+                  stats.min_,
+                  stats.p50_,
+                  stats.p90_,
+                  stats.p95_,
+                  stats.p99_,
+                  stats.max_);
+         result += line;
+      }
+
+      if (!metrics_.empty()) {
+         result += "\nmetric,value\n";
+         for (auto &item : metrics_) {
+            snprintf(line, sizeof(line), "%s,%.4f\n", item.name_.c_str(), item.value_);
+            result += line;
+         }
+      }
+
+      return result;
+   }
+
+   bool benchmark::write_report() const {
+      const string &filename = report_filename_;
+      const bool is_csv = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0;
+      const string report = is_csv ? report_csv() : report_json();
+
+      dynamic_array<uint8> content(report.begin(), report.end());
+      return file_system::write_file_content(filename, content, true);
+   }
+} // !neon
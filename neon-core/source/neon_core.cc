@@ -3,5 +3,19 @@
 #include "neon_core.h"
 
 namespace neon {
+   // static
+   uint64 hash::fnv1a(const void *data, const uint64 size, const uint64 seed) {
+      const uint8 *bytes = (const uint8 *)data;
+      uint64 result = seed;
+      for (uint64 index = 0; index < size; index++) {
+         result ^= bytes[index];
+         result *= 0x100000001b3ull;
+      }
 
+      return result;
+   }
+
+   uint64 hash::fnv1a(const string &text, const uint64 seed) {
+      return fnv1a(text.data(), text.size(), seed);
+   }
 } // !neon
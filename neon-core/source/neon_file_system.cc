@@ -1,10 +1,19 @@
 // neon_file_system.cc
 
 #include "neon_core.h"
+#include <cstdio>
 
+#if defined(_WIN32)
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <Shlobj.h> // SHGetKnownFolderPath
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace neon {
    template <typename Fn>
@@ -19,6 +28,7 @@ namespace neon {
       return scope_guard<Fn>(f);
    }
 
+#if defined(_WIN32)
    namespace {
       void string_replace(std::string &str, char old_ch, char new_ch) {
          std::string::size_type pos;
@@ -69,7 +79,8 @@ namespace neon {
       }
 
       content.resize(size.QuadPart);
-      if (!ReadFile(handle, content.data(), size.LowPart, NULL, NULL)) {
+      DWORD read = 0;
+      if (!ReadFile(handle, content.data(), size.LowPart, &read, NULL) || read != size.LowPart) {
          return false;
       }
 
@@ -98,16 +109,13 @@ namespace neon {
          CloseHandle(handle);
       }));
 
-      if (allow_overwrite) {
-         DWORD error = GetLastError();
-         if (error != ERROR_ALREADY_EXISTS) {
-            return false;
-         }
-      }
+      // note: CREATE_ALWAYS reports ERROR_ALREADY_EXISTS when it truncated an
+      //       existing file, a fresh file is not an error either way
 
       LARGE_INTEGER size = {};
       size.QuadPart = content.size();
-      if (!WriteFile(handle, content.data(), size.LowPart, NULL, NULL)) {
+      DWORD written = 0;
+      if (!WriteFile(handle, content.data(), size.LowPart, &written, NULL) || written != size.LowPart) {
          return false;
       }
 
@@ -150,6 +158,36 @@ namespace neon {
       return true;
    }
 
+   bool file_system::remove_directory(const string &name) {
+      // note: the directory has to be empty
+      if (!RemoveDirectoryA(name.c_str())) {
+         return GetLastError() == ERROR_FILE_NOT_FOUND;
+      }
+
+      return true;
+   }
+
+   string file_system::create_temporary_directory(const string &prefix) {
+      char buf[MAX_PATH] = {};
+      const DWORD length = GetTempPathA(MAX_PATH, buf);
+      if (length == 0 || length >= MAX_PATH) {
+         return "";
+      }
+
+      string base(buf, length);
+      string_replace(base, '\\', '/');
+      for (uint32 attempt = 0; attempt < 64; attempt++) {
+         char name[64] = {};
+         snprintf(name, sizeof(name), "%s-%lu-%lu", prefix.c_str(), GetCurrentProcessId(), GetTickCount() + attempt);
+         const string result = base + name;
+         if (CreateDirectoryA(result.c_str(), NULL)) {
+            return result + '/';
+         }
+      }
+
+      return "";
+   }
+
    string file_system::get_app_directory() {
       string result;
       char buf[MAX_PATH] = {};
@@ -186,12 +224,171 @@ namespace neon {
          }
 
          string_replace(result, '\\', '/');
+         result += '/';
          result.append(app_name);
          result += '/';
       }
 
       return result;
    }
+#else
+   // static 
+   bool file_system::exists(const string &filename) {
+      struct stat info = {};
+      return stat(filename.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+   }
+
+   bool file_system::read_file_content(const string &filename, dynamic_array<uint8> &content) {
+      int handle = open(filename.c_str(), O_RDONLY);
+      if (handle < 0) {
+         return false;
+      }
+
+      auto defer = make_scope_guard(([&]() {
+         close(handle);
+      }));
+
+      struct stat info = {};
+      if (fstat(handle, &info) != 0) {
+         return false;
+      }
+
+      content.resize((size_t)info.st_size);
+      size_t offset = 0;
+      while (offset < content.size()) {
+         ssize_t result = read(handle, content.data() + offset, content.size() - offset);
+         if (result < 0 && errno == EINTR) {
+            continue;
+         }
+
+         if (result <= 0) {
+            return false;
+         }
+
+         offset += (size_t)result;
+      }
+
+      return true;
+   }
+
+   bool file_system::write_file_content(const string &filename, const dynamic_array<uint8> &content, bool allow_overwrite) {
+      const int flags = O_WRONLY | O_CREAT | (allow_overwrite ? O_TRUNC : O_EXCL);
+      int handle = open(filename.c_str(), flags, 0644);
+      if (handle < 0) {
+         return false;
+      }
+
+      auto defer = make_scope_guard(([&]() {
+         close(handle);
+      }));
+
+      size_t offset = 0;
+      while (offset < content.size()) {
+         ssize_t result = write(handle, content.data() + offset, content.size() - offset);
+         if (result < 0 && errno == EINTR) {
+            continue;
+         }
+
+         if (result <= 0) {
+            return false;
+         }
+
+         offset += (size_t)result;
+      }
+
+      return true;
+   }
+
+   bool file_system::remove_file(const string &filename) {
+      if (unlink(filename.c_str()) != 0 && errno != ENOENT) {
+         return false;
+      }
+
+      return true;
+   }
+
+   bool file_system::create_directory(const string &name) {
+      // note: create every missing parent, like SHCreateDirectoryEx
+      string path;
+      for (size_t index = 0; index <= name.size(); index++) {
+         if (index == name.size() || name[index] == '/') {
+            if (!path.empty() && mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+               return false;
+            }
+         }
+
+         if (index < name.size()) {
+            path += name[index];
+         }
+      }
+
+      return true;
+   }
+
+   bool file_system::remove_directory(const string &name) {
+      // note: the directory has to be empty
+      if (rmdir(name.c_str()) != 0 && errno != ENOENT) {
+         return false;
+      }
+
+      return true;
+   }
+
+   string file_system::create_temporary_directory(const string &prefix) {
+      const char *temp = getenv("TMPDIR");
+      string result = temp && temp[0] ? temp : "/tmp";
+      if (result.back() != '/') {
+         result += '/';
+      }
+      result += prefix;
+      result += "-XXXXXX";
+
+      if (!mkdtemp(&result[0])) {
+         return "";
+      }
+
+      return result + '/';
+   }
+
+   string file_system::get_app_directory() {
+      string result;
+      char buf[4096] = {};
+      ssize_t length = readlink("/proc/self/exe", buf, sizeof(buf) - 1);
+      if (length > 0) {
+         result.assign(buf, (size_t)length);
+         result = result.substr(0, result.find_last_of('/'));
+         result += '/';
+      }
+
+      return result;
+   }
+
+   string file_system::get_save_directory(const string &app_name) {
+      string result;
+      const char *data_home = getenv("XDG_DATA_HOME");
+      const char *home = getenv("HOME");
+      if (data_home && data_home[0]) {
+         result = data_home;
+      }
+      else if (home && home[0]) {
+         result = home;
+         result += "/.local/share";
+      }
+      else {
+         return "";
+      }
+
+      result += '/';
+      result.append(app_name);
+      result += '/';
+
+      if (!create_directory(result)) {
+         return "";
+      }
+
+      return result;
+   }
+#endif
 
    file_system::file_system()
    {
@@ -0,0 +1,205 @@
+// neon_frame_pacer.cc
+
+#include "neon_core.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#else
+#include <sched.h>
+#include <time.h>
+#endif
+
+namespace neon {
+   namespace {
+      void sleep_for(const time &duration) {
+#if defined(_WIN32)
+         // note: whole milliseconds only, the spin takes care of the rest
+         const DWORD milliseconds = (DWORD)(duration.as_nanoseconds() / 1000000);
+         if (milliseconds > 0) {
+            Sleep(milliseconds);
+         }
+#else
+         timespec request = {};
+         request.tv_sec = (time_t)(duration.as_nanoseconds() / 1000000000ll);
+         request.tv_nsec = (long)(duration.as_nanoseconds() % 1000000000ll);
+         nanosleep(&request, nullptr);
+#endif
+      }
+
+      void spin_pause() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+         _mm_pause();
+#else
+         sched_yield();
+#endif
+      }
+   } // !anon
+
+   frame_pacer::statistics::statistics()
+      : missed_deadlines_(0)
+   {
+   }
+
+   frame_pacer::frame_pacer()
+      : sleep_margin_(time::from_milliseconds(1.0))
+      , vsync_(true)
+      , fixed_step_(time::from_seconds(1.0 / 60.0))
+      , max_steps_(8)
+   {
+#if defined(_WIN32)
+      // note: raise the scheduler resolution so Sleep(1) sleeps about a millisecond
+      timeBeginPeriod(1);
+#endif
+   }
+
+   frame_pacer::~frame_pacer() {
+#if defined(_WIN32)
+      timeEndPeriod(1);
+#endif
+   }
+
+   bool frame_pacer::parse_argument(int argc, char **argv, int &index) {
+      const char *argument = argv[index];
+      if (strcmp(argument, "--vsync") == 0) {
+         vsync_ = true;
+         return true;
+      }
+      else if (strcmp(argument, "--no-vsync") == 0) {
+         vsync_ = false;
+         return true;
+      }
+      else if (strcmp(argument, "--target-fps") == 0 && index + 1 < argc) {
+         char *end = nullptr;
+         const double rate = strtod(argv[++index], &end);
+         if (*end != '\0' || rate < 0.0) {
+            return false;
+         }
+
+         set_target_rate(rate);
+         return true;
+      }
+
+      return false;
+   }
+
+   void frame_pacer::set_target_rate(const double frames_per_second) {
+      target_interval_ = frames_per_second > 0.0 ? time::from_seconds(1.0 / frames_per_second) : time();
+      deadline_ = time();
+   }
+
+   void frame_pacer::set_vsync(bool enabled) {
+      vsync_ = enabled;
+   }
+
+   bool frame_pacer::apply() {
+      return window::set_swap_interval(vsync_ ? 1 : 0);
+   }
+
+   void frame_pacer::mark_input() {
+      input_ = time::now();
+   }
+
+   void frame_pacer::mark_presented() {
+      const time now = time::now();
+      if (presented_ != time()) {
+         statistics_.frame_time_ = now - presented_;
+      }
+      presented_ = now;
+
+      statistics_.latency_ = now - input_;
+      if (statistics_.max_latency_ < statistics_.latency_) {
+         statistics_.max_latency_ = statistics_.latency_;
+      }
+
+      // note: exponential moving average over roughly the last 16 frames
+      const int64 average = statistics_.average_latency_.as_nanoseconds();
+      statistics_.average_latency_ = time(average + (statistics_.latency_.as_nanoseconds() - average) / 16);
+   }
+
+   void frame_pacer::wait() {
+      if (target_interval_ == time()) {
+         return;
+      }
+
+      time now = time::now();
+      const time deadline = deadline_ + target_interval_;
+
+      // note: more than a frame behind, start over instead of rushing to catch up
+      if (deadline_ == time() || now > deadline + target_interval_) {
+         if (deadline_ != time()) {
+            statistics_.missed_deadlines_++;
+         }
+
+         deadline_ = now;
+         return;
+      }
+
+      while (deadline - now > sleep_margin_) {
+         const time request = deadline - now - sleep_margin_;
+         const time before = now;
+         sleep_for(request);
+         now = time::now();
+
+         // note: widen the margin right away when we overslept, narrow it slowly otherwise
+         const time overshoot = (now - before) - request;
+         if (overshoot > sleep_margin_) {
+            sleep_margin_ = overshoot;
+         }
+         else {
+            const int64 margin = sleep_margin_.as_nanoseconds();
+            sleep_margin_ = time(margin - (margin - overshoot.as_nanoseconds()) / 64);
+         }
+
+         if (now > deadline) {
+            statistics_.missed_deadlines_++;
+            break;
+         }
+      }
+
+      while (now < deadline) {
+         spin_pause();
+         now = time::now();
+      }
+
+      deadline_ = deadline;
+   }
+
+   void frame_pacer::set_fixed_step(const time &step, uint32 max_steps) {
+      fixed_step_ = step;
+      max_steps_ = max_steps;
+      accumulator_ = time();
+   }
+
+   uint32 frame_pacer::accumulate(const time &deltatime) {
+      accumulator_ += deltatime;
+
+      const int64 step = fixed_step_.as_nanoseconds();
+      if (step <= 0) {
+         return 0;
+      }
+
+      int64 steps = accumulator_.as_nanoseconds() / step;
+      if (steps > (int64)max_steps_) {
+         // note: we cannot keep up, drop the simulation time we would never catch up on
+         accumulator_ = time(accumulator_.as_nanoseconds() % step);
+         return max_steps_;
+      }
+
+      accumulator_ -= time(steps * step);
+      return (uint32)steps;
+   }
+
+   double frame_pacer::alpha() const {
+      const int64 step = fixed_step_.as_nanoseconds();
+      if (step <= 0) {
+         return 0.0;
+      }
+
+      return (double)accumulator_.as_nanoseconds() / (double)step;
+   }
+} // !neon
@@ -19,4 +19,11 @@ namespace neon {
    bool keyboard::is_released(keycode index) const {
       return keys_[index].released_;
    }
+
+   void keyboard::clear_edges() {
+      for (auto &key : keys_) {
+         key.pressed_ = false;
+         key.released_ = false;
+      }
+   }
 } // !neon
@@ -22,4 +22,12 @@ namespace neon {
    bool mouse::is_released(mouse_button index) const {
       return buttons_[index].released_;
    }
+
+   void mouse::clear_edges() {
+      delta_ = 0;
+      for (auto &button : buttons_) {
+         button.pressed_ = false;
+         button.released_ = false;
+      }
+   }
 } // !neon
@@ -0,0 +1,164 @@
+// neon_profiler.cc
+
+#include "neon_profiler.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace neon {
+   namespace {
+      const uint64 epoch_ticks = cycle_counter::now();
+
+      std::atomic<profiler::thread_ring *> ring_list{ nullptr };
+      std::atomic<uint32> thread_count{ 0 };
+
+      uint64 frames[profiler::FRAME_CAPACITY] = {};
+      std::atomic<uint64> frame_count{ 0 };
+
+      // note: copies the zones still present in the ring, oldest first
+      void copy_ring(const profiler::thread_ring &ring, dynamic_array<profiler::zone> &zones) {
+         const uint64 write = ring.write_.load(std::memory_order_acquire);
+         uint64 first = write > profiler::RING_CAPACITY ? write - profiler::RING_CAPACITY : 0;
+
+         zones.clear();
+         zones.reserve((size_t)(write - first));
+         for (uint64 index = first; index < write; index++) {
+            zones.push_back(ring.zones_[index & (profiler::RING_CAPACITY - 1)]);
+         }
+
+         // note: drop what the owning thread overwrote while we were copying
+         const uint64 lapped = ring.write_.load(std::memory_order_acquire);
+         if (lapped > profiler::RING_CAPACITY && lapped - profiler::RING_CAPACITY > first) {
+            const uint64 skip = std::min<uint64>(lapped - profiler::RING_CAPACITY - first, zones.size());
+            zones.erase(zones.begin(), zones.begin() + (size_t)skip);
+         }
+      }
+   } // !anon
+
+   thread_local profiler::thread_ring *profiler::ring_ = nullptr;
+
+   profiler::thread_ring::thread_ring()
+      : thread_id_(0)
+      , depth_(0)
+      , write_(0)
+      , next_(nullptr)
+   {
+   }
+
+   // static
+   profiler::thread_ring *profiler::register_thread() {
+      // note: rings outlive their threads so zones can still be exported
+      thread_ring *ring = new thread_ring;
+      ring->thread_id_ = ++thread_count;
+
+      thread_ring *head = ring_list.load(std::memory_order_relaxed);
+      do {
+         ring->next_ = head;
+      } while (!ring_list.compare_exchange_weak(head, ring, std::memory_order_release, std::memory_order_relaxed));
+
+      ring_ = ring;
+      return ring;
+   }
+
+   // static
+   void profiler::frame_marker() {
+      const uint64 index = frame_count.load(std::memory_order_relaxed);
+      frames[index & (FRAME_CAPACITY - 1)] = cycle_counter::now();
+      frame_count.store(index + 1, std::memory_order_release);
+   }
+
+   // static
+   void profiler::summarize(dynamic_array<summary> &result) {
+      result.clear();
+
+      // note: the last complete frame lies between the two latest markers
+      const uint64 count = frame_count.load(std::memory_order_acquire);
+      if (count < 2) {
+         return;
+      }
+
+      const uint64 frame_begin = frames[(count - 2) & (FRAME_CAPACITY - 1)];
+      const uint64 frame_end = frames[(count - 1) & (FRAME_CAPACITY - 1)];
+
+      dynamic_array<zone> zones;
+      copy_ring(*local_ring(), zones);
+
+      const double nanoseconds_per_cycle = cycle_counter::nanoseconds_per_cycle();
+
+      for (auto &entry : zones) {
+         if (entry.begin_ < frame_begin || entry.end_ > frame_end) {
+            continue;
+         }
+
+         auto it = std::find_if(result.begin(), result.end(), [&](const summary &item) {
+            return item.name_ == entry.name_ && item.depth_ == entry.depth_;
+         });
+
+         if (it == result.end()) {
+            summary item = {};
+            item.name_ = entry.name_;
+            item.depth_ = entry.depth_;
+            item.first_ = entry.begin_;
+            result.push_back(item);
+            it = result.end() - 1;
+         }
+
+         it->count_++;
+         it->first_ = std::min(it->first_, entry.begin_);
+         it->milliseconds_ += (double)(entry.end_ - entry.begin_) * nanoseconds_per_cycle * 1e-6;
+      }
+
+      // note: zones are recorded when they close, order by start for a readable hierarchy
+      std::sort(result.begin(), result.end(), [](const summary &lhs, const summary &rhs) {
+         if (lhs.first_ != rhs.first_) {
+            return lhs.first_ < rhs.first_;
+         }
+
+         return lhs.depth_ < rhs.depth_;
+      });
+   }
+
+   // static
+   bool profiler::write_chrome_trace(const string &filename) {
+      string result = "{\"traceEvents\":[\n";
+      char line[256] = {};
+      bool first = true;
+
+      const double nanoseconds_per_tick = cycle_counter::nanoseconds_per_cycle();
+      auto to_microseconds = [&](uint64 ticks) {
+         return (double)(int64)(ticks - epoch_ticks) * nanoseconds_per_tick * 1e-3;
+      };
+
+      dynamic_array<zone> zones;
+      for (thread_ring *ring = ring_list.load(std::memory_order_acquire); ring; ring = ring->next_) {
+         copy_ring(*ring, zones);
+         for (auto &entry : zones) {
+            snprintf(line, sizeof(line),
+                     "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                     first ? "" : ",\n",
+                     entry.name_,
+                     ring->thread_id_,
+                     to_microseconds(entry.begin_),
+                     (double)(entry.end_ - entry.begin_) * nanoseconds_per_tick * 1e-3);
+            result += line;
+            first = false;
+         }
+      }
+
+      const uint64 count = frame_count.load(std::memory_order_acquire);
+      const uint64 oldest = count > FRAME_CAPACITY ? count - FRAME_CAPACITY : 0;
+      for (uint64 index = oldest; index < count; index++) {
+         snprintf(line, sizeof(line),
+                  "%s{\"name\":\"frame %llu\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}",
+                  first ? "" : ",\n",
+                  (unsigned long long)index,
+                  to_microseconds(frames[index & (FRAME_CAPACITY - 1)]));
+         result += line;
+         first = false;
+      }
+
+      result += "\n]}\n";
+
+      dynamic_array<uint8> content(result.begin(), result.end());
+      return file_system::write_file_content(filename, content, true);
+   }
+} // !neon
@@ -0,0 +1,136 @@
+// neon_thread_pool.cc
+
+#include "neon_core.h"
+
+namespace neon {
+   // static
+   uint32 thread_pool::default_worker_count() {
+      const uint32 hardware = std::thread::hardware_concurrency();
+      return hardware > 1 ? hardware - 1 : 1;
+   }
+
+   thread_pool::thread_pool()
+      : job_(nullptr)
+      , count_(0)
+      , next_(0)
+      , remaining_(0)
+      , active_(0)
+      , generation_(0)
+      , running_(false)
+   {
+   }
+
+   thread_pool::~thread_pool() {
+      destroy();
+   }
+
+   bool thread_pool::create(uint32 worker_count) {
+      if (running_) {
+         return false;
+      }
+
+      running_ = true;
+      workers_.reserve(worker_count);
+      for (uint32 slot = 1; slot <= worker_count; slot++) {
+         workers_.emplace_back(&thread_pool::work, this, slot);
+      }
+
+      return true;
+   }
+
+   void thread_pool::destroy() {
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         if (!running_) {
+            return;
+         }
+
+         running_ = false;
+      }
+
+      wake_.notify_all();
+      for (auto &worker : workers_) {
+         worker.join();
+      }
+
+      workers_.clear();
+   }
+
+   uint32 thread_pool::worker_count() const {
+      return (uint32)workers_.size();
+   }
+
+   void thread_pool::parallel_for(uint32 count, const job &function) {
+      if (count == 0) {
+         return;
+      }
+
+      if (workers_.empty()) {
+         for (uint32 index = 0; index < count; index++) {
+            function(index, 0);
+         }
+
+         return;
+      }
+
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         job_ = &function;
+         count_ = count;
+         next_ = 0;
+         remaining_ = count;
+         generation_++;
+      }
+
+      wake_.notify_all();
+      run(function, count, 0);
+
+      // note: also wait for workers that woke up late, they still hold on to the job
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_.wait(lock, [this] { return remaining_ == 0 && active_ == 0; });
+      job_ = nullptr;
+   }
+
+   void thread_pool::work(uint32 slot) {
+      uint32 seen = 0;
+      for (;;) {
+         const job *function = nullptr;
+         uint32 count = 0;
+         {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return !running_ || (job_ && generation_ != seen); });
+            if (!running_) {
+               return;
+            }
+
+            seen = generation_;
+            function = job_;
+            count = count_;
+            active_++;
+         }
+
+         run(*function, count, slot);
+
+         std::lock_guard<std::mutex> lock(mutex_);
+         if (--active_ == 0 && remaining_ == 0) {
+            done_.notify_all();
+         }
+      }
+   }
+
+   void thread_pool::run(const job &function, uint32 count, uint32 slot) {
+      for (;;) {
+         const uint32 index = next_.fetch_add(1);
+         if (index >= count) {
+            return;
+         }
+
+         function(index, slot);
+
+         if (remaining_.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.notify_all();
+         }
+      }
+   }
+} // !neon
@@ -2,26 +2,81 @@
 
 #include "neon_core.h"
 
+#if defined(_WIN32)
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
+#else
+#include <time.h>
+#endif
 
 namespace neon {
+   namespace {
+      struct cycle_calibration {
+         cycle_calibration()
+            : cycles_(cycle_counter::now())
+            , time_(time::now())
+         {
+         }
+
+         uint64 cycles_;
+         time time_;
+      };
+
+      const cycle_calibration calibration;
+   } // !anon
+
+#if defined(_WIN32)
    // static
    time time::now() {
       static LARGE_INTEGER start = {};
-      static int64 factor = 0;
-      if (!factor)
+      static int64 frequency = 0;
+      if (!frequency)
       {
          LARGE_INTEGER f = {};
          QueryPerformanceFrequency(&f);
-         factor = f.QuadPart / 1000;
+         frequency = f.QuadPart;
          QueryPerformanceCounter(&start);
       }
 
       LARGE_INTEGER now = {};
       QueryPerformanceCounter(&now);
 
-      return time((now.QuadPart - start.QuadPart) / factor);
+      // note: split into whole seconds and remainder so the multiply cannot overflow
+      const int64 counter = now.QuadPart - start.QuadPart;
+      const int64 seconds = counter / frequency;
+      const int64 remainder = counter % frequency;
+      return time(seconds * 1000000000ll + remainder * 1000000000ll / frequency);
+   }
+#else
+   // static
+   time time::now() {
+      static timespec start = {};
+      if (!start.tv_sec && !start.tv_nsec) {
+         clock_gettime(CLOCK_MONOTONIC, &start);
+      }
+
+      timespec now = {};
+      clock_gettime(CLOCK_MONOTONIC, &now);
+
+      const int64 seconds = (int64)now.tv_sec - (int64)start.tv_sec;
+      const int64 nanoseconds = (int64)now.tv_nsec - (int64)start.tv_nsec;
+      return time(seconds * 1000000000ll + nanoseconds);
+   }
+#endif
+
+   // static
+   time time::from_seconds(const double seconds) {
+      return time((int64)(seconds * 1e9));
+   }
+
+   // static
+   time time::from_milliseconds(const double milliseconds) {
+      return time((int64)(milliseconds * 1e6));
+   }
+
+   // static
+   time time::from_microseconds(const double microseconds) {
+      return time((int64)(microseconds * 1e3));
    }
 
    time::time()
@@ -68,11 +123,57 @@ namespace neon {
       return tick_ != rhs.tick_;
    }
 
-   float time::as_seconds() const {
-      return tick_ * 0.001f;
+   double time::as_seconds() const {
+      return (double)tick_ * 1e-9;
+   }
+
+   double time::as_milliseconds() const {
+      return (double)tick_ * 1e-6;
+   }
+
+   double time::as_microseconds() const {
+      return (double)tick_ * 1e-3;
+   }
+
+   int64 time::as_nanoseconds() const {
+      return tick_;
+   }
+
+   // static
+   double cycle_counter::nanoseconds_per_cycle() {
+      // note: measure over at least a millisecond the first time around
+      time elapsed = time::now() - calibration.time_;
+      while (elapsed < time::from_milliseconds(1.0)) {
+         elapsed = time::now() - calibration.time_;
+      }
+
+      const uint64 cycles = now() - calibration.cycles_;
+      if (cycles == 0) {
+         return 1.0;
+      }
+
+      return (double)elapsed.as_nanoseconds() / (double)cycles;
+   }
+
+   // static
+   time cycle_counter::to_time(const uint64 cycles) {
+      return time((int64)((double)cycles * nanoseconds_per_cycle()));
+   }
+
+   cycle_counter::cycle_counter()
+      : start_(now())
+   {
+   }
+
+   void cycle_counter::reset() {
+      start_ = now();
+   }
+
+   uint64 cycle_counter::elapsed_cycles() const {
+      return now() - start_;
    }
 
-   float time::as_milliseconds() const {
-      return tick_ * 1.0f;
+   time cycle_counter::elapsed() const {
+      return to_time(elapsed_cycles());
    }
 } // !neon
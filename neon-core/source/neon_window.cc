@@ -2,11 +2,19 @@
 
 #include "neon_core.h"
 
+#if defined(_WIN32)
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <windowsx.h>
 
 extern HWND win32_get_window_handle();
+extern bool win32_set_swap_interval(int interval);
+#else
+// note: implemented by the headless platform layer
+extern void headless_get_display_size(int &width, int &height);
+extern void headless_set_display_size(int width, int height);
+extern bool egl_set_swap_interval(int interval);
+#endif
 
 namespace neon {
    window::display_mode::display_mode()
@@ -21,6 +29,7 @@ namespace neon {
    {
    }
 
+#if defined(_WIN32)
    // static
    bool window::get_available_display_modes(dynamic_array<display_mode> &modes) {
       DEVMODE desktop_mode = {};
@@ -93,4 +102,35 @@ namespace neon {
       }
       return false;
    }
+
+   bool window::set_swap_interval(int32 interval) {
+      return win32_set_swap_interval(interval);
+   }
+#else
+   // static
+   bool window::get_available_display_modes(dynamic_array<display_mode> &modes) {
+      display_mode mode;
+      get_desktop_display_mode(mode);
+      modes.push_back(mode);
+      return true;
+   }
+
+   bool window::get_desktop_display_mode(display_mode &mode) {
+      headless_get_display_size(mode.width_, mode.height_);
+      return true;
+   }
+
+   void window::set_display_mode(const display_mode &mode) {
+      headless_set_display_size(mode.width_, mode.height_);
+   }
+
+   bool window::get_display_mode(display_mode &mode) {
+      headless_get_display_size(mode.width_, mode.height_);
+      return true;
+   }
+
+   bool window::set_swap_interval(int32 interval) {
+      return egl_set_swap_interval(interval);
+   }
+#endif
 } // !neon
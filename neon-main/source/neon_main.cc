@@ -2,6 +2,8 @@
 
 #include <neon_core.h>
 
+#if defined(_WIN32)
+
 #include <Windows.h>
 #include <windowsx.h>
 
@@ -102,10 +104,8 @@ win32_main_proc(HWND window, UINT message, WPARAM wParam, LPARAM lParam) {
 
 static void
 input_state_process(input_state &is, neon::keyboard &kb) {
+   // note: edges are cleared by the application once an update has seen them
    for (int index = 0; index < neon::keycode::KEYCODE_COUNT; index++) {
-      kb.keys_[index].pressed_ = false;
-      kb.keys_[index].released_ = false;
-
       if (is.keys_[index].current_ != is.keys_[index].previous_) {
          if (is.keys_[index].current_) {
             kb.keys_[index].down_ = true;
@@ -126,13 +126,10 @@ input_state_process(input_state &is, neon::mouse &mb) {
    mb.x_ = is.x_;
    mb.y_ = is.y_;
 
-   mb.delta_ = is.delta_;
+   mb.delta_ += is.delta_;
    is.delta_ = 0;
 
    for (int index = 0; index < neon::mouse_button::MOUSE_BUTTON_COUNT; index++) {
-      mb.buttons_[index].pressed_ = false;
-      mb.buttons_[index].released_ = false;
-
       if (is.buttons_[index].current_ != is.buttons_[index].previous_) {
          if (is.buttons_[index].current_) {
             mb.buttons_[index].down_ = true;
@@ -294,6 +291,16 @@ int WINAPI WinMain(_In_ HINSTANCE instance,
    int req_width = width;
    int req_height = height;
    auto app = neon::application::create(req_width, req_height, title);
+
+   // note: unknown arguments are ignored, see neon_benchmark.cc, neon_frame_pacer.cc and the application for the flags
+   for (int index = 1; index < __argc; index++) {
+      if (!app->pacer_.parse_argument(__argc, __argv, index) &&
+          !app->benchmark_.parse_argument(__argc, __argv, index))
+      {
+         app->parse_argument(__argc, __argv, index);
+      }
+   }
+
    if (!app->init()) {
       return -1;
    }
@@ -318,13 +325,25 @@ int WINAPI WinMain(_In_ HINSTANCE instance,
       input_state_process(is, app->keyboard_);
       input_state_process(is, app->mouse_);
 
-      // todo: frame limit?
       if (!app->frame()) {
          running = false;
       }
 
+      app->benchmark_.begin(neon::BENCHMARK_SECTION_SWAP);
       SwapBuffers(device);
-      Sleep(16);
+      app->benchmark_.end(neon::BENCHMARK_SECTION_SWAP);
+      app->benchmark_.end_frame();
+      app->pacer_.mark_presented();
+
+      if (app->benchmark_.is_finished()) {
+         running = false;
+      }
+
+      app->pacer_.wait();
+   }
+
+   if (app->benchmark_.is_finished()) {
+      app->benchmark_.write_report();
    }
 
    app->exit();
@@ -332,3 +351,4 @@ int WINAPI WinMain(_In_ HINSTANCE instance,
 
    return 0;
 }
+#endif // _WIN32
@@ -0,0 +1,220 @@
+// neon_main_headless.cc
+
+#include <neon_core.h>
+#include <neon_opengl.h>
+#include <neon_profiler.h>
+
+#if !defined(_WIN32)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// notes:
+//   - headless platform layer, renders into an offscreen egl context so the
+//     testbed can run on build machines without a display server or gpu
+//     (mesa llvmpipe through the surfaceless platform works)
+//   - built by the Makefile in the repository root (make, make check,
+//     make benchmark), assimp is optional there
+//   - usage: neon-headless [--frames N] [--width W] [--height H] [benchmark flags]
+//     runs until the application quits, N frames have been rendered or the
+//     benchmark is finished, there is no input so keyboard and mouse stay idle
+//   - benchmark: neon-headless --benchmark --warmup 60 --benchmark-frames 600 --fixed-dt 16 --report out.json
+//     a report filename ending in .csv writes the csv summary instead
+//   - --trace FILE saves the profiler zones as a chrome://tracing capture on exit
+//   - --target-fps N paces the loop like a windowed run, vsync is off by default
+//   - --check-pacer feeds the fixed-step accumulator synthetic frame times,
+//     checks the step counts and what is left over, then exits without a
+//     context. a non-zero exit code means a check failed
+//   - anything else goes to application::parse_argument, see the testbed for its flags
+
+extern bool egl_create_headless_opengl_context(int width, int height, int major, int minor);
+extern void egl_destroy_headless_opengl_context();
+extern void egl_swap_buffers();
+
+static int g_display_width = 1280;
+static int g_display_height = 720;
+
+void headless_get_display_size(int &width, int &height) {
+   width = g_display_width;
+   height = g_display_height;
+}
+
+void headless_set_display_size(int width, int height) {
+   // note: the pbuffer keeps its size, applications render into their own framebuffers
+   g_display_width = width;
+   g_display_height = height;
+}
+
+static bool
+headless_parse_int(int argc, char **argv, int &index, int &value) {
+   if (index + 1 >= argc) {
+      return false;
+   }
+
+   char *end = nullptr;
+   const long result = strtol(argv[++index], &end, 10);
+   if (*end != '\0' || result <= 0) {
+      return false;
+   }
+
+   value = (int)result;
+   return true;
+}
+
+struct pacer_check {
+   const char *name_;
+   double delta_ms_;
+   neon::uint32 steps_;
+   double remaining_ms_;
+};
+
+// note: a 10 ms step with at most 8 steps a frame, each entry continues from
+//       the accumulator the previous one left behind
+static const pacer_check g_pacer_checks[] =
+{
+   { "below one step",              5.0, 0,  5.0 },
+   { "completes a step",            5.0, 1,  0.0 },
+   { "steady frame",               10.0, 1,  0.0 },
+   { "two steps and a remainder",  23.0, 2,  3.0 },
+   { "catches up a short stall",   77.0, 8,  0.0 },
+   { "stall over the clamp",      255.0, 8,  5.0 },
+   { "dropped time stays dropped", 10.0, 1,  5.0 },
+   { "long stall on a boundary",  500.0, 8,  5.0 },
+};
+
+static bool
+headless_check_pacer() {
+   neon::frame_pacer pacer;
+   pacer.set_fixed_step(neon::time::from_milliseconds(10.0), 8);
+
+   int failed = 0;
+   for (auto &check : g_pacer_checks) {
+      const neon::uint32 steps = pacer.accumulate(neon::time::from_milliseconds(check.delta_ms_));
+      const double remaining_ms = pacer.alpha() * 10.0;
+      const bool passed = steps == check.steps_ && fabs(remaining_ms - check.remaining_ms_) < 1e-6;
+      fprintf(stderr, "%s: %s, %.1f ms gave %u steps and %.3f ms left (expected %u and %.3f)\n",
+              passed ? "pass" : "FAIL", check.name_, check.delta_ms_, steps, remaining_ms, check.steps_, check.remaining_ms_);
+      if (!passed) {
+         failed++;
+      }
+   }
+
+   // note: a zero step never simulates anything
+   pacer.set_fixed_step(neon::time(), 8);
+   if (pacer.accumulate(neon::time::from_milliseconds(16.0)) != 0 || pacer.alpha() != 0.0) {
+      fprintf(stderr, "FAIL: zero step\n");
+      failed++;
+   }
+
+   fprintf(stderr, "frame pacer: %d check(s) failed\n", failed);
+   return failed == 0;
+}
+
+int main(int argc, char **argv) {
+   for (int index = 1; index < argc; index++) {
+      if (strcmp(argv[index], "--check-pacer") == 0) {
+         return headless_check_pacer() ? 0 : -1;
+      }
+   }
+
+   int width = 1280;
+   int height = 720;
+   int frame_count = 0;
+   neon::string trace_filename;
+
+   neon::string title = "neon";
+   int req_width = width;
+   int req_height = height;
+   auto app = neon::application::create(req_width, req_height, title);
+   app->pacer_.set_vsync(false);
+
+   for (int index = 1; index < argc; index++) {
+      bool valid = true;
+      if (strcmp(argv[index], "--frames") == 0) {
+         valid = headless_parse_int(argc, argv, index, frame_count);
+      }
+      else if (strcmp(argv[index], "--width") == 0) {
+         valid = headless_parse_int(argc, argv, index, width);
+      }
+      else if (strcmp(argv[index], "--height") == 0) {
+         valid = headless_parse_int(argc, argv, index, height);
+      }
+      else if (strcmp(argv[index], "--trace") == 0 && index + 1 < argc) {
+         trace_filename = argv[++index];
+      }
+      else if (!app->pacer_.parse_argument(argc, argv, index) &&
+               !app->benchmark_.parse_argument(argc, argv, index))
+      {
+         valid = app->parse_argument(argc, argv, index);
+      }
+
+      if (!valid) {
+         fprintf(stderr, "usage: %s [--frames N] [--width W] [--height H] [--benchmark] [--warmup N] [--benchmark-frames N] [--fixed-dt MS] [--report FILE] [--trace FILE] [--target-fps N] [--check-pacer] [application flags]\n", argv[0]);
+         delete app;
+         return -1;
+      }
+   }
+
+   g_display_width = width;
+   g_display_height = height;
+   if (!egl_create_headless_opengl_context(width, height, 3, 3)) {
+      fprintf(stderr, "error: could not create headless opengl 3.3 context\n");
+      delete app;
+      return -1;
+   }
+
+   if (!app->init()) {
+      delete app;
+      egl_destroy_headless_opengl_context();
+      return -1;
+   }
+
+   int frame = 0;
+   while (frame_count == 0 || frame < frame_count) {
+      if (!app->frame()) {
+         break;
+      }
+
+      // note: wait for the gpu so frame times include the rendering
+      app->benchmark_.begin(neon::BENCHMARK_SECTION_SWAP);
+      egl_swap_buffers();
+      glFinish();
+      app->benchmark_.end(neon::BENCHMARK_SECTION_SWAP);
+      app->benchmark_.end_frame();
+      app->pacer_.mark_presented();
+
+      frame++;
+      if (app->benchmark_.is_finished()) {
+         break;
+      }
+
+      app->pacer_.wait();
+   }
+
+   int result = 0;
+   if (app->benchmark_.is_enabled()) {
+      if (!app->benchmark_.is_finished()) {
+         fprintf(stderr, "error: benchmark stopped after %d frames\n", frame);
+         result = -1;
+      }
+      else if (!app->benchmark_.write_report()) {
+         fprintf(stderr, "error: could not write benchmark report '%s'\n", app->benchmark_.report_filename_.c_str());
+         result = -1;
+      }
+   }
+
+   if (!trace_filename.empty() && !neon::profiler::write_chrome_trace(trace_filename)) {
+      fprintf(stderr, "error: could not write trace '%s'\n", trace_filename.c_str());
+      result = -1;
+   }
+
+   app->exit();
+   delete app;
+
+   egl_destroy_headless_opengl_context();
+
+   return result;
+}
+#endif // !_WIN32
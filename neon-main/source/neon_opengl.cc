@@ -15,8 +15,10 @@ GL_FUNCLIST_3_0;
 GL_FUNCLIST_3_1;
 GL_FUNCLIST_3_2;
 GL_FUNCLIST_3_3;
+GL_FUNCLIST_ARB_get_program_binary;
 #undef GLF
 
+#if defined(_WIN32)
 #define WIN32_MEAN_AND_LEAN
 #include <Windows.h>
 
@@ -218,6 +220,14 @@ win32_load_opengl_functions(HMODULE handle, int major, int minor) {
 #undef GLF
 
    done:
+   // note: optional extensions, a missing entry point is not an error
+#define GLF(ret, name, ...)                           \
+   name = (type_##name *)wgl_get_proc_address(#name);
+
+   GL_FUNCLIST_ARB_get_program_binary;
+
+#undef GLF
+
    win32_destroy_fake_opengl_context(fake_window_handle);
 
    return result;
@@ -288,3 +298,251 @@ bool win32_create_core_opengl_context(void *handle, int major, int minor) {
 
    return true;
 }
+
+bool win32_set_swap_interval(int interval) {
+   if (!wglSwapIntervalEXT) {
+      return false;
+   }
+
+   return wglSwapIntervalEXT(interval) == TRUE;
+}
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <string.h>
+
+static EGLDisplay g_egl_display = EGL_NO_DISPLAY;
+static EGLContext g_egl_context = EGL_NO_CONTEXT;
+static EGLSurface g_egl_surface = EGL_NO_SURFACE;
+
+static bool
+egl_has_extension(const char *extensions, const char *name) {
+   if (!extensions) {
+      return false;
+   }
+
+   const size_t length = strlen(name);
+   const char *at = extensions;
+   while ((at = strstr(at, name)) != NULL) {
+      const bool starts = at == extensions || at[-1] == ' ';
+      const bool ends = at[length] == ' ' || at[length] == '\0';
+      if (starts && ends) {
+         return true;
+      }
+
+      at += length;
+   }
+
+   return false;
+}
+
+static EGLDisplay
+egl_get_headless_display() {
+   // note: prefer mesa's surfaceless platform, it needs neither a display server nor a gpu
+   const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+   if (egl_has_extension(client_extensions, "EGL_MESA_platform_surfaceless")) {
+      PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+         (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+      if (get_platform_display) {
+         EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+         if (display != EGL_NO_DISPLAY) {
+            return display;
+         }
+      }
+   }
+
+   return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static bool
+egl_load_opengl_functions(int major, int minor) {
+   bool result = true;
+
+   // note: requires EGL_KHR_get_all_proc_addresses (egl 1.5) for core entry points
+#define GLF(ret, name, ...)                              \
+   name = (type_##name *)eglGetProcAddress(#name);       \
+   if (!name) { result = false; }
+
+   GL_FUNCLIST_1_0;
+   if (major == 1 && minor == 0) {
+      goto done;
+   }
+   GL_FUNCLIST_1_1;
+   if (major == 1 && minor == 1) {
+      goto done;
+   }
+   GL_FUNCLIST_1_2;
+   if (major == 1 && minor == 2) {
+      goto done;
+   }
+   GL_FUNCLIST_1_3;
+   if (major == 1 && minor == 3) {
+      goto done;
+   }
+   GL_FUNCLIST_1_4;
+   if (major == 1 && minor == 4) {
+      goto done;
+   }
+   GL_FUNCLIST_1_5;
+   if (major == 1 && minor == 5) {
+      goto done;
+   }
+   GL_FUNCLIST_2_0;
+   if (major == 2 && minor == 0) {
+      goto done;
+   }
+   GL_FUNCLIST_2_1;
+   if (major == 2 && minor == 1) {
+      goto done;
+   }
+   GL_FUNCLIST_3_0;
+   if (major == 3 && minor == 0) {
+      goto done;
+   }
+   GL_FUNCLIST_3_1;
+   if (major == 3 && minor == 1) {
+      goto done;
+   }
+   GL_FUNCLIST_3_2;
+   if (major == 3 && minor == 2) {
+      goto done;
+   }
+   GL_FUNCLIST_3_3;
+
+#undef GLF
+
+   done:
+   // note: optional extensions, a missing entry point is not an error
+#define GLF(ret, name, ...)                              \
+   name = (type_##name *)eglGetProcAddress(#name);
+
+   GL_FUNCLIST_ARB_get_program_binary;
+
+#undef GLF
+
+   return result;
+}
+
+void egl_destroy_headless_opengl_context() {
+   if (g_egl_display == EGL_NO_DISPLAY) {
+      return;
+   }
+
+   eglMakeCurrent(g_egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+   if (g_egl_surface != EGL_NO_SURFACE) {
+      eglDestroySurface(g_egl_display, g_egl_surface);
+   }
+
+   if (g_egl_context != EGL_NO_CONTEXT) {
+      eglDestroyContext(g_egl_display, g_egl_context);
+   }
+
+   eglTerminate(g_egl_display);
+
+   g_egl_display = EGL_NO_DISPLAY;
+   g_egl_context = EGL_NO_CONTEXT;
+   g_egl_surface = EGL_NO_SURFACE;
+}
+
+bool egl_create_headless_opengl_context(int width, int height, int major, int minor) {
+   EGLDisplay display = egl_get_headless_display();
+   if (display == EGL_NO_DISPLAY) {
+      return false;
+   }
+
+   if (!eglInitialize(display, NULL, NULL)) {
+      return false;
+   }
+
+   g_egl_display = display;
+   if (!eglBindAPI(EGL_OPENGL_API)) {
+      egl_destroy_headless_opengl_context();
+      return false;
+   }
+
+   // note: a pbuffer stands in for the window so framebuffer 0 stays usable,
+   //       without one we fall back to a surfaceless context
+   const EGLint pbuffer_config_attribs[] =
+   {
+      EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_RED_SIZE, 8,
+      EGL_GREEN_SIZE, 8,
+      EGL_BLUE_SIZE, 8,
+      EGL_ALPHA_SIZE, 8,
+      EGL_DEPTH_SIZE, 24,
+      EGL_STENCIL_SIZE, 8,
+      EGL_NONE
+   };
+   const EGLint surfaceless_config_attribs[] =
+   {
+      EGL_SURFACE_TYPE, 0,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_NONE
+   };
+
+   EGLConfig config = NULL;
+   EGLint config_count = 0;
+   bool has_pbuffer = eglChooseConfig(display, pbuffer_config_attribs, &config, 1, &config_count) && config_count > 0;
+   if (!has_pbuffer) {
+      if (!eglChooseConfig(display, surfaceless_config_attribs, &config, 1, &config_count) || config_count == 0) {
+         egl_destroy_headless_opengl_context();
+         return false;
+      }
+   }
+
+   const EGLint context_attribs[] =
+   {
+      EGL_CONTEXT_MAJOR_VERSION, major,
+      EGL_CONTEXT_MINOR_VERSION, minor,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE
+   };
+   g_egl_context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+   if (g_egl_context == EGL_NO_CONTEXT) {
+      egl_destroy_headless_opengl_context();
+      return false;
+   }
+
+   if (has_pbuffer) {
+      const EGLint surface_attribs[] =
+      {
+         EGL_WIDTH, width,
+         EGL_HEIGHT, height,
+         EGL_NONE
+      };
+      g_egl_surface = eglCreatePbufferSurface(display, config, surface_attribs);
+   }
+
+   if (!eglMakeCurrent(display, g_egl_surface, g_egl_surface, g_egl_context)) {
+      egl_destroy_headless_opengl_context();
+      return false;
+   }
+
+   if (!egl_load_opengl_functions(major, minor)) {
+      egl_destroy_headless_opengl_context();
+      return false;
+   }
+
+   if (g_egl_surface != EGL_NO_SURFACE) {
+      eglSwapInterval(display, 0);
+   }
+
+   return true;
+}
+
+bool egl_set_swap_interval(int interval) {
+   // note: a surfaceless context has nothing to synchronize with
+   if (g_egl_surface == EGL_NO_SURFACE) {
+      return false;
+   }
+
+   return eglSwapInterval(g_egl_display, interval) == EGL_TRUE;
+}
+
+void egl_swap_buffers() {
+   if (g_egl_surface != EGL_NO_SURFACE) {
+      eglSwapBuffers(g_egl_display, g_egl_surface);
+   }
+}
+#endif // _WIN32
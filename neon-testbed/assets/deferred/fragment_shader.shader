@@ -0,0 +1,101 @@
+#version 330
+
+// note: the shading of assets/lit with NEON_NORMALS, NEON_LIGHTS and NEON_SHADOWS, with
+//       the inputs read from the g-buffer. the cluster layout has to match light_clusters,
+//       the atlas layout shadow_cascades
+
+#define LIGHT_GRID_X 16
+#define LIGHT_GRID_Y 9
+#define LIGHT_GRID_Z 24
+#define SHADOW_CASCADES 4
+#define SHADOW_ATLAS_SIZE 2048.0
+
+uniform sampler2D gbuffer_albedo;
+uniform sampler2D gbuffer_normal;
+uniform sampler2D gbuffer_depth;
+uniform samplerCube skybox;
+uniform mat4 inverse_view_projection;
+uniform mat4 view;
+uniform vec3 light_direction;
+uniform samplerBuffer light_data;
+uniform usamplerBuffer light_grid;
+uniform usamplerBuffer light_indices;
+uniform vec4 light_cluster_scale;
+uniform sampler2D shadow_map;
+uniform mat4 shadow_matrices[SHADOW_CASCADES];
+uniform vec4 shadow_splits;
+
+in vec2 f_ndc;
+
+out vec4 frag_color;
+
+float shadow_factor(vec3 world_position, float view_depth)
+{
+	int cascade = 0;
+	while (cascade < SHADOW_CASCADES && view_depth > shadow_splits[cascade]) {
+		cascade++;
+	}
+	if (cascade == SHADOW_CASCADES) {
+		return 1.0;
+	}
+
+	vec4 coords = shadow_matrices[cascade] * vec4(world_position, 1.0);
+	float lit = 0.0;
+	for (int y = 0; y < 2; y++) {
+		for (int x = 0; x < 2; x++) {
+			vec2 offset = (vec2(x, y) - 0.5) / SHADOW_ATLAS_SIZE;
+			lit += step(coords.z, texture(shadow_map, coords.xy + offset).r);
+		}
+	}
+	return lit * 0.25;
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gbuffer_depth, pixel, 0).r;
+
+	// note: nothing was drawn here, the skybox shows through
+	if (depth >= 1.0) {
+		vec4 near_point = inverse_view_projection * vec4(f_ndc, -1.0, 1.0);
+		vec4 far_point = inverse_view_projection * vec4(f_ndc, 1.0, 1.0);
+		frag_color = texture(skybox, far_point.xyz / far_point.w - near_point.xyz / near_point.w);
+		return;
+	}
+
+	vec4 world_position = inverse_view_projection * vec4(f_ndc, depth * 2.0 - 1.0, 1.0);
+	world_position /= world_position.w;
+	float view_depth = -(view * world_position).z;
+
+	vec4 albedo = texelFetch(gbuffer_albedo, pixel, 0);
+	vec3 N = normalize(texelFetch(gbuffer_normal, pixel, 0).xyz * 2.0 - 1.0);
+	bool has_normal = albedo.a > 0.5;
+
+	vec3 lighting = vec3(1.0);
+	if (has_normal) {
+		lighting = vec3(dot(N, -normalize(light_direction))) * shadow_factor(world_position.xyz, view_depth);
+	}
+
+	ivec3 cluster = ivec3(vec3(gl_FragCoord.xy * light_cluster_scale.xy, log(max(view_depth, 0.0001)) * light_cluster_scale.z + light_cluster_scale.w));
+	cluster = clamp(cluster, ivec3(0), ivec3(LIGHT_GRID_X - 1, LIGHT_GRID_Y - 1, LIGHT_GRID_Z - 1));
+	uvec2 range = texelFetch(light_grid, (cluster.z * LIGHT_GRID_Y + cluster.y) * LIGHT_GRID_X + cluster.x).xy;
+	for (uint index = 0u; index < range.y; index++) {
+		int light = int(texelFetch(light_indices, int(range.x + index)).r) * 3;
+		vec4 position_radius = texelFetch(light_data, light);
+		vec4 color_outer = texelFetch(light_data, light + 1);
+		vec4 direction_inner = texelFetch(light_data, light + 2);
+
+		vec3 to_light = position_radius.xyz - world_position.xyz;
+		float distance = length(to_light);
+		vec3 light_vector = to_light / max(distance, 0.0001);
+		float window = clamp(1.0 - pow(distance / position_radius.w, 4.0), 0.0, 1.0);
+		float attenuation = window * window / (1.0 + distance * distance);
+		attenuation *= smoothstep(color_outer.w, direction_inner.w, dot(-light_vector, direction_inner.xyz));
+		if (has_normal) {
+			attenuation *= max(dot(N, light_vector), 0.0);
+		}
+		lighting += color_outer.rgb * attenuation;
+	}
+
+	frag_color = vec4(albedo.rgb * lighting, 1.0);
+}
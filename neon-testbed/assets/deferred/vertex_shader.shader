@@ -0,0 +1,12 @@
+#version 330
+
+// note: one triangle covering the screen, no vertex buffer needed
+
+out vec2 f_ndc;
+
+void main()
+{
+	vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+	f_ndc = position;
+	gl_Position = vec4(position, 0.0, 1.0);
+}
@@ -0,0 +1,141 @@
+#version 330
+
+// note: features are injected as defines by shader_program, see shader_feature
+
+uniform sampler2D diffuse;
+#if defined(NEON_NORMALS)
+uniform vec3 light_direction;
+#endif
+#if defined(NEON_FOG)
+uniform vec3 fog_color;
+uniform float fog_density;
+#endif
+#if defined(NEON_LIGHTS)
+// note: has to match light_clusters, three texels per light:
+//       position and radius, color and cos outer, direction and cos inner
+#define LIGHT_GRID_X 16
+#define LIGHT_GRID_Y 9
+#define LIGHT_GRID_Z 24
+uniform samplerBuffer light_data;
+uniform usamplerBuffer light_grid;
+uniform usamplerBuffer light_indices;
+uniform vec4 light_cluster_scale;
+#endif
+#if defined(NEON_SHADOWS)
+// note: has to match shadow_cascades, one tile of the depth atlas per cascade
+#define SHADOW_CASCADES 4
+#define SHADOW_ATLAS_SIZE 2048.0
+uniform sampler2D shadow_map;
+uniform mat4 shadow_matrices[SHADOW_CASCADES];
+uniform vec4 shadow_splits;
+#endif
+
+#if defined(NEON_TEXCOORD)
+in vec2 f_texcoord;
+#endif
+#if defined(NEON_NORMALS)
+in vec3 f_normal;
+#endif
+#if defined(NEON_FOG) || defined(NEON_LIGHTS) || defined(NEON_SHADOWS)
+in float f_view_depth;
+#endif
+#if defined(NEON_LIGHTS) || defined(NEON_SHADOWS)
+in vec3 f_world_position;
+#endif
+
+#if defined(NEON_GBUFFER)
+layout(location = 0) out vec4 frag_color;
+layout(location = 1) out vec4 frag_normal;
+#else
+out vec4 frag_color;
+#endif
+
+#if defined(NEON_SHADOWS)
+// note: the first cascade whose slice reaches past the fragment, four taps around it.
+//       past the last split everything is lit
+float shadow_factor(vec3 world_position, float view_depth)
+{
+	int cascade = 0;
+	while (cascade < SHADOW_CASCADES && view_depth > shadow_splits[cascade]) {
+		cascade++;
+	}
+	if (cascade == SHADOW_CASCADES) {
+		return 1.0;
+	}
+
+	vec4 coords = shadow_matrices[cascade] * vec4(world_position, 1.0);
+	float lit = 0.0;
+	for (int y = 0; y < 2; y++) {
+		for (int x = 0; x < 2; x++) {
+			vec2 offset = (vec2(x, y) - 0.5) / SHADOW_ATLAS_SIZE;
+			lit += step(coords.z, texture(shadow_map, coords.xy + offset).r);
+		}
+	}
+	return lit * 0.25;
+}
+#endif
+
+void main()
+{
+#if defined(NEON_TEXCOORD)
+	vec4 color = texture(diffuse, f_texcoord);
+#else
+	vec4 color = vec4(1.0);
+#endif
+
+#if defined(NEON_GBUFFER)
+	// note: albedo with alpha telling the lighting pass whether the surface has normals,
+	//       normals are packed into the 10 bits per axis of the second target
+#if defined(NEON_NORMALS)
+	frag_color = vec4(color.rgb, 1.0);
+	frag_normal = vec4(normalize(f_normal) * 0.5 + 0.5, 1.0);
+#else
+	frag_color = vec4(color.rgb, 0.0);
+	frag_normal = vec4(0.5, 1.0, 0.5, 1.0);
+#endif
+#else
+
+	vec3 lighting = vec3(1.0);
+#if defined(NEON_NORMALS)
+	vec3 N = normalize(f_normal);
+	vec3 L = normalize(light_direction);
+	float NdL = dot(N, -L);
+	lighting = vec3(NdL);
+#if defined(NEON_SHADOWS)
+	lighting *= shadow_factor(f_world_position, f_view_depth);
+#endif
+#endif
+
+#if defined(NEON_LIGHTS)
+	ivec3 cluster = ivec3(vec3(gl_FragCoord.xy * light_cluster_scale.xy, log(max(f_view_depth, 0.0001)) * light_cluster_scale.z + light_cluster_scale.w));
+	cluster = clamp(cluster, ivec3(0), ivec3(LIGHT_GRID_X - 1, LIGHT_GRID_Y - 1, LIGHT_GRID_Z - 1));
+	uvec2 range = texelFetch(light_grid, (cluster.z * LIGHT_GRID_Y + cluster.y) * LIGHT_GRID_X + cluster.x).xy;
+	for (uint index = 0u; index < range.y; index++) {
+		int light = int(texelFetch(light_indices, int(range.x + index)).r) * 3;
+		vec4 position_radius = texelFetch(light_data, light);
+		vec4 color_outer = texelFetch(light_data, light + 1);
+		vec4 direction_inner = texelFetch(light_data, light + 2);
+
+		vec3 to_light = position_radius.xyz - f_world_position;
+		float distance = length(to_light);
+		vec3 light_vector = to_light / max(distance, 0.0001);
+		float window = clamp(1.0 - pow(distance / position_radius.w, 4.0), 0.0, 1.0);
+		float attenuation = window * window / (1.0 + distance * distance);
+		attenuation *= smoothstep(color_outer.w, direction_inner.w, dot(-light_vector, direction_inner.xyz));
+#if defined(NEON_NORMALS)
+		attenuation *= max(dot(N, light_vector), 0.0);
+#endif
+		lighting += color_outer.rgb * attenuation;
+	}
+#endif
+
+	color.rgb *= lighting;
+
+#if defined(NEON_FOG)
+	float fog = exp(-fog_density * f_view_depth);
+	color.rgb = mix(fog_color, color.rgb, clamp(fog, 0.0, 1.0));
+#endif
+
+	frag_color = color;
+#endif
+}
@@ -0,0 +1,77 @@
+#version 330
+
+// note: features are injected as defines by shader_program, see shader_feature
+
+#define MAX_BONES 64
+
+layout(location = 0) in vec3 position;
+#if defined(NEON_TEXCOORD)
+layout(location = 1) in vec2 texcoord;
+#endif
+#if defined(NEON_NORMALS)
+layout(location = 2) in vec3 normal;
+#endif
+#if defined(NEON_INSTANCING)
+layout(location = 3) in mat4 instance_world;
+#endif
+#if defined(NEON_SKINNING)
+layout(location = 7) in vec4 bone_weights;
+layout(location = 8) in vec4 bone_indices;
+#endif
+
+// note: the depth prepass draws with the same shader minus the features, positions must match
+invariant gl_Position;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 world;
+#if defined(NEON_SKINNING)
+uniform mat4 bones[MAX_BONES];
+#endif
+
+#if defined(NEON_TEXCOORD)
+out vec2 f_texcoord;
+#endif
+#if defined(NEON_NORMALS)
+out vec3 f_normal;
+#endif
+#if defined(NEON_FOG) || defined(NEON_LIGHTS) || defined(NEON_SHADOWS)
+out float f_view_depth;
+#endif
+#if defined(NEON_LIGHTS) || defined(NEON_SHADOWS)
+out vec3 f_world_position;
+#endif
+
+void main()
+{
+#if defined(NEON_INSTANCING)
+	mat4 model = instance_world * world;
+#else
+	mat4 model = world;
+#endif
+
+#if defined(NEON_SKINNING)
+	mat4 skin = bones[int(bone_indices.x)] * bone_weights.x +
+	            bones[int(bone_indices.y)] * bone_weights.y +
+	            bones[int(bone_indices.z)] * bone_weights.z +
+	            bones[int(bone_indices.w)] * bone_weights.w;
+	model = model * skin;
+#endif
+
+	vec4 world_position = model * vec4(position, 1.0);
+	vec4 view_position = view * world_position;
+	gl_Position = projection * view_position;
+
+#if defined(NEON_TEXCOORD)
+	f_texcoord = texcoord;
+#endif
+#if defined(NEON_NORMALS)
+	f_normal = normalize(mat3(model) * normal);
+#endif
+#if defined(NEON_FOG) || defined(NEON_LIGHTS) || defined(NEON_SHADOWS)
+	f_view_depth = -view_position.z;
+#endif
+#if defined(NEON_LIGHTS) || defined(NEON_SHADOWS)
+	f_world_position = world_position.xyz;
+#endif
+}
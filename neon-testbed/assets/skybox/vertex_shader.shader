@@ -9,6 +9,7 @@ out vec3 f_texcoord;
 
 void main()
 {
-	gl_Position = projection * view * vec4(position, 1.0);
+	// note: z = w puts the skybox on the far plane, it is drawn with GL_LEQUAL
+	gl_Position = (projection * view * vec4(position, 1.0)).xyww;
 	f_texcoord = position;
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+// neon_batching.h
+
+#ifndef NEON_BATCHING_H_INCLUDED
+#define NEON_BATCHING_H_INCLUDED
+
+#include "neon_graphics.h"
+#include "neon_culling.h"
+#include "neon_command_buffer.h"
+
+namespace neon {
+   // note: what a renderable hands to the batcher. vertices start with a
+   //       position and are stride_ bytes apart, a normal at normal_offset_
+   //       is rotated along with the position, -1 when there is none. the
+   //       gbuffer and depth programs may be null, those passes skip it then.
+   struct batch_source {
+      batch_source();
+
+      const shader_program *program_;
+      const shader_program *gbuffer_program_;
+      const shader_program *depth_program_;
+      const texture *texture_;
+      const sampler_state *sampler_;
+      const vertex_format *format_;
+      const void *vertices_;
+      uint32 vertex_count_;
+      uint32 stride_;
+      int32 normal_offset_;
+      const uint32 *indices_;
+      uint32 index_count_;
+   };
+
+   // note: static geometry merged at load time. renderables are added with
+   //       their world matrix and grouped by program, texture, sampler and
+   //       vertex format. build() transforms every group into world space and
+   //       packs it into one vertex and one index buffer, sorted into chunks
+   //       of CHUNK_SIZE units on the ground with a bounding sphere each.
+   //       cull() keeps the chunks in view, neighbouring ones are merged into
+   //       one range, and each group goes out as a single multi-draw. shadow
+   //       views cull the chunks on their own when recording depth. the
+   //       sources only have to live until build().
+   struct static_batches {
+      static constexpr float CHUNK_SIZE = 16.0f;
+
+      struct instance {
+         batch_source source_;
+         glm::mat4 world_;
+         int32 chunk_x_;
+         int32 chunk_z_;
+      };
+
+      struct chunk {
+         int32 start_;
+         int32 count_;
+         bounding_sphere bounds_;
+      };
+
+      struct group {
+         const shader_program *program_;
+         const shader_program *gbuffer_program_;
+         const shader_program *depth_program_;
+         const texture *texture_;
+         const sampler_state *sampler_;
+         vertex_format format_;
+         vertex_format depth_format_;
+         vertex_buffer vertex_buffer_;
+         index_buffer index_buffer_;
+         dynamic_array<chunk> chunks_;
+         dynamic_array<int32> starts_;
+         dynamic_array<int32> counts_;
+      };
+
+      struct statistics {
+         statistics();
+
+         uint32 renderables_;
+         uint32 groups_;
+         uint32 chunks_;
+         uint32 frustum_culled_chunks_;
+         uint32 visible_chunks_;
+         uint32 ranges_;
+         uint64 vertex_bytes_;
+         uint64 index_bytes_;
+      };
+
+      static_batches();
+
+      bool is_valid() const;
+      void add(const batch_source &source, const glm::mat4 &world);
+      bool build();
+      void destroy();
+
+      void cull(const frustum &view, occlusion_culler *occlusion);
+      void record(command_buffer &commands, const fps_camera &camera, const light_clusters &lights) const;
+      void record_gbuffer(command_buffer &commands, const fps_camera &camera) const;
+      void record_depth(command_buffer &commands, const fps_camera &camera) const;
+      uint32 record_depth(command_buffer &commands, const fps_camera &camera, const frustum &view) const;
+      void record_depth_ranges(command_buffer &commands, const fps_camera &camera, const group &target, const int32 *starts, const int32 *counts, int32 count) const;
+
+      dynamic_array<instance> instances_;
+      dynamic_array<group> groups_;
+      statistics statistics_;
+   };
+} // !neon
+
+#endif // !NEON_BATCHING_H_INCLUDED
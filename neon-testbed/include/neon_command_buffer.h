@@ -0,0 +1,201 @@
+// neon_command_buffer.h
+
+#ifndef NEON_COMMAND_BUFFER_H_INCLUDED
+#define NEON_COMMAND_BUFFER_H_INCLUDED
+
+#include "neon_graphics.h"
+
+namespace neon {
+   enum command_type {
+      COMMAND_TYPE_BIND_PROGRAM,
+      COMMAND_TYPE_BIND_VERTEX_BUFFER,
+      COMMAND_TYPE_BIND_INDEX_BUFFER,
+      COMMAND_TYPE_BIND_VERTEX_FORMAT,
+      COMMAND_TYPE_BIND_TEXTURE,
+      COMMAND_TYPE_BIND_SAMPLER,
+      COMMAND_TYPE_UNIFORM_MAT4,
+      COMMAND_TYPE_UNIFORM_VEC4,
+      COMMAND_TYPE_UNIFORM_VEC3,
+      COMMAND_TYPE_UNIFORM_INT,
+      COMMAND_TYPE_SET_CAPABILITY,
+      COMMAND_TYPE_SET_FRONT_FACE,
+      COMMAND_TYPE_SET_BLEND,
+      COMMAND_TYPE_SET_WRITE_MASK,
+      COMMAND_TYPE_SET_DEPTH_FUNC,
+      COMMAND_TYPE_SET_PRIMITIVE_RESTART,
+      COMMAND_TYPE_BEGIN_QUERY,
+      COMMAND_TYPE_END_QUERY,
+      COMMAND_TYPE_BEGIN_CONDITIONAL_RENDER,
+      COMMAND_TYPE_END_CONDITIONAL_RENDER,
+      COMMAND_TYPE_UPDATE_VERTEX_BUFFER,
+      COMMAND_TYPE_DRAW_ARRAYS,
+      COMMAND_TYPE_DRAW_ELEMENTS,
+      COMMAND_TYPE_DRAW_ELEMENTS_BASE_VERTEX,
+      COMMAND_TYPE_MULTI_DRAW_ELEMENTS,
+      COMMAND_TYPE_COUNT,
+   };
+
+   // note: records draw, bind and uniform commands as plain structs into
+   //       linear memory without touching gl, so any thread can record into
+   //       its own buffer. submit() replays them in order and has to run on
+   //       the thread that owns the gl context. uniform names must outlive
+   //       the buffer, string literals are fine.
+   struct command_buffer {
+      struct header {
+         uint32 type_;
+         uint32 size_;
+      };
+
+      struct bind_command {
+         GLenum target_;
+         GLuint id_;
+         uint32 slot_;
+      };
+
+      struct vertex_format_command {
+         vertex_format format_;
+      };
+
+      template <typename T>
+      struct uniform_command {
+         const char *name_;
+         T value_;
+      };
+
+      struct capability_command {
+         GLenum capability_;
+         GLboolean enabled_;
+      };
+
+      struct front_face_command {
+         GLenum mode_;
+      };
+
+      struct blend_command {
+         GLenum source_color_;
+         GLenum destination_color_;
+         GLenum source_alpha_;
+         GLenum destination_alpha_;
+         GLenum equation_color_;
+         GLenum equation_alpha_;
+      };
+
+      struct write_mask_command {
+         GLboolean color_;
+         GLboolean depth_;
+      };
+
+      struct depth_func_command {
+         GLenum func_;
+      };
+
+      struct primitive_restart_command {
+         GLboolean enabled_;
+         GLuint index_;
+      };
+
+      struct query_command {
+         GLenum target_;
+         GLuint id_;
+      };
+
+      struct conditional_render_command {
+         GLuint id_;
+         GLenum mode_;
+      };
+
+      struct update_buffer_command {
+         GLuint id_;
+         uint32 size_;
+      };
+
+      struct draw_command {
+         GLenum primitive_;
+         GLenum index_type_;
+         int32 start_;
+         int32 count_;
+      };
+
+      struct draw_base_vertex_command {
+         GLenum primitive_;
+         GLenum index_type_;
+         int32 start_;
+         int32 count_;
+         int32 base_vertex_;
+      };
+
+      // note: followed by draw_count_ byte offsets into the index buffer, 8-byte aligned,
+      //       and then draw_count_ index counts, the layout glMultiDrawElements takes
+      struct multi_draw_command {
+         GLenum primitive_;
+         GLenum index_type_;
+         int32 draw_count_;
+      };
+
+      command_buffer();
+
+      void reset();
+      bool is_empty() const;
+      uint32 command_count() const;
+      uint32 draw_count() const;
+      uint32 size() const;
+
+      void bind_program(const shader_program &program);
+      void bind_vertex_buffer(const vertex_buffer &buffer);
+      void bind_index_buffer(const index_buffer &buffer);
+      void bind_vertex_format(const vertex_format &format);
+      void bind_texture(const texture &texture, uint32 slot = 0);
+      void bind_sampler(const sampler_state &sampler, uint32 slot = 0);
+
+      void set_uniform_mat4(const char *name, const glm::mat4 &value);
+      void set_uniform_vec4(const char *name, const glm::vec4 &value);
+      void set_uniform_vec3(const char *name, const glm::vec3 &value);
+      void set_uniform_int(const char *name, int32 value);
+
+      void set_capability(GLenum capability, bool enabled);
+      void set_front_face(GLenum mode);
+      void set_blend(GLenum source_color, GLenum destination_color, GLenum source_alpha, GLenum destination_alpha, GLenum equation_color, GLenum equation_alpha);
+      void set_write_mask(bool color, bool depth);
+      void set_depth_func(GLenum func);
+      void set_primitive_restart(bool enabled, GLuint index = 0);
+
+      void begin_query(GLenum target, GLuint id);
+      void end_query(GLenum target);
+      void begin_conditional_render(GLuint id, GLenum mode);
+      void end_conditional_render();
+
+      void update_vertex_buffer(const vertex_buffer &buffer, uint32 size, const void *data);
+      void draw_arrays(GLenum primitive, int32 start, int32 count);
+      void draw_elements(GLenum primitive, const index_buffer &buffer, int32 start, int32 count);
+      void draw_elements_base_vertex(GLenum primitive, const index_buffer &buffer, int32 start, int32 count, int32 base_vertex);
+      void draw_elements_multi(GLenum primitive, const index_buffer &buffer, const int32 *starts, const int32 *counts, int32 draw_count);
+
+      void submit() const;
+
+      template <typename T>
+      T *push(command_type type, uint32 extra = 0);
+
+      dynamic_array<uint8> storage_;
+      uint32 command_count_;
+      uint32 draw_count_;
+   };
+
+   template <typename T>
+   T *command_buffer::push(command_type type, uint32 extra) {
+      // note: keep every command 8-byte aligned, matrices are copied in place
+      const uint32 payload = (uint32)sizeof(T) + extra;
+      const uint32 size = (uint32)((sizeof(header) + payload + 7) & ~7u);
+
+      const size_t offset = storage_.size();
+      storage_.resize(offset + size);
+
+      header *head = (header *)(storage_.data() + offset);
+      head->type_ = type;
+      head->size_ = size;
+      command_count_++;
+
+      return (T *)(head + 1);
+   }
+} // !neon
+
+#endif // !NEON_COMMAND_BUFFER_H_INCLUDED
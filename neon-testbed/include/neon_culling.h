@@ -0,0 +1,153 @@
+// neon_culling.h
+
+#ifndef NEON_CULLING_H_INCLUDED
+#define NEON_CULLING_H_INCLUDED
+
+#include "neon_graphics.h"
+#include "neon_command_buffer.h"
+
+namespace neon {
+   struct bounding_sphere {
+      bounding_sphere();
+      explicit bounding_sphere(const glm::vec3 &center, float radius);
+
+      void set_center(const glm::vec3 &center);
+      void set_radius(const float radius);
+
+      glm::vec3 center_;
+      float radius_;
+   };
+
+   struct plane {
+      enum plane_type_id {
+         PLANE_NEAR,
+         PLANE_FAR,
+         PLANE_LEFT,
+         PLANE_RIGHT,
+         PLANE_TOP,
+         PLANE_BOTTOM,
+         PLANE_COUNT,
+      };
+
+      plane();
+
+      glm::vec3 normal_;
+      float d_;
+   };
+
+   // note: planes are extracted from a view-projection matrix with gl clip space
+   struct frustum {
+      frustum();
+
+      void construct_from_view_matrix(const glm::mat4 &view);
+
+      bool is_inside(const glm::vec3 &point) const;
+      bool is_inside(const bounding_sphere &sphere) const;
+
+      plane planes_[plane::PLANE_COUNT];
+   };
+
+   // note: software occlusion culling. occluder triangles are transformed on
+   //       the calling thread and rasterized into a small depth buffer with
+   //       sse2, four pixels at a time, one horizontal band per job on the
+   //       thread pool. a max-depth pyramid is built on top so a sphere test
+   //       reads at most a handful of texels. triangles crossing the near
+   //       plane are dropped, occluders must only ever hide less than they
+   //       cover on screen, never more.
+   struct occlusion_culler {
+      static constexpr int32 WIDTH = 256;
+      static constexpr int32 HEIGHT = 144;
+      static constexpr int32 BAND_HEIGHT = 16;
+      static constexpr int32 BAND_COUNT = HEIGHT / BAND_HEIGHT;
+
+      struct triangle {
+         float x_[3];
+         float y_[3];
+         float z_[3];
+      };
+
+      struct level {
+         int32 width_;
+         int32 height_;
+         dynamic_array<float> depth_;
+      };
+
+      struct statistics {
+         statistics();
+
+         uint32 occluder_triangles_;
+         uint32 rasterized_triangles_;
+         uint32 tested_;
+         uint32 culled_;
+         time transform_time_;
+         time raster_time_;
+      };
+
+      occlusion_culler();
+
+      void begin(const glm::mat4 &view_projection);
+      void add_occluder(const glm::vec3 *positions, const uint32 *indices, uint32 index_count, const glm::mat4 &world);
+      void rasterize(thread_pool &workers);
+      bool is_visible(const bounding_sphere &sphere);
+
+      void rasterize_band(int32 band);
+      void build_hierarchy();
+
+      glm::mat4 view_projection_;
+      dynamic_array<triangle> triangles_;
+      dynamic_array<level> levels_;
+      statistics statistics_;
+   };
+
+   // note: hardware occlusion queries for a fixed set of nodes. a node that was
+   //       hidden last frame is not drawn, only its bounding box proxy is, with
+   //       color and depth writes off. nodes that were visible keep being drawn
+   //       and are only queried again every REQUERY_INTERVAL frames, staggered
+   //       so the queries spread out. nodes that were not tested last frame are
+   //       queried and drawn with conditional rendering so they never pop in.
+   //       results are read one frame later without waiting, a query that is
+   //       not done yet keeps the previous state.
+   struct occlusion_queries {
+      static constexpr uint32 REQUERY_INTERVAL = 8;
+
+      struct node {
+         GLuint query_;
+         uint32 last_tested_;
+         bool visible_;
+         bool pending_;
+         bool issued_;
+         glm::mat4 proxy_;
+      };
+
+      struct statistics {
+         statistics();
+
+         uint32 tested_;
+         uint32 queries_;
+         uint32 results_;
+         uint32 skipped_draws_;
+         uint32 conditional_draws_;
+         time readback_time_;
+      };
+
+      occlusion_queries();
+
+      bool create(resource_cache &cache, uint32 node_count);
+      void destroy(resource_cache &cache);
+
+      bool is_valid() const;
+      void begin_frame();
+      bool test(uint32 index, const bounding_sphere &sphere, const glm::vec3 &eye);
+      void record(command_buffer &commands, const fps_camera &camera) const;
+
+      shader_program program_;
+      vertex_buffer proxy_buffer_;
+      vertex_format proxy_format_;
+      dynamic_array<node> nodes_;
+      dynamic_array<uint32> issued_;
+      uint32 frame_;
+      statistics statistics_;
+   };
+} // !neon
+
+#endif // !NEON_CULLING_H_INCLUDED
@@ -4,6 +4,11 @@
 #define NEON_FRAMEBUFFER_H_INCLUDED
 
 #include "neon_graphics.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 namespace neon {
    constexpr uint32 MAX_FRAMEBUFFER_ATTACHMENTS = 4;
@@ -13,12 +18,119 @@ namespace neon {
       FRAMEBUFFER_FORMAT_RGB8,
       FRAMEBUFFER_FORMAT_RGBA8,
       FRAMEBUFFER_FORMAT_D32,
+      FRAMEBUFFER_FORMAT_RGB10A2,
       FRAMEBUFFER_FORMAT_COUNT,
       FRAMEBUFFER_FORMAT_INVALID,
    };
 
+   struct framebuffer_desc {
+      static uint32 bytes_per_pixel(framebuffer_format format);
+
+      framebuffer_desc();
+      explicit framebuffer_desc(int32 width, int32 height,
+                                uint32 format_count,
+                                const framebuffer_format *formats,
+                                framebuffer_format depth_format = FRAMEBUFFER_FORMAT_NONE,
+                                uint32 samples = 1);
+
+      bool operator==(const framebuffer_desc &rhs) const;
+      bool operator!=(const framebuffer_desc &rhs) const;
+      uint64 byte_size() const;
+
+      int32 width_;
+      int32 height_;
+      uint32 format_count_;
+      framebuffer_format formats_[MAX_FRAMEBUFFER_ATTACHMENTS];
+      framebuffer_format depth_format_;
+      uint32 samples_;
+   };
+
+   // note: reads framebuffers back without waiting on the gpu. read() copies
+   //       the pixels into one of RING_SIZE pixel pack buffers and fences it,
+   //       update() maps the buffers the gpu is done with, usually a frame or
+   //       two later, and hands them to the worker threads. the callback gets
+   //       the mapped memory, bgra rows bottom up as gl reads them, and may
+   //       only use it until it returns, the main thread unmaps the buffer on
+   //       the next update(). with every buffer in flight a read is dropped
+   //       instead of stalling. finish() waits for everything read so far.
+   struct framebuffer_readback {
+      static constexpr uint32 RING_SIZE = 4;
+
+      enum slot_state {
+         SLOT_STATE_FREE,
+         SLOT_STATE_READING,
+         SLOT_STATE_MAPPED,
+         SLOT_STATE_DONE,
+      };
+
+      struct frame {
+         uint64 sequence_;
+         int32 width_;
+         int32 height_;
+         const uint8 *pixels_;
+      };
+
+      typedef std::function<bool(const frame &image)> callback;
+
+      static bool encode_png(const frame &image, dynamic_array<uint8> &content);
+      static bool write_png(const string &filename, const frame &image);
+      static bool write_raw(const string &filename, const frame &image);
+
+      struct slot {
+         slot();
+
+         GLuint buffer_;
+         uint32 capacity_;
+         GLsync fence_;
+         std::atomic<uint32> state_;
+         frame frame_;
+         callback callback_;
+         uint64 issued_;
+         bool failed_;
+      };
+
+      struct statistics {
+         statistics();
+
+         uint32 requested_;
+         uint32 mapped_;
+         uint32 completed_;
+         uint32 dropped_;
+         uint32 failed_;
+         uint64 read_bytes_;
+         uint64 latency_sum_;
+         uint32 max_latency_;
+         time update_time_;
+      };
+
+      framebuffer_readback();
+
+      bool create(uint32 worker_count = 1);
+      void destroy();
+
+      bool is_valid() const;
+      bool is_idle() const;
+      bool read(GLuint framebuffer_id, GLenum buffer, int32 width, int32 height, const callback &done);
+      void update();
+      void finish();
+
+      void work();
+
+      slot slots_[RING_SIZE];
+      dynamic_array<uint32> jobs_;
+      dynamic_array<std::thread> workers_;
+      std::mutex mutex_;
+      std::condition_variable wake_;
+      std::condition_variable done_;
+      uint64 sequence_;
+      uint64 updates_;
+      bool running_;
+      statistics statistics_;
+   };
+
    struct framebuffer {
       static void unbind(int32 width, int32 height);
+      static bool read_backbuffer_async(int32 width, int32 height, framebuffer_readback &readback, const framebuffer_readback::callback &done);
 
       framebuffer();
 
@@ -27,19 +139,97 @@ namespace neon {
                   int32 color_attachment_format_count,
                   const framebuffer_format *color_attachment_formats,
                   framebuffer_format depth_attachment_format = FRAMEBUFFER_FORMAT_NONE);
+      bool create(const framebuffer_desc &desc);
       void destroy();
 
       void bind();
 	  void bind_as_texture(uint32 index, uint32 slot = 0);
 	  void bind_as_depth(uint32 slot);
       void blit(int32 x, int32 y, int32 width, int32 height);
+      bool read_async(uint32 index, framebuffer_readback &readback, const framebuffer_readback::callback &done);
 
       int32 width_;
       int32 height_;
+      uint32 samples_;
+      GLenum texture_type_;
+      uint32 color_attachment_count_;
       uint32 id_;
       uint32 depth_attachment_;
+      uint32 depth_texture_;
       uint32 color_attachments_[MAX_FRAMEBUFFER_ATTACHMENTS];
    };
+
+   // note: recycles framebuffers instead of creating and deleting gl objects
+   //       whenever a target is needed. acquire() hands out a released
+   //       framebuffer with the same description or creates one, release()
+   //       gives it back. framebuffers nobody acquired for max_age_ frames
+   //       are deleted in begin_frame(), so targets of an old window size or
+   //       resolution go away on their own. handles stay valid until the
+   //       framebuffer is released.
+   struct framebuffer_pool {
+      static constexpr uint32 INVALID_HANDLE = ~0u;
+
+      struct entry {
+         framebuffer framebuffer_;
+         framebuffer_desc desc_;
+         uint64 last_used_;
+         bool in_use_;
+      };
+
+      struct statistics {
+         statistics();
+
+         uint32 allocations_;
+         uint32 reuses_;
+         uint32 evictions_;
+         uint32 live_count_;
+         uint32 in_use_count_;
+         uint64 live_bytes_;
+      };
+
+      framebuffer_pool();
+
+      void destroy();
+      void set_max_age(uint32 frames);
+      void begin_frame();
+
+      uint32 acquire(const framebuffer_desc &desc);
+      void release(uint32 handle);
+      framebuffer &get(uint32 handle);
+      const framebuffer &get(uint32 handle) const;
+
+      uint64 frame_;
+      uint32 max_age_;
+      dynamic_array<entry> entries_;
+      statistics statistics_;
+   };
+
+   // note: scales the internal resolution so the measured gpu frame time
+   //       stays under the target. the cost is taken to grow with the pixel
+   //       count, so the scale moves by the square root of target over
+   //       measured time. the scale is quantized to step_ and held for a few
+   //       frames after each change, both keep the pool from reallocating
+   //       targets every frame and give delayed gpu timings time to catch up.
+   struct dynamic_resolution {
+      dynamic_resolution();
+
+      bool is_enabled() const;
+      void set_target(const time &target);
+      void set_limits(float min_scale, float max_scale);
+      bool update(const time &gpu_time);
+      void apply(int32 width, int32 height, int32 &scaled_width, int32 &scaled_height) const;
+
+      time target_;
+      time filtered_;
+      float scale_;
+      float min_scale_;
+      float max_scale_;
+      float step_;
+      float headroom_;
+      uint32 hold_frames_;
+      uint32 hold_;
+      uint32 changes_;
+   };
 } // !neon
 
 #endif // !NEON_FRAMEBUFFER_H_INCLUDED
@@ -0,0 +1,108 @@
+// neon_geometry_arena.h
+
+#ifndef NEON_GEOMETRY_ARENA_H_INCLUDED
+#define NEON_GEOMETRY_ARENA_H_INCLUDED
+
+#include "neon_graphics.h"
+
+namespace neon {
+   // note: first fit over the free blocks of one buffer, sorted by offset so
+   //       neighbours merge again on release. sizes and offsets are counted
+   //       in elements, vertices of one stride or indices.
+   struct free_list {
+      struct block {
+         uint32 offset_;
+         uint32 count_;
+      };
+
+      free_list();
+
+      void reset(uint32 capacity);
+      bool allocate(uint32 count, uint32 &offset);
+      void release(uint32 offset, uint32 count);
+
+      uint32 free_count() const;
+      uint32 largest_free() const;
+
+      uint32 capacity_;
+      dynamic_array<block> blocks_;
+   };
+
+   // note: vertices and indices of every static mesh sub-allocated from a
+   //       few large buffers instead of a buffer pair each. vertices are kept
+   //       in pools per stride, so an allocation is a base vertex into a
+   //       shared buffer, indices live in 16 or 32-bit index arenas by
+   //       their type. meshes that share arenas draw back to back without
+   //       rebinding. handles stay valid across defragment(), which packs
+   //       every arena and empties the last ones into the room that frees
+   //       up, so ranges are looked up again whenever a mesh is recorded.
+   struct geometry_arena {
+      static constexpr uint32 ARENA_BYTES = 8 * 1024 * 1024;
+      static constexpr geometry_handle INVALID_HANDLE = ~0u;
+
+      struct arena {
+         arena();
+
+         GLuint id_;
+         free_list free_;
+         uint32 used_;
+      };
+
+      struct pool {
+         pool();
+
+         GLenum target_;
+         uint32 stride_;
+         dynamic_array<arena> arenas_;
+      };
+
+      struct allocation {
+         allocation();
+
+         uint32 pool_;
+         uint32 arena_;
+         uint32 offset_;
+         uint32 count_;
+      };
+
+      struct statistics {
+         statistics();
+
+         uint32 arenas_;
+         uint32 allocations_;
+         uint32 free_blocks_;
+         uint64 capacity_bytes_;
+         uint64 used_bytes_;
+         uint64 largest_free_bytes_;
+         float utilization_;
+         float fragmentation_;
+         uint32 defragment_moves_;
+         uint64 defragment_bytes_;
+      };
+
+      geometry_arena();
+
+      void destroy();
+
+      geometry_handle allocate_vertices(uint32 stride, uint32 count, const void *data);
+      geometry_handle allocate_indices(uint32 count, const uint16 *data);
+      geometry_handle allocate_indices(uint32 count, const uint32 *data);
+      void release(geometry_handle &handle);
+      void defragment();
+
+      void bind(command_buffer &commands, geometry_handle vertices, geometry_handle indices) const;
+      void draw(command_buffer &commands, GLenum primitive, geometry_handle vertices, geometry_handle indices, int32 start, int32 count, int32 base_vertex = 0) const;
+      GLenum index_type(geometry_handle indices) const;
+
+      geometry_handle allocate(GLenum target, uint32 stride, uint32 count, const void *data);
+      bool add_arena(pool &target, uint32 count);
+      void update_statistics();
+
+      dynamic_array<pool> pools_;
+      dynamic_array<allocation> allocations_;
+      dynamic_array<geometry_handle> unused_;
+      statistics statistics_;
+   };
+} // !neon
+
+#endif // !NEON_GEOMETRY_ARENA_H_INCLUDED
@@ -15,6 +15,13 @@
 
 namespace neon
 {
+	struct resource_cache;
+	struct command_buffer;
+	struct light_clusters;
+	struct shadow_cascades;
+	struct geometry_arena;
+	typedef uint32 geometry_handle;
+
 	struct vertex_buffer
 	{
 		vertex_buffer();
@@ -46,11 +53,29 @@ namespace neon
 		GLenum type_; // Note: type -> GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
 	};
 
+	// note: each feature is injected as a define (NEON_NORMALS, ...) after the #version line
+	enum shader_feature
+	{
+		SHADER_FEATURE_NONE       = 0,
+		SHADER_FEATURE_NORMALS    = 1 << 0,
+		SHADER_FEATURE_TEXCOORD   = 1 << 1,
+		SHADER_FEATURE_INSTANCING = 1 << 2,
+		SHADER_FEATURE_SKINNING   = 1 << 3,
+		SHADER_FEATURE_FOG        = 1 << 4,
+		SHADER_FEATURE_LIGHTS     = 1 << 5,
+		SHADER_FEATURE_GBUFFER    = 1 << 6,
+		SHADER_FEATURE_SHADOWS    = 1 << 7,
+		SHADER_FEATURE_COUNT      = 8,
+	};
+
 	struct shader_program
 	{
+		static string inject_features(const char* source, const uint32 features);
+
 		shader_program();
 
-		bool create(const string& vertex_shader_filename, const string& fragment_shader_filename);
+		bool create(const string& vertex_shader_filename, const string& fragment_shader_filename, const uint32 features = SHADER_FEATURE_NONE);
+		bool create_from_source(const char* vertex_shader_source, const char* fragment_shader_source);
 		void destroy();
 
 		GLint get_attrib_location(const string &name) const;
@@ -94,11 +119,17 @@ namespace neon
 		attribute attributes_[ATTRIBUTE_COUNT];
 	};
 
+	// note: decode() is safe to call from any thread, stb keeps the flip setting in a
+	//       global so it is never set and rows are flipped while copying instead. it
+	//       writes rgba8 into destination and fails when the image does not fit.
 	struct texture {
+		static bool decode(const dynamic_array<uint8>& content, bool flip, uint8* destination, uint32 capacity, int32& width, int32& height);
+
 		texture();
 
 		bool create(const std::string& filename, bool flip = true);
 		bool create_cubemap(int width, int height, const void **data);
+		bool create_storage(int width, int height, const void* data = nullptr);
 		void destroy();
 		
 		bool is_valid() const;
@@ -114,12 +145,134 @@ namespace neon
 		bool create(const GLenum filter, const GLenum address_mode_u, const GLenum address_mode_v);
 		void destroy();
 
-		bool is_valid();
+		bool is_valid() const;
 		void bind(uint32 slot = 0);
 
 		GLuint id_;
 	};
 
+	// note: a buffer seen as a texture, shaders read it with texelFetch. update()
+	//       respecifies the whole storage so the driver can hand out fresh memory
+	//       while the gpu still reads the previous contents.
+	struct texture_buffer {
+		texture_buffer();
+
+		bool create(const GLenum format);
+		void destroy();
+		bool update(int size, const void* data);
+
+		bool is_valid() const;
+
+		GLuint buffer_;
+		texture texture_;
+	};
+
+	// note: measures gpu time between begin() and end() with timestamp queries.
+	//       results are read back LATENCY frames later so the cpu never waits,
+	//       frames are skipped while all queries are still in flight.
+	//       read() returns the oldest finished frame, call it until it fails.
+	struct gpu_timer {
+		static constexpr uint32 LATENCY = 4;
+
+		gpu_timer();
+
+		bool create();
+		void destroy();
+
+		bool is_valid() const;
+		void begin();
+		void end();
+		bool read(time& elapsed);
+
+		GLuint queries_[LATENCY * 2];
+		uint32 write_;
+		uint32 read_;
+		bool active_;
+	};
+
+	// note: named and nested gpu scopes per frame, one pair of timestamp queries
+	//       each. frames are read back LATENCY frames later without waiting,
+	//       a frame is not recorded at all while every slot is still in flight.
+	//       read() moves the oldest finished frame into results_, call it until
+	//       it fails. scope names must be string literals.
+	//       binning drivers (llvmpipe among them) stamp a query whenever a
+	//       tile gets to it, the scopes nested in a pass read as ~0 ms no
+	//       matter how they are flushed. read() sets collapsed_ for such a
+	//       frame and the profiler switches to serialized_ timing, every
+	//       scope boundary waits with glFinish and reads the cpu clock. that
+	//       stalls the pipeline, it is only taken where the queries are no use.
+	struct gpu_profiler {
+		static constexpr uint32 LATENCY = 4;
+		static constexpr uint32 MAX_SCOPES = 32;
+		static constexpr uint32 INVALID_SCOPE = ~0u;
+
+		struct scope {
+			const char* name_;
+			uint32 depth_;
+			time elapsed_;
+		};
+
+		struct frame {
+			GLuint queries_[MAX_SCOPES * 2];
+			scope scopes_[MAX_SCOPES];
+			time starts_[MAX_SCOPES];
+			uint32 count_;
+			GLuint last_;
+			bool serialized_;
+		};
+
+		gpu_profiler();
+
+		bool create();
+		void destroy();
+
+		bool is_valid() const;
+		void begin_frame();
+		void end_frame();
+		void push(const char* name);
+		void pop();
+		bool read();
+
+		frame frames_[LATENCY];
+		uint32 write_;
+		uint32 read_;
+		uint32 stack_[MAX_SCOPES];
+		uint32 depth_;
+		bool recording_;
+		bool collapsed_;
+		bool serialized_;
+		dynamic_array<scope> results_;
+	};
+
+	// note: counts the samples that pass the depth test, one counter per slot and
+	//       frame. slots must not overlap and no other occlusion query may be
+	//       active in between. read back LATENCY frames later like gpu_timer,
+	//       read() returns the oldest finished frame, slots that were not used
+	//       that frame read as zero.
+	struct fragment_counter {
+		static constexpr uint32 LATENCY = 4;
+		static constexpr uint32 MAX_SLOTS = 8;
+
+		fragment_counter();
+
+		bool create();
+		void destroy();
+
+		bool is_valid() const;
+		void begin_frame();
+		void end_frame();
+		void begin(uint32 slot);
+		void end();
+		bool read(uint64 (&samples)[MAX_SLOTS]);
+
+		GLuint queries_[LATENCY][MAX_SLOTS];
+		bool used_[LATENCY][MAX_SLOTS];
+		uint32 write_;
+		uint32 read_;
+		bool recording_;
+		bool active_;
+	};
+
 	struct bitmap_font {
 		struct vertex {
 			float x_, y_;
@@ -128,11 +281,11 @@ namespace neon
 
 		bitmap_font();
 
-		bool create();
-		void destroy();
+		bool create(resource_cache& cache);
+		void destroy(resource_cache& cache);
 
 		void render_text(const float p_x, const float p_y, const string& text);
-		void flush();
+		void flush(command_buffer& commands);
 
 		shader_program program_;
 		vertex_format format_;
@@ -147,6 +300,7 @@ namespace neon
 		fps_camera();
 
 		void update();
+		void interpolate(const fps_camera& from, const fps_camera& to, float alpha);
 
 		void set_perspective(float fov, float aspect, float znear, float zfar);
 		void rotate_x(float amount);
@@ -179,13 +333,35 @@ namespace neon
 		glm::vec2 mouse_position_;
 	};
 
+	// note: scripted camera used by benchmarks in place of the controller,
+	//       positions follow a catmull-rom spline through the keyframes and
+	//       the path loops after the last keyframe
+	struct camera_path {
+		struct keyframe {
+			float time_;
+			glm::vec3 position_;
+			float yaw_;
+			float pitch_;
+		};
+
+		camera_path(fps_camera& camera);
+
+		void add_keyframe(float seconds, const glm::vec3& position, float yaw, float pitch);
+		void reset();
+		void update(const time& deltatime);
+
+		fps_camera& camera_;
+		dynamic_array<keyframe> keyframes_;
+		time elapsed_;
+	};
+
 	struct skybox {
 		skybox();
 
-		bool create();
-		void destroy();
+		bool create(resource_cache& cache);
+		void destroy(resource_cache& cache);
 
-		void render(const fps_camera& camera);
+		void render(command_buffer& commands, const fps_camera& camera) const;
 	
 		shader_program program_;
 		vertex_buffer buffer_;
@@ -194,6 +370,47 @@ namespace neon
 		texture cubemap_;
 	};
 
+	enum grid_topology {
+		GRID_TOPOLOGY_TRIANGLES,
+		GRID_TOPOLOGY_STRIPS,
+	};
+
+	// note: indices for a regular grid of columns by rows vertices stored row
+	//       after row, every quad split along the diagonal from its first
+	//       vertex to the one across. triangles take six indices a quad,
+	//       strips one strip per row of quads with a restart index between
+	//       them, about two a quad. with short indices the grid is cut into
+	//       chunks of less than 65535 vertices drawn from their own base
+	//       vertex, so the largest value stays free as the restart index.
+	//       neighbouring chunks share a row of vertices, nothing is duplicated.
+	//       the indices only live until upload(), the chunks stay for draw().
+	struct grid_mesh {
+		struct chunk {
+			int32 start_;
+			int32 count_;
+			int32 base_vertex_;
+		};
+
+		grid_mesh();
+
+		bool build(grid_topology topology, bool short_indices, uint32 columns, uint32 rows);
+		geometry_handle upload(geometry_arena& arena);
+		void draw(command_buffer& commands, const geometry_arena& arena, geometry_handle vertices, geometry_handle indices) const;
+
+		GLenum primitive() const;
+		GLuint restart_index() const;
+		uint64 index_bytes() const;
+
+		grid_topology topology_;
+		bool short_indices_;
+		uint32 columns_;
+		uint32 rows_;
+		uint32 index_count_;
+		dynamic_array<chunk> chunks_;
+		dynamic_array<uint16> short_index_array_;
+		dynamic_array<uint32> index_array_;
+	};
+
 	struct terrain {
 
 		struct vertex {
@@ -204,18 +421,31 @@ namespace neon
 
 		terrain();
 
-		bool create(const string& heightmap_filemap, const string& texture_filename);
-		void destroy();
+		bool create(resource_cache& cache, geometry_arena& arena, const string& heightmap_filemap, const string& texture_filename, grid_topology topology = GRID_TOPOLOGY_STRIPS, bool short_indices = true);
+		void destroy(resource_cache& cache);
+
+		void render(command_buffer& commands, const fps_camera& camera, const light_clusters& lights, const shadow_cascades& shadows) const;
+		void render_gbuffer(command_buffer& commands, const fps_camera& camera) const;
+		void render_depth(command_buffer& commands, const fps_camera& camera) const;
 
-		void render(const fps_camera& camera);
+		float height_at(float x, float z) const;
+		void build_occluder(int32 step, dynamic_array<glm::vec3>& positions, dynamic_array<uint32>& indices) const;
 
 		shader_program program_;
-		vertex_buffer vertex_buffer_;
+		geometry_arena* arena_;
+		geometry_handle vertex_range_;
+		geometry_handle index_range_;
 		vertex_format format_;
-		index_buffer index_buffer_;
 		texture texture_;
 		sampler_state sampler_;
-		int index_count_;
+		shader_program depth_program_;
+		shader_program gbuffer_program_;
+		geometry_handle depth_range_;
+		vertex_format depth_format_;
+		grid_mesh grid_;
+		int32 width_;
+		int32 depth_;
+		dynamic_array<float> heights_;
 	};
 	
 	struct sphere {
@@ -228,21 +458,23 @@ namespace neon
 
 		sphere();
 
-		bool create(std::string texture_filename, float radius, int stacks, int sectors);
-		void render(fps_camera camera);
+		bool create(resource_cache& cache, geometry_arena& arena, std::string texture_filename, float radius, int stacks, int sectors, grid_topology topology = GRID_TOPOLOGY_STRIPS, bool short_indices = true);
+		void destroy(resource_cache& cache);
+		void render(command_buffer& commands, const fps_camera& camera, const light_clusters& lights, const shadow_cascades& shadows) const;
 
 		float radius_;
 		int stacks_;
 		int sectors_;
 		float sectorStep_;
 		float stackStep_;
-		int index_count_;
+		grid_mesh grid_;
 
 		dynamic_array<vertex> vertices_;
 		shader_program program_;
-		vertex_buffer vertex_buffer_;
+		geometry_arena* arena_;
+		geometry_handle vertex_range_;
+		geometry_handle index_range_;
 		vertex_format format_;
-		index_buffer index_buffer_;
 		texture texture_;
 		sampler_state sampler_;
 	};
@@ -0,0 +1,117 @@
+// neon_lighting.h
+
+#ifndef NEON_LIGHTING_H_INCLUDED
+#define NEON_LIGHTING_H_INCLUDED
+
+#include "neon_graphics.h"
+#include "neon_command_buffer.h"
+
+namespace neon {
+   // note: a point light unless the cone is narrowed, spot lights shine along
+   //       direction_ and fade out between cos_inner_ and cos_outer_
+   struct light {
+      light();
+
+      glm::vec3 position_;
+      float radius_;
+      glm::vec3 color_;
+      glm::vec3 direction_;
+      float cos_inner_;
+      float cos_outer_;
+   };
+
+   // note: clustered forward lighting. the view frustum is split into GRID_X
+   //       by GRID_Y tiles on screen and GRID_Z slices that grow exponentially
+   //       with depth. every frame the lights are moved into view space and
+   //       binned, one slice per job on the thread pool, each light tested as
+   //       a sphere against four cluster boxes at a time with sse2. the lists
+   //       are packed into texture buffers (light data, per cluster offset and
+   //       count, light indices) and the lit shader only walks the lights of
+   //       the cluster a fragment falls into. spot lights are binned by their
+   //       bounding sphere. lights past MAX_LIGHTS_PER_CLUSTER are dropped
+   //       from that cluster and counted as overflow.
+   struct light_clusters {
+      static constexpr int32 GRID_X = 16;
+      static constexpr int32 GRID_Y = 9;
+      static constexpr int32 GRID_Z = 24;
+      static constexpr int32 TILE_COUNT = GRID_X * GRID_Y;
+      static constexpr int32 CLUSTER_COUNT = TILE_COUNT * GRID_Z;
+      static constexpr uint32 MAX_LIGHTS = 4096;
+      static constexpr uint32 MAX_LIGHTS_PER_CLUSTER = 128;
+      static constexpr uint32 LIGHT_DATA_SLOT = 1;
+      static constexpr uint32 LIGHT_GRID_SLOT = 2;
+      static constexpr uint32 LIGHT_INDEX_SLOT = 3;
+
+      struct statistics {
+         statistics();
+
+         uint32 lights_;
+         uint32 visible_;
+         uint32 references_;
+         uint32 max_per_cluster_;
+         uint32 overflow_;
+         time assign_time_;
+         time upload_time_;
+      };
+
+      light_clusters();
+
+      bool create();
+      void destroy();
+
+      bool is_valid() const;
+      void set_viewport(int32 width, int32 height);
+      void assign(const fps_camera &camera, const light *lights, uint32 count, thread_pool &workers);
+      void upload();
+      void bind(command_buffer &commands) const;
+
+      void build_grid(const glm::mat4 &projection);
+      void assign_slice(int32 slice);
+
+      glm::mat4 projection_;
+      float slice_scale_;
+      float slice_bias_;
+      int32 width_;
+      int32 height_;
+      float slice_near_[GRID_Z];
+      float slice_far_[GRID_Z];
+      dynamic_array<float> min_x_;
+      dynamic_array<float> max_x_;
+      dynamic_array<float> min_y_;
+      dynamic_array<float> max_y_;
+      dynamic_array<glm::vec4> view_lights_;
+      dynamic_array<uint32> counts_;
+      dynamic_array<uint16> scratch_;
+      dynamic_array<glm::vec4> light_data_;
+      dynamic_array<uint32> grid_;
+      dynamic_array<uint16> indices_;
+      texture_buffer light_buffer_;
+      texture_buffer grid_buffer_;
+      texture_buffer index_buffer_;
+      statistics statistics_;
+   };
+
+   // note: the lighting pass of the deferred path. one fullscreen triangle reads
+   //       albedo, normals and depth back from the g-buffer, rebuilds the world
+   //       position and shades it with the shadowed sun and the lights of its
+   //       cluster, the same lists and atlas the forward path reads. pixels without
+   //       geometry get the skybox. the g-buffer textures are bound to the
+   //       *_SLOT units by whoever runs the pass.
+   struct deferred_lighting {
+      static constexpr uint32 ALBEDO_SLOT = 4;
+      static constexpr uint32 NORMAL_SLOT = 5;
+      static constexpr uint32 DEPTH_SLOT = 6;
+      static constexpr uint32 SKYBOX_SLOT = 7;
+
+      deferred_lighting();
+
+      bool create(resource_cache &cache);
+      void destroy(resource_cache &cache);
+
+      void record(command_buffer &commands, const fps_camera &camera, const light_clusters &lights, const shadow_cascades &shadows, const skybox &sky) const;
+
+      shader_program program_;
+   };
+} // !neon
+
+#endif // !NEON_LIGHTING_H_INCLUDED
@@ -11,6 +11,9 @@ struct aiMesh;
 struct aiScene;
 
 namespace neon {
+   // note: forward declare
+   struct batch_source;
+
    struct model {
       struct mesh {
          mesh();
@@ -26,27 +29,54 @@ namespace neon {
 		// glm::vec3 normal_;
       };
 
+      // note: the loaded file, shared between every model created from the
+      //       same path through the resource cache
+      struct geometry {
+         geometry();
+
+         bool create(geometry_arena &arena, const string &filename);
+         void destroy();
+
+         // note: assimp
+         bool process_node(const aiNode *node, const aiScene *scene);
+         bool process_mesh(const aiMesh *mesh, const aiScene *scene);
+
+         // note: builds without assimp (NEON_NO_ASSIMP) load this box instead of any file
+         void create_placeholder();
+
+         geometry_arena *arena_;
+         geometry_handle vertex_range_;
+         geometry_handle index_range_;
+         geometry_handle depth_range_;
+         glm::vec3 bounds_min_;
+         glm::vec3 bounds_max_;
+         dynamic_array<mesh> meshes_;
+         dynamic_array<vertex> vertices_;
+         dynamic_array<uint32> indices_;
+      };
+
       model();
 
       bool is_valid() const;
-      bool create_from_file(const string &filename, const string& vertex, const string& fragment, const string& diffuse);
-      void destroy();
+      bool create_from_file(resource_cache &cache, geometry_arena &arena, const string &filename, const string& vertex, const string& fragment, const string& diffuse, const uint32 features = SHADER_FEATURE_TEXCOORD);
+      void destroy(resource_cache &cache);
 
-      void render(const fps_camera &camera, const glm::mat4 &world);
+      batch_source as_batch_source() const;
 
-      // note: assimp
-      bool process_node(const aiNode *node, const aiScene *scene);
-      bool process_mesh(const aiMesh *mesh, const aiScene *scene);
+      void render(command_buffer &commands, const fps_camera &camera, const light_clusters &lights, const glm::mat4 &world) const;
+      void render_gbuffer(command_buffer &commands, const fps_camera &camera, const glm::mat4 &world) const;
+      void render_depth(command_buffer &commands, const fps_camera &camera, const glm::mat4 &world) const;
 
       shader_program program_;
       texture texture_;
       sampler_state sampler_;
-      vertex_buffer vertex_buffer_;
-      index_buffer index_buffer_;
+      const geometry *geometry_;
       vertex_format vertex_format_;
-      dynamic_array<mesh> meshes_;
-      dynamic_array<vertex> vertices_;
-      dynamic_array<uint32> indices_;
+      shader_program depth_program_;
+      shader_program gbuffer_program_;
+      vertex_format depth_format_;
+      glm::vec3 bounds_min_;
+      glm::vec3 bounds_max_;
    };
 } // !neon
 
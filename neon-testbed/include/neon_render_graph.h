@@ -0,0 +1,112 @@
+// neon_render_graph.h
+
+#ifndef NEON_RENDER_GRAPH_H_INCLUDED
+#define NEON_RENDER_GRAPH_H_INCLUDED
+
+#include "neon_framebuffer.h"
+
+namespace neon {
+   struct gpu_profiler;
+
+   typedef uint32 render_resource;
+   constexpr render_resource INVALID_RENDER_RESOURCE = ~0u;
+
+   // note: passes declare the attachments they read and write and the graph
+   //       works out the rest when compiled: passes nobody depends on are
+   //       dropped, the remaining ones are ordered so writers run before
+   //       readers, and transient attachments are packed into shared
+   //       framebuffers, reusing one when the lifetimes do not overlap.
+   //       the framebuffers themselves are acquired from the pool when the
+   //       first pass needs them and released after the last one.
+   //       every transient attachment has exactly one writer and is cleared
+   //       right before it unless the pass overwrites it anyway (resolve),
+   //       the backbuffer is the only resource that more than one pass may
+   //       write to. pass names must be string literals. with a gpu
+   //       profiler set every executed pass becomes a gpu scope.
+   struct render_graph {
+      typedef std::function<void(const render_graph &graph)> execute_function;
+
+      static constexpr uint32 INVALID_INDEX = ~0u;
+
+      struct resource {
+         const char *name_;
+         int32 width_;
+         int32 height_;
+         framebuffer_format format_;
+         uint32 samples_;
+         uint32 writer_;
+         uint32 readers_;
+         uint32 last_;
+         uint32 target_;
+         uint32 attachment_;
+         uint32 color_index_;
+      };
+
+      struct pass {
+         const char *name_;
+         dynamic_array<render_resource> reads_;
+         dynamic_array<render_resource> writes_;
+         execute_function execute_;
+         bool side_effect_;
+         bool overwrites_;
+         bool culled_;
+         uint32 target_;
+         time cpu_time_;
+         time total_cpu_time_;
+         uint32 executions_;
+      };
+
+      struct target {
+         framebuffer_desc desc_;
+         uint32 busy_until_;
+         uint32 handle_;
+      };
+
+      struct statistics {
+         statistics();
+
+         uint32 pass_count_;
+         uint32 culled_pass_count_;
+         uint32 target_count_;
+         uint64 requested_bytes_;
+         uint64 transient_bytes_;
+      };
+
+      explicit render_graph(framebuffer_pool &pool);
+
+      void reset();
+      void destroy();
+      void set_gpu_profiler(gpu_profiler *profiler);
+
+      render_resource backbuffer() const;
+      void set_backbuffer_size(int32 width, int32 height);
+      render_resource create_attachment(const char *name, int32 width, int32 height, framebuffer_format format, uint32 samples = 1);
+      void set_attachment_size(render_resource resource, int32 width, int32 height);
+
+      uint32 add_pass(const char *name, const execute_function &execute);
+      void read(uint32 pass_index, render_resource resource);
+      void write(uint32 pass_index, render_resource resource);
+      void set_side_effect(uint32 pass_index);
+      render_resource resolve(const char *name, render_resource resource);
+      void present(render_resource resource);
+
+      bool compile();
+      void execute();
+      void reset_timings();
+
+      void bind_texture(render_resource resource, uint32 slot) const;
+
+      framebuffer_pool &pool_;
+      gpu_profiler *gpu_profiler_;
+      int32 backbuffer_width_;
+      int32 backbuffer_height_;
+      dynamic_array<resource> resources_;
+      dynamic_array<pass> passes_;
+      dynamic_array<uint32> order_;
+      dynamic_array<target> targets_;
+      statistics statistics_;
+      bool compiled_;
+   };
+} // !neon
+
+#endif // !NEON_RENDER_GRAPH_H_INCLUDED
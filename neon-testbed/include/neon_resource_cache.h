@@ -0,0 +1,95 @@
+// neon_resource_cache.h
+
+#ifndef NEON_RESOURCE_CACHE_H_INCLUDED
+#define NEON_RESOURCE_CACHE_H_INCLUDED
+
+#include "neon_graphics.h"
+#include "neon_shader_cache.h"
+#include "neon_model.h"
+
+namespace neon {
+   enum resource_type {
+      RESOURCE_TYPE_PROGRAM,
+      RESOURCE_TYPE_TEXTURE,
+      RESOURCE_TYPE_SAMPLER,
+      RESOURCE_TYPE_GEOMETRY,
+      RESOURCE_TYPE_COUNT,
+   };
+
+   // note: bucket n counts loads that took less than 2^n milliseconds,
+   //       the last bucket collects everything slower than that
+   constexpr uint32 LOAD_TIME_HISTOGRAM_BUCKET_COUNT = 10;
+
+   struct load_time_histogram {
+      load_time_histogram();
+
+      void add(const time &duration);
+
+      uint32 count_;
+      time total_;
+      time slowest_;
+      uint32 buckets_[LOAD_TIME_HISTOGRAM_BUCKET_COUNT];
+   };
+
+   // note: resources are handed out as copies of the graphics structs, the
+   //       gl object id is the handle. every acquire must be matched with a
+   //       release, the gl object is destroyed with the last reference.
+   //       model geometry has no gl object of its own, it is owned by the
+   //       cache and handed out by pointer under a made up id instead.
+   struct resource_cache {
+      struct entry {
+         entry();
+
+         string name_;
+         GLuint id_;
+         GLenum type_;
+         int32 references_;
+         time load_time_;
+      };
+
+      struct statistics {
+         statistics();
+
+         uint32 hits_;
+         uint32 misses_;
+         uint32 failures_;
+      };
+
+      static string normalize_path(const string &path);
+
+      resource_cache();
+
+      bool acquire_program(const string &vertex_filename, const string &fragment_filename, shader_program &program, const uint32 features = SHADER_FEATURE_NONE);
+      bool acquire_texture(const string &filename, bool flip, texture &texture);
+      bool acquire_cubemap(const string (&filenames)[6], texture &texture);
+      bool acquire_sampler(const GLenum filter, const GLenum address_mode_u, const GLenum address_mode_v, sampler_state &sampler);
+      bool acquire_geometry(const string &filename, geometry_arena &arena, const model::geometry *&geometry);
+
+      void release(shader_program &program);
+      void release(texture &texture);
+      void release(sampler_state &sampler);
+      void release(const model::geometry *&geometry);
+      void destroy();
+
+      string report() const;
+
+      bool acquire_entry(resource_type type, const string &key, GLuint &id, GLenum &target);
+      void insert_entry(resource_type type, const string &key, const string &name, GLuint id, GLenum target, const time &load_time);
+      bool release_entry(resource_type type, GLuint id);
+
+      // note: entries are keyed by normalized path plus parameters, except
+      //       programs that are keyed by a hash of their sources after the
+      //       feature defines are injected. program paths plus the feature
+      //       bitmask are kept as aliases to skip reading the sources again.
+      hashmap<string, entry> entries_[RESOURCE_TYPE_COUNT];
+      hashmap<GLuint, string> keys_[RESOURCE_TYPE_COUNT];
+      hashmap<string, string> program_aliases_;
+      statistics statistics_[RESOURCE_TYPE_COUNT];
+      load_time_histogram histograms_[RESOURCE_TYPE_COUNT];
+      program_binary_cache binaries_;
+      hashmap<GLuint, model::geometry *> geometries_;
+      GLuint next_geometry_id_;
+   };
+} // !neon
+
+#endif // !NEON_RESOURCE_CACHE_H_INCLUDED
@@ -0,0 +1,54 @@
+// neon_shader_cache.h
+
+#ifndef NEON_SHADER_CACHE_H_INCLUDED
+#define NEON_SHADER_CACHE_H_INCLUDED
+
+#include "neon_graphics.h"
+
+namespace neon {
+   // note: stores linked program binaries on disk, keyed by a hash of the
+   //       shader sources and the driver vendor/renderer/version strings.
+   //       a binary the driver rejects is deleted and the program is
+   //       compiled from source again.
+   struct program_binary_cache {
+      struct header {
+         uint32 magic_;
+         uint32 version_;
+         uint64 key_;
+         uint32 format_;
+         uint32 length_;
+      };
+
+      struct statistics {
+         statistics();
+
+         uint32 hits_;
+         uint32 misses_;
+         uint32 rejected_;
+         uint32 writes_;
+         time load_time_;
+         time compile_time_;
+      };
+
+      program_binary_cache();
+
+      bool is_enabled() const;
+      bool create(const string &directory);
+
+      bool create_program(const char *vertex_source, const char *fragment_source, shader_program &program);
+      bool remove_program(const char *vertex_source, const char *fragment_source);
+      uint64 make_key(const char *vertex_source, const char *fragment_source) const;
+      string make_filename(uint64 key) const;
+      bool load_program(const string &filename, uint64 key, shader_program &program);
+      bool store_program(const string &filename, uint64 key, const shader_program &program);
+
+      string report() const;
+
+      bool enabled_;
+      string directory_;
+      uint64 driver_hash_;
+      statistics statistics_;
+   };
+} // !neon
+
+#endif // !NEON_SHADER_CACHE_H_INCLUDED
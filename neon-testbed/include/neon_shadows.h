@@ -0,0 +1,86 @@
+// neon_shadows.h
+
+#ifndef NEON_SHADOWS_H_INCLUDED
+#define NEON_SHADOWS_H_INCLUDED
+
+#include "neon_framebuffer.h"
+#include "neon_culling.h"
+#include "neon_command_buffer.h"
+
+namespace neon {
+   // note: cascaded shadow maps for the sun. the view frustum is split into
+   //       CASCADE_COUNT slices, each one gets a tile of a depth atlas fitted
+   //       around the bounding sphere of its slice, so the tile never changes
+   //       size while the camera turns. tiles only move in steps of
+   //       SCROLL_TEXELS, which lets static geometry be rendered once into a
+   //       cache atlas and again only when the sun moves or a cascade scrolls
+   //       to its next step. every frame the dynamic casters are drawn on top
+   //       of a copy of the cache in the atlas the shaders sample, tiles are
+   //       only copied again when something changed. with caching off both
+   //       are drawn every frame. the owner of the scene records the casters
+   //       of each cascade, culled against its frustum, static ones only when
+   //       needs_static() says so.
+   struct shadow_cascades {
+      static constexpr uint32 CASCADE_COUNT = 4;
+      static constexpr int32 TILE_SIZE = 1024;
+      static constexpr int32 ATLAS_SIZE = TILE_SIZE * 2;
+      static constexpr int32 SCROLL_TEXELS = 128;
+      static constexpr uint32 SHADOW_MAP_SLOT = 8;
+
+      struct cascade {
+         cascade();
+
+         fps_camera camera_;
+         frustum frustum_;
+         glm::mat4 shadow_matrix_;
+         glm::vec2 origin_;
+         float radius_;
+         float split_;
+         bool cached_;
+         bool atlas_dirty_;
+         uint32 static_casters_;
+         uint32 dynamic_casters_;
+         command_buffer static_commands_;
+         command_buffer dynamic_commands_;
+      };
+
+      struct statistics {
+         statistics();
+
+         uint32 static_updates_;
+         uint32 tile_copies_;
+         uint32 static_casters_;
+         uint32 dynamic_casters_;
+         time execute_time_;
+      };
+
+      shadow_cascades();
+
+      bool create();
+      void destroy();
+
+      bool is_valid() const;
+      void set_caching(bool enabled);
+      void set_direction(const glm::vec3 &direction);
+      void set_scene_bounds(const glm::vec3 &min, const glm::vec3 &max);
+      void update(const fps_camera &camera);
+      bool needs_static(uint32 index) const;
+      void execute();
+      void bind(command_buffer &commands) const;
+
+      glm::vec3 direction_;
+      glm::vec3 scene_min_;
+      glm::vec3 scene_max_;
+      glm::mat4 light_view_;
+      float depth_near_;
+      float depth_far_;
+      bool caching_;
+      framebuffer cache_;
+      framebuffer atlas_;
+      texture atlas_texture_;
+      cascade cascades_[CASCADE_COUNT];
+      statistics statistics_;
+   };
+} // !neon
+
+#endif // !NEON_SHADOWS_H_INCLUDED
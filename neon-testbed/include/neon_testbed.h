@@ -5,10 +5,19 @@
 
 #include <neon_core.h>
 #include <neon_opengl.h>
+#include <neon_profiler.h>
 
 #include "neon_graphics.h"
 #include <neon_model.h>
-#include <neon_framebuffer.h>
+#include <neon_culling.h>
+#include <neon_lighting.h>
+#include <neon_shadows.h>
+#include <neon_batching.h>
+#include <neon_geometry_arena.h>
+#include <neon_texture_streamer.h>
+#include <neon_render_graph.h>
+#include <neon_resource_cache.h>
+#include <neon_command_buffer.h>
 
 // Render triangle in 3d: add Z component, add attribute, add vertice for Z
 
@@ -23,13 +32,219 @@ namespace neon
 		float u_, v_;
 	};
 
+   // note: each task records into its own command buffer on the thread pool,
+   //       they are submitted in this order unless the skybox goes first
+   enum render_task
+   {
+      RENDER_TASK_PREPASS,
+      RENDER_TASK_TERRAIN,
+      RENDER_TASK_QUERIES,
+      RENDER_TASK_MODEL,
+      RENDER_TASK_SKYBOX,
+      RENDER_TASK_COUNT,
+   };
+
+   const char *render_task_name(render_task task);
+
+   enum occlusion_mode
+   {
+      OCCLUSION_MODE_NONE,
+      OCCLUSION_MODE_SOFTWARE,
+      OCCLUSION_MODE_HARDWARE,
+      OCCLUSION_MODE_BOTH,
+   };
+
+   // note: forward shades while drawing, deferred writes albedo and normals to
+   //       the g-buffer and shades every pixel once in a fullscreen pass
+   enum shading_path
+   {
+      SHADING_PATH_FORWARD,
+      SHADING_PATH_DEFERRED,
+   };
+
+   // note: how the opaque geometry is drawn. with the prepass the depth buffer
+   //       is laid down from position-only streams first and the shaded passes
+   //       only ever write the front-most fragment. sorting helps the same way
+   //       without a prepass. the skybox either fills the screen first or only
+   //       the pixels that nothing else covered.
+   struct opaque_pass_settings
+   {
+      opaque_pass_settings();
+
+      bool depth_prepass_;
+      bool front_to_back_;
+      bool skybox_last_;
+   };
+
+   // note: field spreads the props out over the hills, city packs them into a
+   //       dense grid of blocks of different heights
+   enum scene_layout
+   {
+      SCENE_LAYOUT_FIELD,
+      SCENE_LAYOUT_CITY,
+   };
+
+   // note: samples that passed the depth test per render task over the measured frames
+   struct fragment_statistics
+   {
+      fragment_statistics();
+
+      uint32 frames_;
+      uint64 pixels_;
+      uint64 samples_[RENDER_TASK_COUNT];
+   };
+
+   // note: gpu frame times of the measured frames, reported as benchmark metrics
+   struct gpu_frame_statistics
+   {
+      gpu_frame_statistics();
+
+      void add(const time &gpu_time, const time &budget, float scale);
+
+      uint32 count_;
+      uint32 over_budget_;
+      double sum_;
+      double sum_squared_;
+      double max_;
+      double scale_sum_;
+   };
+
+   // note: culling results of the measured frames, reported as benchmark metrics
+   struct culling_statistics
+   {
+      culling_statistics();
+
+      uint32 frames_;
+      uint64 tested_;
+      uint64 frustum_culled_;
+      uint64 occlusion_culled_;
+      time raster_time_;
+      uint64 queries_;
+      uint64 skipped_draws_;
+      uint64 conditional_draws_;
+      time readback_time_;
+   };
+
+   // note: clustered lighting results of the measured frames, reported as benchmark metrics
+   struct lighting_statistics
+   {
+      lighting_statistics();
+
+      uint32 frames_;
+      uint64 visible_;
+      uint64 references_;
+      uint32 max_per_cluster_;
+      uint64 overflow_;
+   };
+
+   // note: shadow pass results of the measured frames, reported as benchmark metrics
+   struct shadow_statistics
+   {
+      shadow_statistics();
+
+      uint32 frames_;
+      uint64 static_updates_;
+      uint64 tile_copies_;
+      uint64 static_casters_;
+      uint64 dynamic_casters_;
+   };
+
+   // note: draw calls of the scene tasks and static batch results of the measured frames
+   struct batching_statistics
+   {
+      batching_statistics();
+
+      uint32 frames_;
+      uint64 draw_calls_;
+      uint64 visible_chunks_;
+      uint64 ranges_;
+   };
+
+   // note: sync decodes and uploads one texture a frame on the main thread,
+   //       pbo hands them to the texture streamer
+   enum texture_streaming
+   {
+      TEXTURE_STREAMING_OFF,
+      TEXTURE_STREAMING_SYNC,
+      TEXTURE_STREAMING_PBO,
+   };
+
+   // note: main thread time spent on streaming over the frames it took to
+   //       stream everything, a hitch is a frame that lost more than HITCH_MS
+   struct streaming_statistics
+   {
+      static constexpr double HITCH_MS = 4.0;
+
+      streaming_statistics();
+
+      uint32 frames_;
+      uint32 hitches_;
+      uint32 textures_;
+      uint64 bytes_;
+      double total_ms_;
+      double max_ms_;
+      bool finished_;
+   };
+
+   // note: reads the backbuffer back every frame and writes it out on the
+   //       readback workers, as png or as raw rgba
+   enum frame_capture
+   {
+      FRAME_CAPTURE_OFF,
+      FRAME_CAPTURE_PNG,
+      FRAME_CAPTURE_RAW,
+   };
+
+   // note: main thread time spent on capturing over the measured frames
+   struct capture_statistics
+   {
+      capture_statistics();
+
+      uint32 frames_;
+      double total_ms_;
+      double max_ms_;
+   };
+
+   // note: micro-benchmarks that run once before the first measured frame,
+   //       picked with --measure. the program cache one compiles every lit
+   //       shader permutation and is only run when asked for
+   enum measure_flags
+   {
+      MEASURE_NONE           = 0,
+      MEASURE_RECORDING      = 1 << 0,
+      MEASURE_OCCLUSION      = 1 << 1,
+      MEASURE_LIGHTING       = 1 << 2,
+      MEASURE_GEOMETRY_ARENA = 1 << 3,
+      MEASURE_GRID_MESHES    = 1 << 4,
+      MEASURE_PROGRAM_CACHE  = 1 << 5,
+      MEASURE_DEFAULT        = MEASURE_RECORDING | MEASURE_OCCLUSION | MEASURE_LIGHTING | MEASURE_GEOMETRY_ARENA | MEASURE_GRID_MESHES,
+      MEASURE_ALL            = MEASURE_DEFAULT | MEASURE_PROGRAM_CACHE,
+   };
+
    struct testbed : application 
    {
       testbed();
+      virtual bool parse_argument(int argc, char **argv, int &index) final;
       virtual bool enter() final;
       virtual void exit() final;
-      virtual bool tick(const time &dt) final;
+      virtual bool update(const time &dt) final;
+      virtual void render(const double alpha) final;
 
+      void cull();
+      void record(render_task task, command_buffer &commands);
+      void record_shadows(uint32 cascade);
+      void update_dynamic_props();
+      void stream_textures();
+      void capture_frame();
+      void measure_recording();
+      void measure_occlusion();
+      void measure_lighting();
+      void measure_geometry_arena();
+      void measure_grid_meshes();
+      void measure_program_cache();
+      void create_lights(uint32 count, dynamic_array<light> &lights) const;
+
+	  resource_cache cache_;
 	  shader_program program_;
 	  vertex_buffer vbo_;
 	  index_buffer index_buffer_;
@@ -41,13 +256,84 @@ namespace neon
 	  bitmap_font font_;
 
 	  fps_camera camera_;
+	  fps_camera previous_camera_;
+	  fps_camera render_camera_;
 	  fps_camera_controller controller_;
+	  camera_path path_;
+	  geometry_arena arena_;
+	  grid_topology grid_topology_;
+	  bool grid_short_indices_;
 	  skybox skybox_;
 	  terrain terrain_;
 	  sphere sphere_;
 	  glm::mat4 model_matrix_;
 	  model model_;
-	  framebuffer framebuffer_;
+	  bounding_sphere model_bounds_;
+	  dynamic_array<glm::mat4> props_;
+	  dynamic_array<bounding_sphere> prop_bounds_;
+	  dynamic_array<uint32> visible_props_;
+	  scene_layout scene_layout_;
+	  bool batching_;
+	  bool batching_requested_;
+	  bool batching_overridden_;
+	  static_batches batches_;
+	  batching_statistics batching_statistics_;
+	  texture_streaming texture_streaming_;
+	  texture_streamer streamer_;
+	  dynamic_array<texture> streamed_textures_;
+	  dynamic_array<uint8> streamed_pixels_;
+	  uint32 streamed_next_;
+	  streaming_statistics streaming_statistics_;
+	  frame_capture frame_capture_;
+	  framebuffer_readback readback_;
+	  string capture_directory_;
+	  capture_statistics capture_statistics_;
+	  uint32 measures_;
+	  uint32 draw_calls_;
+	  dynamic_array<glm::mat4> dynamic_props_;
+	  dynamic_array<bounding_sphere> dynamic_bounds_;
+	  dynamic_array<uint32> visible_dynamic_;
+	  dynamic_array<glm::vec3> occluder_positions_;
+	  dynamic_array<uint32> occluder_indices_;
+	  occlusion_mode occlusion_mode_;
+	  occlusion_culler occlusion_;
+	  occlusion_queries occlusion_queries_;
+	  uint32 frustum_culled_;
+	  culling_statistics culling_statistics_;
+	  opaque_pass_settings opaque_settings_;
+	  fragment_counter fragment_counter_;
+	  fragment_statistics fragment_statistics_;
+	  double overdraw_;
+	  uint32 light_count_;
+	  dynamic_array<light> lights_;
+	  light_clusters clusters_;
+	  lighting_statistics lighting_statistics_;
+	  shadow_cascades shadows_;
+	  shadow_statistics shadow_statistics_;
+	  framebuffer_pool pool_;
+	  render_graph graph_;
+	  render_resource scene_color_;
+	  render_resource scene_depth_;
+	  render_resource scene_output_;
+	  render_resource gbuffer_albedo_;
+	  render_resource gbuffer_normal_;
+	  shading_path shading_path_;
+	  deferred_lighting deferred_;
+	  command_buffer lighting_commands_;
+	  uint32 msaa_samples_;
+	  dynamic_resolution resolution_;
+	  gpu_timer gpu_timer_;
+	  time gpu_time_;
+	  gpu_profiler gpu_profiler_;
+	  dynamic_array<gpu_profiler::scope> gpu_profile_;
+	  gpu_frame_statistics gpu_statistics_;
+
+	  thread_pool workers_;
+	  command_buffer commands_[RENDER_TASK_COUNT];
+	  command_buffer overlay_commands_;
+
+	  bool show_profiler_;
+	  dynamic_array<profiler::summary> profile_;
    };
 } // !neon
 
@@ -0,0 +1,88 @@
+// neon_texture_streamer.h
+
+#ifndef NEON_TEXTURE_STREAMER_H_INCLUDED
+#define NEON_TEXTURE_STREAMER_H_INCLUDED
+
+#include "neon_graphics.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace neon {
+   // note: loads textures without stalling the main thread on decoding or
+   //       uploading. a ring of RING_SIZE pixel unpack buffers is mapped on
+   //       the main thread and handed to one of the decode threads, which
+   //       reads the file and writes the pixels straight into the mapped
+   //       memory. update() unmaps finished slots, allocates the texture and
+   //       issues glTexSubImage2D from the buffer, the driver copies from
+   //       there whenever it likes. a fence per slot tells when the buffer
+   //       may be mapped again, update() only polls them. the thread_pool
+   //       only does fork-join work, so the streamer keeps one decode thread
+   //       per slot, capped by the core count. update() leaves the texture
+   //       bound to GL_TEXTURE_2D as it found it. the target texture has to
+   //       stay where it is until it turns valid.
+   struct texture_streamer {
+      static constexpr uint32 RING_SIZE = 4;
+      static constexpr uint32 SLOT_BYTES = 16 * 1024 * 1024;
+
+      enum slot_state {
+         SLOT_STATE_FREE,
+         SLOT_STATE_DECODING,
+         SLOT_STATE_DECODED,
+         SLOT_STATE_UPLOADING,
+      };
+
+      struct queued_request {
+         string filename_;
+         bool flip_;
+         texture *target_;
+      };
+
+      struct slot {
+         slot();
+
+         GLuint buffer_;
+         GLsync fence_;
+         uint8 *pixels_;
+         std::atomic<uint32> state_;
+         queued_request request_;
+         int32 width_;
+         int32 height_;
+         bool failed_;
+      };
+
+      struct statistics {
+         statistics();
+
+         uint32 requested_;
+         uint32 uploaded_;
+         uint32 failed_;
+         uint64 uploaded_bytes_;
+         time update_time_;
+      };
+
+      texture_streamer();
+
+      bool create();
+      void destroy();
+
+      bool is_valid() const;
+      bool is_idle() const;
+      void request(const string &filename, bool flip, texture &target);
+      void update();
+
+      void decode_loop();
+
+      slot slots_[RING_SIZE];
+      dynamic_array<queued_request> pending_;
+      dynamic_array<uint32> jobs_;
+      dynamic_array<std::thread> threads_;
+      std::mutex mutex_;
+      std::condition_variable wake_;
+      bool running_;
+      statistics statistics_;
+   };
+} // !neon
+
+#endif // !NEON_TEXTURE_STREAMER_H_INCLUDED
@@ -0,0 +1,360 @@
+// neon_batching.cc
+
+#include "neon_batching.h"
+#include "neon_lighting.h"
+#include <neon_profiler.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace neon {
+   namespace {
+      bool is_same_group(const batch_source &lhs, const batch_source &rhs) {
+         return lhs.program_ == rhs.program_ &&
+            lhs.texture_ == rhs.texture_ &&
+            lhs.sampler_ == rhs.sampler_ &&
+            lhs.format_ == rhs.format_;
+      }
+
+      // note: any strict order works, equal materials only have to end up next to each other
+      bool is_group_before(const batch_source &lhs, const batch_source &rhs) {
+         if (lhs.program_ != rhs.program_) {
+            return std::less<const shader_program *>()(lhs.program_, rhs.program_);
+         }
+         if (lhs.texture_ != rhs.texture_) {
+            return std::less<const texture *>()(lhs.texture_, rhs.texture_);
+         }
+         if (lhs.sampler_ != rhs.sampler_) {
+            return std::less<const sampler_state *>()(lhs.sampler_, rhs.sampler_);
+         }
+         return std::less<const vertex_format *>()(lhs.format_, rhs.format_);
+      }
+
+      // note: chunks next to each other in the buffer become one range
+      void append_range(dynamic_array<int32> &starts, dynamic_array<int32> &counts, const static_batches::chunk &entry) {
+         if (!counts.empty() && starts.back() + counts.back() == entry.start_) {
+            counts.back() += entry.count_;
+         }
+         else {
+            starts.push_back(entry.start_);
+            counts.push_back(entry.count_);
+         }
+      }
+   } // !anon
+
+   batch_source::batch_source()
+      : program_(nullptr)
+      , gbuffer_program_(nullptr)
+      , depth_program_(nullptr)
+      , texture_(nullptr)
+      , sampler_(nullptr)
+      , format_(nullptr)
+      , vertices_(nullptr)
+      , vertex_count_(0)
+      , stride_(0)
+      , normal_offset_(-1)
+      , indices_(nullptr)
+      , index_count_(0)
+   {
+   }
+
+   static_batches::statistics::statistics()
+      : renderables_(0)
+      , groups_(0)
+      , chunks_(0)
+      , frustum_culled_chunks_(0)
+      , visible_chunks_(0)
+      , ranges_(0)
+      , vertex_bytes_(0)
+      , index_bytes_(0)
+   {
+   }
+
+   static_batches::static_batches()
+   {
+   }
+
+   bool static_batches::is_valid() const {
+      return !groups_.empty();
+   }
+
+   void static_batches::add(const batch_source &source, const glm::mat4 &world) {
+      assert(source.program_ && source.format_ && source.vertices_ && source.indices_);
+      assert(source.stride_ >= sizeof(glm::vec3));
+
+      instance entry;
+      entry.source_ = source;
+      entry.world_ = world;
+      entry.chunk_x_ = (int32)floorf(world[3].x / CHUNK_SIZE);
+      entry.chunk_z_ = (int32)floorf(world[3].z / CHUNK_SIZE);
+      instances_.push_back(entry);
+   }
+
+   bool static_batches::build() {
+      NEON_PROFILE_SCOPE("static_batches::build");
+
+      // note: by material first, then by chunk so every chunk is one index range
+      std::stable_sort(instances_.begin(), instances_.end(), [](const instance &lhs, const instance &rhs) {
+         if (!is_same_group(lhs.source_, rhs.source_)) {
+            return is_group_before(lhs.source_, rhs.source_);
+         }
+         if (lhs.chunk_z_ != rhs.chunk_z_) {
+            return lhs.chunk_z_ < rhs.chunk_z_;
+         }
+         return lhs.chunk_x_ < rhs.chunk_x_;
+      });
+
+      statistics_ = statistics();
+      statistics_.renderables_ = (uint32)instances_.size();
+
+      dynamic_array<uint8> vertices;
+      dynamic_array<uint32> indices;
+      size_t first = 0;
+      while (first < instances_.size()) {
+         const batch_source &material = instances_[first].source_;
+         size_t last = first + 1;
+         while (last < instances_.size() && is_same_group(material, instances_[last].source_)) {
+            last++;
+         }
+
+         groups_.push_back(group());
+         group &target = groups_.back();
+         target.program_ = material.program_;
+         target.gbuffer_program_ = material.gbuffer_program_;
+         target.depth_program_ = material.depth_program_;
+         target.texture_ = material.texture_;
+         target.sampler_ = material.sampler_;
+         target.format_ = *material.format_;
+         if (material.depth_program_) {
+            target.depth_format_.add_attribute(material.depth_program_->get_attrib_location("position"), 3, GL_FLOAT, false);
+            target.depth_format_.stride_ = material.stride_;
+         }
+
+         vertices.clear();
+         indices.clear();
+         glm::vec3 bounds_min(0.0f), bounds_max(0.0f);
+         for (size_t index = first; index < last; index++) {
+            const instance &entry = instances_[index];
+            const batch_source &source = entry.source_;
+            assert(source.stride_ == material.stride_);
+
+            const bool new_chunk = index == first ||
+               entry.chunk_x_ != instances_[index - 1].chunk_x_ ||
+               entry.chunk_z_ != instances_[index - 1].chunk_z_;
+            if (new_chunk) {
+               chunk next;
+               next.start_ = (int32)indices.size();
+               next.count_ = 0;
+               target.chunks_.push_back(next);
+            }
+
+            // note: positions and normals go to world space, everything else is copied as is
+            const uint32 base = (uint32)(vertices.size() / source.stride_);
+            const glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(entry.world_)));
+            vertices.resize(vertices.size() + (size_t)source.vertex_count_ * source.stride_);
+            uint8 *destination = vertices.data() + (size_t)base * source.stride_;
+            memcpy(destination, source.vertices_, (size_t)source.vertex_count_ * source.stride_);
+
+            for (uint32 vertex = 0; vertex < source.vertex_count_; vertex++) {
+               uint8 *at = destination + (size_t)vertex * source.stride_;
+               glm::vec3 position;
+               memcpy(&position, at, sizeof(position));
+               position = glm::vec3(entry.world_ * glm::vec4(position, 1.0f));
+               memcpy(at, &position, sizeof(position));
+
+               if (source.normal_offset_ >= 0) {
+                  glm::vec3 normal;
+                  memcpy(&normal, at + source.normal_offset_, sizeof(normal));
+                  normal = glm::normalize(normal_matrix * normal);
+                  memcpy(at + source.normal_offset_, &normal, sizeof(normal));
+               }
+
+               if (new_chunk && vertex == 0) {
+                  bounds_min = bounds_max = position;
+               }
+               bounds_min = glm::min(bounds_min, position);
+               bounds_max = glm::max(bounds_max, position);
+            }
+
+            for (uint32 index_at = 0; index_at < source.index_count_; index_at++) {
+               indices.push_back(source.indices_[index_at] + base);
+            }
+
+            // note: the sphere grows with every instance of the chunk, closed when the next one starts
+            chunk &current = target.chunks_.back();
+            current.count_ = (int32)indices.size() - current.start_;
+            current.bounds_ = bounding_sphere((bounds_min + bounds_max) * 0.5f, glm::length(bounds_max - bounds_min) * 0.5f);
+         }
+
+         if (!target.vertex_buffer_.create((int)vertices.size(), vertices.data())) {
+            return false;
+         }
+
+         if (!target.index_buffer_.create((int)(sizeof(uint32) * indices.size()), GL_UNSIGNED_INT, indices.data())) {
+            return false;
+         }
+
+         target.starts_.reserve(target.chunks_.size());
+         target.counts_.reserve(target.chunks_.size());
+
+         statistics_.groups_++;
+         statistics_.chunks_ += (uint32)target.chunks_.size();
+         statistics_.vertex_bytes_ += vertices.size();
+         statistics_.index_bytes_ += sizeof(uint32) * indices.size();
+         first = last;
+      }
+
+      instances_.clear();
+
+      return true;
+   }
+
+   void static_batches::destroy() {
+      for (auto &target : groups_) {
+         target.vertex_buffer_.destroy();
+         target.index_buffer_.destroy();
+      }
+      groups_.clear();
+      instances_.clear();
+   }
+
+   void static_batches::cull(const frustum &view, occlusion_culler *occlusion) {
+      NEON_PROFILE_SCOPE("static_batches::cull");
+
+      statistics_.frustum_culled_chunks_ = 0;
+      statistics_.visible_chunks_ = 0;
+      statistics_.ranges_ = 0;
+      for (auto &target : groups_) {
+         target.starts_.clear();
+         target.counts_.clear();
+         for (auto &entry : target.chunks_) {
+            if (!view.is_inside(entry.bounds_)) {
+               statistics_.frustum_culled_chunks_++;
+               continue;
+            }
+
+            if (occlusion && !occlusion->is_visible(entry.bounds_)) {
+               continue;
+            }
+
+            append_range(target.starts_, target.counts_, entry);
+            statistics_.visible_chunks_++;
+         }
+
+         statistics_.ranges_ += (uint32)target.starts_.size();
+      }
+   }
+
+   void static_batches::record(command_buffer &commands, const fps_camera &camera, const light_clusters &lights) const {
+      NEON_PROFILE_SCOPE("static_batches::record");
+
+      for (auto &target : groups_) {
+         if (target.starts_.empty()) {
+            continue;
+         }
+
+         commands.set_capability(GL_DEPTH_TEST, true);
+         commands.set_capability(GL_CULL_FACE, false);
+         commands.set_front_face(GL_CW);
+
+         commands.bind_program(*target.program_);
+         commands.set_uniform_mat4("projection", camera.projection_);
+         commands.set_uniform_mat4("view", camera.view_);
+         commands.set_uniform_mat4("world", glm::mat4(1));
+         lights.bind(commands);
+
+         commands.bind_texture(*target.texture_);
+         commands.bind_sampler(*target.sampler_);
+
+         commands.bind_vertex_buffer(target.vertex_buffer_);
+         commands.bind_vertex_format(target.format_);
+         commands.bind_index_buffer(target.index_buffer_);
+         commands.draw_elements_multi(GL_TRIANGLES, target.index_buffer_, target.starts_.data(), target.counts_.data(), (int32)target.starts_.size());
+      }
+   }
+
+   void static_batches::record_gbuffer(command_buffer &commands, const fps_camera &camera) const {
+      NEON_PROFILE_SCOPE("static_batches::record_gbuffer");
+
+      for (auto &target : groups_) {
+         if (target.starts_.empty() || !target.gbuffer_program_) {
+            continue;
+         }
+
+         commands.set_capability(GL_DEPTH_TEST, true);
+         commands.set_capability(GL_CULL_FACE, false);
+         commands.set_front_face(GL_CW);
+
+         commands.bind_program(*target.gbuffer_program_);
+         commands.set_uniform_mat4("projection", camera.projection_);
+         commands.set_uniform_mat4("view", camera.view_);
+         commands.set_uniform_mat4("world", glm::mat4(1));
+
+         commands.bind_texture(*target.texture_);
+         commands.bind_sampler(*target.sampler_);
+
+         commands.bind_vertex_buffer(target.vertex_buffer_);
+         commands.bind_vertex_format(target.format_);
+         commands.bind_index_buffer(target.index_buffer_);
+         commands.draw_elements_multi(GL_TRIANGLES, target.index_buffer_, target.starts_.data(), target.counts_.data(), (int32)target.starts_.size());
+      }
+   }
+
+   void static_batches::record_depth(command_buffer &commands, const fps_camera &camera) const {
+      NEON_PROFILE_SCOPE("static_batches::record_depth");
+
+      for (auto &target : groups_) {
+         if (target.starts_.empty() || !target.depth_program_) {
+            continue;
+         }
+
+         record_depth_ranges(commands, camera, target, target.starts_.data(), target.counts_.data(), (int32)target.starts_.size());
+      }
+   }
+
+   // note: the ranges of cull() belong to the main view, these are built here and
+   //       only live until recorded, the command buffer keeps its own copy
+   uint32 static_batches::record_depth(command_buffer &commands, const fps_camera &camera, const frustum &view) const {
+      NEON_PROFILE_SCOPE("static_batches::record_depth");
+
+      uint32 visible = 0;
+      dynamic_array<int32> starts;
+      dynamic_array<int32> counts;
+      for (auto &target : groups_) {
+         if (!target.depth_program_) {
+            continue;
+         }
+
+         starts.clear();
+         counts.clear();
+         for (auto &entry : target.chunks_) {
+            if (view.is_inside(entry.bounds_)) {
+               append_range(starts, counts, entry);
+               visible++;
+            }
+         }
+
+         if (!starts.empty()) {
+            record_depth_ranges(commands, camera, target, starts.data(), counts.data(), (int32)starts.size());
+         }
+      }
+
+      return visible;
+   }
+
+   void static_batches::record_depth_ranges(command_buffer &commands, const fps_camera &camera, const group &target, const int32 *starts, const int32 *counts, int32 count) const {
+      commands.set_capability(GL_DEPTH_TEST, true);
+      commands.set_capability(GL_CULL_FACE, false);
+
+      commands.bind_program(*target.depth_program_);
+      commands.set_uniform_mat4("projection", camera.projection_);
+      commands.set_uniform_mat4("view", camera.view_);
+      commands.set_uniform_mat4("world", glm::mat4(1));
+
+      commands.bind_vertex_buffer(target.vertex_buffer_);
+      commands.bind_vertex_format(target.depth_format_);
+      commands.bind_index_buffer(target.index_buffer_);
+      commands.draw_elements_multi(GL_TRIANGLES, target.index_buffer_, starts, counts, count);
+   }
+} // !neon
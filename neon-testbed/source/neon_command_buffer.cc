@@ -0,0 +1,413 @@
+// neon_command_buffer.cc
+
+#include "neon_command_buffer.h"
+#include <cassert>
+#include <cstring>
+
+namespace neon {
+   namespace {
+      // note: where the offsets of a multi draw start, counted from the command
+      const uint32 MULTI_DRAW_OFFSETS = (uint32)((sizeof(command_buffer::multi_draw_command) + 7) & ~7u);
+   } // !anon
+
+   command_buffer::command_buffer()
+      : command_count_(0)
+      , draw_count_(0)
+   {
+   }
+
+   void command_buffer::reset() {
+      // note: keeps the capacity, buffers are reused every frame
+      storage_.clear();
+      command_count_ = 0;
+      draw_count_ = 0;
+   }
+
+   bool command_buffer::is_empty() const {
+      return command_count_ == 0;
+   }
+
+   uint32 command_buffer::command_count() const {
+      return command_count_;
+   }
+
+   uint32 command_buffer::draw_count() const {
+      return draw_count_;
+   }
+
+   uint32 command_buffer::size() const {
+      return (uint32)storage_.size();
+   }
+
+   void command_buffer::bind_program(const shader_program &program) {
+      bind_command *command = push<bind_command>(COMMAND_TYPE_BIND_PROGRAM);
+      command->target_ = GL_NONE;
+      command->id_ = program.id_;
+      command->slot_ = 0;
+   }
+
+   void command_buffer::bind_vertex_buffer(const vertex_buffer &buffer) {
+      bind_command *command = push<bind_command>(COMMAND_TYPE_BIND_VERTEX_BUFFER);
+      command->target_ = GL_ARRAY_BUFFER;
+      command->id_ = buffer.id_;
+      command->slot_ = 0;
+   }
+
+   void command_buffer::bind_index_buffer(const index_buffer &buffer) {
+      bind_command *command = push<bind_command>(COMMAND_TYPE_BIND_INDEX_BUFFER);
+      command->target_ = GL_ELEMENT_ARRAY_BUFFER;
+      command->id_ = buffer.id_;
+      command->slot_ = 0;
+   }
+
+   void command_buffer::bind_vertex_format(const vertex_format &format) {
+      vertex_format_command *command = push<vertex_format_command>(COMMAND_TYPE_BIND_VERTEX_FORMAT);
+      command->format_ = format;
+   }
+
+   void command_buffer::bind_texture(const texture &texture, uint32 slot) {
+      bind_command *command = push<bind_command>(COMMAND_TYPE_BIND_TEXTURE);
+      command->target_ = texture.type_;
+      command->id_ = texture.id_;
+      command->slot_ = slot;
+   }
+
+   void command_buffer::bind_sampler(const sampler_state &sampler, uint32 slot) {
+      bind_command *command = push<bind_command>(COMMAND_TYPE_BIND_SAMPLER);
+      command->target_ = GL_NONE;
+      command->id_ = sampler.id_;
+      command->slot_ = slot;
+   }
+
+   void command_buffer::set_uniform_mat4(const char *name, const glm::mat4 &value) {
+      uniform_command<glm::mat4> *command = push<uniform_command<glm::mat4>>(COMMAND_TYPE_UNIFORM_MAT4);
+      command->name_ = name;
+      command->value_ = value;
+   }
+
+   void command_buffer::set_uniform_vec4(const char *name, const glm::vec4 &value) {
+      uniform_command<glm::vec4> *command = push<uniform_command<glm::vec4>>(COMMAND_TYPE_UNIFORM_VEC4);
+      command->name_ = name;
+      command->value_ = value;
+   }
+
+   void command_buffer::set_uniform_vec3(const char *name, const glm::vec3 &value) {
+      uniform_command<glm::vec3> *command = push<uniform_command<glm::vec3>>(COMMAND_TYPE_UNIFORM_VEC3);
+      command->name_ = name;
+      command->value_ = value;
+   }
+
+   void command_buffer::set_uniform_int(const char *name, int32 value) {
+      uniform_command<int32> *command = push<uniform_command<int32>>(COMMAND_TYPE_UNIFORM_INT);
+      command->name_ = name;
+      command->value_ = value;
+   }
+
+   void command_buffer::set_capability(GLenum capability, bool enabled) {
+      capability_command *command = push<capability_command>(COMMAND_TYPE_SET_CAPABILITY);
+      command->capability_ = capability;
+      command->enabled_ = enabled ? GL_TRUE : GL_FALSE;
+   }
+
+   void command_buffer::set_front_face(GLenum mode) {
+      front_face_command *command = push<front_face_command>(COMMAND_TYPE_SET_FRONT_FACE);
+      command->mode_ = mode;
+   }
+
+   void command_buffer::set_blend(GLenum source_color, GLenum destination_color, GLenum source_alpha, GLenum destination_alpha, GLenum equation_color, GLenum equation_alpha) {
+      blend_command *command = push<blend_command>(COMMAND_TYPE_SET_BLEND);
+      command->source_color_ = source_color;
+      command->destination_color_ = destination_color;
+      command->source_alpha_ = source_alpha;
+      command->destination_alpha_ = destination_alpha;
+      command->equation_color_ = equation_color;
+      command->equation_alpha_ = equation_alpha;
+   }
+
+   void command_buffer::set_write_mask(bool color, bool depth) {
+      write_mask_command *command = push<write_mask_command>(COMMAND_TYPE_SET_WRITE_MASK);
+      command->color_ = color ? GL_TRUE : GL_FALSE;
+      command->depth_ = depth ? GL_TRUE : GL_FALSE;
+   }
+
+   void command_buffer::set_depth_func(GLenum func) {
+      depth_func_command *command = push<depth_func_command>(COMMAND_TYPE_SET_DEPTH_FUNC);
+      command->func_ = func;
+   }
+
+   void command_buffer::set_primitive_restart(bool enabled, GLuint index) {
+      primitive_restart_command *command = push<primitive_restart_command>(COMMAND_TYPE_SET_PRIMITIVE_RESTART);
+      command->enabled_ = enabled ? GL_TRUE : GL_FALSE;
+      command->index_ = index;
+   }
+
+   void command_buffer::begin_query(GLenum target, GLuint id) {
+      query_command *command = push<query_command>(COMMAND_TYPE_BEGIN_QUERY);
+      command->target_ = target;
+      command->id_ = id;
+   }
+
+   void command_buffer::end_query(GLenum target) {
+      query_command *command = push<query_command>(COMMAND_TYPE_END_QUERY);
+      command->target_ = target;
+      command->id_ = 0;
+   }
+
+   void command_buffer::begin_conditional_render(GLuint id, GLenum mode) {
+      conditional_render_command *command = push<conditional_render_command>(COMMAND_TYPE_BEGIN_CONDITIONAL_RENDER);
+      command->id_ = id;
+      command->mode_ = mode;
+   }
+
+   void command_buffer::end_conditional_render() {
+      push<conditional_render_command>(COMMAND_TYPE_END_CONDITIONAL_RENDER);
+   }
+
+   void command_buffer::update_vertex_buffer(const vertex_buffer &buffer, uint32 size, const void *data) {
+      // note: the data is copied in after the command, the caller may reuse its memory
+      update_buffer_command *command = push<update_buffer_command>(COMMAND_TYPE_UPDATE_VERTEX_BUFFER, size);
+      command->id_ = buffer.id_;
+      command->size_ = size;
+      if (size > 0) {
+         memcpy(command + 1, data, size);
+      }
+   }
+
+   void command_buffer::draw_arrays(GLenum primitive, int32 start, int32 count) {
+      draw_command *command = push<draw_command>(COMMAND_TYPE_DRAW_ARRAYS);
+      command->primitive_ = primitive;
+      command->index_type_ = GL_NONE;
+      command->start_ = start;
+      command->count_ = count;
+      draw_count_++;
+   }
+
+   void command_buffer::draw_elements(GLenum primitive, const index_buffer &buffer, int32 start, int32 count) {
+      draw_command *command = push<draw_command>(COMMAND_TYPE_DRAW_ELEMENTS);
+      command->primitive_ = primitive;
+      command->index_type_ = buffer.type_;
+      command->start_ = start;
+      command->count_ = count;
+      draw_count_++;
+   }
+
+   void command_buffer::draw_elements_base_vertex(GLenum primitive, const index_buffer &buffer, int32 start, int32 count, int32 base_vertex) {
+      draw_base_vertex_command *command = push<draw_base_vertex_command>(COMMAND_TYPE_DRAW_ELEMENTS_BASE_VERTEX);
+      command->primitive_ = primitive;
+      command->index_type_ = buffer.type_;
+      command->start_ = start;
+      command->count_ = count;
+      command->base_vertex_ = base_vertex;
+      draw_count_++;
+   }
+
+   void command_buffer::draw_elements_multi(GLenum primitive, const index_buffer &buffer, const int32 *starts, const int32 *counts, int32 draw_count) {
+      if (draw_count <= 0) {
+         return;
+      }
+
+      const uint32 extra = MULTI_DRAW_OFFSETS - (uint32)sizeof(multi_draw_command) + (uint32)(sizeof(const void *) + sizeof(GLsizei)) * draw_count;
+      multi_draw_command *command = push<multi_draw_command>(COMMAND_TYPE_MULTI_DRAW_ELEMENTS, extra);
+      command->primitive_ = primitive;
+      command->index_type_ = buffer.type_;
+      command->draw_count_ = draw_count;
+
+      const uint64 index_size = buffer.type_ == GL_UNSIGNED_INT ? 4 : 2;
+      const void **offsets = (const void **)((uint8 *)command + MULTI_DRAW_OFFSETS);
+      GLsizei *sizes = (GLsizei *)(offsets + draw_count);
+      for (int32 index = 0; index < draw_count; index++) {
+         offsets[index] = (const void *)(starts[index] * index_size);
+         sizes[index] = counts[index];
+      }
+      draw_count_++;
+   }
+
+   void command_buffer::submit() const {
+      GLuint program = 0;
+
+      // note: meshes sharing an arena bind the same buffers, those binds are skipped.
+      //       nothing is known about the bindings before the first command
+      GLuint vertex_buffer_id = ~0u;
+      GLuint index_buffer_id = ~0u;
+
+      const uint8 *at = storage_.data();
+      const uint8 *end = at + storage_.size();
+      while (at < end) {
+         const header *head = (const header *)at;
+         const void *payload = head + 1;
+         at += head->size_;
+
+         switch (head->type_) {
+            case COMMAND_TYPE_BIND_PROGRAM:
+            {
+               program = ((const bind_command *)payload)->id_;
+               glUseProgram(program);
+            } break;
+
+            case COMMAND_TYPE_BIND_VERTEX_BUFFER:
+            case COMMAND_TYPE_BIND_INDEX_BUFFER:
+            {
+               const bind_command *command = (const bind_command *)payload;
+               GLuint &bound = head->type_ == COMMAND_TYPE_BIND_VERTEX_BUFFER ? vertex_buffer_id : index_buffer_id;
+               if (bound != command->id_) {
+                  glBindBuffer(command->target_, command->id_);
+                  bound = command->id_;
+               }
+            } break;
+
+            case COMMAND_TYPE_BIND_VERTEX_FORMAT:
+            {
+               ((const vertex_format_command *)payload)->format_.bind();
+            } break;
+
+            case COMMAND_TYPE_BIND_TEXTURE:
+            {
+               const bind_command *command = (const bind_command *)payload;
+               glActiveTexture(GL_TEXTURE0 + command->slot_);
+               glBindTexture(command->target_, command->id_);
+            } break;
+
+            case COMMAND_TYPE_BIND_SAMPLER:
+            {
+               const bind_command *command = (const bind_command *)payload;
+               glBindSampler(command->slot_, command->id_);
+            } break;
+
+            case COMMAND_TYPE_UNIFORM_MAT4:
+            {
+               const uniform_command<glm::mat4> *command = (const uniform_command<glm::mat4> *)payload;
+               glUniformMatrix4fv(glGetUniformLocation(program, command->name_), 1, GL_FALSE, glm::value_ptr(command->value_));
+            } break;
+
+            case COMMAND_TYPE_UNIFORM_VEC4:
+            {
+               const uniform_command<glm::vec4> *command = (const uniform_command<glm::vec4> *)payload;
+               glUniform4fv(glGetUniformLocation(program, command->name_), 1, glm::value_ptr(command->value_));
+            } break;
+
+            case COMMAND_TYPE_UNIFORM_VEC3:
+            {
+               const uniform_command<glm::vec3> *command = (const uniform_command<glm::vec3> *)payload;
+               glUniform3fv(glGetUniformLocation(program, command->name_), 1, glm::value_ptr(command->value_));
+            } break;
+
+            case COMMAND_TYPE_UNIFORM_INT:
+            {
+               const uniform_command<int32> *command = (const uniform_command<int32> *)payload;
+               glUniform1i(glGetUniformLocation(program, command->name_), command->value_);
+            } break;
+
+            case COMMAND_TYPE_SET_CAPABILITY:
+            {
+               const capability_command *command = (const capability_command *)payload;
+               if (command->enabled_) {
+                  glEnable(command->capability_);
+               }
+               else {
+                  glDisable(command->capability_);
+               }
+            } break;
+
+            case COMMAND_TYPE_SET_FRONT_FACE:
+            {
+               glFrontFace(((const front_face_command *)payload)->mode_);
+            } break;
+
+            case COMMAND_TYPE_SET_BLEND:
+            {
+               const blend_command *command = (const blend_command *)payload;
+               glBlendFuncSeparate(command->source_color_, command->destination_color_, command->source_alpha_, command->destination_alpha_);
+               glBlendEquationSeparate(command->equation_color_, command->equation_alpha_);
+            } break;
+
+            case COMMAND_TYPE_SET_WRITE_MASK:
+            {
+               const write_mask_command *command = (const write_mask_command *)payload;
+               glColorMask(command->color_, command->color_, command->color_, command->color_);
+               glDepthMask(command->depth_);
+            } break;
+
+            case COMMAND_TYPE_SET_DEPTH_FUNC:
+            {
+               glDepthFunc(((const depth_func_command *)payload)->func_);
+            } break;
+
+            case COMMAND_TYPE_SET_PRIMITIVE_RESTART:
+            {
+               // note: the index has to match the index type of the draws that follow
+               const primitive_restart_command *command = (const primitive_restart_command *)payload;
+               if (command->enabled_) {
+                  glEnable(GL_PRIMITIVE_RESTART);
+                  glPrimitiveRestartIndex(command->index_);
+               }
+               else {
+                  glDisable(GL_PRIMITIVE_RESTART);
+               }
+            } break;
+
+            case COMMAND_TYPE_BEGIN_QUERY:
+            {
+               const query_command *command = (const query_command *)payload;
+               glBeginQuery(command->target_, command->id_);
+            } break;
+
+            case COMMAND_TYPE_END_QUERY:
+            {
+               glEndQuery(((const query_command *)payload)->target_);
+            } break;
+
+            case COMMAND_TYPE_BEGIN_CONDITIONAL_RENDER:
+            {
+               const conditional_render_command *command = (const conditional_render_command *)payload;
+               glBeginConditionalRender(command->id_, command->mode_);
+            } break;
+
+            case COMMAND_TYPE_END_CONDITIONAL_RENDER:
+            {
+               glEndConditionalRender();
+            } break;
+
+            case COMMAND_TYPE_UPDATE_VERTEX_BUFFER:
+            {
+               const update_buffer_command *command = (const update_buffer_command *)payload;
+               glBindBuffer(GL_ARRAY_BUFFER, command->id_);
+               glBufferData(GL_ARRAY_BUFFER, command->size_, command + 1, GL_STATIC_DRAW);
+               vertex_buffer_id = command->id_;
+            } break;
+
+            case COMMAND_TYPE_DRAW_ARRAYS:
+            {
+               const draw_command *command = (const draw_command *)payload;
+               glDrawArrays(command->primitive_, command->start_, command->count_);
+            } break;
+
+            case COMMAND_TYPE_DRAW_ELEMENTS:
+            {
+               const draw_command *command = (const draw_command *)payload;
+               const uint64 index_size = command->index_type_ == GL_UNSIGNED_INT ? 4 : 2;
+               glDrawElements(command->primitive_, command->count_, command->index_type_, (const void *)(command->start_ * index_size));
+            } break;
+
+            case COMMAND_TYPE_DRAW_ELEMENTS_BASE_VERTEX:
+            {
+               const draw_base_vertex_command *command = (const draw_base_vertex_command *)payload;
+               const uint64 index_size = command->index_type_ == GL_UNSIGNED_INT ? 4 : 2;
+               glDrawElementsBaseVertex(command->primitive_, command->count_, command->index_type_, (const void *)(command->start_ * index_size), command->base_vertex_);
+            } break;
+
+            case COMMAND_TYPE_MULTI_DRAW_ELEMENTS:
+            {
+               const multi_draw_command *command = (const multi_draw_command *)payload;
+               const void *const *offsets = (const void *const *)((const uint8 *)command + MULTI_DRAW_OFFSETS);
+               const GLsizei *counts = (const GLsizei *)(offsets + command->draw_count_);
+               glMultiDrawElements(command->primitive_, counts, command->index_type_, offsets, command->draw_count_);
+            } break;
+
+            default:
+            {
+               assert(!"unknown command type");
+            } break;
+         }
+      }
+   }
+} // !neon
@@ -0,0 +1,526 @@
+// neon_culling.cc
+
+#include "neon_culling.h"
+#include "neon_resource_cache.h"
+#include <neon_profiler.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <emmintrin.h>
+
+namespace neon {
+   bounding_sphere::bounding_sphere()
+      : center_{}
+      , radius_{}
+   {
+   }
+
+   bounding_sphere::bounding_sphere(const glm::vec3 &center, float radius)
+      : center_(center)
+      , radius_(radius)
+   {
+   }
+
+   void bounding_sphere::set_center(const glm::vec3 &center) {
+      center_ = center;
+   }
+
+   void bounding_sphere::set_radius(const float radius) {
+      radius_ = radius;
+   }
+
+   plane::plane()
+      : normal_{}
+      , d_{}
+   {
+   }
+
+   frustum::frustum()
+   {
+   }
+
+   // source: https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf
+   void frustum::construct_from_view_matrix(const glm::mat4 &view) {
+      // note: extract left plane
+      planes_[plane::PLANE_LEFT].normal_  = glm::vec3(view[0][3] + view[0][0],
+                                                      view[1][3] + view[1][0],
+                                                      view[2][3] + view[2][0]);
+      planes_[plane::PLANE_LEFT].d_       = view[3][3] + view[3][0];
+
+      // note: extract right plane
+      planes_[plane::PLANE_RIGHT].normal_ = glm::vec3(view[0][3] - view[0][0],
+                                                      view[1][3] - view[1][0],
+                                                      view[2][3] - view[2][0]);
+      planes_[plane::PLANE_RIGHT].d_      = view[3][3] - view[3][0];
+
+      // note: extract top plane
+      planes_[plane::PLANE_TOP].normal_   = glm::vec3(view[0][3] - view[0][1],
+                                                      view[1][3] - view[1][1],
+                                                      view[2][3] - view[2][1]);
+      planes_[plane::PLANE_TOP].d_        = view[3][3] - view[3][1];
+
+      // note: extract bottom plane
+      planes_[plane::PLANE_BOTTOM].normal_ = glm::vec3(view[0][3] + view[0][1],
+                                                       view[1][3] + view[1][1],
+                                                       view[2][3] + view[2][1]);
+      planes_[plane::PLANE_BOTTOM].d_     = view[3][3] + view[3][1];
+
+      // note: extract far plane
+      planes_[plane::PLANE_FAR].normal_   = glm::vec3(view[0][3] - view[0][2],
+                                                      view[1][3] - view[1][2],
+                                                      view[2][3] - view[2][2]);
+      planes_[plane::PLANE_FAR].d_        = view[3][3] - view[3][2];
+
+      // note: extract near plane, gl clip space runs from -w to w
+      planes_[plane::PLANE_NEAR].normal_  = glm::vec3(view[0][3] + view[0][2],
+                                                      view[1][3] + view[1][2],
+                                                      view[2][3] + view[2][2]);
+      planes_[plane::PLANE_NEAR].d_       = view[3][3] + view[3][2];
+
+
+      for (int32 i = 0; i < plane::PLANE_COUNT; i++) {
+         float length = glm::length(planes_[i].normal_);
+         planes_[i].normal_ /= length;
+         planes_[i].d_ /= length;
+      }
+   }
+
+   bool frustum::is_inside(const glm::vec3 &point) const {
+      for (int32 index = 0; index < plane::PLANE_COUNT; index++) {
+         float dist = glm::dot(planes_[index].normal_, point) +
+                      planes_[index].d_;
+         if (dist < 0.0f)
+            return false;
+      }
+
+      return true;
+   }
+
+   bool frustum::is_inside(const bounding_sphere &sphere) const {
+      for (int32 index = 0; index < plane::PLANE_COUNT; index++) {
+         float dist = glm::dot(planes_[index].normal_, sphere.center_) +
+                      planes_[index].d_;
+         if (dist < -sphere.radius_)
+            return false;
+      }
+
+      return true;
+   }
+
+   occlusion_culler::statistics::statistics()
+      : occluder_triangles_(0)
+      , rasterized_triangles_(0)
+      , tested_(0)
+      , culled_(0)
+   {
+   }
+
+   occlusion_culler::occlusion_culler()
+      : view_projection_(1.0f)
+   {
+      int32 width = WIDTH, height = HEIGHT;
+      for (;;) {
+         level entry;
+         entry.width_ = width;
+         entry.height_ = height;
+         entry.depth_.resize((size_t)width * height, 1.0f);
+         levels_.push_back(entry);
+
+         if (width == 1 && height == 1) {
+            break;
+         }
+
+         width = (width + 1) / 2;
+         height = (height + 1) / 2;
+      }
+   }
+
+   void occlusion_culler::begin(const glm::mat4 &view_projection) {
+      view_projection_ = view_projection;
+      triangles_.clear();
+      statistics_ = statistics();
+
+      for (auto &depth : levels_[0].depth_) {
+         depth = 1.0f;
+      }
+   }
+
+   void occlusion_culler::add_occluder(const glm::vec3 *positions, const uint32 *indices, uint32 index_count, const glm::mat4 &world) {
+      const time start = time::now();
+      const glm::mat4 transform = view_projection_ * world;
+
+      for (uint32 index = 0; index + 2 < index_count; index += 3) {
+         statistics_.occluder_triangles_++;
+
+         // note: the gpu clips whatever is in front of the near plane, we drop the whole triangle
+         glm::vec4 clip[3];
+         bool clipped = false;
+         for (int32 corner = 0; corner < 3; corner++) {
+            clip[corner] = transform * glm::vec4(positions[indices[index + corner]], 1.0f);
+            clipped |= clip[corner].w <= 0.0f || clip[corner].z < -clip[corner].w;
+         }
+
+         if (clipped) {
+            continue;
+         }
+
+         triangle result;
+         for (int32 corner = 0; corner < 3; corner++) {
+            const float inverse_w = 1.0f / clip[corner].w;
+            result.x_[corner] = (clip[corner].x * inverse_w * 0.5f + 0.5f) * WIDTH;
+            result.y_[corner] = (clip[corner].y * inverse_w * 0.5f + 0.5f) * HEIGHT;
+            result.z_[corner] = clip[corner].z * inverse_w * 0.5f + 0.5f;
+         }
+
+         if ((result.x_[0] < 0.0f && result.x_[1] < 0.0f && result.x_[2] < 0.0f) ||
+             (result.y_[0] < 0.0f && result.y_[1] < 0.0f && result.y_[2] < 0.0f) ||
+             (result.x_[0] > WIDTH && result.x_[1] > WIDTH && result.x_[2] > WIDTH) ||
+             (result.y_[0] > HEIGHT && result.y_[1] > HEIGHT && result.y_[2] > HEIGHT) ||
+             (result.z_[0] > 1.0f && result.z_[1] > 1.0f && result.z_[2] > 1.0f))
+         {
+            continue;
+         }
+
+         // note: no backface culling, every triangle is turned counter-clockwise instead
+         const float area = (result.x_[1] - result.x_[0]) * (result.y_[2] - result.y_[0]) -
+                            (result.x_[2] - result.x_[0]) * (result.y_[1] - result.y_[0]);
+         if (fabsf(area) < 1e-6f) {
+            continue;
+         }
+
+         if (area < 0.0f) {
+            std::swap(result.x_[1], result.x_[2]);
+            std::swap(result.y_[1], result.y_[2]);
+            std::swap(result.z_[1], result.z_[2]);
+         }
+
+         triangles_.push_back(result);
+         statistics_.rasterized_triangles_++;
+      }
+
+      statistics_.transform_time_ += time::now() - start;
+   }
+
+   void occlusion_culler::rasterize(thread_pool &workers) {
+      NEON_PROFILE_SCOPE("occlusion_culler::rasterize");
+
+      const time start = time::now();
+      workers.parallel_for(BAND_COUNT, [this](uint32 index, uint32) {
+         rasterize_band((int32)index);
+      });
+
+      build_hierarchy();
+      statistics_.raster_time_ = time::now() - start;
+   }
+
+   bool occlusion_culler::is_visible(const bounding_sphere &sphere) {
+      statistics_.tested_++;
+
+      // note: screen rectangle and nearest depth of the box around the sphere
+      float min_x = 1.0f, min_y = 1.0f, max_x = -1.0f, max_y = -1.0f, min_z = 1.0f;
+      for (int32 corner = 0; corner < 8; corner++) {
+         const glm::vec3 offset((corner & 1) ? sphere.radius_ : -sphere.radius_,
+                                (corner & 2) ? sphere.radius_ : -sphere.radius_,
+                                (corner & 4) ? sphere.radius_ : -sphere.radius_);
+         const glm::vec4 clip = view_projection_ * glm::vec4(sphere.center_ + offset, 1.0f);
+         if (clip.w <= 0.0f || clip.z < -clip.w) {
+            return true;
+         }
+
+         const float inverse_w = 1.0f / clip.w;
+         min_x = glm::min(min_x, clip.x * inverse_w);
+         max_x = glm::max(max_x, clip.x * inverse_w);
+         min_y = glm::min(min_y, clip.y * inverse_w);
+         max_y = glm::max(max_y, clip.y * inverse_w);
+         min_z = glm::min(min_z, clip.z * inverse_w);
+      }
+
+      // note: whatever is off screen is left to the frustum
+      int32 x0 = glm::max(0, (int32)floorf((min_x * 0.5f + 0.5f) * WIDTH));
+      int32 y0 = glm::max(0, (int32)floorf((min_y * 0.5f + 0.5f) * HEIGHT));
+      int32 x1 = glm::min(WIDTH - 1, (int32)floorf((max_x * 0.5f + 0.5f) * WIDTH));
+      int32 y1 = glm::min(HEIGHT - 1, (int32)floorf((max_y * 0.5f + 0.5f) * HEIGHT));
+      if (x0 > x1 || y0 > y1) {
+         return true;
+      }
+
+      // note: coarsest level where the rectangle still spans no more than 4x4 texels
+      uint32 index = 0;
+      while (index + 1 < (uint32)levels_.size() && ((x1 >> index) - (x0 >> index) >= 4 || (y1 >> index) - (y0 >> index) >= 4)) {
+         index++;
+      }
+
+      const level &entry = levels_[index];
+      const float depth = min_z * 0.5f + 0.5f;
+      for (int32 y = y0 >> index; y <= (y1 >> index); y++) {
+         for (int32 x = x0 >> index; x <= (x1 >> index); x++) {
+            if (depth <= entry.depth_[y * entry.width_ + x]) {
+               return true;
+            }
+         }
+      }
+
+      statistics_.culled_++;
+      return false;
+   }
+
+   void occlusion_culler::rasterize_band(int32 band) {
+      const int32 band_min = band * BAND_HEIGHT;
+      const int32 band_max = band_min + BAND_HEIGHT;
+      float *depth = levels_[0].depth_.data();
+
+      const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+      const __m128 zero = _mm_setzero_ps();
+
+      for (auto &tri : triangles_) {
+         const int32 min_y = glm::max(band_min, (int32)floorf(glm::min(tri.y_[0], glm::min(tri.y_[1], tri.y_[2]))));
+         const int32 max_y = glm::min(band_max, (int32)ceilf(glm::max(tri.y_[0], glm::max(tri.y_[1], tri.y_[2]))));
+         if (min_y >= max_y) {
+            continue;
+         }
+
+         const int32 min_x = glm::max(0, (int32)floorf(glm::min(tri.x_[0], glm::min(tri.x_[1], tri.x_[2])))) & ~3;
+         const int32 max_x = glm::min(WIDTH, (int32)ceilf(glm::max(tri.x_[0], glm::max(tri.x_[1], tri.x_[2]))));
+         if (min_x >= max_x) {
+            continue;
+         }
+
+         // note: edge functions a * x + b * y + c, positive inside
+         float a[3], b[3], c[3];
+         for (int32 edge = 0; edge < 3; edge++) {
+            const int32 next = (edge + 1) % 3;
+            a[edge] = tri.y_[edge] - tri.y_[next];
+            b[edge] = tri.x_[next] - tri.x_[edge];
+            c[edge] = (tri.y_[next] - tri.y_[edge]) * tri.x_[edge] - (tri.x_[next] - tri.x_[edge]) * tri.y_[edge];
+         }
+
+         // note: depth after the perspective divide is linear in screen space
+         const float dx1 = tri.x_[1] - tri.x_[0], dy1 = tri.y_[1] - tri.y_[0], dz1 = tri.z_[1] - tri.z_[0];
+         const float dx2 = tri.x_[2] - tri.x_[0], dy2 = tri.y_[2] - tri.y_[0], dz2 = tri.z_[2] - tri.z_[0];
+         const float area = dx1 * dy2 - dx2 * dy1;
+         const float dzdx = (dz1 * dy2 - dz2 * dy1) / area;
+         const float dzdy = (dz2 * dx1 - dz1 * dx2) / area;
+
+         const __m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]);
+         const __m128 z_step = _mm_set1_ps(dzdx);
+
+         for (int32 y = min_y; y < max_y; y++) {
+            const float py = (float)y + 0.5f;
+            const __m128 row0 = _mm_set1_ps(b[0] * py + c[0]);
+            const __m128 row1 = _mm_set1_ps(b[1] * py + c[1]);
+            const __m128 row2 = _mm_set1_ps(b[2] * py + c[2]);
+            const __m128 row_z = _mm_set1_ps(tri.z_[0] + dzdy * (py - tri.y_[0]) - dzdx * tri.x_[0]);
+
+            float *line = depth + y * WIDTH;
+            for (int32 x = min_x; x < max_x; x += 4) {
+               const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+               const __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+               const __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+               const __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+               const __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+               if (_mm_movemask_ps(inside) == 0) {
+                  continue;
+               }
+
+               const __m128 z = _mm_add_ps(_mm_mul_ps(z_step, px), row_z);
+               const __m128 previous = _mm_loadu_ps(line + x);
+               const __m128 nearest = _mm_min_ps(previous, z);
+               _mm_storeu_ps(line + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+            }
+         }
+      }
+   }
+
+   void occlusion_culler::build_hierarchy() {
+      // note: every texel keeps the farthest depth below it, a sphere in front of it is visible
+      for (size_t index = 1; index < levels_.size(); index++) {
+         const level &source = levels_[index - 1];
+         level &target = levels_[index];
+
+         for (int32 y = 0; y < target.height_; y++) {
+            const int32 y0 = y * 2;
+            const int32 y1 = glm::min(y0 + 1, source.height_ - 1);
+            for (int32 x = 0; x < target.width_; x++) {
+               const int32 x0 = x * 2;
+               const int32 x1 = glm::min(x0 + 1, source.width_ - 1);
+               const float depth = glm::max(glm::max(source.depth_[y0 * source.width_ + x0], source.depth_[y0 * source.width_ + x1]),
+                                            glm::max(source.depth_[y1 * source.width_ + x0], source.depth_[y1 * source.width_ + x1]));
+               target.depth_[y * target.width_ + x] = depth;
+            }
+         }
+      }
+   }
+
+   occlusion_queries::statistics::statistics()
+      : tested_(0)
+      , queries_(0)
+      , results_(0)
+      , skipped_draws_(0)
+      , conditional_draws_(0)
+   {
+   }
+
+   occlusion_queries::occlusion_queries()
+      : frame_(0)
+   {
+   }
+
+   bool occlusion_queries::create(resource_cache &cache, uint32 node_count) {
+      if (is_valid()) {
+         return false;
+      }
+
+      // note: a unit cube, scaled and moved onto the bounding sphere of each node
+      const glm::vec3 corners[8] =
+      {
+         { -1.0f, -1.0f, -1.0f }, {  1.0f, -1.0f, -1.0f }, {  1.0f,  1.0f, -1.0f }, { -1.0f,  1.0f, -1.0f },
+         { -1.0f, -1.0f,  1.0f }, {  1.0f, -1.0f,  1.0f }, {  1.0f,  1.0f,  1.0f }, { -1.0f,  1.0f,  1.0f },
+      };
+      const uint32 faces[36] =
+      {
+         0, 2, 1, 0, 3, 2,
+         4, 5, 6, 4, 6, 7,
+         0, 1, 5, 0, 5, 4,
+         3, 6, 2, 3, 7, 6,
+         0, 4, 7, 0, 7, 3,
+         1, 2, 6, 1, 6, 5,
+      };
+
+      glm::vec3 vertices[36];
+      for (uint32 index = 0; index < 36; index++) {
+         vertices[index] = corners[faces[index]];
+      }
+
+      if (!proxy_buffer_.create(sizeof(vertices), vertices)) {
+         return false;
+      }
+
+      proxy_format_.add_attribute(0, 3, GL_FLOAT, false);
+
+      if (!cache.acquire_program("assets/lit/vertex_shader.shader", "assets/lit/fragment_shader.shader", program_)) {
+         proxy_buffer_.destroy();
+         return false;
+      }
+
+      nodes_.resize(node_count);
+      for (auto &entry : nodes_) {
+         entry = {};
+         entry.last_tested_ = ~0u;
+         entry.visible_ = true;
+         glGenQueries(1, &entry.query_);
+      }
+      issued_.reserve(node_count);
+      frame_ = 0;
+
+      return true;
+   }
+
+   void occlusion_queries::destroy(resource_cache &cache) {
+      if (!is_valid()) {
+         return;
+      }
+
+      for (auto &entry : nodes_) {
+         glDeleteQueries(1, &entry.query_);
+      }
+
+      nodes_.clear();
+      issued_.clear();
+      cache.release(program_);
+      proxy_buffer_.destroy();
+   }
+
+   bool occlusion_queries::is_valid() const {
+      return proxy_buffer_.is_valid();
+   }
+
+   void occlusion_queries::begin_frame() {
+      NEON_PROFILE_SCOPE("occlusion_queries::begin_frame");
+
+      const time start = time::now();
+      frame_++;
+      issued_.clear();
+      statistics_ = statistics();
+
+      for (auto &entry : nodes_) {
+         if (!entry.pending_) {
+            continue;
+         }
+
+         GLuint available = 0;
+         glGetQueryObjectuiv(entry.query_, GL_QUERY_RESULT_AVAILABLE, &available);
+         if (!available) {
+            continue;
+         }
+
+         GLuint samples = 0;
+         glGetQueryObjectuiv(entry.query_, GL_QUERY_RESULT, &samples);
+         entry.visible_ = samples != 0;
+         entry.pending_ = false;
+         statistics_.results_++;
+      }
+
+      statistics_.readback_time_ = time::now() - start;
+   }
+
+   bool occlusion_queries::test(uint32 index, const bounding_sphere &sphere, const glm::vec3 &eye) {
+      node &entry = nodes_[index];
+      const bool coherent = entry.last_tested_ + 1 == frame_;
+      entry.last_tested_ = frame_;
+      entry.issued_ = false;
+      statistics_.tested_++;
+
+      // note: with the eye inside the box the proxy is clipped by the near plane
+      const glm::vec3 distance = glm::abs(eye - sphere.center_);
+      const float extent = sphere.radius_ + 1.0f;
+      if (distance.x < extent && distance.y < extent && distance.z < extent) {
+         entry.visible_ = true;
+         return true;
+      }
+
+      const bool due = !entry.visible_ || !coherent || (frame_ + index) % REQUERY_INTERVAL == 0;
+      if (due && !entry.pending_) {
+         entry.issued_ = true;
+         entry.pending_ = true;
+         entry.proxy_ = glm::scale(glm::translate(glm::mat4(1.0f), sphere.center_), glm::vec3(sphere.radius_));
+         issued_.push_back(index);
+         statistics_.queries_++;
+      }
+
+      const bool draw = entry.visible_ || !coherent;
+      if (!draw) {
+         statistics_.skipped_draws_++;
+      }
+      else if (entry.issued_) {
+         statistics_.conditional_draws_++;
+      }
+
+      return draw;
+   }
+
+   void occlusion_queries::record(command_buffer &commands, const fps_camera &camera) const {
+      if (issued_.empty()) {
+         return;
+      }
+
+      commands.bind_program(program_);
+      commands.set_uniform_mat4("projection", camera.projection_);
+      commands.set_uniform_mat4("view", camera.view_);
+      commands.bind_vertex_buffer(proxy_buffer_);
+      commands.bind_vertex_format(proxy_format_);
+
+      commands.set_capability(GL_DEPTH_TEST, true);
+      commands.set_capability(GL_CULL_FACE, false);
+      commands.set_write_mask(false, false);
+
+      for (auto &index : issued_) {
+         const node &entry = nodes_[index];
+         commands.set_uniform_mat4("world", entry.proxy_);
+         commands.begin_query(GL_ANY_SAMPLES_PASSED, entry.query_);
+         commands.draw_arrays(GL_TRIANGLES, 0, 36);
+         commands.end_query(GL_ANY_SAMPLES_PASSED);
+      }
+
+      commands.set_write_mask(true, true);
+   }
+} // !neon
@@ -1,13 +1,17 @@
 // neon_framebuffer.cc
 
 #include "neon_framebuffer.h"
+#include <cassert>
+#include <cmath>
+#include <cstring>
 
 static const GLenum gl_framebuffer_format_internal[] =
 {
    GL_NONE,
-   GL_RGB,
-   GL_RGBA,
+   GL_RGB8,
+   GL_RGBA8,
    GL_DEPTH24_STENCIL8,
+   GL_RGB10_A2,
 };
 
 static const GLenum gl_framebuffer_format[] =
@@ -16,6 +20,7 @@ static const GLenum gl_framebuffer_format[] =
    GL_RGB,
    GL_RGBA,
    GL_DEPTH_STENCIL,
+   GL_RGBA,
 };
 
 static GLenum gl_framebuffer_type[] =
@@ -24,6 +29,7 @@ static GLenum gl_framebuffer_type[] =
    GL_UNSIGNED_BYTE,
    GL_UNSIGNED_BYTE,
    GL_UNSIGNED_INT_24_8,
+   GL_UNSIGNED_INT_2_10_10_10_REV,
 };
 
 namespace neon {
@@ -34,19 +40,531 @@ namespace neon {
             assert(!"opengl error code!");
          }
       }
+
+      // note: png stores every length and size big endian
+      void append_u32(dynamic_array<uint8> &content, uint32 value) {
+         content.push_back((uint8)(value >> 24));
+         content.push_back((uint8)(value >> 16));
+         content.push_back((uint8)(value >> 8));
+         content.push_back((uint8)(value));
+      }
+
+      struct crc_table {
+         crc_table() {
+            for (uint32 index = 0; index < 256; index++) {
+               uint32 value = index;
+               for (uint32 bit = 0; bit < 8; bit++) {
+                  value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+               }
+               values_[index] = value;
+            }
+         }
+
+         uint32 values_[256];
+      };
+
+      uint32 update_crc(uint32 crc, const uint8 *data, size_t size) {
+         static const crc_table table;
+         for (size_t index = 0; index < size; index++) {
+            crc = table.values_[(crc ^ data[index]) & 0xff] ^ (crc >> 8);
+         }
+
+         return crc;
+      }
+
+      // note: 5552 bytes is the most that can be summed before the sums overflow
+      void update_adler(uint32 &a, uint32 &b, const uint8 *data, size_t size) {
+         while (size > 0) {
+            const size_t count = size < 5552 ? size : 5552;
+            for (size_t index = 0; index < count; index++) {
+               a += data[index];
+               b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+            data += count;
+            size -= count;
+         }
+      }
+
+      // note: bgra as read back to the rgba both file formats want
+      void swizzle_row(const uint8 *source, uint8 *destination, uint32 width) {
+         for (uint32 index = 0; index < width; index++) {
+            destination[0] = source[2];
+            destination[1] = source[1];
+            destination[2] = source[0];
+            destination[3] = source[3];
+            source += 4;
+            destination += 4;
+         }
+      }
+
+      // note: length, type and data of one chunk, the crc covers type and data
+      void append_chunk(dynamic_array<uint8> &content, const char *type, const uint8 *data, uint32 size) {
+         append_u32(content, size);
+         const size_t start = content.size();
+         content.insert(content.end(), type, type + 4);
+         content.insert(content.end(), data, data + size);
+         append_u32(content, update_crc(0xffffffffu, content.data() + start, content.size() - start) ^ 0xffffffffu);
+      }
    } // !anon
 
+   // static
+   uint32 framebuffer_desc::bytes_per_pixel(framebuffer_format format) {
+      switch (format) {
+         case FRAMEBUFFER_FORMAT_RGB8:
+            return 3;
+         case FRAMEBUFFER_FORMAT_RGBA8:
+         case FRAMEBUFFER_FORMAT_D32:
+         case FRAMEBUFFER_FORMAT_RGB10A2:
+            return 4;
+         default:
+            return 0;
+      }
+   }
+
+   framebuffer_desc::framebuffer_desc()
+      : width_(0)
+      , height_(0)
+      , format_count_(0)
+      , formats_{}
+      , depth_format_(FRAMEBUFFER_FORMAT_NONE)
+      , samples_(1)
+   {
+   }
+
+   framebuffer_desc::framebuffer_desc(int32 width, int32 height,
+                                      uint32 format_count,
+                                      const framebuffer_format *formats,
+                                      framebuffer_format depth_format,
+                                      uint32 samples)
+      : width_(width)
+      , height_(height)
+      , format_count_(format_count)
+      , formats_{}
+      , depth_format_(depth_format)
+      , samples_(samples)
+   {
+      assert(format_count <= MAX_FRAMEBUFFER_ATTACHMENTS);
+      for (uint32 index = 0; index < format_count; index++) {
+         formats_[index] = formats[index];
+      }
+   }
+
+   bool framebuffer_desc::operator==(const framebuffer_desc &rhs) const {
+      return width_ == rhs.width_ &&
+         height_ == rhs.height_ &&
+         format_count_ == rhs.format_count_ &&
+         memcmp(formats_, rhs.formats_, sizeof(formats_[0]) * format_count_) == 0 &&
+         depth_format_ == rhs.depth_format_ &&
+         samples_ == rhs.samples_;
+   }
+
+   bool framebuffer_desc::operator!=(const framebuffer_desc &rhs) const {
+      return !(*this == rhs);
+   }
+
+   uint64 framebuffer_desc::byte_size() const {
+      uint64 bytes_per_sample = bytes_per_pixel(depth_format_);
+      for (uint32 index = 0; index < format_count_; index++) {
+         bytes_per_sample += bytes_per_pixel(formats_[index]);
+      }
+
+      return (uint64)width_ * height_ * samples_ * bytes_per_sample;
+   }
+
+   // static
+   bool framebuffer_readback::encode_png(const frame &image, dynamic_array<uint8> &content) {
+      // note: one stored deflate block holds at most this many bytes
+      const uint32 MAX_STORED = 65535;
+      if (image.width_ <= 0 || image.height_ <= 0 || !image.pixels_) {
+         return false;
+      }
+
+      const uint32 row_bytes = (uint32)image.width_ * 4;
+      const uint64 raw_bytes = (uint64)(row_bytes + 1) * image.height_;
+      const uint64 block_count = (raw_bytes + MAX_STORED - 1) / MAX_STORED;
+      const uint64 data_bytes = 2 + block_count * 5 + raw_bytes + 4;
+      if (data_bytes > 0x7fffffffu) {
+         return false;
+      }
+
+      static const uint8 signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+      content.clear();
+      content.reserve(sizeof(signature) + 25 + (size_t)data_bytes + 12 + 12);
+      content.insert(content.end(), signature, signature + sizeof(signature));
+
+      // note: 8 bits per channel, rgba, no interlacing
+      dynamic_array<uint8> header;
+      append_u32(header, (uint32)image.width_);
+      append_u32(header, (uint32)image.height_);
+      header.push_back(8);
+      header.push_back(6);
+      header.push_back(0);
+      header.push_back(0);
+      header.push_back(0);
+      append_chunk(content, "IHDR", header.data(), (uint32)header.size());
+
+      // note: a zlib stream of stored blocks, the rows are flipped and swizzled on
+      //       the way and go out unfiltered. nothing is compressed, the point is to keep up
+      //       with the frame rate, not to save disk space
+      append_u32(content, (uint32)data_bytes);
+      const size_t start = content.size();
+      content.insert(content.end(), { 'I', 'D', 'A', 'T', 0x78, 0x01 });
+
+      uint32 a = 1, b = 0;
+      uint64 remaining = raw_bytes;
+      uint32 block_left = 0;
+      const auto emit = [&](const uint8 *data, uint32 size) {
+         update_adler(a, b, data, size);
+         while (size > 0) {
+            if (block_left == 0) {
+               block_left = remaining < MAX_STORED ? (uint32)remaining : MAX_STORED;
+               content.push_back(remaining <= MAX_STORED ? 1 : 0);
+               content.push_back((uint8)(block_left));
+               content.push_back((uint8)(block_left >> 8));
+               content.push_back((uint8)(~block_left));
+               content.push_back((uint8)(~block_left >> 8));
+            }
+
+            const uint32 count = size < block_left ? size : block_left;
+            content.insert(content.end(), data, data + count);
+            data += count;
+            size -= count;
+            block_left -= count;
+            remaining -= count;
+         }
+      };
+
+      dynamic_array<uint8> row(row_bytes + 1);
+      for (int32 y = image.height_ - 1; y >= 0; y--) {
+         swizzle_row(image.pixels_ + (size_t)y * row_bytes, row.data() + 1, (uint32)image.width_);
+         emit(row.data(), (uint32)row.size());
+      }
+
+      append_u32(content, (b << 16) | a);
+      append_u32(content, update_crc(0xffffffffu, content.data() + start, content.size() - start) ^ 0xffffffffu);
+      append_chunk(content, "IEND", nullptr, 0);
+
+      return true;
+   }
+
+   // static
+   bool framebuffer_readback::write_png(const string &filename, const frame &image) {
+      dynamic_array<uint8> content;
+      if (!encode_png(image, content)) {
+         return false;
+      }
+
+      return file_system::write_file_content(filename, content, true);
+   }
+
+   // static
+   bool framebuffer_readback::write_raw(const string &filename, const frame &image) {
+      // note: tightly packed rgba rows top down, no header
+      if (image.width_ <= 0 || image.height_ <= 0 || !image.pixels_) {
+         return false;
+      }
+
+      const size_t row_bytes = (size_t)image.width_ * 4;
+      dynamic_array<uint8> content(row_bytes * image.height_);
+      for (int32 y = 0; y < image.height_; y++) {
+         swizzle_row(image.pixels_ + (image.height_ - 1 - y) * row_bytes, content.data() + y * row_bytes, (uint32)image.width_);
+      }
+
+      return file_system::write_file_content(filename, content, true);
+   }
+
+   framebuffer_readback::slot::slot()
+      : buffer_(0)
+      , capacity_(0)
+      , fence_(nullptr)
+      , state_(SLOT_STATE_FREE)
+      , frame_{}
+      , issued_(0)
+      , failed_(false)
+   {
+   }
+
+   framebuffer_readback::statistics::statistics()
+      : requested_(0)
+      , mapped_(0)
+      , completed_(0)
+      , dropped_(0)
+      , failed_(0)
+      , read_bytes_(0)
+      , latency_sum_(0)
+      , max_latency_(0)
+   {
+   }
+
+   framebuffer_readback::framebuffer_readback()
+      : sequence_(0)
+      , updates_(0)
+      , running_(false)
+   {
+   }
+
+   bool framebuffer_readback::create(uint32 worker_count) {
+      if (is_valid() || worker_count == 0) {
+         return false;
+      }
+
+      // note: the buffers grow to the framebuffer size on the first read
+      for (auto &entry : slots_) {
+         glGenBuffers(1, &entry.buffer_);
+      }
+
+      if (glGetError() != GL_NO_ERROR) {
+         destroy();
+         return false;
+      }
+
+      running_ = true;
+      for (uint32 index = 0; index < worker_count; index++) {
+         workers_.push_back(std::thread(&framebuffer_readback::work, this));
+      }
+
+      return true;
+   }
+
+   void framebuffer_readback::destroy() {
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         running_ = false;
+         jobs_.clear();
+      }
+
+      wake_.notify_all();
+      for (auto &worker : workers_) {
+         worker.join();
+      }
+      workers_.clear();
+
+      // note: whatever is still mapped was never handed out or is finished
+      for (auto &entry : slots_) {
+         if (entry.state_ == SLOT_STATE_MAPPED || entry.state_ == SLOT_STATE_DONE) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, entry.buffer_);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+         }
+
+         if (entry.fence_) {
+            glDeleteSync(entry.fence_);
+            entry.fence_ = nullptr;
+         }
+
+         if (entry.buffer_) {
+            glDeleteBuffers(1, &entry.buffer_);
+            entry.buffer_ = 0;
+         }
+
+         entry.capacity_ = 0;
+         entry.callback_ = nullptr;
+         entry.state_ = SLOT_STATE_FREE;
+      }
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+   }
+
+   bool framebuffer_readback::is_valid() const {
+      return slots_[0].buffer_ != 0;
+   }
+
+   bool framebuffer_readback::is_idle() const {
+      for (auto &entry : slots_) {
+         if (entry.state_ != SLOT_STATE_FREE) {
+            return false;
+         }
+      }
+
+      return true;
+   }
+
+   bool framebuffer_readback::read(GLuint framebuffer_id, GLenum buffer, int32 width, int32 height, const callback &done) {
+      assert(is_valid());
+      slot *target = nullptr;
+      for (auto &entry : slots_) {
+         if (entry.state_ == SLOT_STATE_FREE) {
+            target = &entry;
+            break;
+         }
+      }
+
+      if (!target) {
+         statistics_.dropped_++;
+         return false;
+      }
+
+      // note: GL_NONE keeps the read buffer as it is, the default framebuffer
+      //       may only have a front or only a back buffer. bgra is what the
+      //       backbuffer usually holds, rgba costs a conversion in the driver
+      const uint32 size = (uint32)width * height * 4;
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, target->buffer_);
+      if (target->capacity_ < size) {
+         glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+         target->capacity_ = size;
+      }
+
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_id);
+      if (buffer != GL_NONE) {
+         glReadBuffer(buffer);
+      }
+      glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, (void *)0);
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+      target->fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      target->frame_.sequence_ = sequence_++;
+      target->frame_.width_ = width;
+      target->frame_.height_ = height;
+      target->frame_.pixels_ = nullptr;
+      target->callback_ = done;
+      target->issued_ = updates_;
+      target->failed_ = false;
+      target->state_ = SLOT_STATE_READING;
+      statistics_.requested_++;
+
+      return true;
+   }
+
+   void framebuffer_readback::update() {
+      const time start = time::now();
+      updates_++;
+
+      for (auto &entry : slots_) {
+         if (entry.state_.load(std::memory_order_acquire) != SLOT_STATE_DONE) {
+            continue;
+         }
+
+         glBindBuffer(GL_PIXEL_PACK_BUFFER, entry.buffer_);
+         glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+         entry.frame_.pixels_ = nullptr;
+         entry.callback_ = nullptr;
+         if (entry.failed_) {
+            statistics_.failed_++;
+         }
+         else {
+            statistics_.completed_++;
+         }
+         entry.state_ = SLOT_STATE_FREE;
+      }
+
+      // note: polled with a zero timeout, once signaled the copy is done and mapping does not wait
+      uint32 handed_out = 0;
+      for (uint32 index = 0; index < RING_SIZE; index++) {
+         slot &entry = slots_[index];
+         if (entry.state_ != SLOT_STATE_READING) {
+            continue;
+         }
+
+         const GLenum result = glClientWaitSync(entry.fence_, 0, 0);
+         if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+            continue;
+         }
+
+         glDeleteSync(entry.fence_);
+         entry.fence_ = nullptr;
+
+         const uint32 size = (uint32)entry.frame_.width_ * entry.frame_.height_ * 4;
+         glBindBuffer(GL_PIXEL_PACK_BUFFER, entry.buffer_);
+         entry.frame_.pixels_ = (const uint8 *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+         if (!entry.frame_.pixels_) {
+            entry.callback_ = nullptr;
+            entry.state_ = SLOT_STATE_FREE;
+            statistics_.failed_++;
+            continue;
+         }
+
+         const uint32 latency = (uint32)(updates_ - entry.issued_);
+         statistics_.mapped_++;
+         statistics_.latency_sum_ += latency;
+         statistics_.max_latency_ = latency > statistics_.max_latency_ ? latency : statistics_.max_latency_;
+         statistics_.read_bytes_ += size;
+         entry.state_ = SLOT_STATE_MAPPED;
+
+         std::lock_guard<std::mutex> lock(mutex_);
+         jobs_.push_back(index);
+         handed_out++;
+      }
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+      if (handed_out > 0) {
+         wake_.notify_all();
+      }
+
+      statistics_.update_time_ = time::now() - start;
+   }
+
+   void framebuffer_readback::finish() {
+      // note: the only place that blocks, meant for shutting down or the end of a capture
+      const GLuint64 TIMEOUT = 1000000000ull;
+      for (auto &entry : slots_) {
+         if (entry.state_ == SLOT_STATE_READING) {
+            glClientWaitSync(entry.fence_, GL_SYNC_FLUSH_COMMANDS_BIT, TIMEOUT);
+         }
+      }
+
+      update();
+      {
+         std::unique_lock<std::mutex> lock(mutex_);
+         done_.wait(lock, [this] {
+            for (auto &entry : slots_) {
+               if (entry.state_ == SLOT_STATE_MAPPED) {
+                  return false;
+               }
+            }
+
+            return true;
+         });
+      }
+      update();
+   }
+
+   void framebuffer_readback::work() {
+      for (;;) {
+         uint32 index = 0;
+         {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return !running_ || !jobs_.empty(); });
+            if (!running_) {
+               return;
+            }
+
+            index = jobs_.front();
+            jobs_.erase(jobs_.begin());
+         }
+
+         // note: the main thread leaves a mapped slot alone until it reads done
+         slot &entry = slots_[index];
+         assert(entry.state_ == SLOT_STATE_MAPPED && entry.frame_.pixels_);
+         entry.failed_ = !entry.callback_(entry.frame_);
+         {
+            std::lock_guard<std::mutex> lock(mutex_);
+            entry.state_.store(SLOT_STATE_DONE, std::memory_order_release);
+         }
+         done_.notify_all();
+      }
+   }
+
    // static 
    void framebuffer::unbind(int32 width, int32 height) {
       glBindFramebuffer(GL_FRAMEBUFFER, 0);
       glViewport(0, 0, width, height);
    }
 
+   // static
+   bool framebuffer::read_backbuffer_async(int32 width, int32 height, framebuffer_readback &readback, const framebuffer_readback::callback &done) {
+      return readback.read(0, GL_NONE, width, height, done);
+   }
+
    framebuffer::framebuffer()
       : width_(0)
       , height_(0)
+      , samples_(1)
+      , texture_type_(GL_TEXTURE_2D)
+      , color_attachment_count_(0)
       , id_(0)
       , depth_attachment_(0)
+      , depth_texture_(0)
       , color_attachments_{}
    {
    }
@@ -60,10 +578,27 @@ namespace neon {
                             const framebuffer_format *color_attachment_formats,
                             framebuffer_format depth_attachment_format)
    {
+      return create(framebuffer_desc(width, height,
+                                     (uint32)color_attachment_format_count,
+                                     color_attachment_formats,
+                                     depth_attachment_format));
+   }
+
+   bool framebuffer::create(const framebuffer_desc &desc) {
       if (is_valid()) {
          return false;
       }
 
+      const int32 width = desc.width_;
+      const int32 height = desc.height_;
+      const int32 color_attachment_format_count = (int32)desc.format_count_;
+      const framebuffer_format *color_attachment_formats = desc.formats_;
+      const framebuffer_format depth_attachment_format = desc.depth_format_;
+
+      // note: multisampled attachments are textures too, so they can be resolved or read with texelFetch
+      const GLsizei samples = desc.samples_ > 1 ? (GLsizei)desc.samples_ : 0;
+      const GLenum texture_type = samples ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+
       GLuint id = 0;
       glGenFramebuffers(1, &id);
       glBindFramebuffer(GL_FRAMEBUFFER, id);
@@ -73,6 +608,7 @@ namespace neon {
 
       int32 color_attachment_count = 0;
       int32 depth_attachment_count = 0;
+      GLuint depth_texture = 0;
 
       for (int32 attachment_index = 0;
            attachment_index < color_attachment_format_count;
@@ -80,16 +616,30 @@ namespace neon {
       {
          const framebuffer_format format = color_attachment_formats[attachment_index];
 
-         glBindTexture(GL_TEXTURE_2D, textures[attachment_index]);
-         glTexImage2D(GL_TEXTURE_2D,
-                      0,
-                      gl_framebuffer_format_internal[format],
-                      width,
-                      height,
-                      0,
-                      gl_framebuffer_format[format],
-                      gl_framebuffer_type[format],
-                      nullptr);
+         glBindTexture(texture_type, textures[attachment_index]);
+         if (samples) {
+            glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE,
+                                    samples,
+                                    gl_framebuffer_format_internal[format],
+                                    width,
+                                    height,
+                                    GL_TRUE);
+         }
+         else {
+            glTexImage2D(GL_TEXTURE_2D,
+                         0,
+                         gl_framebuffer_format_internal[format],
+                         width,
+                         height,
+                         0,
+                         gl_framebuffer_format[format],
+                         gl_framebuffer_type[format],
+                         nullptr);
+
+            // note: without mipmaps the default filter leaves the texture incomplete for sampling
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+         }
 
          opengl_error_check();
 
@@ -98,16 +648,17 @@ namespace neon {
 
             glFramebufferTexture2D(GL_FRAMEBUFFER,
                                    GL_DEPTH_STENCIL_ATTACHMENT,
-                                   GL_TEXTURE_2D,
+                                   texture_type,
                                    textures[attachment_index],
                                    0);
 
+            depth_texture = textures[attachment_index];
             depth_attachment_count++;
          }
          else {
             glFramebufferTexture2D(GL_FRAMEBUFFER,
                                    GL_COLOR_ATTACHMENT0 + color_attachment_count,
-                                   GL_TEXTURE_2D,
+                                   texture_type,
                                    textures[attachment_index],
                                    0);
 
@@ -122,16 +673,31 @@ namespace neon {
          glGenRenderbuffers(1, &rbo);
          glBindRenderbuffer(GL_RENDERBUFFER, rbo);
 
-         glRenderbufferStorage(GL_RENDERBUFFER,
-                               gl_framebuffer_format_internal[depth_attachment_format],
-                               width,
-                               height);
+         if (samples) {
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER,
+                                             samples,
+                                             gl_framebuffer_format_internal[depth_attachment_format],
+                                             width,
+                                             height);
+         }
+         else {
+            glRenderbufferStorage(GL_RENDERBUFFER,
+                                  gl_framebuffer_format_internal[depth_attachment_format],
+                                  width,
+                                  height);
+         }
          glFramebufferRenderbuffer(GL_FRAMEBUFFER,
                                    GL_DEPTH_STENCIL_ATTACHMENT,
                                    GL_RENDERBUFFER,
                                    rbo);
       }
 
+      // note: a depth only framebuffer, there is no color buffer to draw into or read from
+      if (color_attachment_count == 0) {
+         glDrawBuffer(GL_NONE);
+         glReadBuffer(GL_NONE);
+      }
+
       GLenum complete_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
       if (complete_status != GL_FRAMEBUFFER_COMPLETE) {
          assert(false);
@@ -141,8 +707,12 @@ namespace neon {
 
       width_ = width;
       height_ = height;
+      samples_ = desc.samples_ > 1 ? desc.samples_ : 1;
+      texture_type_ = texture_type;
+      color_attachment_count_ = (uint32)color_attachment_count;
       id_ = id;
       depth_attachment_ = rbo;
+      depth_texture_ = depth_texture;
       for (int32 index = 0; index < MAX_FRAMEBUFFER_ATTACHMENTS; index++) {
          color_attachments_[index] = textures[index];
       }
@@ -169,6 +739,8 @@ namespace neon {
 
       width_ = 0;
       height_ = 0;
+      samples_ = 1;
+      color_attachment_count_ = 0;
 
       glDeleteFramebuffers(1, &id_);
       id_ = 0;
@@ -177,6 +749,7 @@ namespace neon {
          glDeleteRenderbuffers(1, &depth_attachment_);
       }
       depth_attachment_ = 0;
+      depth_texture_ = 0;
 
       for (int index = 0; index < MAX_FRAMEBUFFER_ATTACHMENTS; index++) {
          if (color_attachments_[index]) {
@@ -199,13 +772,15 @@ namespace neon {
 
    void framebuffer::bind_as_texture(uint32 index, uint32 slot)
    {
-	   glActiveTexture(GL_TEXTURE_2D + slot);
-	   glBindTexture(GL_TEXTURE_2D, color_attachments_[index]);
+	   glActiveTexture(GL_TEXTURE0 + slot);
+	   glBindTexture(texture_type_, color_attachments_[index]);
    }
 
    void framebuffer::bind_as_depth(uint32 slot) {
-	   glActiveTexture(GL_TEXTURE_2D + slot);
-	   glBindTexture(GL_TEXTURE_2D, depth_attachment_);
+	   // note: only a depth texture can be sampled, the renderbuffer cannot
+	   assert(depth_texture_);
+	   glActiveTexture(GL_TEXTURE0 + slot);
+	   glBindTexture(texture_type_, depth_texture_);
    }
 
    void framebuffer::blit(int32 x, int32 y, int32 width, int32 height) {
@@ -217,4 +792,214 @@ namespace neon {
                         GL_NEAREST);
       glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
    }
+
+   // note: multisampled attachments cannot be read directly, resolve them first
+   bool framebuffer::read_async(uint32 index, framebuffer_readback &readback, const framebuffer_readback::callback &done) {
+      assert(index < color_attachment_count_);
+      if (samples_ > 1) {
+         return false;
+      }
+
+      return readback.read(id_, GL_COLOR_ATTACHMENT0 + index, width_, height_, done);
+   }
+
+   framebuffer_pool::statistics::statistics()
+      : allocations_(0)
+      , reuses_(0)
+      , evictions_(0)
+      , live_count_(0)
+      , in_use_count_(0)
+      , live_bytes_(0)
+   {
+   }
+
+   framebuffer_pool::framebuffer_pool()
+      : frame_(0)
+      , max_age_(60)
+   {
+   }
+
+   void framebuffer_pool::destroy() {
+      for (auto &item : entries_) {
+         assert(!item.in_use_);
+         item.framebuffer_.destroy();
+      }
+
+      entries_.clear();
+      statistics_ = statistics();
+   }
+
+   void framebuffer_pool::set_max_age(uint32 frames) {
+      max_age_ = frames;
+   }
+
+   void framebuffer_pool::begin_frame() {
+      frame_++;
+
+      for (auto &item : entries_) {
+         if (item.in_use_ || !item.framebuffer_.is_valid()) {
+            continue;
+         }
+
+         if (frame_ - item.last_used_ > max_age_) {
+            statistics_.live_bytes_ -= item.desc_.byte_size();
+            statistics_.live_count_--;
+            statistics_.evictions_++;
+
+            // note: the slot stays, handles of other entries must not move
+            item.framebuffer_.destroy();
+            item.desc_ = framebuffer_desc();
+         }
+      }
+   }
+
+   uint32 framebuffer_pool::acquire(const framebuffer_desc &desc) {
+      uint32 found = INVALID_HANDLE;
+      uint32 empty = INVALID_HANDLE;
+
+      // note: prefer the most recently used match, it is likely still resident
+      for (uint32 index = 0; index < (uint32)entries_.size(); index++) {
+         const entry &item = entries_[index];
+         if (!item.framebuffer_.is_valid()) {
+            if (empty == INVALID_HANDLE) {
+               empty = index;
+            }
+
+            continue;
+         }
+
+         if (item.in_use_ || item.desc_ != desc) {
+            continue;
+         }
+
+         if (found == INVALID_HANDLE || entries_[found].last_used_ < item.last_used_) {
+            found = index;
+         }
+      }
+
+      if (found != INVALID_HANDLE) {
+         statistics_.reuses_++;
+      }
+      else {
+         if (empty == INVALID_HANDLE) {
+            entries_.push_back(entry());
+            empty = (uint32)(entries_.size() - 1);
+         }
+
+         entry &item = entries_[empty];
+         item.last_used_ = 0;
+         item.in_use_ = false;
+         if (!item.framebuffer_.create(desc)) {
+            return INVALID_HANDLE;
+         }
+
+         item.desc_ = desc;
+         statistics_.allocations_++;
+         statistics_.live_count_++;
+         statistics_.live_bytes_ += desc.byte_size();
+         found = empty;
+      }
+
+      entry &item = entries_[found];
+      item.in_use_ = true;
+      item.last_used_ = frame_;
+      statistics_.in_use_count_++;
+
+      return found;
+   }
+
+   void framebuffer_pool::release(uint32 handle) {
+      assert(handle < entries_.size() && entries_[handle].in_use_);
+
+      entry &item = entries_[handle];
+      item.in_use_ = false;
+      item.last_used_ = frame_;
+      statistics_.in_use_count_--;
+   }
+
+   framebuffer &framebuffer_pool::get(uint32 handle) {
+      assert(handle < entries_.size() && entries_[handle].in_use_);
+      return entries_[handle].framebuffer_;
+   }
+
+   const framebuffer &framebuffer_pool::get(uint32 handle) const {
+      assert(handle < entries_.size() && entries_[handle].in_use_);
+      return entries_[handle].framebuffer_;
+   }
+
+   dynamic_resolution::dynamic_resolution()
+      : scale_(1.0f)
+      , min_scale_(0.25f)
+      , max_scale_(1.0f)
+      , step_(0.05f)
+      , headroom_(0.85f)
+      , hold_frames_(8)
+      , hold_(0)
+      , changes_(0)
+   {
+   }
+
+   bool dynamic_resolution::is_enabled() const {
+      return target_ > time();
+   }
+
+   void dynamic_resolution::set_target(const time &target) {
+      target_ = target;
+      filtered_ = time();
+      hold_ = 0;
+   }
+
+   void dynamic_resolution::set_limits(float min_scale, float max_scale) {
+      min_scale_ = min_scale;
+      max_scale_ = max_scale;
+      scale_ = glm::clamp(scale_, min_scale_, max_scale_);
+   }
+
+   bool dynamic_resolution::update(const time &gpu_time) {
+      if (!is_enabled()) {
+         return false;
+      }
+
+      // note: exponential moving average, single slow frames should not flip the resolution
+      if (filtered_ == time()) {
+         filtered_ = gpu_time;
+      }
+      else {
+         const int64 filtered = filtered_.as_nanoseconds();
+         filtered_ = time(filtered + (gpu_time.as_nanoseconds() - filtered) / 8);
+      }
+
+      if (hold_ > 0) {
+         hold_--;
+         return false;
+      }
+
+      // note: shrink as soon as we are over budget, only grow back with some headroom left
+      const double measured = filtered_.as_seconds();
+      const double target = target_.as_seconds();
+      if (measured <= 0.0 || (measured <= target && measured >= target * headroom_)) {
+         return false;
+      }
+
+      const float ideal = scale_ * (float)sqrt(target * headroom_ / measured);
+      float scale = glm::clamp(floorf(ideal / step_ + 0.5f) * step_, min_scale_, max_scale_);
+      if (measured > target && scale >= scale_) {
+         scale = glm::max(scale_ - step_, min_scale_);
+      }
+
+      if (fabsf(scale - scale_) < step_ * 0.5f) {
+         return false;
+      }
+
+      scale_ = scale;
+      hold_ = hold_frames_;
+      changes_++;
+
+      return true;
+   }
+
+   void dynamic_resolution::apply(int32 width, int32 height, int32 &scaled_width, int32 &scaled_height) const {
+      scaled_width = glm::max(1, (int32)(width * scale_ + 0.5f));
+      scaled_height = glm::max(1, (int32)(height * scale_ + 0.5f));
+   }
 } // !neon
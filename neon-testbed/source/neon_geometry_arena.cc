@@ -0,0 +1,425 @@
+// neon_geometry_arena.cc
+
+#include "neon_geometry_arena.h"
+#include "neon_command_buffer.h"
+#include <neon_profiler.h>
+#include <algorithm>
+#include <cassert>
+
+namespace neon {
+   namespace {
+      const uint32 UNUSED_POOL = ~0u;
+
+      // note: uploads and copies go through the copy targets so the element array binding
+      //       of whatever vertex array is bound stays untouched
+      GLuint create_buffer(uint32 size) {
+         GLuint id = 0;
+         glGenBuffers(1, &id);
+         glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+         glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+         glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+         return id;
+      }
+
+      void copy_buffer(GLuint source, GLuint destination, uint32 source_offset, uint32 destination_offset, uint32 size) {
+         glBindBuffer(GL_COPY_READ_BUFFER, source);
+         glBindBuffer(GL_COPY_WRITE_BUFFER, destination);
+         glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source_offset, destination_offset, size);
+      }
+   } // !anon
+
+   free_list::free_list()
+      : capacity_(0)
+   {
+   }
+
+   void free_list::reset(uint32 capacity) {
+      capacity_ = capacity;
+      blocks_.clear();
+      if (capacity > 0) {
+         blocks_.push_back({ 0, capacity });
+      }
+   }
+
+   bool free_list::allocate(uint32 count, uint32 &offset) {
+      for (size_t index = 0; index < blocks_.size(); index++) {
+         block &entry = blocks_[index];
+         if (entry.count_ < count) {
+            continue;
+         }
+
+         offset = entry.offset_;
+         entry.offset_ += count;
+         entry.count_ -= count;
+         if (entry.count_ == 0) {
+            blocks_.erase(blocks_.begin() + index);
+         }
+
+         return true;
+      }
+
+      return false;
+   }
+
+   void free_list::release(uint32 offset, uint32 count) {
+      if (count == 0) {
+         return;
+      }
+
+      auto at = std::lower_bound(blocks_.begin(), blocks_.end(), offset, [](const block &entry, uint32 value) {
+         return entry.offset_ < value;
+      });
+      at = blocks_.insert(at, { offset, count });
+
+      // note: merge with the block after first, then the one before
+      auto next = at + 1;
+      if (next != blocks_.end() && at->offset_ + at->count_ == next->offset_) {
+         at->count_ += next->count_;
+         blocks_.erase(next);
+      }
+
+      if (at != blocks_.begin()) {
+         auto previous = at - 1;
+         if (previous->offset_ + previous->count_ == at->offset_) {
+            previous->count_ += at->count_;
+            blocks_.erase(at);
+         }
+      }
+   }
+
+   uint32 free_list::free_count() const {
+      uint32 count = 0;
+      for (auto &entry : blocks_) {
+         count += entry.count_;
+      }
+      return count;
+   }
+
+   uint32 free_list::largest_free() const {
+      uint32 largest = 0;
+      for (auto &entry : blocks_) {
+         largest = entry.count_ > largest ? entry.count_ : largest;
+      }
+      return largest;
+   }
+
+   geometry_arena::arena::arena()
+      : id_(0)
+      , used_(0)
+   {
+   }
+
+   geometry_arena::pool::pool()
+      : target_(GL_ARRAY_BUFFER)
+      , stride_(0)
+   {
+   }
+
+   geometry_arena::allocation::allocation()
+      : pool_(UNUSED_POOL)
+      , arena_(0)
+      , offset_(0)
+      , count_(0)
+   {
+   }
+
+   geometry_arena::statistics::statistics()
+      : arenas_(0)
+      , allocations_(0)
+      , free_blocks_(0)
+      , capacity_bytes_(0)
+      , used_bytes_(0)
+      , largest_free_bytes_(0)
+      , utilization_(0.0f)
+      , fragmentation_(0.0f)
+      , defragment_moves_(0)
+      , defragment_bytes_(0)
+   {
+   }
+
+   geometry_arena::geometry_arena()
+   {
+   }
+
+   void geometry_arena::destroy() {
+      for (auto &target : pools_) {
+         for (auto &entry : target.arenas_) {
+            glDeleteBuffers(1, &entry.id_);
+         }
+      }
+      pools_.clear();
+      allocations_.clear();
+      unused_.clear();
+      statistics_ = statistics();
+   }
+
+   geometry_handle geometry_arena::allocate_vertices(uint32 stride, uint32 count, const void *data) {
+      assert(stride > 0);
+      return allocate(GL_ARRAY_BUFFER, stride, count, data);
+   }
+
+   geometry_handle geometry_arena::allocate_indices(uint32 count, const uint16 *data) {
+      return allocate(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16), count, data);
+   }
+
+   geometry_handle geometry_arena::allocate_indices(uint32 count, const uint32 *data) {
+      return allocate(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32), count, data);
+   }
+
+   geometry_handle geometry_arena::allocate(GLenum target, uint32 stride, uint32 count, const void *data) {
+      uint32 pool_index = 0;
+      while (pool_index < pools_.size() && (pools_[pool_index].target_ != target || pools_[pool_index].stride_ != stride)) {
+         pool_index++;
+      }
+
+      if (pool_index == pools_.size()) {
+         pools_.push_back(pool());
+         pools_.back().target_ = target;
+         pools_.back().stride_ = stride;
+      }
+
+      // note: empty allocations are valid, they take no room but still name an arena to bind
+      pool &owner = pools_[pool_index];
+      uint32 arena_index = 0;
+      uint32 offset = 0;
+      while (arena_index < owner.arenas_.size() && !owner.arenas_[arena_index].free_.allocate(count, offset)) {
+         arena_index++;
+      }
+
+      if (arena_index == owner.arenas_.size()) {
+         if (!add_arena(owner, count)) {
+            return INVALID_HANDLE;
+         }
+
+         const bool allocated = owner.arenas_.back().free_.allocate(count, offset);
+         assert(allocated);
+         (void)allocated;
+      }
+
+      arena &destination = owner.arenas_[arena_index];
+      destination.used_ += count;
+      if (count > 0 && data) {
+         glBindBuffer(GL_COPY_WRITE_BUFFER, destination.id_);
+         glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)offset * stride, (GLsizeiptr)count * stride, data);
+         glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+      }
+
+      geometry_handle handle = (geometry_handle)allocations_.size();
+      if (!unused_.empty()) {
+         handle = unused_.back();
+         unused_.pop_back();
+      }
+      else {
+         allocations_.push_back(allocation());
+      }
+
+      allocation &entry = allocations_[handle];
+      entry.pool_ = pool_index;
+      entry.arena_ = arena_index;
+      entry.offset_ = offset;
+      entry.count_ = count;
+
+      update_statistics();
+
+      return handle;
+   }
+
+   bool geometry_arena::add_arena(pool &target, uint32 count) {
+      // note: meshes larger than an arena get one of their own that fits them exactly
+      uint32 capacity = ARENA_BYTES / target.stride_;
+      capacity = count > capacity ? count : capacity;
+
+      arena entry;
+      entry.id_ = create_buffer(capacity * target.stride_);
+      if (glGetError() != GL_NO_ERROR) {
+         glDeleteBuffers(1, &entry.id_);
+         return false;
+      }
+
+      entry.free_.reset(capacity);
+      target.arenas_.push_back(entry);
+
+      return true;
+   }
+
+   void geometry_arena::release(geometry_handle &handle) {
+      if (handle == INVALID_HANDLE) {
+         return;
+      }
+
+      assert(handle < allocations_.size() && allocations_[handle].pool_ != UNUSED_POOL);
+      allocation &entry = allocations_[handle];
+      arena &owner = pools_[entry.pool_].arenas_[entry.arena_];
+      owner.free_.release(entry.offset_, entry.count_);
+      owner.used_ -= entry.count_;
+
+      entry = allocation();
+      unused_.push_back(handle);
+      handle = INVALID_HANDLE;
+
+      update_statistics();
+   }
+
+   void geometry_arena::defragment() {
+      NEON_PROFILE_SCOPE("geometry_arena::defragment");
+
+      for (uint32 pool_index = 0; pool_index < (uint32)pools_.size(); pool_index++) {
+         pool &target = pools_[pool_index];
+         const uint32 stride = target.stride_;
+
+         // note: live allocations of the pool by arena and offset, the order they are packed in
+         dynamic_array<geometry_handle> live;
+         for (geometry_handle handle = 0; handle < (geometry_handle)allocations_.size(); handle++) {
+            if (allocations_[handle].pool_ == pool_index) {
+               live.push_back(handle);
+            }
+         }
+         std::sort(live.begin(), live.end(), [this](geometry_handle lhs, geometry_handle rhs) {
+            const allocation &left = allocations_[lhs];
+            const allocation &right = allocations_[rhs];
+            return left.arena_ != right.arena_ ? left.arena_ < right.arena_ : left.offset_ < right.offset_;
+         });
+
+         // note: ranges of one buffer may not overlap in a copy, so a fragmented arena is packed
+         //       into a new buffer. one free block at the end means there is nothing to pack
+         size_t first = 0;
+         for (uint32 arena_index = 0; arena_index < (uint32)target.arenas_.size(); arena_index++) {
+            arena &source = target.arenas_[arena_index];
+            size_t last = first;
+            while (last < live.size() && allocations_[live[last]].arena_ == arena_index) {
+               last++;
+            }
+
+            const uint32 capacity = source.free_.capacity_;
+            const bool packed = source.free_.blocks_.empty() ||
+               (source.free_.blocks_.size() == 1 && source.free_.blocks_[0].offset_ + source.free_.blocks_[0].count_ == capacity);
+            if (!packed) {
+               const GLuint id = create_buffer(capacity * stride);
+               uint32 cursor = 0;
+               for (size_t index = first; index < last; index++) {
+                  allocation &entry = allocations_[live[index]];
+                  if (entry.count_ > 0) {
+                     copy_buffer(source.id_, id, entry.offset_ * stride, cursor * stride, entry.count_ * stride);
+                     statistics_.defragment_moves_++;
+                     statistics_.defragment_bytes_ += (uint64)entry.count_ * stride;
+                  }
+                  entry.offset_ = cursor;
+                  cursor += entry.count_;
+               }
+
+               glDeleteBuffers(1, &source.id_);
+               source.id_ = id;
+               source.free_.reset(capacity);
+               uint32 offset = 0;
+               source.free_.allocate(cursor, offset);
+            }
+
+            first = last;
+         }
+
+         // note: the last arena is emptied into the tail of an earlier one when all of it fits there
+         while (target.arenas_.size() > 1) {
+            const uint32 last_index = (uint32)target.arenas_.size() - 1;
+            arena &source = target.arenas_[last_index];
+            uint32 arena_index = 0;
+            while (arena_index < last_index && target.arenas_[arena_index].free_.largest_free() < source.used_) {
+               arena_index++;
+            }
+
+            if (arena_index == last_index) {
+               break;
+            }
+
+            arena &destination = target.arenas_[arena_index];
+            for (auto &handle : live) {
+               allocation &entry = allocations_[handle];
+               if (entry.arena_ != last_index) {
+                  continue;
+               }
+
+               uint32 offset = 0;
+               const bool allocated = destination.free_.allocate(entry.count_, offset);
+               assert(allocated);
+               (void)allocated;
+               if (entry.count_ > 0) {
+                  copy_buffer(source.id_, destination.id_, entry.offset_ * stride, offset * stride, entry.count_ * stride);
+                  statistics_.defragment_moves_++;
+                  statistics_.defragment_bytes_ += (uint64)entry.count_ * stride;
+               }
+               destination.used_ += entry.count_;
+               entry.arena_ = arena_index;
+               entry.offset_ = offset;
+            }
+
+            glDeleteBuffers(1, &source.id_);
+            target.arenas_.pop_back();
+         }
+      }
+
+      glBindBuffer(GL_COPY_READ_BUFFER, 0);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+      update_statistics();
+   }
+
+   void geometry_arena::bind(command_buffer &commands, geometry_handle vertices, geometry_handle indices) const {
+      const allocation &vertex_entry = allocations_[vertices];
+      const allocation &index_entry = allocations_[indices];
+
+      // note: stand-ins that only carry the ids, the arenas own the buffers
+      vertex_buffer vertex_arena;
+      vertex_arena.id_ = pools_[vertex_entry.pool_].arenas_[vertex_entry.arena_].id_;
+      index_buffer index_arena;
+      index_arena.id_ = pools_[index_entry.pool_].arenas_[index_entry.arena_].id_;
+      index_arena.type_ = index_type(indices);
+
+      commands.bind_vertex_buffer(vertex_arena);
+      commands.bind_index_buffer(index_arena);
+   }
+
+   void geometry_arena::draw(command_buffer &commands, GLenum primitive, geometry_handle vertices, geometry_handle indices, int32 start, int32 count, int32 base_vertex) const {
+      const allocation &vertex_entry = allocations_[vertices];
+      const allocation &index_entry = allocations_[indices];
+      assert(start + count <= (int32)index_entry.count_);
+      assert(base_vertex >= 0 && base_vertex <= (int32)vertex_entry.count_);
+
+      index_buffer index_arena;
+      index_arena.type_ = index_type(indices);
+      commands.draw_elements_base_vertex(primitive, index_arena, (int32)index_entry.offset_ + start, count, (int32)vertex_entry.offset_ + base_vertex);
+   }
+
+   GLenum geometry_arena::index_type(geometry_handle indices) const {
+      const pool &owner = pools_[allocations_[indices].pool_];
+      assert(owner.target_ == GL_ELEMENT_ARRAY_BUFFER);
+      return owner.stride_ == sizeof(uint16) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+   }
+
+   void geometry_arena::update_statistics() {
+      statistics_.arenas_ = 0;
+      statistics_.allocations_ = (uint32)(allocations_.size() - unused_.size());
+      statistics_.free_blocks_ = 0;
+      statistics_.capacity_bytes_ = 0;
+      statistics_.used_bytes_ = 0;
+      statistics_.largest_free_bytes_ = 0;
+
+      // note: fragmentation is the share of free memory outside the largest block of its arena,
+      //       0 when every arena has one hole left and 1 when it is all crumbs
+      uint64 free_bytes = 0;
+      uint64 largest_sum = 0;
+      for (auto &target : pools_) {
+         for (auto &entry : target.arenas_) {
+            const uint64 largest = (uint64)entry.free_.largest_free() * target.stride_;
+            statistics_.arenas_++;
+            statistics_.free_blocks_ += (uint32)entry.free_.blocks_.size();
+            statistics_.capacity_bytes_ += (uint64)entry.free_.capacity_ * target.stride_;
+            statistics_.used_bytes_ += (uint64)entry.used_ * target.stride_;
+            statistics_.largest_free_bytes_ = largest > statistics_.largest_free_bytes_ ? largest : statistics_.largest_free_bytes_;
+            free_bytes += (uint64)entry.free_.free_count() * target.stride_;
+            largest_sum += largest;
+         }
+      }
+
+      statistics_.utilization_ = statistics_.capacity_bytes_ > 0 ? (float)((double)statistics_.used_bytes_ / statistics_.capacity_bytes_) : 0.0f;
+      statistics_.fragmentation_ = free_bytes > 0 ? (float)(1.0 - (double)largest_sum / free_bytes) : 0.0f;
+   }
+} // !neon
@@ -1,6 +1,12 @@
 //neon_graphics.cc
 
 #include "neon_graphics.h"
+#include "neon_command_buffer.h"
+#include "neon_lighting.h"
+#include "neon_shadows.h"
+#include "neon_geometry_arena.h"
+#include "neon_resource_cache.h"
+#include <neon_profiler.h>
 #include <cassert>
 
 // #define STB_IMAGE_IMPLEMENTATION
@@ -99,7 +105,8 @@ namespace neon
 
 	void index_buffer::render(GLenum primitive, int start, int count)
 	{
-		glDrawElements(primitive, count, type_, (const void*) nullptr);
+		const uint64 index_size = type_ == GL_UNSIGNED_INT ? 4 : 2;
+		glDrawElements(primitive, count, type_, (const void*)(start * index_size));
 	}
 
 	// Shader program
@@ -178,6 +185,12 @@ namespace neon
 			GLuint id = glCreateProgram();
 			glAttachShader(id, vid);
 			glAttachShader(id, fid);
+
+			// note: some drivers only keep the binary around when asked to before linking
+			if (glProgramParameteri) {
+				glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			}
+
 			glLinkProgram(id);
 
 			GLint status = GL_TRUE;
@@ -206,12 +219,67 @@ namespace neon
 
 	} //anon
 
+	// static
+	string shader_program::inject_features(const char* source, const uint32 features)
+	{
+		static const char* feature_names[SHADER_FEATURE_COUNT] =
+		{
+			"NEON_NORMALS",
+			"NEON_TEXCOORD",
+			"NEON_INSTANCING",
+			"NEON_SKINNING",
+			"NEON_FOG",
+			"NEON_LIGHTS",
+			"NEON_GBUFFER",
+			"NEON_SHADOWS",
+		};
+
+		string result(source);
+		if (features == SHADER_FEATURE_NONE) {
+			return result;
+		}
+
+		// note: #version has to stay the first directive, defines go right after it
+		size_t position = 0;
+		int line = 1;
+		const size_t version = result.find("#version");
+		if (version != string::npos) {
+			position = result.find('\n', version);
+			position = position == string::npos ? result.size() : position + 1;
+			for (size_t index = 0; index < position; index++) {
+				if (result[index] == '\n') {
+					line++;
+				}
+			}
+		}
+
+		string defines;
+		if (position == result.size() && position > 0 && result.back() != '\n') {
+			defines += '\n';
+			line++;
+		}
+
+		for (uint32 index = 0; index < SHADER_FEATURE_COUNT; index++) {
+			if (features & (1u << index)) {
+				defines += "#define ";
+				defines += feature_names[index];
+				defines += " 1\n";
+			}
+		}
+
+		// note: keep compiler error line numbers pointing into the file
+		defines += "#line " + std::to_string(line) + "\n";
+		result.insert(position, defines);
+
+		return result;
+	}
+
 	shader_program::shader_program()
 		:id_(0)
 	{
 	}
 
-	bool shader_program::create(const string& vertex_shader_filename, const string& fragment_shader_filename)
+	bool shader_program::create(const string& vertex_shader_filename, const string& fragment_shader_filename, const uint32 features)
 	{
 		if (is_valid())
 		{
@@ -234,6 +302,18 @@ namespace neon
 		fragment_shader_file_content.push_back(0);
 		const char* fragment_shader_source = (const char*)fragment_shader_file_content.data();
 
+		const string vertex_variant = inject_features(vertex_shader_source, features);
+		const string fragment_variant = inject_features(fragment_shader_source, features);
+
+		return create_from_source(vertex_variant.c_str(), fragment_variant.c_str());
+	}
+
+	bool shader_program::create_from_source(const char* vertex_shader_source, const char* fragment_shader_source)
+	{
+		if (is_valid())
+		{
+			return false;
+		}
 
 		GLuint vid = create_shader(GL_VERTEX_SHADER, vertex_shader_source);
 		GLuint fid = create_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
@@ -325,6 +405,37 @@ namespace neon
 		}
 	}
 
+	namespace
+	{
+		// note: stb's own flip is a global setting, decoding threads would race on it
+		void copy_rows(uint8* destination, const uint8* source, int width, int height, bool flip)
+		{
+			const uint64 pitch = (uint64)width * 4;
+			for (int row = 0; row < height; row++) {
+				const int from = flip ? height - 1 - row : row;
+				memcpy(destination + pitch * row, source + pitch * from, pitch);
+			}
+		}
+	} // !anon
+
+	bool texture::decode(const dynamic_array<uint8>& content, bool flip, uint8* destination, uint32 capacity, int32& width, int32& height)
+	{
+		int components = 0;
+		auto bitmap = stbi_load_from_memory(content.data(), (int)content.size(), &width, &height, &components, STBI_rgb_alpha);
+		if (!bitmap) {
+			return false;
+		}
+
+		const uint64 size = (uint64)width * height * 4;
+		if (size <= capacity) {
+			copy_rows(destination, bitmap, width, height, flip);
+		}
+
+		stbi_image_free(bitmap);
+
+		return size <= capacity;
+	}
+
 	texture::texture() : id_(0), type_(0)
 	{
 	}
@@ -335,9 +446,6 @@ namespace neon
 			return false;
 		}
 
-		// Flip image
-		stbi_set_flip_vertically_on_load(flip);
-
 		// read file
 		dynamic_array<uint8> file_content;
 		if (!file_system::read_file_content(filename, file_content)) {
@@ -347,19 +455,21 @@ namespace neon
 		// save image from memory to bitmap
 		int width = 0, height = 0, components = 0;
 		auto bitmap = stbi_load_from_memory(file_content.data(), (int)file_content.size(), &width, &height, &components, STBI_rgb_alpha);
-
 		if (!bitmap) {
 			return false;
 		}
 
+		// Flip image
+		dynamic_array<uint8> pixels((uint64)width * height * 4);
+		copy_rows(pixels.data(), bitmap, width, height, flip);
+		stbi_image_free(bitmap);
+
 		glGenTextures(1, &id_);
 
 		type_ = GL_TEXTURE_2D;
 		glBindTexture(GL_TEXTURE_2D, id_);
 
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, bitmap);
-
-		stbi_image_free(bitmap);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
 		
 		GLenum error = glGetError();
 		return error == GL_NO_ERROR;
@@ -384,6 +494,22 @@ namespace neon
 		return error == GL_NO_ERROR;
 	}
 
+	bool texture::create_storage(int width, int height, const void* data)
+	{
+		if (is_valid()) {
+			return false;
+		}
+
+		// note: rgba8 pixels, without data the storage is left for glTexSubImage2D to fill
+		type_ = GL_TEXTURE_2D;
+		glGenTextures(1, &id_);
+		glBindTexture(GL_TEXTURE_2D, id_);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+
+		GLenum error = glGetError();
+		return error == GL_NO_ERROR;
+	}
+
 	void texture::destroy()
 	{
 		if (!is_valid()) {
@@ -396,7 +522,7 @@ namespace neon
 
 	bool texture::is_valid() const
 	{
-		return false;
+		return id_ != 0;
 	}
 
 	void texture::bind(uint32 slot)
@@ -435,9 +561,9 @@ namespace neon
 		id_ = 0;
 	}
 
-	bool sampler_state::is_valid()
+	bool sampler_state::is_valid() const
 	{
-		return false;
+		return id_ != 0;
 	}
 
 	void sampler_state::bind(uint32 slot)
@@ -445,13 +571,431 @@ namespace neon
 		glBindSampler(slot, id_);
 	}
 
+	texture_buffer::texture_buffer() : buffer_(0)
+	{
+	}
+
+	bool texture_buffer::create(const GLenum format)
+	{
+		if (is_valid()) {
+			return false;
+		}
+
+		glGenBuffers(1, &buffer_);
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer_);
+		glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+
+		texture_.type_ = GL_TEXTURE_BUFFER;
+		glGenTextures(1, &texture_.id_);
+		glBindTexture(GL_TEXTURE_BUFFER, texture_.id_);
+		glTexBuffer(GL_TEXTURE_BUFFER, format, buffer_);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		GLenum error = glGetError();
+		return error == GL_NO_ERROR;
+	}
+
+	void texture_buffer::destroy()
+	{
+		if (!is_valid()) {
+			return;
+		}
+
+		texture_.destroy();
+		glDeleteBuffers(1, &buffer_);
+		buffer_ = 0;
+	}
+
+	bool texture_buffer::update(int size, const void* data)
+	{
+		if (!is_valid()) {
+			return false;
+		}
+
+		// note: empty buffers keep a few bytes, a texture buffer without storage is incomplete
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer_);
+		glBufferData(GL_TEXTURE_BUFFER, size > 0 ? size : 16, size > 0 ? data : nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		return true;
+	}
+
+	bool texture_buffer::is_valid() const
+	{
+		return buffer_ != 0;
+	}
+
+	gpu_timer::gpu_timer() : queries_{}, write_(0), read_(0), active_(false)
+	{
+	}
+
+	bool gpu_timer::create()
+	{
+		if (is_valid()) {
+			return false;
+		}
+
+		glGenQueries(LATENCY * 2, queries_);
+		write_ = 0;
+		read_ = 0;
+		active_ = false;
+
+		return is_valid();
+	}
+
+	void gpu_timer::destroy()
+	{
+		if (!is_valid()) {
+			return;
+		}
+
+		glDeleteQueries(LATENCY * 2, queries_);
+		for (auto& query : queries_) {
+			query = 0;
+		}
+	}
+
+	bool gpu_timer::is_valid() const
+	{
+		return queries_[0] != 0;
+	}
+
+	void gpu_timer::begin()
+	{
+		assert(!active_);
+		if (!is_valid() || write_ - read_ >= LATENCY) {
+			return;
+		}
+
+		glQueryCounter(queries_[(write_ % LATENCY) * 2 + 0], GL_TIMESTAMP);
+		active_ = true;
+	}
+
+	void gpu_timer::end()
+	{
+		if (!active_) {
+			return;
+		}
+
+		glQueryCounter(queries_[(write_ % LATENCY) * 2 + 1], GL_TIMESTAMP);
+		write_++;
+		active_ = false;
+	}
+
+	bool gpu_timer::read(time& elapsed)
+	{
+		if (read_ == write_) {
+			return false;
+		}
+
+		// note: queries finish in order, once the end stamp is there the begin stamp is too
+		const GLuint* pair = queries_ + (read_ % LATENCY) * 2;
+		GLint available = 0;
+		glGetQueryObjectiv(pair[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			return false;
+		}
+
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(pair[0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(pair[1], GL_QUERY_RESULT, &end);
+
+		elapsed = time((int64)(end - begin));
+		read_++;
+
+		return true;
+	}
+
+	gpu_profiler::gpu_profiler() : frames_{}, write_(0), read_(0), stack_{}, depth_(0), recording_(false), collapsed_(false), serialized_(false)
+	{
+	}
+
+	bool gpu_profiler::create()
+	{
+		if (is_valid()) {
+			return false;
+		}
+
+		for (auto& frame : frames_) {
+			glGenQueries(MAX_SCOPES * 2, frame.queries_);
+			frame.count_ = 0;
+			frame.last_ = 0;
+		}
+		write_ = 0;
+		read_ = 0;
+		depth_ = 0;
+		recording_ = false;
+		results_.reserve(MAX_SCOPES);
+
+		return is_valid();
+	}
+
+	void gpu_profiler::destroy()
+	{
+		if (!is_valid()) {
+			return;
+		}
+
+		for (auto& frame : frames_) {
+			glDeleteQueries(MAX_SCOPES * 2, frame.queries_);
+			for (auto& query : frame.queries_) {
+				query = 0;
+			}
+		}
+		results_.clear();
+	}
+
+	bool gpu_profiler::is_valid() const
+	{
+		return frames_[0].queries_[0] != 0;
+	}
+
+	void gpu_profiler::begin_frame()
+	{
+		assert(depth_ == 0);
+		recording_ = is_valid() && write_ - read_ < LATENCY;
+		if (!recording_) {
+			return;
+		}
+
+		frame& current = frames_[write_ % LATENCY];
+		current.count_ = 0;
+		current.last_ = 0;
+		current.serialized_ = serialized_;
+	}
+
+	void gpu_profiler::end_frame()
+	{
+		assert(depth_ == 0);
+		if (!recording_) {
+			return;
+		}
+
+		write_++;
+		recording_ = false;
+	}
+
+	void gpu_profiler::push(const char* name)
+	{
+		assert(depth_ < MAX_SCOPES);
+		frame& current = frames_[write_ % LATENCY];
+		if (!recording_ || current.count_ == MAX_SCOPES) {
+			stack_[depth_++] = INVALID_SCOPE;
+			return;
+		}
+
+		const uint32 index = current.count_++;
+		current.scopes_[index] = { name, depth_, time() };
+		stack_[depth_++] = index;
+
+		if (current.serialized_) {
+			glFinish();
+			current.starts_[index] = time::now();
+			return;
+		}
+
+		glQueryCounter(current.queries_[index * 2 + 0], GL_TIMESTAMP);
+	}
+
+	void gpu_profiler::pop()
+	{
+		assert(depth_ > 0);
+		const uint32 index = stack_[--depth_];
+		if (index == INVALID_SCOPE) {
+			return;
+		}
+
+		frame& current = frames_[write_ % LATENCY];
+		if (current.serialized_) {
+			glFinish();
+			current.scopes_[index].elapsed_ = time::now() - current.starts_[index];
+			return;
+		}
+
+		current.last_ = current.queries_[index * 2 + 1];
+		glQueryCounter(current.last_, GL_TIMESTAMP);
+	}
+
+	bool gpu_profiler::read()
+	{
+		if (read_ == write_) {
+			return false;
+		}
+
+		// note: queries finish in order, once the last one is there every other one is too
+		frame& oldest = frames_[read_ % LATENCY];
+		if (oldest.last_ != 0) {
+			GLint available = 0;
+			glGetQueryObjectiv(oldest.last_, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				return false;
+			}
+		}
+
+		results_.clear();
+		for (uint32 index = 0; index < oldest.count_; index++) {
+			scope result = oldest.scopes_[index];
+			if (!oldest.serialized_) {
+				GLuint64 begin = 0, end = 0;
+				glGetQueryObjectui64v(oldest.queries_[index * 2 + 0], GL_QUERY_RESULT, &begin);
+				glGetQueryObjectui64v(oldest.queries_[index * 2 + 1], GL_QUERY_RESULT, &end);
+				result.elapsed_ = time((int64)(end - begin));
+			}
+			results_.push_back(result);
+		}
+		read_++;
+
+		// note: less than a percent of a scope that took at least 0.1 ms is not a real split
+		collapsed_ = false;
+		for (uint32 index = 0; index < (uint32)results_.size(); index++) {
+			const scope& parent = results_[index];
+			time nested;
+			bool has_nested = false;
+			for (uint32 child = index + 1; child < (uint32)results_.size() && results_[child].depth_ > parent.depth_; child++) {
+				if (results_[child].depth_ == parent.depth_ + 1) {
+					nested += results_[child].elapsed_;
+					has_nested = true;
+				}
+			}
+
+			if (has_nested && parent.elapsed_.as_milliseconds() >= 0.1 && nested.as_milliseconds() < parent.elapsed_.as_milliseconds() * 0.01) {
+				collapsed_ = true;
+			}
+		}
+
+		// note: frames still in flight keep their queries, the ones after them are serialized
+		if (collapsed_) {
+			serialized_ = true;
+		}
+
+		return true;
+	}
+
+	fragment_counter::fragment_counter() : queries_{}, used_{}, write_(0), read_(0), recording_(false), active_(false)
+	{
+	}
+
+	bool fragment_counter::create()
+	{
+		if (is_valid()) {
+			return false;
+		}
+
+		for (auto& frame : queries_) {
+			glGenQueries(MAX_SLOTS, frame);
+		}
+		write_ = 0;
+		read_ = 0;
+		recording_ = false;
+		active_ = false;
+
+		return is_valid();
+	}
+
+	void fragment_counter::destroy()
+	{
+		if (!is_valid()) {
+			return;
+		}
+
+		for (auto& frame : queries_) {
+			glDeleteQueries(MAX_SLOTS, frame);
+			for (auto& query : frame) {
+				query = 0;
+			}
+		}
+	}
+
+	bool fragment_counter::is_valid() const
+	{
+		return queries_[0][0] != 0;
+	}
+
+	void fragment_counter::begin_frame()
+	{
+		assert(!active_);
+		recording_ = is_valid() && write_ - read_ < LATENCY;
+		if (!recording_) {
+			return;
+		}
+
+		for (auto& used : used_[write_ % LATENCY]) {
+			used = false;
+		}
+	}
+
+	void fragment_counter::end_frame()
+	{
+		assert(!active_);
+		if (!recording_) {
+			return;
+		}
+
+		write_++;
+		recording_ = false;
+	}
+
+	void fragment_counter::begin(uint32 slot)
+	{
+		assert(slot < MAX_SLOTS && !active_);
+		if (!recording_) {
+			return;
+		}
+
+		used_[write_ % LATENCY][slot] = true;
+		glBeginQuery(GL_SAMPLES_PASSED, queries_[write_ % LATENCY][slot]);
+		active_ = true;
+	}
+
+	void fragment_counter::end()
+	{
+		if (!active_) {
+			return;
+		}
+
+		glEndQuery(GL_SAMPLES_PASSED);
+		active_ = false;
+	}
+
+	bool fragment_counter::read(uint64 (&samples)[MAX_SLOTS])
+	{
+		if (read_ == write_) {
+			return false;
+		}
+
+		// note: queries finish in order, the last used slot decides for the whole frame
+		const uint32 frame = read_ % LATENCY;
+		for (uint32 slot = MAX_SLOTS; slot-- > 0;) {
+			if (used_[frame][slot]) {
+				GLint available = 0;
+				glGetQueryObjectiv(queries_[frame][slot], GL_QUERY_RESULT_AVAILABLE, &available);
+				if (!available) {
+					return false;
+				}
+				break;
+			}
+		}
+
+		for (uint32 slot = 0; slot < MAX_SLOTS; slot++) {
+			GLuint64 count = 0;
+			if (used_[frame][slot]) {
+				glGetQueryObjectui64v(queries_[frame][slot], GL_QUERY_RESULT, &count);
+			}
+			samples[slot] = (uint64)count;
+		}
+		read_++;
+
+		return true;
+	}
+
 	bitmap_font::bitmap_font() : projection_(1.0f) {
 
 	}
 
-	bool bitmap_font::create()
+	bool bitmap_font::create(resource_cache& cache)
 	{
-		if (!program_.create("assets/bitmap_font_vertex_shader.shader", "assets/bitmap_font_fragment_shader.shader")) {
+		if (!cache.acquire_program("assets/bitmap_font_vertex_shader.shader", "assets/bitmap_font_fragment_shader.shader", program_)) {
 			return false;
 		}
 
@@ -462,11 +1006,11 @@ namespace neon
 			return false;
 		}
 
-		if (!texture_.create("assets/font_8x8.png", false)) {
+		if (!cache.acquire_texture("assets/font_8x8.png", false, texture_)) {
 			return false;
 		}
 
-		if (!sampler_.create(GL_NEAREST, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)) {
+		if (!cache.acquire_sampler(GL_NEAREST, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, sampler_)) {
 			return false;
 		}
 
@@ -475,8 +1019,12 @@ namespace neon
 		return true;
 	}
 
-	void bitmap_font::destroy()
+	void bitmap_font::destroy(resource_cache& cache)
 	{
+		cache.release(program_);
+		cache.release(texture_);
+		cache.release(sampler_);
+		buffer_.destroy();
 	}
 
 	void bitmap_font::render_text(const float pos_x, const float pos_y, const string& text) {
@@ -515,27 +1063,26 @@ namespace neon
 		}
 	}
 
-	void bitmap_font::flush()
+	void bitmap_font::flush(command_buffer& commands)
 	{
-		// note: submit vertices from CPU to GPU
-		int size = (int)(sizeof(vertex) * vertices_.size());
-		buffer_.update(size , vertices_.data());
+		NEON_PROFILE_SCOPE("bitmap_font::flush");
+
+		// note: vertices are copied into the command buffer, uploaded when it is submitted
+		uint32 size = (uint32)(sizeof(vertex) * vertices_.size());
+		commands.update_vertex_buffer(buffer_, size, vertices_.data());
 
 		// note: render the thing!
-		glDisable(GL_DEPTH_TEST);
-		glDisable(GL_CULL_FACE);
-		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE);
-		glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
+		commands.set_capability(GL_DEPTH_TEST, false);
+		commands.set_capability(GL_CULL_FACE, false);
+		commands.set_blend(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE, GL_FUNC_ADD, GL_FUNC_ADD);
 		
-		program_.bind();
-		program_.set_uniform_mat4("projection", projection_);
-		buffer_.bind();
-		format_.bind();
-		texture_.bind();
-		sampler_.bind();
-		glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices_.size());
-
-		GLenum error = glGetError();
+		commands.bind_program(program_);
+		commands.set_uniform_mat4("projection", projection_);
+		commands.bind_vertex_buffer(buffer_);
+		commands.bind_vertex_format(format_);
+		commands.bind_texture(texture_);
+		commands.bind_sampler(sampler_);
+		commands.draw_arrays(GL_TRIANGLES, 0, (int32)vertices_.size());
 	
 		vertices_.clear();
 	}
@@ -594,6 +1141,24 @@ namespace neon
 		z_axis = z;
 	}
 
+	void fps_camera::interpolate(const fps_camera& from, const fps_camera& to, float alpha)
+	{
+		projection_ = to.projection_;
+		position_ = glm::mix(from.position_, to.position_, alpha);
+		pitch_ = glm::mix(from.pitch_, to.pitch_, alpha);
+		roll_ = glm::mix(from.roll_, to.roll_, alpha);
+
+		// note: a camera path wrapping around would otherwise spin the long way
+		if (fabsf(to.yaw_ - from.yaw_) > glm::pi<float>()) {
+			yaw_ = to.yaw_;
+		}
+		else {
+			yaw_ = glm::mix(from.yaw_, to.yaw_, alpha);
+		}
+
+		update();
+	}
+
 	void fps_camera::set_perspective(float fov, float aspect, float znear, float zfar)
 	{
 		// fov in degrees
@@ -632,23 +1197,24 @@ namespace neon
 	{
 		constexpr float camera_speed = 50.0f;
 		constexpr float camera_turn_speed = 5.0f;
-		const float amount = camera_speed * deltatime.as_seconds();
+		const float seconds = (float)deltatime.as_seconds();
+		const float amount = camera_speed * seconds;
 
 		// Camera Movement
 		if (keyboard_.is_down(KEYCODE_W)) {
-			camera_.forward(-amount * deltatime.as_seconds() * camera_speed);
+			camera_.forward(-amount);
 		}
 
 		if (keyboard_.is_down(KEYCODE_S)) {
-			camera_.forward(amount * deltatime.as_seconds() * camera_speed);
+			camera_.forward(amount);
 		}
 
 		if (keyboard_.is_down(KEYCODE_A)) {
-			camera_.sidestep(-amount * deltatime.as_seconds() * camera_speed);
+			camera_.sidestep(-amount);
 		}
 
 		if (keyboard_.is_down(KEYCODE_D)) {
-			camera_.sidestep(amount * deltatime.as_seconds() * camera_speed);
+			camera_.sidestep(amount);
 		}
 
 		// Look rotation
@@ -661,11 +1227,11 @@ namespace neon
 			mouse_delta = mouse_delta - mouse_position_;
 
 			if (fabsf(mouse_delta.x) > 0.0f) {
-				camera_.rotate_y(glm::radians(mouse_delta.x) * deltatime.as_seconds() * camera_turn_speed);
+				camera_.rotate_y(glm::radians(mouse_delta.x) * seconds * camera_turn_speed);
 			}
 
 			if (fabsf(mouse_delta.y) > 0.0f) {
-				camera_.rotate_x(glm::radians(mouse_delta.y) * deltatime.as_seconds() * camera_turn_speed);
+				camera_.rotate_x(glm::radians(mouse_delta.y) * seconds * camera_turn_speed);
 			}
 		}
 
@@ -674,7 +1240,7 @@ namespace neon
 			float mouse_delta_x = (float)mouse_.x_ - mouse_position_.x;
 
 			if (fabsf(mouse_delta_x) > 0) {
-				camera_.rotate_z(glm::radians(mouse_delta_x) * deltatime.as_seconds() * camera_turn_speed);
+				camera_.rotate_z(glm::radians(mouse_delta_x) * seconds * camera_turn_speed);
 			}
 		}
 
@@ -684,14 +1250,74 @@ namespace neon
 		camera_.update();
 	}
 
+	camera_path::camera_path(fps_camera& camera) : camera_(camera)
+	{
+	}
+
+	void camera_path::add_keyframe(float seconds, const glm::vec3& position, float yaw, float pitch)
+	{
+		assert(keyframes_.empty() || keyframes_.back().time_ < seconds);
+
+		keyframe frame;
+		frame.time_ = seconds;
+		frame.position_ = position;
+		frame.yaw_ = yaw;
+		frame.pitch_ = pitch;
+		keyframes_.push_back(frame);
+	}
+
+	void camera_path::reset()
+	{
+		elapsed_ = time();
+	}
+
+	void camera_path::update(const time& deltatime)
+	{
+		if (keyframes_.empty()) {
+			return;
+		}
+
+		// note: accumulate ticks rather than seconds so the path does not drift between runs
+		elapsed_ += deltatime;
+
+		const int32 last = (int32)keyframes_.size() - 1;
+		const float duration = keyframes_[last].time_;
+		float t = duration > 0.0f ? (float)fmod(elapsed_.as_seconds(), (double)duration) : 0.0f;
+
+		int32 index = 0;
+		while (index < last - 1 && keyframes_[index + 1].time_ <= t) {
+			index++;
+		}
+
+		const keyframe& k0 = keyframes_[index > 0 ? index - 1 : 0];
+		const keyframe& k1 = keyframes_[index];
+		const keyframe& k2 = keyframes_[index < last ? index + 1 : last];
+		const keyframe& k3 = keyframes_[index + 2 <= last ? index + 2 : last];
+
+		const float span = k2.time_ - k1.time_;
+		const float u = span > 0.0f ? glm::clamp((t - k1.time_) / span, 0.0f, 1.0f) : 0.0f;
+		const float u2 = u * u;
+		const float u3 = u2 * u;
+
+		camera_.position_ = 0.5f * ((2.0f * k1.position_) +
+									(-k0.position_ + k2.position_) * u +
+									(2.0f * k0.position_ - 5.0f * k1.position_ + 4.0f * k2.position_ - k3.position_) * u2 +
+									(-k0.position_ + 3.0f * k1.position_ - 3.0f * k2.position_ + k3.position_) * u3);
+		camera_.yaw_ = glm::mix(k1.yaw_, k2.yaw_, u);
+		camera_.pitch_ = glm::mix(k1.pitch_, k2.pitch_, u);
+		camera_.roll_ = 0.0f;
+
+		camera_.update();
+	}
+
 	skybox::skybox()
 	{
 
 	}
 
-	bool skybox::create()
+	bool skybox::create(resource_cache& cache)
 	{
-		const char* names[] = 
+		const string names[] = 
 		{
 			"assets/skybox/xpos.png",
 			"assets/skybox/xneg.png",
@@ -701,31 +1327,7 @@ namespace neon
 			"assets/skybox/zneg.png"
 		};
 
-		image sides[6];
-		for (int index = 0; index < 6; index++) {
-			if (!sides[index].create_from_file(names[index])) {
-				assert(!"Could not load cubemap image!");
-				return false;
-			}
-		}
-
-		const int width = sides[0].width();
-		const int height = sides[0].height();
-
-		for (int index = 1; index < 6; index++) {
-			if (width != sides[index].width() || height != sides[index].height()) {
-				assert(!"cubemap images must be same dimension");
-				return false;
-			}
-		}
-
-		// Populate faces with data of images
-		const void* faces[6];
-		for (int index = 0; index < 6; index++) {
-			faces[index] = sides[index].data();
-		}
-
-		if (!cubemap_.create_cubemap(width, height, faces)) {
+		if (!cache.acquire_cubemap(names, cubemap_)) {
 			assert(!"Could not create cubemap");
 			return false;
 		}
@@ -788,49 +1390,204 @@ namespace neon
 
 		format_.add_attribute(0, 3, GL_FLOAT, false);
 
-		if (!program_.create("assets/skybox/vertex_shader.shader", "assets/skybox/fragment_shader.shader")) {
+		if (!cache.acquire_program("assets/skybox/vertex_shader.shader", "assets/skybox/fragment_shader.shader", program_)) {
 			return false;
 		}
 
-		if (!sampler_.create(GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)) {
+		if (!cache.acquire_sampler(GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, sampler_)) {
 			return false;
 		}
 
 		return true;
 	}
 
-	void skybox::destroy()
+	void skybox::destroy(resource_cache& cache)
 	{
-
+		cache.release(program_);
+		cache.release(cubemap_);
+		cache.release(sampler_);
+		buffer_.destroy();
 	}
-	void skybox::render(const fps_camera& camera)
+	void skybox::render(command_buffer& commands, const fps_camera& camera) const
 	{
+		NEON_PROFILE_SCOPE("skybox::render");
+
 		glm::mat4 fixed_view = camera.view_;
 		// Reset translation to not move skybox
 		fixed_view[3][0] = 0.0f;
 		fixed_view[3][1] = 0.0f;
 		fixed_view[3][2] = 0.0f;
 
-		program_.bind();
-		program_.set_uniform_mat4("projection", camera.projection_);
-		program_.set_uniform_mat4("view", fixed_view); // we only want to see camera rotation, not position
+		commands.bind_program(program_);
+		commands.set_uniform_mat4("projection", camera.projection_);
+		commands.set_uniform_mat4("view", fixed_view); // we only want to see camera rotation, not position
+
+		commands.bind_vertex_buffer(buffer_);
+		commands.bind_vertex_format(format_);
+		commands.bind_texture(cubemap_);
+		commands.bind_sampler(sampler_);
+
+		// note: at far depth with GL_LEQUAL it only shades what nothing else covered,
+		//       drawn first into a cleared depth buffer it simply covers everything
+		commands.set_capability(GL_DEPTH_TEST, true);
+		commands.set_depth_func(GL_LEQUAL);
+		commands.set_write_mask(true, false);
+
+		commands.draw_arrays(GL_TRIANGLES, 0, 36);
+
+		commands.set_write_mask(true, true);
+		commands.set_depth_func(GL_LESS);
+	}
+
+	grid_mesh::grid_mesh()
+		: topology_(GRID_TOPOLOGY_TRIANGLES)
+		, short_indices_(false)
+		, columns_(0)
+		, rows_(0)
+		, index_count_(0)
+	{
+	}
+
+	bool grid_mesh::build(grid_topology topology, bool short_indices, uint32 columns, uint32 rows)
+	{
+		topology_ = topology;
+		short_indices_ = short_indices;
+		columns_ = columns;
+		rows_ = rows;
+		index_count_ = 0;
+		chunks_.clear();
+		short_index_array_.clear();
+		index_array_.clear();
+
+		if (columns < 2 || rows < 2) {
+			return false;
+		}
+
+		// note: rows of quads per chunk, a chunk of short indices keeps every vertex below the restart index
+		uint32 chunk_rows = rows - 1;
+		if (short_indices) {
+			const uint32 vertex_rows = restart_index() / columns;
+			if (vertex_rows < 2) {
+				return false;
+			}
+
+			chunk_rows = glm::min(chunk_rows, vertex_rows - 1);
+		}
+
+		const auto emit = [this](uint32 index) {
+			if (short_indices_) {
+				short_index_array_.push_back((uint16)index);
+			}
+			else {
+				index_array_.push_back(index);
+			}
+			index_count_++;
+		};
+
+		for (uint32 first = 0; first < rows - 1; first += chunk_rows) {
+			const uint32 count = glm::min(chunk_rows, rows - 1 - first);
+
+			chunk entry;
+			entry.start_ = (int32)index_count_;
+			entry.base_vertex_ = (int32)(first * columns);
+
+			for (uint32 y = 0; y < count; y++) {
+				const uint32 top = y * columns;
+				const uint32 bottom = top + columns;
+
+				if (topology == GRID_TOPOLOGY_STRIPS) {
+					if (y > 0) {
+						emit(restart_index());
+					}
+
+					// note: bottom first, the strip then cuts every quad along the same diagonal as the triangles
+					for (uint32 x = 0; x < columns; x++) {
+						emit(bottom + x);
+						emit(top + x);
+					}
+				}
+				else {
+					for (uint32 x = 0; x < columns - 1; x++) {
+						emit(top + x);
+						emit(top + x + 1);
+						emit(bottom + x + 1);
+
+						emit(bottom + x + 1);
+						emit(bottom + x);
+						emit(top + x);
+					}
+				}
+			}
+
+			entry.count_ = (int32)index_count_ - entry.start_;
+			chunks_.push_back(entry);
+		}
+
+		return true;
+	}
+
+	geometry_handle grid_mesh::upload(geometry_arena& arena)
+	{
+		geometry_handle handle = geometry_arena::INVALID_HANDLE;
+		if (short_indices_) {
+			handle = arena.allocate_indices(index_count_, short_index_array_.data());
+		}
+		else {
+			handle = arena.allocate_indices(index_count_, index_array_.data());
+		}
 
-		buffer_.bind();
-		format_.bind();
-		cubemap_.bind();
-		sampler_.bind();
+		dynamic_array<uint16>().swap(short_index_array_);
+		dynamic_array<uint32>().swap(index_array_);
 
-		glDisable(GL_DEPTH_TEST);
+		return handle;
+	}
+
+	void grid_mesh::draw(command_buffer& commands, const geometry_arena& arena, geometry_handle vertices, geometry_handle indices) const
+	{
+		// note: restart stays off outside of the strips, other meshes may use the same index value
+		const bool strips = topology_ == GRID_TOPOLOGY_STRIPS;
+		if (strips) {
+			commands.set_primitive_restart(true, restart_index());
+		}
 
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		for (auto& entry : chunks_) {
+			arena.draw(commands, primitive(), vertices, indices, entry.start_, entry.count_, entry.base_vertex_);
+		}
+
+		if (strips) {
+			commands.set_primitive_restart(false);
+		}
 	}
 
-	terrain::terrain() : index_count_(0)
+	GLenum grid_mesh::primitive() const
 	{
+		return topology_ == GRID_TOPOLOGY_STRIPS ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
 	}
 
-	bool terrain::create(const string& heightmap_filemap, const string& texture_filename)
+	GLuint grid_mesh::restart_index() const
 	{
+		return short_indices_ ? 0xffffu : 0xffffffffu;
+	}
+
+	uint64 grid_mesh::index_bytes() const
+	{
+		return (uint64)index_count_ * (short_indices_ ? sizeof(uint16) : sizeof(uint32));
+	}
+
+	terrain::terrain()
+		: arena_(nullptr)
+		, vertex_range_(geometry_arena::INVALID_HANDLE)
+		, index_range_(geometry_arena::INVALID_HANDLE)
+		, depth_range_(geometry_arena::INVALID_HANDLE)
+		, width_(0)
+		, depth_(0)
+	{
+	}
+
+	bool terrain::create(resource_cache& cache, geometry_arena& arena, const string& heightmap_filemap, const string& texture_filename, grid_topology topology, bool short_indices)
+	{
+		arena_ = &arena;
+
 		image heightmap;
 		if (!heightmap.create_from_file(heightmap_filemap.c_str())) {
 			return false;
@@ -845,6 +1602,12 @@ namespace neon
 		dynamic_array<vertex> vertices;
 		float scale = 0.05f;
 
+		// note: heights stay on the cpu for placing objects and building occluders
+		width_ = width;
+		depth_ = height;
+		heights_.clear();
+		heights_.reserve((size_t)width * height);
+
 		for (int32 h = 0; h < height; h++) {
 			for (int32 w = 0; w < width; w++) {
 				const uint32 offset = w * channels + h * stride;
@@ -852,6 +1615,7 @@ namespace neon
  
 				vertex vertex_ = vertex();
 				vertex_.position_ = { w, rbga[2] * scale, h };
+				heights_.push_back(vertex_.position_.y);
 
 				// calculate uv in range of 0-1
 				float u = (float)w / width;
@@ -865,38 +1629,25 @@ namespace neon
 			}
 		}
 
-		if (!vertex_buffer_.create(sizeof(vertex) * (int)vertices.size(), vertices.data())) {
+		vertex_range_ = arena.allocate_vertices(sizeof(vertex), (uint32)vertices.size(), vertices.data());
+		if (vertex_range_ == geometry_arena::INVALID_HANDLE) {
 			return false;
 		}
-		
-		dynamic_array<uint32> index_array;
-		int x = 0; // pic width
-		int y = 0; // pic height
-		uint32 offset = 1;
-		for (uint32 index = 0; index < (uint32)width * (uint32)height; index ++) {
-
-			if (x >= width-1) {
-				x = 0;
-				y++;
-				continue;
-			}
-
-			x++;
-
-			if (y >= height-1) {
-				break;
-			}
 
-			// First triangle
-	
-			index_array.push_back(index);
-			index_array.push_back(index + offset);
-			index_array.push_back(index + offset + width);
+		// note: position-only stream for the depth prepass, a third of the bandwidth. it shares
+		//       the indices, only the base vertex differs
+		dynamic_array<glm::vec3> positions(vertices.size());
+		for (size_t index = 0; index < vertices.size(); index++) {
+			positions[index] = vertices[index].position_;
+		}
 
-			// Second triangle
-			index_array.push_back(index + offset + width);
-			index_array.push_back(index + width);
-			index_array.push_back(index);
+		depth_range_ = arena.allocate_vertices(sizeof(glm::vec3), (uint32)positions.size(), positions.data());
+		if (depth_range_ == geometry_arena::INVALID_HANDLE) {
+			return false;
+		}
+		
+		if (!grid_.build(topology, short_indices, (uint32)width, (uint32)height)) {
+			return false;
 		}
 
 		/*
@@ -923,66 +1674,199 @@ namespace neon
 		}
 		*/
 
-		if (!index_buffer_.create(sizeof(int) * (int)index_array.size(), GL_UNSIGNED_INT, index_array.data())) {
+		index_range_ = grid_.upload(arena);
+		if (index_range_ == geometry_arena::INVALID_HANDLE) {
 			return false;
 		}
 
-		index_count_ = (int)index_array.size();
 		format_.add_attribute(0, 3, GL_FLOAT, false);
 		format_.add_attribute(1, 2, GL_FLOAT, false);
 		format_.add_attribute(2, 3, GL_FLOAT, false);
+		depth_format_.add_attribute(0, 3, GL_FLOAT, false);
+
+		if (!cache.acquire_program("assets/lit/vertex_shader.shader", "assets/lit/fragment_shader.shader", program_, SHADER_FEATURE_NORMALS | SHADER_FEATURE_TEXCOORD | SHADER_FEATURE_LIGHTS | SHADER_FEATURE_SHADOWS)) {
+			return false;
+		}
 
-		if (!program_.create("assets/heightmap/vertex_shader.shader", "assets/heightmap/fragment_shader.shader")) {
+		if (!cache.acquire_program("assets/lit/vertex_shader.shader", "assets/lit/fragment_shader.shader", depth_program_)) {
 			return false;
 		}
 
-		if (!sampler_.create(GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)) {
+		if (!cache.acquire_program("assets/lit/vertex_shader.shader", "assets/lit/fragment_shader.shader", gbuffer_program_, SHADER_FEATURE_NORMALS | SHADER_FEATURE_TEXCOORD | SHADER_FEATURE_GBUFFER)) {
 			return false;
 		}
 
-		if (!texture_.create(texture_filename, false)) {
+		if (!cache.acquire_sampler(GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, sampler_)) {
+			return false;
+		}
+
+		if (!cache.acquire_texture(texture_filename, false, texture_)) {
 			return false;
 		}
 	
 		return true;
 	}
 
-	void terrain::destroy()
+	void terrain::destroy(resource_cache& cache)
 	{
+		cache.release(program_);
+		cache.release(depth_program_);
+		cache.release(gbuffer_program_);
+		cache.release(texture_);
+		cache.release(sampler_);
+		if (arena_) {
+			arena_->release(vertex_range_);
+			arena_->release(index_range_);
+			arena_->release(depth_range_);
+		}
+		heights_.clear();
+		width_ = 0;
+		depth_ = 0;
 	}
 
-	void terrain::render(const fps_camera& camera)
+	float terrain::height_at(float x, float z) const
 	{
-		program_.bind();
-		program_.set_uniform_mat4("projection", camera.projection_);
-		program_.set_uniform_mat4("view", camera.view_);
-		program_.set_uniform_mat4("world", glm::mat4(1));
-		program_.set_uniform_vec3("light_direction", glm::vec3(0, 1, 0));
+		if (heights_.empty()) {
+			return 0.0f;
+		}
+
+		x = glm::clamp(x, 0.0f, (float)(width_ - 1));
+		z = glm::clamp(z, 0.0f, (float)(depth_ - 1));
+		const int32 x0 = (int32)x, z0 = (int32)z;
+		const int32 x1 = glm::min(x0 + 1, width_ - 1), z1 = glm::min(z0 + 1, depth_ - 1);
+		const float fx = x - x0, fz = z - z0;
+
+		const float top = glm::mix(heights_[z0 * width_ + x0], heights_[z0 * width_ + x1], fx);
+		const float bottom = glm::mix(heights_[z1 * width_ + x0], heights_[z1 * width_ + x1], fx);
+		return glm::mix(top, bottom, fz);
+	}
 
-		vertex_buffer_.bind();
-		index_buffer_.bind();
-		format_.bind();
-		texture_.bind();
-		sampler_.bind();
+	void terrain::build_occluder(int32 step, dynamic_array<glm::vec3>& positions, dynamic_array<uint32>& indices) const
+	{
+		positions.clear();
+		indices.clear();
+		if (heights_.empty() || step < 1) {
+			return;
+		}
+
+		// note: a coarse grid where every vertex takes the lowest height of the cells
+		//       around it, so the occluder always stays below the real surface
+		const int32 columns = (width_ - 2) / step + 2;
+		const int32 rows = (depth_ - 2) / step + 2;
+		for (int32 row = 0; row < rows; row++) {
+			const int32 z = glm::min(row * step, depth_ - 1);
+			for (int32 column = 0; column < columns; column++) {
+				const int32 x = glm::min(column * step, width_ - 1);
+
+				float lowest = heights_[z * width_ + x];
+				for (int32 nz = glm::max(0, z - step); nz <= glm::min(depth_ - 1, z + step); nz++) {
+					for (int32 nx = glm::max(0, x - step); nx <= glm::min(width_ - 1, x + step); nx++) {
+						lowest = glm::min(lowest, heights_[nz * width_ + nx]);
+					}
+				}
+
+				positions.push_back(glm::vec3((float)x, lowest, (float)z));
+			}
+		}
+
+		for (int32 row = 0; row + 1 < rows; row++) {
+			for (int32 column = 0; column + 1 < columns; column++) {
+				const uint32 index = (uint32)(row * columns + column);
+				indices.push_back(index);
+				indices.push_back(index + 1);
+				indices.push_back(index + 1 + columns);
+				indices.push_back(index + 1 + columns);
+				indices.push_back(index + columns);
+				indices.push_back(index);
+			}
+		}
+	}
+
+	void terrain::render(command_buffer& commands, const fps_camera& camera, const light_clusters& lights, const shadow_cascades& shadows) const
+	{
+		NEON_PROFILE_SCOPE("terrain::render");
+
+		commands.bind_program(program_);
+		commands.set_uniform_mat4("projection", camera.projection_);
+		commands.set_uniform_mat4("view", camera.view_);
+		commands.set_uniform_mat4("world", glm::mat4(1));
+		lights.bind(commands);
+		shadows.bind(commands);
+
+		arena_->bind(commands, vertex_range_, index_range_);
+		commands.bind_vertex_format(format_);
+		commands.bind_texture(texture_);
+		commands.bind_sampler(sampler_);
 
 		// Culling
-		glEnable(GL_DEPTH_TEST);
-		glDisable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
-		glFrontFace(GL_CW);
+		commands.set_capability(GL_DEPTH_TEST, true);
+		commands.set_capability(GL_CULL_FACE, false);
+		commands.set_front_face(GL_CW);
 
-		index_buffer_.render(GL_TRIANGLES, 0, index_count_);
+		grid_.draw(commands, *arena_, vertex_range_, index_range_);
 	}
 
+	void terrain::render_gbuffer(command_buffer& commands, const fps_camera& camera) const
+	{
+		NEON_PROFILE_SCOPE("terrain::render_gbuffer");
 
-	sphere::sphere() : radius_(0), stacks_(0), sectors_(0), sectorStep_(0), stackStep_(0), index_count_(0)
+		commands.bind_program(gbuffer_program_);
+		commands.set_uniform_mat4("projection", camera.projection_);
+		commands.set_uniform_mat4("view", camera.view_);
+		commands.set_uniform_mat4("world", glm::mat4(1));
+
+		arena_->bind(commands, vertex_range_, index_range_);
+		commands.bind_vertex_format(format_);
+		commands.bind_texture(texture_);
+		commands.bind_sampler(sampler_);
+
+		commands.set_capability(GL_DEPTH_TEST, true);
+		commands.set_capability(GL_CULL_FACE, false);
+		commands.set_front_face(GL_CW);
+
+		grid_.draw(commands, *arena_, vertex_range_, index_range_);
+	}
+
+	void terrain::render_depth(command_buffer& commands, const fps_camera& camera) const
+	{
+		NEON_PROFILE_SCOPE("terrain::render_depth");
+
+		commands.bind_program(depth_program_);
+		commands.set_uniform_mat4("projection", camera.projection_);
+		commands.set_uniform_mat4("view", camera.view_);
+		commands.set_uniform_mat4("world", glm::mat4(1));
+
+		arena_->bind(commands, depth_range_, index_range_);
+		commands.bind_vertex_format(depth_format_);
+
+		commands.set_capability(GL_DEPTH_TEST, true);
+		commands.set_capability(GL_CULL_FACE, false);
+
+		grid_.draw(commands, *arena_, depth_range_, index_range_);
+	}
+
+
+	sphere::sphere()
+		: radius_(0)
+		, stacks_(0)
+		, sectors_(0)
+		, sectorStep_(0)
+		, stackStep_(0)
+		, arena_(nullptr)
+		, vertex_range_(geometry_arena::INVALID_HANDLE)
+		, index_range_(geometry_arena::INVALID_HANDLE)
 	{
 	}
 
-	bool sphere::create(std::string texture_filename, float radius, int stacks, int sectors) {
+	bool sphere::create(resource_cache& cache, geometry_arena& arena, std::string texture_filename, float radius, int stacks, int sectors, grid_topology topology, bool short_indices) {
 		
+		arena_ = &arena;
 		constexpr float PI = 3.14159265359f;
 
+		// note: the loops below read the members, not the arguments
+		radius_ = radius;
+		stacks_ = stacks;
+		sectors_ = sectors;
 		vertices_.clear();
 
 		sectorStep_ = 2.0f * PI / sectors;
@@ -1025,83 +1909,74 @@ namespace neon
 			}
 		}
 
-		if (!vertex_buffer_.create(sizeof(vertex) * (int)vertices_.size(), vertices_.data())) {
+		vertex_range_ = arena.allocate_vertices(sizeof(vertex), (uint32)vertices_.size(), vertices_.data());
+		if (vertex_range_ == geometry_arena::INVALID_HANDLE) {
 			return false;
 		}
 
-		neon::dynamic_array<int> index_array;
-
-		int v1, v2;
-
-		for (int y = 0; y < sectors_; ++y) {
-
-			v1 = y * (sectors_ + 1); // beginning of the current stack
-			v2 = v1 + sectors_ + 1;  // beginning of next stack
-
-			for (int x = 0; x < sectors_; ++x, ++v1, ++v2) {
-				// 2 triangles per sector excluding first and last stacks
-				// v1 => v2 => v1+1
-
-				if (y != 0) {
-					index_array.push_back(v1);
-					index_array.push_back(v2);
-					index_array.push_back(v1 + 1);
-				}
-
-				// v1+1 => v2 => v2+1
-				if (y != (stacks_ - 1)) {
-					index_array.push_back(v1 + 1);
-					index_array.push_back(v2);
-					index_array.push_back(v2 + 1);
-				}
-			}
+		// note: a grid of stacks by sectors, the quads around the poles come out as one
+		//       triangle each and a degenerate one the rasterizer drops
+		if (!grid_.build(topology, short_indices, (uint32)sectors_ + 1, (uint32)stacks_ + 1)) {
+			return false;
 		}
 
-		if (!index_buffer_.create(sizeof(int) * (int)index_array.size(), GL_UNSIGNED_INT, index_array.data())) {
+		index_range_ = grid_.upload(arena);
+		if (index_range_ == geometry_arena::INVALID_HANDLE) {
 			return false;
 		}
 
-		index_count_ = (int)index_array.size();
 		format_.add_attribute(0, 3, GL_FLOAT, false);
 		format_.add_attribute(1, 2, GL_FLOAT, false);
 		format_.add_attribute(2, 3, GL_FLOAT, false);
 
-		if (!program_.create("assets/sphere/vertex_shader.shader", "assets/sphere/fragment_shader.shader")) {
+		if (!cache.acquire_program("assets/lit/vertex_shader.shader", "assets/lit/fragment_shader.shader", program_, SHADER_FEATURE_NORMALS | SHADER_FEATURE_TEXCOORD | SHADER_FEATURE_LIGHTS | SHADER_FEATURE_SHADOWS)) {
 			return false;
 		}
 
-		if (!sampler_.create(GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)) {
+		if (!cache.acquire_sampler(GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, sampler_)) {
 			return false;
 		}
 
-		if (!texture_.create(texture_filename, false)) {
+		if (!cache.acquire_texture(texture_filename, false, texture_)) {
 			return false;
 		}
 
 		return true;
 	}
 
-	void sphere::render(neon::fps_camera camera)
+	void sphere::destroy(resource_cache& cache)
 	{
-		program_.bind();
-		program_.set_uniform_mat4("projection", camera.projection_);
-		program_.set_uniform_mat4("view", camera.view_);
-		program_.set_uniform_mat4("world", glm::mat4(1));
-		program_.set_uniform_vec3("light_direction", glm::vec3(0, 1, 0));
+		cache.release(program_);
+		cache.release(texture_);
+		cache.release(sampler_);
+		if (arena_) {
+			arena_->release(vertex_range_);
+			arena_->release(index_range_);
+		}
+	}
+
+	void sphere::render(command_buffer& commands, const fps_camera& camera, const light_clusters& lights, const shadow_cascades& shadows) const
+	{
+		NEON_PROFILE_SCOPE("sphere::render");
+
+		commands.bind_program(program_);
+		commands.set_uniform_mat4("projection", camera.projection_);
+		commands.set_uniform_mat4("view", camera.view_);
+		commands.set_uniform_mat4("world", glm::mat4(1));
+		lights.bind(commands);
+		shadows.bind(commands);
 
-		vertex_buffer_.bind();
-		index_buffer_.bind();
-		format_.bind();
-		texture_.bind();
-		sampler_.bind();
+		arena_->bind(commands, vertex_range_, index_range_);
+		commands.bind_vertex_format(format_);
+		commands.bind_texture(texture_);
+		commands.bind_sampler(sampler_);
 
 		// Culling
-		glEnable(GL_DEPTH_TEST);
-		glDisable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
-		glFrontFace(GL_CCW);
+		commands.set_capability(GL_DEPTH_TEST, true);
+		commands.set_capability(GL_CULL_FACE, false);
+		commands.set_front_face(GL_CCW);
 
-		index_buffer_.render(GL_TRIANGLES, 0, index_count_);
+		grid_.draw(commands, *arena_, vertex_range_, index_range_);
 	}
 
 } //!neon
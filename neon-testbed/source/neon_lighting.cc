@@ -0,0 +1,290 @@
+// neon_lighting.cc
+
+#include "neon_lighting.h"
+#include "neon_shadows.h"
+#include "neon_resource_cache.h"
+#include <neon_profiler.h>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+namespace neon {
+   light::light()
+      : position_{}
+      , radius_(1.0f)
+      , color_(1.0f)
+      , direction_(0.0f, -1.0f, 0.0f)
+      , cos_inner_(-1.0f)
+      , cos_outer_(-2.0f)
+   {
+   }
+
+   light_clusters::statistics::statistics()
+      : lights_(0)
+      , visible_(0)
+      , references_(0)
+      , max_per_cluster_(0)
+      , overflow_(0)
+   {
+   }
+
+   light_clusters::light_clusters()
+      : projection_(0.0f)
+      , slice_scale_(0.0f)
+      , slice_bias_(0.0f)
+      , width_(1)
+      , height_(1)
+      , slice_near_{}
+      , slice_far_{}
+      , min_x_(CLUSTER_COUNT)
+      , max_x_(CLUSTER_COUNT)
+      , min_y_(CLUSTER_COUNT)
+      , max_y_(CLUSTER_COUNT)
+      , counts_(CLUSTER_COUNT)
+      , scratch_(CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER)
+      , grid_(CLUSTER_COUNT * 2)
+   {
+   }
+
+   bool light_clusters::create() {
+      if (!light_buffer_.create(GL_RGBA32F)) {
+         return false;
+      }
+
+      if (!grid_buffer_.create(GL_RG32UI)) {
+         return false;
+      }
+
+      if (!index_buffer_.create(GL_R16UI)) {
+         return false;
+      }
+
+      return true;
+   }
+
+   void light_clusters::destroy() {
+      light_buffer_.destroy();
+      grid_buffer_.destroy();
+      index_buffer_.destroy();
+   }
+
+   bool light_clusters::is_valid() const {
+      return light_buffer_.is_valid() && grid_buffer_.is_valid() && index_buffer_.is_valid();
+   }
+
+   void light_clusters::set_viewport(int32 width, int32 height) {
+      width_ = width > 0 ? width : 1;
+      height_ = height > 0 ? height : 1;
+   }
+
+   void light_clusters::assign(const fps_camera &camera, const light *lights, uint32 count, thread_pool &workers) {
+      NEON_PROFILE_SCOPE("light_clusters::assign");
+
+      const time start = time::now();
+      if (camera.projection_ != projection_) {
+         build_grid(camera.projection_);
+      }
+
+      count = count < MAX_LIGHTS ? count : MAX_LIGHTS;
+      statistics_ = statistics();
+      statistics_.lights_ = count;
+
+      // note: positions go to view space with depth along +z for the binning, the
+      //       shader gets world space data, three texels per light
+      view_lights_.resize(count);
+      light_data_.resize(count * 3);
+      for (uint32 index = 0; index < count; index++) {
+         const light &source = lights[index];
+         const glm::vec4 position = camera.view_ * glm::vec4(source.position_, 1.0f);
+         view_lights_[index] = glm::vec4(position.x, position.y, -position.z, source.radius_);
+
+         light_data_[index * 3 + 0] = glm::vec4(source.position_, source.radius_);
+         light_data_[index * 3 + 1] = glm::vec4(source.color_, source.cos_outer_);
+         light_data_[index * 3 + 2] = glm::vec4(source.direction_, source.cos_inner_);
+      }
+
+      workers.parallel_for(GRID_Z, [this](uint32 index, uint32) {
+         assign_slice((int32)index);
+      });
+
+      // note: pack the per cluster lists back to back, offset and count per cluster
+      indices_.clear();
+      for (int32 cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+         const uint32 found = counts_[cluster];
+         const uint32 kept = found < MAX_LIGHTS_PER_CLUSTER ? found : MAX_LIGHTS_PER_CLUSTER;
+         const uint16 *list = scratch_.data() + cluster * MAX_LIGHTS_PER_CLUSTER;
+
+         grid_[cluster * 2 + 0] = (uint32)indices_.size();
+         grid_[cluster * 2 + 1] = kept;
+         indices_.insert(indices_.end(), list, list + kept);
+
+         statistics_.max_per_cluster_ = found > statistics_.max_per_cluster_ ? found : statistics_.max_per_cluster_;
+         statistics_.overflow_ += found - kept;
+      }
+      statistics_.references_ = (uint32)indices_.size();
+
+      // note: a light counts as visible when it landed in at least one cluster
+      dynamic_array<bool> visible(count);
+      for (auto &index : indices_) {
+         visible[index] = true;
+      }
+      for (uint32 index = 0; index < count; index++) {
+         statistics_.visible_ += visible[index] ? 1 : 0;
+      }
+
+      statistics_.assign_time_ = time::now() - start;
+   }
+
+   void light_clusters::upload() {
+      NEON_PROFILE_SCOPE("light_clusters::upload");
+
+      const time start = time::now();
+      light_buffer_.update((int)(sizeof(glm::vec4) * light_data_.size()), light_data_.data());
+      grid_buffer_.update((int)(sizeof(uint32) * grid_.size()), grid_.data());
+      index_buffer_.update((int)(sizeof(uint16) * indices_.size()), indices_.data());
+      statistics_.upload_time_ = time::now() - start;
+   }
+
+   void light_clusters::bind(command_buffer &commands) const {
+      // note: xy turn gl_FragCoord into a tile, zw turn log(view depth) into a slice
+      const glm::vec4 scale((float)GRID_X / width_, (float)GRID_Y / height_, slice_scale_, slice_bias_);
+
+      commands.bind_texture(light_buffer_.texture_, LIGHT_DATA_SLOT);
+      commands.bind_texture(grid_buffer_.texture_, LIGHT_GRID_SLOT);
+      commands.bind_texture(index_buffer_.texture_, LIGHT_INDEX_SLOT);
+      commands.set_uniform_int("light_data", LIGHT_DATA_SLOT);
+      commands.set_uniform_int("light_grid", LIGHT_GRID_SLOT);
+      commands.set_uniform_int("light_indices", LIGHT_INDEX_SLOT);
+      commands.set_uniform_vec4("light_cluster_scale", scale);
+   }
+
+   void light_clusters::build_grid(const glm::mat4 &projection) {
+      projection_ = projection;
+
+      // note: near and far from a gl perspective matrix
+      const float near_plane = projection[3][2] / (projection[2][2] - 1.0f);
+      const float far_plane = projection[3][2] / (projection[2][2] + 1.0f);
+      const float ratio = logf(far_plane / near_plane);
+      slice_scale_ = GRID_Z / ratio;
+      slice_bias_ = -GRID_Z * logf(near_plane) / ratio;
+
+      for (int32 slice = 0; slice < GRID_Z; slice++) {
+         slice_near_[slice] = near_plane * expf(ratio * slice / GRID_Z);
+         slice_far_[slice] = near_plane * expf(ratio * (slice + 1) / GRID_Z);
+      }
+
+      // note: the box of a froxel spans its four corner rays between both slice depths
+      for (int32 slice = 0; slice < GRID_Z; slice++) {
+         const float depths[2] = { slice_near_[slice], slice_far_[slice] };
+         for (int32 y = 0; y < GRID_Y; y++) {
+            for (int32 x = 0; x < GRID_X; x++) {
+               const float ndc_x[2] = { -1.0f + 2.0f * x / GRID_X, -1.0f + 2.0f * (x + 1) / GRID_X };
+               const float ndc_y[2] = { -1.0f + 2.0f * y / GRID_Y, -1.0f + 2.0f * (y + 1) / GRID_Y };
+
+               const int32 cluster = slice * TILE_COUNT + y * GRID_X + x;
+               min_x_[cluster] = min_y_[cluster] = FLT_MAX;
+               max_x_[cluster] = max_y_[cluster] = -FLT_MAX;
+               for (auto &depth : depths) {
+                  for (int32 corner = 0; corner < 2; corner++) {
+                     const float view_x = ndc_x[corner] * depth / projection[0][0];
+                     const float view_y = ndc_y[corner] * depth / projection[1][1];
+                     min_x_[cluster] = view_x < min_x_[cluster] ? view_x : min_x_[cluster];
+                     max_x_[cluster] = view_x > max_x_[cluster] ? view_x : max_x_[cluster];
+                     min_y_[cluster] = view_y < min_y_[cluster] ? view_y : min_y_[cluster];
+                     max_y_[cluster] = view_y > max_y_[cluster] ? view_y : max_y_[cluster];
+                  }
+               }
+            }
+         }
+      }
+   }
+
+   void light_clusters::assign_slice(int32 slice) {
+      static_assert(TILE_COUNT % 4 == 0, "tiles are tested four at a time");
+
+      const float slice_near = slice_near_[slice];
+      const float slice_far = slice_far_[slice];
+      const int32 first = slice * TILE_COUNT;
+      uint32 *counts = counts_.data() + first;
+      uint16 *lists = scratch_.data() + first * MAX_LIGHTS_PER_CLUSTER;
+      memset(counts, 0, sizeof(uint32) * TILE_COUNT);
+
+      const __m128 zero = _mm_setzero_ps();
+      for (uint32 index = 0; index < (uint32)view_lights_.size(); index++) {
+         const glm::vec4 &source = view_lights_[index];
+         if (source.z + source.w < slice_near || source.z - source.w > slice_far) {
+            continue;
+         }
+
+         // note: the depth distance is the same for every froxel in the slice
+         const float dz = source.z < slice_near ? slice_near - source.z : (source.z > slice_far ? source.z - slice_far : 0.0f);
+         const __m128 center_x = _mm_set1_ps(source.x);
+         const __m128 center_y = _mm_set1_ps(source.y);
+         const __m128 limit = _mm_set1_ps(source.w * source.w - dz * dz);
+
+         for (int32 tile = 0; tile < TILE_COUNT; tile += 4) {
+            const __m128 min_x = _mm_loadu_ps(min_x_.data() + first + tile);
+            const __m128 max_x = _mm_loadu_ps(max_x_.data() + first + tile);
+            const __m128 min_y = _mm_loadu_ps(min_y_.data() + first + tile);
+            const __m128 max_y = _mm_loadu_ps(max_y_.data() + first + tile);
+
+            const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min_x, center_x), _mm_sub_ps(center_x, max_x)), zero);
+            const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min_y, center_y), _mm_sub_ps(center_y, max_y)), zero);
+            const __m128 distance = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+            const int32 mask = _mm_movemask_ps(_mm_cmple_ps(distance, limit));
+            if (mask == 0) {
+               continue;
+            }
+
+            for (int32 lane = 0; lane < 4; lane++) {
+               if (mask & (1 << lane)) {
+                  uint32 &count = counts[tile + lane];
+                  if (count < MAX_LIGHTS_PER_CLUSTER) {
+                     lists[(tile + lane) * MAX_LIGHTS_PER_CLUSTER + count] = (uint16)index;
+                  }
+                  count++;
+               }
+            }
+         }
+      }
+   }
+
+   deferred_lighting::deferred_lighting()
+   {
+   }
+
+   bool deferred_lighting::create(resource_cache &cache) {
+      return cache.acquire_program("assets/deferred/vertex_shader.shader", "assets/deferred/fragment_shader.shader", program_);
+   }
+
+   void deferred_lighting::destroy(resource_cache &cache) {
+      cache.release(program_);
+   }
+
+   void deferred_lighting::record(command_buffer &commands, const fps_camera &camera, const light_clusters &lights, const shadow_cascades &shadows, const skybox &sky) const {
+      NEON_PROFILE_SCOPE("deferred_lighting::record");
+
+      commands.set_capability(GL_DEPTH_TEST, false);
+      commands.set_capability(GL_CULL_FACE, false);
+
+      commands.bind_program(program_);
+      commands.set_uniform_mat4("inverse_view_projection", glm::inverse(camera.projection_ * camera.view_));
+      commands.set_uniform_mat4("view", camera.view_);
+      commands.set_uniform_int("gbuffer_albedo", ALBEDO_SLOT);
+      commands.set_uniform_int("gbuffer_normal", NORMAL_SLOT);
+      commands.set_uniform_int("gbuffer_depth", DEPTH_SLOT);
+      commands.set_uniform_int("skybox", SKYBOX_SLOT);
+      lights.bind(commands);
+      shadows.bind(commands);
+
+      commands.bind_texture(sky.cubemap_, SKYBOX_SLOT);
+      commands.bind_sampler(sky.sampler_, SKYBOX_SLOT);
+
+      // note: the triangle is generated from gl_VertexID, whatever vertex format is bound stays unused
+      commands.draw_arrays(GL_TRIANGLES, 0, 3);
+
+      commands.set_capability(GL_DEPTH_TEST, true);
+   }
+} // !neon
@@ -1,16 +1,26 @@
 // neon_model.cc
 
 #include "neon_model.h"
+#include "neon_batching.h"
+#include "neon_command_buffer.h"
+#include "neon_geometry_arena.h"
+#include "neon_lighting.h"
+#include "neon_resource_cache.h"
+#include <neon_profiler.h>
 
 // notes: 
 // - C/C++ > General > Additional Include Directories (add to end): external\assimp\include\;
 // - Linker > General > Additional Library Directories (add to end): external\assimp\lib\;
 // - Linker > Input > Additional Dependencies (add to end): assimp-vc142-mtd.lib
 // - copy external/assimp/assimp-vc142-mtd.dll to neon/build
+// - the headless makefile defines NEON_NO_ASSIMP when assimp is not installed,
+//   models are placeholder boxes then
 
+#if !defined(NEON_NO_ASSIMP)
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#endif
 
 namespace neon {
    model::mesh::mesh()
@@ -25,90 +35,227 @@ namespace neon {
    {
    }
 
-   model::model()
+   model::geometry::geometry()
+      : arena_(nullptr)
+      , vertex_range_(geometry_arena::INVALID_HANDLE)
+      , index_range_(geometry_arena::INVALID_HANDLE)
+      , depth_range_(geometry_arena::INVALID_HANDLE)
+      , bounds_min_(0.0f)
+      , bounds_max_(0.0f)
    {
    }
 
-   bool model::is_valid() const {
-      return !meshes_.empty();
-   }
+   bool model::geometry::create(geometry_arena &arena, const string &filename) {
+      arena_ = &arena;
 
-   bool model::create_from_file(const string &filename, const string &vertex, const string &fragment, const string &diffuse) {
-      if (!program_.create(vertex, fragment)) {
+#if !defined(NEON_NO_ASSIMP)
+      // note: assimp-ery
+      Assimp::Importer importer;
+      const aiScene *scene = importer.ReadFile(filename.c_str(), aiProcess_FlipUVs | aiProcessPreset_TargetRealtime_MaxQuality);
+      if (!scene || !scene->mRootNode || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE)) {
          return false;
       }
 
-      if (!texture_.create(diffuse)) {
+      if (!process_node(scene->mRootNode, scene)) {
          return false;
       }
-
-      if (!sampler_.create(GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)) {
+#else
+      if (!file_system::exists(filename)) {
          return false;
       }
 
-      GLint position_location = program_.get_attrib_location("position");
-      GLint texcoord_location = program_.get_attrib_location("texcoord");
-      vertex_format_.add_attribute(position_location, 3, GL_FLOAT, false);
-      vertex_format_.add_attribute(texcoord_location, 2, GL_FLOAT, false);
+      create_placeholder();
+#endif
 
-      // note: assimp-ery
-      Assimp::Importer importer;
-      const aiScene *scene = importer.ReadFile(filename.c_str(), aiProcess_FlipUVs | aiProcessPreset_TargetRealtime_MaxQuality);
-      if (!scene || !scene->mRootNode || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE)) {
+      vertex_range_ = arena.allocate_vertices(sizeof(vertex), (uint32)vertices_.size(), vertices_.data());
+      if (vertex_range_ == geometry_arena::INVALID_HANDLE) {
          return false;
       }
 
-      if (!process_node(scene->mRootNode, scene)) {
+      // note: bounds and a position-only stream for the depth prepass before the vertices go
+      dynamic_array<glm::vec3> positions(vertices_.size());
+      bounds_min_ = bounds_max_ = vertices_.empty() ? glm::vec3(0.0f) : vertices_[0].position_;
+      for (size_t index = 0; index < vertices_.size(); index++) {
+         positions[index] = vertices_[index].position_;
+         bounds_min_ = glm::min(bounds_min_, positions[index]);
+         bounds_max_ = glm::max(bounds_max_, positions[index]);
+      }
+
+      depth_range_ = arena.allocate_vertices(sizeof(glm::vec3), (uint32)positions.size(), positions.data());
+      if (depth_range_ == geometry_arena::INVALID_HANDLE) {
          return false;
       }
 
-       if (!vertex_buffer_.create((int32)(sizeof(vertex) * vertices_.size()), vertices_.data())) {
+      // note: vertices and indices stay around on the cpu, static batches are built from them
+      index_range_ = arena.allocate_indices((uint32)indices_.size(), indices_.data());
+      if (index_range_ == geometry_arena::INVALID_HANDLE) {
          return false;
       }
+
+      return true;
+   }
+
+   void model::geometry::destroy() {
+      if (arena_) {
+         arena_->release(vertex_range_);
+         arena_->release(index_range_);
+         arena_->release(depth_range_);
+      }
+
+      arena_ = nullptr;
+      vertex_range_ = index_range_ = depth_range_ = geometry_arena::INVALID_HANDLE;
+      meshes_.clear();
       vertices_.clear();
+      indices_.clear();
+   }
+
+   model::model()
+      : geometry_(nullptr)
+      , bounds_min_(0.0f)
+      , bounds_max_(0.0f)
+   {
+   }
+
+   bool model::is_valid() const {
+      return geometry_ && !geometry_->meshes_.empty();
+   }
 
-      if (!index_buffer_.create((int32)(sizeof(uint32) * indices_.size()), GL_UNSIGNED_INT, indices_.data())) {
+   bool model::create_from_file(resource_cache &cache, geometry_arena &arena, const string &filename, const string &vertex, const string &fragment, const string &diffuse, const uint32 features) {
+      if (!cache.acquire_program(vertex, fragment, program_, features)) {
+         return false;
+      }
+
+      if (!cache.acquire_texture(diffuse, true, texture_)) {
          return false;
       }
-      indices_.clear();
+
+      if (!cache.acquire_sampler(GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, sampler_)) {
+         return false;
+      }
+
+      if (!cache.acquire_program(vertex, fragment, depth_program_)) {
+         return false;
+      }
+
+      // note: same inputs as the forward program, the g-buffer variant leaves the lights to the lighting pass
+      if (!cache.acquire_program(vertex, fragment, gbuffer_program_, (features & ~SHADER_FEATURE_LIGHTS) | SHADER_FEATURE_GBUFFER)) {
+         return false;
+      }
+
+      GLint position_location = program_.get_attrib_location("position");
+      GLint texcoord_location = program_.get_attrib_location("texcoord");
+      vertex_format_.add_attribute(position_location, 3, GL_FLOAT, false);
+      vertex_format_.add_attribute(texcoord_location, 2, GL_FLOAT, false);
+      depth_format_.add_attribute(depth_program_.get_attrib_location("position"), 3, GL_FLOAT, false);
+
+      // note: models loaded from the same file share one copy of the geometry
+      if (!cache.acquire_geometry(filename, arena, geometry_)) {
+         return false;
+      }
+
+      bounds_min_ = geometry_->bounds_min_;
+      bounds_max_ = geometry_->bounds_max_;
 
       return true;
    }
 
-   void model::destroy() {
-      program_.destroy();
-      texture_.destroy();
-      sampler_.destroy();
-      vertex_buffer_.destroy();
-      index_buffer_.destroy();
+   void model::destroy(resource_cache &cache) {
+      cache.release(program_);
+      cache.release(depth_program_);
+      cache.release(gbuffer_program_);
+      cache.release(texture_);
+      cache.release(sampler_);
+      cache.release(geometry_);
+   }
+
+   batch_source model::as_batch_source() const {
+      batch_source source;
+      source.program_ = &program_;
+      source.gbuffer_program_ = &gbuffer_program_;
+      source.depth_program_ = &depth_program_;
+      source.texture_ = &texture_;
+      source.sampler_ = &sampler_;
+      source.format_ = &vertex_format_;
+      source.vertices_ = geometry_->vertices_.data();
+      source.vertex_count_ = (uint32)geometry_->vertices_.size();
+      source.stride_ = sizeof(vertex);
+      source.indices_ = geometry_->indices_.data();
+      source.index_count_ = (uint32)geometry_->indices_.size();
+      return source;
    }
 
-   void model::render(const fps_camera &camera, const glm::mat4 &world) {
-      GLenum err = GL_NO_ERROR;
+   void model::render(command_buffer &commands, const fps_camera &camera, const light_clusters &lights, const glm::mat4 &world) const {
+      NEON_PROFILE_SCOPE("model::render");
 
-      glEnable(GL_DEPTH_TEST);
-      glDisable(GL_CULL_FACE);
-      glFrontFace(GL_CW);
+      commands.set_capability(GL_DEPTH_TEST, true);
+      commands.set_capability(GL_CULL_FACE, false);
+      commands.set_front_face(GL_CW);
 
-      program_.bind();
-      program_.set_uniform_mat4("projection", camera.projection_);
-      program_.set_uniform_mat4("view", camera.view_);
-      program_.set_uniform_mat4("world", world);
+      commands.bind_program(program_);
+      commands.set_uniform_mat4("projection", camera.projection_);
+      commands.set_uniform_mat4("view", camera.view_);
+      commands.set_uniform_mat4("world", world);
+      lights.bind(commands);
 
-      texture_.bind();
-      sampler_.bind();
+      commands.bind_texture(texture_);
+      commands.bind_sampler(sampler_);
 
-      vertex_buffer_.bind();
-      vertex_format_.bind();
-      index_buffer_.bind();
+      const geometry &shared = *geometry_;
+      shared.arena_->bind(commands, shared.vertex_range_, shared.index_range_);
+      commands.bind_vertex_format(vertex_format_);
 
-      for (auto &mesh : meshes_) {
-         index_buffer_.render(GL_TRIANGLES, mesh.start_, mesh.count_);
+      for (auto &mesh : shared.meshes_) {
+         shared.arena_->draw(commands, GL_TRIANGLES, shared.vertex_range_, shared.index_range_, mesh.start_, mesh.count_);
       }
    }
 
+   void model::render_gbuffer(command_buffer &commands, const fps_camera &camera, const glm::mat4 &world) const {
+      NEON_PROFILE_SCOPE("model::render_gbuffer");
+
+      commands.set_capability(GL_DEPTH_TEST, true);
+      commands.set_capability(GL_CULL_FACE, false);
+      commands.set_front_face(GL_CW);
+
+      commands.bind_program(gbuffer_program_);
+      commands.set_uniform_mat4("projection", camera.projection_);
+      commands.set_uniform_mat4("view", camera.view_);
+      commands.set_uniform_mat4("world", world);
+
+      commands.bind_texture(texture_);
+      commands.bind_sampler(sampler_);
+
+      const geometry &shared = *geometry_;
+      shared.arena_->bind(commands, shared.vertex_range_, shared.index_range_);
+      commands.bind_vertex_format(vertex_format_);
+
+      for (auto &mesh : shared.meshes_) {
+         shared.arena_->draw(commands, GL_TRIANGLES, shared.vertex_range_, shared.index_range_, mesh.start_, mesh.count_);
+      }
+   }
+
+   void model::render_depth(command_buffer &commands, const fps_camera &camera, const glm::mat4 &world) const {
+      NEON_PROFILE_SCOPE("model::render_depth");
+
+      commands.set_capability(GL_DEPTH_TEST, true);
+      commands.set_capability(GL_CULL_FACE, false);
+
+      commands.bind_program(depth_program_);
+      commands.set_uniform_mat4("projection", camera.projection_);
+      commands.set_uniform_mat4("view", camera.view_);
+      commands.set_uniform_mat4("world", world);
+
+      const geometry &shared = *geometry_;
+      shared.arena_->bind(commands, shared.depth_range_, shared.index_range_);
+      commands.bind_vertex_format(depth_format_);
+
+      for (auto &mesh : shared.meshes_) {
+         shared.arena_->draw(commands, GL_TRIANGLES, shared.depth_range_, shared.index_range_, mesh.start_, mesh.count_);
+      }
+   }
+
+#if !defined(NEON_NO_ASSIMP)
    // note: assimp-ery processing
-   bool model::process_node(const aiNode *ai_node, const aiScene *ai_scene) {
+   bool model::geometry::process_node(const aiNode *ai_node, const aiScene *ai_scene) {
       for (uint32 index = 0; index < ai_node->mNumMeshes; index++) {
          if (!process_mesh(ai_scene->mMeshes[ai_node->mMeshes[index]], ai_scene)) {
             return false;
@@ -124,7 +271,7 @@ namespace neon {
       return true;
    }
 
-   bool model::process_mesh(const aiMesh *ai_mesh, const aiScene *ai_scene) {
+   bool model::geometry::process_mesh(const aiMesh *ai_mesh, const aiScene *ai_scene) {
       for (uint32 index = 0; index < ai_mesh->mNumVertices; index++) {
          aiVector3D position = ai_mesh->mVertices[index];
          aiVector3D texcoord;
@@ -157,4 +304,59 @@ namespace neon {
 
       return true;
    }
+#else
+   bool model::geometry::process_node(const aiNode *, const aiScene *) {
+      return false;
+   }
+
+   bool model::geometry::process_mesh(const aiMesh *, const aiScene *) {
+      return false;
+   }
+#endif
+
+   void model::geometry::create_placeholder() {
+      // note: a box standing on the ground, each side tessellated into SEGMENTS
+      //       by SEGMENTS quads so it costs about as much as a small model
+      const int32 SEGMENTS = 8;
+      const float size[3] = { 20.0f, 14.0f, 12.0f };
+
+      const int32 start = (int32)indices_.size();
+      for (int32 side = 0; side < 6; side++) {
+         const int32 axis = side / 2;
+         const int32 u_axis = (axis + 1) % 3;
+         const int32 v_axis = (axis + 2) % 3;
+         const float sign = (side & 1) ? 1.0f : -1.0f;
+         const uint32 base = (uint32)vertices_.size();
+         for (int32 y = 0; y <= SEGMENTS; y++) {
+            for (int32 x = 0; x <= SEGMENTS; x++) {
+               float position[3] = {};
+               position[axis] = sign * size[axis] * 0.5f;
+               position[u_axis] = (x / (float)SEGMENTS - 0.5f) * size[u_axis];
+               position[v_axis] = (y / (float)SEGMENTS - 0.5f) * size[v_axis];
+               position[1] += size[1] * 0.5f;
+
+               vertex vert = {};
+               vert.position_ = { position[0], position[1], position[2] };
+               vert.texcoord_ = { x / (float)SEGMENTS, y / (float)SEGMENTS };
+               vertices_.push_back(vert);
+            }
+         }
+
+         // note: the winding flips with the side so every face points outwards
+         for (int32 y = 0; y < SEGMENTS; y++) {
+            for (int32 x = 0; x < SEGMENTS; x++) {
+               const uint32 a = base + y * (SEGMENTS + 1) + x;
+               const uint32 b = a + 1;
+               const uint32 c = a + SEGMENTS + 1;
+               const uint32 d = c + 1;
+               const uint32 quad[6] = { a, b, d, a, d, c };
+               const uint32 flipped[6] = { a, d, b, a, c, d };
+               const uint32 *triangles = (side & 1) ? quad : flipped;
+               indices_.insert(indices_.end(), triangles, triangles + 6);
+            }
+         }
+      }
+
+      meshes_.push_back(mesh(start, (int32)indices_.size() - start));
+   }
 } // !neon
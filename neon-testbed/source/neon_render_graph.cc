@@ -0,0 +1,557 @@
+// neon_render_graph.cc
+
+#include "neon_render_graph.h"
+#include "neon_graphics.h"
+#include <neon_profiler.h>
+#include <cassert>
+
+namespace neon {
+   namespace {
+      constexpr render_resource BACKBUFFER = 0;
+
+      bool writes_resource(const render_graph::pass &pass, render_resource resource) {
+         for (auto &write : pass.writes_) {
+            if (write == resource) {
+               return true;
+            }
+         }
+
+         return false;
+      }
+
+      bool is_root(const render_graph::pass &pass) {
+         return pass.side_effect_ || writes_resource(pass, BACKBUFFER);
+      }
+   } // !anon
+
+   render_graph::statistics::statistics()
+      : pass_count_(0)
+      , culled_pass_count_(0)
+      , target_count_(0)
+      , requested_bytes_(0)
+      , transient_bytes_(0)
+   {
+   }
+
+   render_graph::render_graph(framebuffer_pool &pool)
+      : pool_(pool)
+      , gpu_profiler_(nullptr)
+      , backbuffer_width_(0)
+      , backbuffer_height_(0)
+      , compiled_(false)
+   {
+      reset();
+   }
+
+   void render_graph::reset() {
+      resources_.clear();
+      passes_.clear();
+      order_.clear();
+      compiled_ = false;
+
+      resource backbuffer = {};
+      backbuffer.name_ = "backbuffer";
+      backbuffer.format_ = FRAMEBUFFER_FORMAT_RGBA8;
+      backbuffer.samples_ = 1;
+      backbuffer.writer_ = INVALID_INDEX;
+      backbuffer.target_ = INVALID_INDEX;
+      resources_.push_back(backbuffer);
+   }
+
+   void render_graph::destroy() {
+      for (auto &target : targets_) {
+         if (target.handle_ != framebuffer_pool::INVALID_HANDLE) {
+            pool_.release(target.handle_);
+         }
+      }
+
+      targets_.clear();
+      statistics_ = statistics();
+      reset();
+   }
+
+   void render_graph::set_gpu_profiler(gpu_profiler *profiler) {
+      gpu_profiler_ = profiler;
+   }
+
+   render_resource render_graph::backbuffer() const {
+      return BACKBUFFER;
+   }
+
+   void render_graph::set_backbuffer_size(int32 width, int32 height) {
+      backbuffer_width_ = width;
+      backbuffer_height_ = height;
+      resources_[BACKBUFFER].width_ = width;
+      resources_[BACKBUFFER].height_ = height;
+   }
+
+   render_resource render_graph::create_attachment(const char *name, int32 width, int32 height, framebuffer_format format, uint32 samples) {
+      assert(format != FRAMEBUFFER_FORMAT_NONE && format < FRAMEBUFFER_FORMAT_COUNT);
+
+      resource attachment = {};
+      attachment.name_ = name;
+      attachment.width_ = width;
+      attachment.height_ = height;
+      attachment.format_ = format;
+      attachment.samples_ = samples > 1 ? samples : 1;
+      attachment.writer_ = INVALID_INDEX;
+      attachment.target_ = INVALID_INDEX;
+      resources_.push_back(attachment);
+
+      compiled_ = false;
+      return (render_resource)(resources_.size() - 1);
+   }
+
+   void render_graph::set_attachment_size(render_resource resource, int32 width, int32 height) {
+      assert(resource != BACKBUFFER && resource < resources_.size());
+
+      resources_[resource].width_ = width;
+      resources_[resource].height_ = height;
+      compiled_ = false;
+   }
+
+   uint32 render_graph::add_pass(const char *name, const execute_function &execute) {
+      pass entry;
+      entry.name_ = name;
+      entry.execute_ = execute;
+      entry.side_effect_ = false;
+      entry.overwrites_ = false;
+      entry.culled_ = false;
+      entry.target_ = INVALID_INDEX;
+      entry.executions_ = 0;
+      passes_.push_back(entry);
+
+      compiled_ = false;
+      return (uint32)(passes_.size() - 1);
+   }
+
+   void render_graph::read(uint32 pass_index, render_resource resource) {
+      assert(pass_index < passes_.size() && resource < resources_.size());
+      passes_[pass_index].reads_.push_back(resource);
+      compiled_ = false;
+   }
+
+   void render_graph::write(uint32 pass_index, render_resource resource) {
+      assert(pass_index < passes_.size() && resource < resources_.size());
+      passes_[pass_index].writes_.push_back(resource);
+      compiled_ = false;
+   }
+
+   void render_graph::set_side_effect(uint32 pass_index) {
+      assert(pass_index < passes_.size());
+      passes_[pass_index].side_effect_ = true;
+   }
+
+   render_resource render_graph::resolve(const char *name, render_resource resource) {
+      assert(resource != BACKBUFFER && resources_[resource].samples_ > 1);
+
+      const render_resource resolved = create_attachment(name,
+                                                         resources_[resource].width_,
+                                                         resources_[resource].height_,
+                                                         resources_[resource].format_);
+
+      // note: the resolve target is bound for drawing when this runs, only the read side is set up here
+      const uint32 index = add_pass("resolve", [resource](const render_graph &graph) {
+         const render_graph::resource &source = graph.resources_[resource];
+         const framebuffer &target = graph.pool_.get(graph.targets_[source.target_].handle_);
+         const bool is_depth = source.format_ == FRAMEBUFFER_FORMAT_D32;
+
+         glBindFramebuffer(GL_READ_FRAMEBUFFER, target.id_);
+         if (!is_depth) {
+            glReadBuffer(GL_COLOR_ATTACHMENT0 + source.color_index_);
+         }
+         glBlitFramebuffer(0, 0, source.width_, source.height_,
+                           0, 0, source.width_, source.height_,
+                           is_depth ? GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT,
+                           GL_NEAREST);
+         glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+      });
+
+      passes_[index].overwrites_ = true;
+      read(index, resource);
+      write(index, resolved);
+
+      return resolved;
+   }
+
+   void render_graph::present(render_resource resource) {
+      // note: multisampled attachments have to be resolved first, a scaling blit cannot do it
+      assert(resource != BACKBUFFER && resources_[resource].format_ != FRAMEBUFFER_FORMAT_D32);
+      assert(resources_[resource].samples_ == 1);
+
+      const uint32 index = add_pass("present", [resource](const render_graph &graph) {
+         const render_graph::resource &source = graph.resources_[resource];
+         const framebuffer &target = graph.pool_.get(graph.targets_[source.target_].handle_);
+
+         glBindFramebuffer(GL_READ_FRAMEBUFFER, target.id_);
+         glReadBuffer(GL_COLOR_ATTACHMENT0 + source.color_index_);
+         glBlitFramebuffer(0, 0, source.width_, source.height_,
+                           0, 0, graph.backbuffer_width_, graph.backbuffer_height_,
+                           GL_COLOR_BUFFER_BIT,
+                           GL_NEAREST);
+         glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+      });
+
+      passes_[index].overwrites_ = true;
+      read(index, resource);
+      write(index, BACKBUFFER);
+   }
+
+   bool render_graph::compile() {
+      compiled_ = false;
+      order_.clear();
+      targets_.clear();
+      statistics_ = statistics();
+
+      const uint32 pass_count = (uint32)passes_.size();
+      const uint32 resource_count = (uint32)resources_.size();
+
+      for (auto &item : resources_) {
+         item.writer_ = INVALID_INDEX;
+         item.readers_ = 0;
+         item.last_ = 0;
+         item.target_ = INVALID_INDEX;
+         item.attachment_ = 0;
+         item.color_index_ = 0;
+      }
+
+      // note: every transient attachment needs exactly one writer, the backbuffer is never read
+      for (uint32 pass_index = 0; pass_index < pass_count; pass_index++) {
+         pass &entry = passes_[pass_index];
+         entry.culled_ = false;
+         entry.target_ = INVALID_INDEX;
+
+         for (auto &write : entry.writes_) {
+            if (write == BACKBUFFER) {
+               continue;
+            }
+
+            if (resources_[write].writer_ != INVALID_INDEX) {
+               return false;
+            }
+
+            resources_[write].writer_ = pass_index;
+         }
+
+         for (auto &read : entry.reads_) {
+            if (read == BACKBUFFER) {
+               return false;
+            }
+
+            resources_[read].readers_++;
+         }
+      }
+
+      for (uint32 pass_index = 0; pass_index < pass_count; pass_index++) {
+         for (auto &read : passes_[pass_index].reads_) {
+            if (resources_[read].writer_ == INVALID_INDEX) {
+               return false;
+            }
+         }
+      }
+
+      // note: cull passes whose results nobody reads, walking back from the unread attachments
+      dynamic_array<uint32> pass_references(pass_count);
+      dynamic_array<uint32> resource_references(resource_count);
+      dynamic_array<render_resource> unreferenced;
+
+      for (uint32 index = 0; index < resource_count; index++) {
+         resource_references[index] = resources_[index].readers_;
+         if (index != BACKBUFFER && resource_references[index] == 0) {
+            unreferenced.push_back(index);
+         }
+      }
+
+      auto cull = [&](uint32 pass_index) {
+         passes_[pass_index].culled_ = true;
+         for (auto &read : passes_[pass_index].reads_) {
+            if (--resource_references[read] == 0) {
+               unreferenced.push_back(read);
+            }
+         }
+      };
+
+      for (uint32 pass_index = 0; pass_index < pass_count; pass_index++) {
+         pass_references[pass_index] = (uint32)passes_[pass_index].writes_.size();
+         if (pass_references[pass_index] == 0 && !is_root(passes_[pass_index])) {
+            cull(pass_index);
+         }
+      }
+
+      while (!unreferenced.empty()) {
+         const render_resource index = unreferenced.back();
+         unreferenced.pop_back();
+
+         const uint32 writer = resources_[index].writer_;
+         if (writer == INVALID_INDEX || passes_[writer].culled_) {
+            continue;
+         }
+
+         if (--pass_references[writer] == 0 && !is_root(passes_[writer])) {
+            cull(writer);
+         }
+      }
+
+      // note: order by dependency, ties keep the order the passes were added in
+      dynamic_array<uint32> dependencies(pass_count);
+      uint32 previous_backbuffer_writer = INVALID_INDEX;
+      uint32 live_count = 0;
+
+      for (uint32 pass_index = 0; pass_index < pass_count; pass_index++) {
+         const pass &entry = passes_[pass_index];
+         if (entry.culled_) {
+            continue;
+         }
+
+         live_count++;
+         dependencies[pass_index] = (uint32)entry.reads_.size();
+         if (writes_resource(entry, BACKBUFFER)) {
+            if (previous_backbuffer_writer != INVALID_INDEX) {
+               dependencies[pass_index]++;
+            }
+
+            previous_backbuffer_writer = pass_index;
+         }
+      }
+
+      dynamic_array<bool> scheduled(pass_count);
+      while (order_.size() < live_count) {
+         uint32 next = INVALID_INDEX;
+         for (uint32 pass_index = 0; pass_index < pass_count; pass_index++) {
+            if (!passes_[pass_index].culled_ && !scheduled[pass_index] && dependencies[pass_index] == 0) {
+               next = pass_index;
+               break;
+            }
+         }
+
+         // note: a cycle, nothing is ready to run
+         if (next == INVALID_INDEX) {
+            order_.clear();
+            return false;
+         }
+
+         scheduled[next] = true;
+         order_.push_back(next);
+
+         const pass &entry = passes_[next];
+         const bool writes_backbuffer = writes_resource(entry, BACKBUFFER);
+         bool found_next_backbuffer_writer = false;
+
+         for (uint32 pass_index = 0; pass_index < pass_count; pass_index++) {
+            const pass &other = passes_[pass_index];
+            if (other.culled_ || scheduled[pass_index]) {
+               continue;
+            }
+
+            for (auto &read : other.reads_) {
+               if (resources_[read].writer_ == next) {
+                  dependencies[pass_index]--;
+               }
+            }
+
+            if (writes_backbuffer && !found_next_backbuffer_writer && pass_index > next && writes_resource(other, BACKBUFFER)) {
+               dependencies[pass_index]--;
+               found_next_backbuffer_writer = true;
+            }
+         }
+      }
+
+      // note: an attachment lives from its writer up to its last reader
+      for (uint32 position = 0; position < (uint32)order_.size(); position++) {
+         const pass &entry = passes_[order_[position]];
+         for (auto &read : entry.reads_) {
+            resources_[read].last_ = position;
+         }
+
+         for (auto &write : entry.writes_) {
+            if (resources_[write].last_ < position) {
+               resources_[write].last_ = position;
+            }
+         }
+      }
+
+      // note: attachments written by the same pass share a framebuffer, a target
+      //       of the same shape is reused once its last reader ran
+      for (uint32 position = 0; position < (uint32)order_.size(); position++) {
+         pass &entry = passes_[order_[position]];
+         if (writes_resource(entry, BACKBUFFER)) {
+            if (entry.writes_.size() > 1) {
+               return false;
+            }
+
+            continue;
+         }
+
+         if (entry.writes_.empty()) {
+            continue;
+         }
+
+         if (entry.writes_.size() > MAX_FRAMEBUFFER_ATTACHMENTS) {
+            return false;
+         }
+
+         const resource &first = resources_[entry.writes_[0]];
+         framebuffer_format formats[MAX_FRAMEBUFFER_ATTACHMENTS] = {};
+         uint32 depth_count = 0;
+         uint32 busy_until = position;
+
+         for (uint32 index = 0; index < (uint32)entry.writes_.size(); index++) {
+            const resource &attachment = resources_[entry.writes_[index]];
+            if (attachment.width_ != first.width_ ||
+                attachment.height_ != first.height_ ||
+                attachment.samples_ != first.samples_)
+            {
+               return false;
+            }
+
+            if (attachment.format_ == FRAMEBUFFER_FORMAT_D32) {
+               depth_count++;
+            }
+
+            if (busy_until < attachment.last_) {
+               busy_until = attachment.last_;
+            }
+
+            formats[index] = attachment.format_;
+         }
+
+         if (depth_count > 1) {
+            return false;
+         }
+
+         const uint32 format_count = (uint32)entry.writes_.size();
+         const framebuffer_desc desc(first.width_, first.height_, format_count, formats, FRAMEBUFFER_FORMAT_NONE, first.samples_);
+
+         uint32 target_index = INVALID_INDEX;
+         for (uint32 index = 0; index < (uint32)targets_.size(); index++) {
+            const target &candidate = targets_[index];
+            if (candidate.busy_until_ < position && candidate.desc_ == desc) {
+               target_index = index;
+               break;
+            }
+         }
+
+         if (target_index == INVALID_INDEX) {
+            target created;
+            created.desc_ = desc;
+            created.handle_ = framebuffer_pool::INVALID_HANDLE;
+            targets_.push_back(created);
+            target_index = (uint32)(targets_.size() - 1);
+         }
+
+         target &assigned = targets_[target_index];
+         assigned.busy_until_ = busy_until;
+         entry.target_ = target_index;
+
+         uint32 color_index = 0;
+         for (uint32 index = 0; index < format_count; index++) {
+            resource &attachment = resources_[entry.writes_[index]];
+            attachment.target_ = target_index;
+            attachment.attachment_ = index;
+            attachment.color_index_ = color_index;
+            if (attachment.format_ != FRAMEBUFFER_FORMAT_D32) {
+               color_index++;
+            }
+
+            statistics_.requested_bytes_ += (uint64)attachment.width_ * attachment.height_ * framebuffer_desc::bytes_per_pixel(attachment.format_);
+         }
+      }
+
+      statistics_.pass_count_ = live_count;
+      statistics_.culled_pass_count_ = pass_count - live_count;
+      statistics_.target_count_ = (uint32)targets_.size();
+      for (auto &target : targets_) {
+         statistics_.transient_bytes_ += target.desc_.byte_size();
+      }
+
+      compiled_ = true;
+      return true;
+   }
+
+   void render_graph::execute() {
+      assert(compiled_);
+      if (!compiled_) {
+         return;
+      }
+
+      bool backbuffer_written = false;
+      for (uint32 position = 0; position < (uint32)order_.size(); position++) {
+         pass &entry = passes_[order_[position]];
+         NEON_PROFILE_SCOPE(entry.name_);
+         const time start = time::now();
+         if (gpu_profiler_) {
+            gpu_profiler_->push(entry.name_);
+         }
+
+         // note: transient attachments start out undefined, aliased ones hold the previous user's data
+         if (entry.target_ != INVALID_INDEX) {
+            target &assigned = targets_[entry.target_];
+            if (assigned.handle_ == framebuffer_pool::INVALID_HANDLE) {
+               assigned.handle_ = pool_.acquire(assigned.desc_);
+               if (assigned.handle_ == framebuffer_pool::INVALID_HANDLE) {
+                  assert(!"could not create render graph target");
+                  if (gpu_profiler_) {
+                     gpu_profiler_->pop();
+                  }
+                  continue;
+               }
+            }
+
+            pool_.get(assigned.handle_).bind();
+            if (!entry.overwrites_) {
+               glDepthMask(GL_TRUE);
+               glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+               glClearDepth(1.0);
+               glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            }
+         }
+         else if (writes_resource(entry, BACKBUFFER)) {
+            framebuffer::unbind(backbuffer_width_, backbuffer_height_);
+
+            // note: a present covers the whole backbuffer, anything else needs a clear first
+            if (!backbuffer_written && !entry.overwrites_) {
+               glDepthMask(GL_TRUE);
+               glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+               glClearDepth(1.0);
+               glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            }
+
+            backbuffer_written = true;
+         }
+
+         if (entry.execute_) {
+            entry.execute_(*this);
+         }
+
+         if (gpu_profiler_) {
+            gpu_profiler_->pop();
+         }
+
+         // note: hand targets back once their last reader ran, later passes of this frame may get them again
+         for (auto &target : targets_) {
+            if (target.handle_ != framebuffer_pool::INVALID_HANDLE && target.busy_until_ <= position) {
+               pool_.release(target.handle_);
+               target.handle_ = framebuffer_pool::INVALID_HANDLE;
+            }
+         }
+
+         entry.cpu_time_ = time::now() - start;
+         entry.total_cpu_time_ += entry.cpu_time_;
+         entry.executions_++;
+      }
+   }
+
+   void render_graph::reset_timings() {
+      for (auto &entry : passes_) {
+         entry.total_cpu_time_ = time();
+         entry.executions_ = 0;
+      }
+   }
+
+   void render_graph::bind_texture(render_resource resource, uint32 slot) const {
+      const render_graph::resource &source = resources_[resource];
+      assert(source.target_ != INVALID_INDEX);
+
+      pool_.get(targets_[source.target_].handle_).bind_as_texture(source.attachment_, slot);
+   }
+} // !neon
@@ -0,0 +1,489 @@
+// neon_resource_cache.cc
+
+#include "neon_resource_cache.h"
+#include <cassert>
+#include <cctype>
+#include <cstdio>
+
+namespace neon {
+   namespace {
+      const char *resource_type_names[RESOURCE_TYPE_COUNT] =
+      {
+         "program",
+         "texture",
+         "sampler",
+         "geometry",
+      };
+
+      bool read_source(const string &filename, dynamic_array<uint8> &content) {
+         if (!file_system::read_file_content(filename, content)) {
+            return false;
+         }
+
+         content.push_back(0);
+         return true;
+      }
+
+      string to_hex(uint64 value) {
+         char text[32] = {};
+         snprintf(text, sizeof(text), "%016llx", (unsigned long long)value);
+         return text;
+      }
+   } // !anon
+
+   load_time_histogram::load_time_histogram()
+      : count_(0)
+      , buckets_{}
+   {
+   }
+
+   void load_time_histogram::add(const time &duration) {
+      count_++;
+      total_ += duration;
+      if (slowest_ < duration) {
+         slowest_ = duration;
+      }
+
+      uint32 bucket = 0;
+      const double milliseconds = duration.as_milliseconds();
+      while (bucket < LOAD_TIME_HISTOGRAM_BUCKET_COUNT - 1 && milliseconds >= (double)(1u << bucket)) {
+         bucket++;
+      }
+
+      buckets_[bucket]++;
+   }
+
+   resource_cache::entry::entry()
+      : id_(0)
+      , type_(GL_NONE)
+      , references_(0)
+   {
+   }
+
+   resource_cache::statistics::statistics()
+      : hits_(0)
+      , misses_(0)
+      , failures_(0)
+   {
+   }
+
+   // static
+   string resource_cache::normalize_path(const string &path) {
+      dynamic_array<string> segments;
+      string segment;
+      for (size_t index = 0; index <= path.size(); index++) {
+         const char ch = index < path.size() ? path[index] : '/';
+         if (ch != '/' && ch != '\\') {
+#if defined(_WIN32)
+            segment += (char)tolower((unsigned char)ch);
+#else
+            segment += ch;
+#endif
+            continue;
+         }
+
+         if (segment.empty() || segment == ".") {
+            // note: skip duplicate separators and current directory
+         }
+         else if (segment == ".." && !segments.empty() && segments.back() != "..") {
+            segments.pop_back();
+         }
+         else {
+            segments.push_back(segment);
+         }
+
+         segment.clear();
+      }
+
+      string result;
+      for (auto &part : segments) {
+         if (!result.empty()) {
+            result += '/';
+         }
+         result += part;
+      }
+
+      return result;
+   }
+
+   resource_cache::resource_cache()
+      : next_geometry_id_(1)
+   {
+   }
+
+   bool resource_cache::acquire_program(const string &vertex_filename, const string &fragment_filename, shader_program &program, const uint32 features) {
+      char variant[16] = {};
+      snprintf(variant, sizeof(variant), "|%02x", features);
+      const string path_key = normalize_path(vertex_filename) + '|' + normalize_path(fragment_filename) + variant;
+
+      GLuint id = 0;
+      GLenum target = GL_NONE;
+      auto alias = program_aliases_.find(path_key);
+      if (alias != program_aliases_.end() && acquire_entry(RESOURCE_TYPE_PROGRAM, alias->second, id, target)) {
+         program.id_ = id;
+         return true;
+      }
+
+      const time start = time::now();
+
+      dynamic_array<uint8> vertex_source;
+      dynamic_array<uint8> fragment_source;
+      if (!read_source(vertex_filename, vertex_source) ||
+          !read_source(fragment_filename, fragment_source))
+      {
+         statistics_[RESOURCE_TYPE_PROGRAM].failures_++;
+         return false;
+      }
+
+      const string vertex_variant = shader_program::inject_features((const char *)vertex_source.data(), features);
+      const string fragment_variant = shader_program::inject_features((const char *)fragment_source.data(), features);
+
+      // note: programs with identical sources are shared no matter where they were loaded from
+      uint64 source_hash = hash::fnv1a(vertex_variant);
+      source_hash = hash::fnv1a(fragment_variant, source_hash);
+
+      const string key = to_hex(source_hash);
+      program_aliases_[path_key] = key;
+      if (acquire_entry(RESOURCE_TYPE_PROGRAM, key, id, target)) {
+         program.id_ = id;
+         return true;
+      }
+
+      shader_program result;
+      if (!binaries_.create_program(vertex_variant.c_str(), fragment_variant.c_str(), result)) {
+         program_aliases_.erase(path_key);
+         statistics_[RESOURCE_TYPE_PROGRAM].failures_++;
+         return false;
+      }
+
+      insert_entry(RESOURCE_TYPE_PROGRAM, key, path_key, result.id_, GL_NONE, time::now() - start);
+      program.id_ = result.id_;
+
+      return true;
+   }
+
+   bool resource_cache::acquire_texture(const string &filename, bool flip, texture &texture) {
+      const string key = normalize_path(filename) + (flip ? "|flip" : "");
+
+      GLuint id = 0;
+      GLenum target = GL_NONE;
+      if (acquire_entry(RESOURCE_TYPE_TEXTURE, key, id, target)) {
+         texture.id_ = id;
+         texture.type_ = target;
+         return true;
+      }
+
+      const time start = time::now();
+
+      neon::texture result;
+      if (!result.create(filename, flip)) {
+         result.destroy();
+         statistics_[RESOURCE_TYPE_TEXTURE].failures_++;
+         return false;
+      }
+
+      insert_entry(RESOURCE_TYPE_TEXTURE, key, key, result.id_, result.type_, time::now() - start);
+      texture = result;
+
+      return true;
+   }
+
+   bool resource_cache::acquire_cubemap(const string (&filenames)[6], texture &texture) {
+      string key = "cubemap";
+      for (auto &filename : filenames) {
+         key += '|';
+         key += normalize_path(filename);
+      }
+
+      GLuint id = 0;
+      GLenum target = GL_NONE;
+      if (acquire_entry(RESOURCE_TYPE_TEXTURE, key, id, target)) {
+         texture.id_ = id;
+         texture.type_ = target;
+         return true;
+      }
+
+      const time start = time::now();
+
+      image sides[6];
+      for (int index = 0; index < 6; index++) {
+         if (!sides[index].create_from_file(filenames[index].c_str())) {
+            assert(!"Could not load cubemap image!");
+            statistics_[RESOURCE_TYPE_TEXTURE].failures_++;
+            return false;
+         }
+      }
+
+      const int width = sides[0].width();
+      const int height = sides[0].height();
+
+      for (int index = 1; index < 6; index++) {
+         if (width != sides[index].width() || height != sides[index].height()) {
+            assert(!"cubemap images must be same dimension");
+            statistics_[RESOURCE_TYPE_TEXTURE].failures_++;
+            return false;
+         }
+      }
+
+      const void *faces[6];
+      for (int index = 0; index < 6; index++) {
+         faces[index] = sides[index].data();
+      }
+
+      neon::texture result;
+      if (!result.create_cubemap(width, height, faces)) {
+         result.destroy();
+         statistics_[RESOURCE_TYPE_TEXTURE].failures_++;
+         return false;
+      }
+
+      insert_entry(RESOURCE_TYPE_TEXTURE, key, key, result.id_, result.type_, time::now() - start);
+      texture = result;
+
+      return true;
+   }
+
+   bool resource_cache::acquire_sampler(const GLenum filter, const GLenum address_mode_u, const GLenum address_mode_v, sampler_state &sampler) {
+      // note: samplers are deduplicated by state alone
+      char key[64] = {};
+      snprintf(key, sizeof(key), "sampler|%04x|%04x|%04x", filter, address_mode_u, address_mode_v);
+
+      GLuint id = 0;
+      GLenum target = GL_NONE;
+      if (acquire_entry(RESOURCE_TYPE_SAMPLER, key, id, target)) {
+         sampler.id_ = id;
+         return true;
+      }
+
+      const time start = time::now();
+
+      sampler_state result;
+      if (!result.create(filter, address_mode_u, address_mode_v)) {
+         result.destroy();
+         statistics_[RESOURCE_TYPE_SAMPLER].failures_++;
+         return false;
+      }
+
+      insert_entry(RESOURCE_TYPE_SAMPLER, key, key, result.id_, GL_NONE, time::now() - start);
+      sampler.id_ = result.id_;
+
+      return true;
+   }
+
+   bool resource_cache::acquire_geometry(const string &filename, geometry_arena &arena, const model::geometry *&geometry) {
+      // note: the ranges live in the arena they were loaded into, each arena gets its own copy
+      char arena_key[32] = {};
+      snprintf(arena_key, sizeof(arena_key), "|%p", (const void *)&arena);
+      const string name = normalize_path(filename);
+      const string key = name + arena_key;
+
+      GLuint id = 0;
+      GLenum target = GL_NONE;
+      if (acquire_entry(RESOURCE_TYPE_GEOMETRY, key, id, target)) {
+         geometry = geometries_[id];
+         return true;
+      }
+
+      const time start = time::now();
+
+      model::geometry *result = new model::geometry;
+      if (!result->create(arena, filename)) {
+         result->destroy();
+         delete result;
+         statistics_[RESOURCE_TYPE_GEOMETRY].failures_++;
+         return false;
+      }
+
+      id = next_geometry_id_++;
+      geometries_[id] = result;
+      insert_entry(RESOURCE_TYPE_GEOMETRY, key, name, id, GL_NONE, time::now() - start);
+      geometry = result;
+
+      return true;
+   }
+
+   void resource_cache::release(shader_program &program) {
+      if (!program.is_valid()) {
+         return;
+      }
+
+      if (release_entry(RESOURCE_TYPE_PROGRAM, program.id_)) {
+         program.destroy();
+      }
+
+      program.id_ = 0;
+   }
+
+   void resource_cache::release(texture &texture) {
+      if (!texture.is_valid()) {
+         return;
+      }
+
+      if (release_entry(RESOURCE_TYPE_TEXTURE, texture.id_)) {
+         texture.destroy();
+      }
+
+      texture.id_ = 0;
+   }
+
+   void resource_cache::release(sampler_state &sampler) {
+      if (!sampler.is_valid()) {
+         return;
+      }
+
+      if (release_entry(RESOURCE_TYPE_SAMPLER, sampler.id_)) {
+         sampler.destroy();
+      }
+
+      sampler.id_ = 0;
+   }
+
+   void resource_cache::release(const model::geometry *&geometry) {
+      if (!geometry) {
+         return;
+      }
+
+      auto it = geometries_.begin();
+      while (it != geometries_.end() && it->second != geometry) {
+         ++it;
+      }
+
+      assert(it != geometries_.end());
+      if (it != geometries_.end() && release_entry(RESOURCE_TYPE_GEOMETRY, it->first)) {
+         it->second->destroy();
+         delete it->second;
+         geometries_.erase(it);
+      }
+
+      geometry = nullptr;
+   }
+
+   void resource_cache::destroy() {
+      for (auto &pair : entries_[RESOURCE_TYPE_PROGRAM]) {
+         glDeleteProgram(pair.second.id_);
+      }
+
+      for (auto &pair : entries_[RESOURCE_TYPE_TEXTURE]) {
+         glDeleteTextures(1, &pair.second.id_);
+      }
+
+      for (auto &pair : entries_[RESOURCE_TYPE_SAMPLER]) {
+         glDeleteSamplers(1, &pair.second.id_);
+      }
+
+      for (auto &pair : geometries_) {
+         pair.second->destroy();
+         delete pair.second;
+      }
+      geometries_.clear();
+
+      for (uint32 type = 0; type < RESOURCE_TYPE_COUNT; type++) {
+         entries_[type].clear();
+         keys_[type].clear();
+      }
+
+      program_aliases_.clear();
+   }
+
+   string resource_cache::report() const {
+      string result;
+      char line[256] = {};
+      for (uint32 type = 0; type < RESOURCE_TYPE_COUNT; type++) {
+         const load_time_histogram &histogram = histograms_[type];
+         const statistics &stats = statistics_[type];
+
+         snprintf(line, sizeof(line), "%s: %u loaded, %u hits, %u failed, total %.0f ms, slowest %.0f ms\n",
+                  resource_type_names[type],
+                  histogram.count_,
+                  stats.hits_,
+                  stats.failures_,
+                  histogram.total_.as_milliseconds(),
+                  histogram.slowest_.as_milliseconds());
+         result += line;
+
+         for (uint32 bucket = 0; bucket < LOAD_TIME_HISTOGRAM_BUCKET_COUNT; bucket++) {
+            if (!histogram.buckets_[bucket]) {
+               continue;
+            }
+
+            if (bucket < LOAD_TIME_HISTOGRAM_BUCKET_COUNT - 1) {
+               snprintf(line, sizeof(line), "  < %4u ms: %u\n", 1u << bucket, histogram.buckets_[bucket]);
+            }
+            else {
+               snprintf(line, sizeof(line), " >= %4u ms: %u\n", 1u << (bucket - 1), histogram.buckets_[bucket]);
+            }
+            result += line;
+         }
+
+         for (auto &pair : entries_[type]) {
+            snprintf(line, sizeof(line), "  %6.0f ms  %s (refs: %d)\n",
+                     pair.second.load_time_.as_milliseconds(),
+                     pair.second.name_.c_str(),
+                     pair.second.references_);
+            result += line;
+         }
+      }
+
+      result += binaries_.report();
+
+      return result;
+   }
+
+   bool resource_cache::acquire_entry(resource_type type, const string &key, GLuint &id, GLenum &target) {
+      auto it = entries_[type].find(key);
+      if (it == entries_[type].end()) {
+         return false;
+      }
+
+      it->second.references_++;
+      statistics_[type].hits_++;
+
+      id = it->second.id_;
+      target = it->second.type_;
+
+      return true;
+   }
+
+   void resource_cache::insert_entry(resource_type type, const string &key, const string &name, GLuint id, GLenum target, const time &load_time) {
+      entry &result = entries_[type][key];
+      result.name_ = name;
+      result.id_ = id;
+      result.type_ = target;
+      result.references_ = 1;
+      result.load_time_ = load_time;
+
+      keys_[type][id] = key;
+      statistics_[type].misses_++;
+      histograms_[type].add(load_time);
+   }
+
+   bool resource_cache::release_entry(resource_type type, GLuint id) {
+      auto key = keys_[type].find(id);
+      if (key == keys_[type].end()) {
+         assert(!"resource is not owned by the cache");
+         return false;
+      }
+
+      auto it = entries_[type].find(key->second);
+      assert(it != entries_[type].end());
+      if (--it->second.references_ > 0) {
+         return false;
+      }
+
+      if (type == RESOURCE_TYPE_PROGRAM) {
+         for (auto alias = program_aliases_.begin(); alias != program_aliases_.end();) {
+            if (alias->second == key->second) {
+               alias = program_aliases_.erase(alias);
+            }
+            else {
+               ++alias;
+            }
+         }
+      }
+
+      entries_[type].erase(it);
+      keys_[type].erase(key);
+
+      return true;
+   }
+} // !neon
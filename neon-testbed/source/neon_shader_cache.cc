@@ -0,0 +1,208 @@
+// neon_shader_cache.cc
+
+#include "neon_shader_cache.h"
+#include <cstdio>
+#include <cstring>
+
+namespace neon {
+   namespace {
+      constexpr uint32 PROGRAM_BINARY_MAGIC = 0x4342504e; // note: 'NPBC'
+      constexpr uint32 PROGRAM_BINARY_VERSION = 1;
+
+      uint64 hash_gl_string(GLenum name, uint64 seed) {
+         const char *text = (const char *)glGetString(name);
+         if (!text) {
+            return seed;
+         }
+
+         return hash::fnv1a(text, strlen(text), seed);
+      }
+   } // !anon
+
+   program_binary_cache::statistics::statistics()
+      : hits_(0)
+      , misses_(0)
+      , rejected_(0)
+      , writes_(0)
+   {
+   }
+
+   program_binary_cache::program_binary_cache()
+      : enabled_(false)
+      , driver_hash_(0)
+   {
+   }
+
+   bool program_binary_cache::is_enabled() const {
+      return enabled_;
+   }
+
+   bool program_binary_cache::create(const string &directory) {
+      enabled_ = false;
+
+      if (!glGetProgramBinary || !glProgramBinary || !glProgramParameteri) {
+         return false;
+      }
+
+      GLint format_count = 0;
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+      if (format_count <= 0) {
+         return false;
+      }
+
+      if (directory.empty() || !file_system::create_directory(directory)) {
+         return false;
+      }
+
+      uint64 driver_hash = hash::fnv1a(nullptr, 0);
+      driver_hash = hash_gl_string(GL_VENDOR, driver_hash);
+      driver_hash = hash_gl_string(GL_RENDERER, driver_hash);
+      driver_hash = hash_gl_string(GL_VERSION, driver_hash);
+
+      directory_ = directory;
+      if (directory_.back() != '/' && directory_.back() != '\\') {
+         directory_ += '/';
+      }
+
+      driver_hash_ = driver_hash;
+      enabled_ = true;
+
+      return true;
+   }
+
+   bool program_binary_cache::create_program(const char *vertex_source, const char *fragment_source, shader_program &program) {
+      const uint64 key = make_key(vertex_source, fragment_source);
+      const string filename = make_filename(key);
+
+      if (enabled_) {
+         const time start = time::now();
+         if (load_program(filename, key, program)) {
+            statistics_.hits_++;
+            statistics_.load_time_ += time::now() - start;
+            return true;
+         }
+      }
+
+      const time start = time::now();
+      if (!program.create_from_source(vertex_source, fragment_source) || !program.is_valid()) {
+         program.destroy();
+         return false;
+      }
+
+      statistics_.misses_++;
+      statistics_.compile_time_ += time::now() - start;
+
+      if (enabled_ && store_program(filename, key, program)) {
+         statistics_.writes_++;
+      }
+
+      return true;
+   }
+
+   bool program_binary_cache::remove_program(const char *vertex_source, const char *fragment_source) {
+      // note: lets the benchmark start from a cold cache without clearing the directory
+      const string filename = make_filename(make_key(vertex_source, fragment_source));
+      if (!enabled_ || !file_system::exists(filename)) {
+         return false;
+      }
+
+      return file_system::remove_file(filename);
+   }
+
+   uint64 program_binary_cache::make_key(const char *vertex_source, const char *fragment_source) const {
+      uint64 key = hash::fnv1a(vertex_source, strlen(vertex_source), driver_hash_);
+      return hash::fnv1a(fragment_source, strlen(fragment_source), key);
+   }
+
+   string program_binary_cache::make_filename(uint64 key) const {
+      char name[32] = {};
+      snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+      return directory_ + name;
+   }
+
+   bool program_binary_cache::load_program(const string &filename, uint64 key, shader_program &program) {
+      if (!file_system::exists(filename)) {
+         return false;
+      }
+
+      dynamic_array<uint8> content;
+      if (!file_system::read_file_content(filename, content) || content.size() < sizeof(header)) {
+         return false;
+      }
+
+      header head = {};
+      memcpy(&head, content.data(), sizeof(header));
+      if (head.magic_ != PROGRAM_BINARY_MAGIC ||
+          head.version_ != PROGRAM_BINARY_VERSION ||
+          head.key_ != key ||
+          head.length_ != content.size() - sizeof(header))
+      {
+         file_system::remove_file(filename);
+         return false;
+      }
+
+      GLuint id = glCreateProgram();
+      glProgramBinary(id, head.format_, content.data() + sizeof(header), (GLsizei)head.length_);
+
+      // note: drivers reject binaries after an update, fall back to compiling
+      GLint status = GL_FALSE;
+      glGetProgramiv(id, GL_LINK_STATUS, &status);
+      if (status == GL_FALSE) {
+         glDeleteProgram(id);
+         file_system::remove_file(filename);
+         statistics_.rejected_++;
+
+         // note: clear the error the driver might have flagged
+         glGetError();
+         return false;
+      }
+
+      program.id_ = id;
+
+      return true;
+   }
+
+   bool program_binary_cache::store_program(const string &filename, uint64 key, const shader_program &program) {
+      GLint length = 0;
+      glGetProgramiv(program.id_, GL_PROGRAM_BINARY_LENGTH, &length);
+      if (length <= 0) {
+         return false;
+      }
+
+      dynamic_array<uint8> content(sizeof(header) + length);
+
+      header head = {};
+      head.magic_ = PROGRAM_BINARY_MAGIC;
+      head.version_ = PROGRAM_BINARY_VERSION;
+      head.key_ = key;
+
+      GLenum format = GL_NONE;
+      GLsizei written = 0;
+      glGetProgramBinary(program.id_, length, &written, &format, content.data() + sizeof(header));
+      if (written <= 0 || glGetError() != GL_NO_ERROR) {
+         return false;
+      }
+
+      head.format_ = format;
+      head.length_ = (uint32)written;
+      memcpy(content.data(), &head, sizeof(header));
+      content.resize(sizeof(header) + written);
+
+      return file_system::write_file_content(filename, content, true);
+   }
+
+   string program_binary_cache::report() const {
+      char text[256] = {};
+      snprintf(text, sizeof(text),
+               "program binaries: %s, %u loaded in %.0f ms, %u compiled in %.0f ms, %u rejected, %u written\n",
+               enabled_ ? "enabled" : "disabled",
+               statistics_.hits_,
+               statistics_.load_time_.as_milliseconds(),
+               statistics_.misses_,
+               statistics_.compile_time_.as_milliseconds(),
+               statistics_.rejected_,
+               statistics_.writes_);
+
+      return text;
+   }
+} // !neon
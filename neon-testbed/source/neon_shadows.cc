@@ -0,0 +1,309 @@
+// neon_shadows.cc
+
+#include "neon_shadows.h"
+#include <neon_profiler.h>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+namespace neon {
+   namespace {
+      // note: 0 splits the view evenly, 1 logarithmically
+      const float SPLIT_LAMBDA = 0.75f;
+      const float SLOPE_BIAS = 2.0f;
+      const float CONSTANT_BIAS = 32.0f;
+   } // !anon
+
+   shadow_cascades::cascade::cascade()
+      : shadow_matrix_(1.0f)
+      , origin_(0.0f)
+      , radius_(0.0f)
+      , split_(0.0f)
+      , cached_(false)
+      , atlas_dirty_(true)
+      , static_casters_(0)
+      , dynamic_casters_(0)
+   {
+   }
+
+   shadow_cascades::statistics::statistics()
+      : static_updates_(0)
+      , tile_copies_(0)
+      , static_casters_(0)
+      , dynamic_casters_(0)
+   {
+   }
+
+   shadow_cascades::shadow_cascades()
+      : direction_(0.0f, -1.0f, 0.0f)
+      , scene_min_(-1.0f)
+      , scene_max_(1.0f)
+      , light_view_(1.0f)
+      , depth_near_(0.0f)
+      , depth_far_(1.0f)
+      , caching_(true)
+   {
+   }
+
+   bool shadow_cascades::create() {
+      const framebuffer_format formats[] = { FRAMEBUFFER_FORMAT_D32 };
+      if (!cache_.create(ATLAS_SIZE, ATLAS_SIZE, 1, formats)) {
+         return false;
+      }
+
+      if (!atlas_.create(ATLAS_SIZE, ATLAS_SIZE, 1, formats)) {
+         cache_.destroy();
+         return false;
+      }
+
+      // note: the atlas depth texture stays owned by the framebuffer
+      atlas_texture_.id_ = atlas_.depth_texture_;
+      atlas_texture_.type_ = GL_TEXTURE_2D;
+
+      for (auto &target : cascades_) {
+         target.cached_ = false;
+         target.atlas_dirty_ = true;
+      }
+
+      return true;
+   }
+
+   void shadow_cascades::destroy() {
+      atlas_texture_ = texture();
+      atlas_.destroy();
+      cache_.destroy();
+   }
+
+   bool shadow_cascades::is_valid() const {
+      return cache_.is_valid() && atlas_.is_valid();
+   }
+
+   void shadow_cascades::set_caching(bool enabled) {
+      caching_ = enabled;
+      for (auto &target : cascades_) {
+         target.cached_ = false;
+      }
+   }
+
+   void shadow_cascades::set_direction(const glm::vec3 &direction) {
+      const glm::vec3 normalized = glm::normalize(direction);
+      if (normalized == direction_) {
+         return;
+      }
+
+      direction_ = normalized;
+      for (auto &target : cascades_) {
+         target.cached_ = false;
+      }
+   }
+
+   void shadow_cascades::set_scene_bounds(const glm::vec3 &min, const glm::vec3 &max) {
+      if (min == scene_min_ && max == scene_max_) {
+         return;
+      }
+
+      scene_min_ = min;
+      scene_max_ = max;
+      for (auto &target : cascades_) {
+         target.cached_ = false;
+      }
+   }
+
+   void shadow_cascades::update(const fps_camera &camera) {
+      NEON_PROFILE_SCOPE("shadow_cascades::update");
+
+      const glm::vec3 up = fabsf(direction_.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+      light_view_ = glm::lookAt(glm::vec3(0.0f), direction_, up);
+
+      // note: depth covers the whole scene, casters between a slice and the sun still land in its tile
+      float min_z = FLT_MAX;
+      float max_z = -FLT_MAX;
+      for (int32 corner = 0; corner < 8; corner++) {
+         const glm::vec3 point((corner & 1) ? scene_max_.x : scene_min_.x,
+                               (corner & 2) ? scene_max_.y : scene_min_.y,
+                               (corner & 4) ? scene_max_.z : scene_min_.z);
+         const float z = (light_view_ * glm::vec4(point, 1.0f)).z;
+         min_z = z < min_z ? z : min_z;
+         max_z = z > max_z ? z : max_z;
+      }
+      depth_near_ = -max_z - 1.0f;
+      depth_far_ = -min_z + 1.0f;
+
+      // note: near and far from a gl perspective matrix, corner is the squared distance
+      //       of a frustum corner from the view axis at unit depth
+      const glm::mat4 &projection = camera.projection_;
+      const float near_plane = projection[3][2] / (projection[2][2] - 1.0f);
+      const float far_plane = projection[3][2] / (projection[2][2] + 1.0f);
+      const float tan_x = 1.0f / projection[0][0];
+      const float tan_y = 1.0f / projection[1][1];
+      const float corner = tan_x * tan_x + tan_y * tan_y;
+      const glm::mat4 inverse_view = glm::inverse(camera.view_);
+
+      float split_near = near_plane;
+      for (uint32 index = 0; index < CASCADE_COUNT; index++) {
+         cascade &target = cascades_[index];
+
+         const float fraction = (float)(index + 1) / CASCADE_COUNT;
+         const float logarithmic = near_plane * powf(far_plane / near_plane, fraction);
+         const float uniform = near_plane + (far_plane - near_plane) * fraction;
+         const float split_far = uniform + (logarithmic - uniform) * SPLIT_LAMBDA;
+
+         // note: the sphere center sits where the near and far corners of the slice are
+         //       equally far away, the radius only depends on the projection and is rounded
+         //       up so it does not flicker with the float error of the camera
+         float center = (1.0f + corner) * (split_near + split_far) * 0.5f;
+         center = center < split_far ? center : split_far;
+         float radius = sqrtf(corner * split_far * split_far + (split_far - center) * (split_far - center));
+         radius = ceilf(radius * 16.0f) / 16.0f;
+
+         // note: the tile is a bit larger than the sphere so its origin can snap to whole
+         //       scroll steps, a step is a whole number of texels and the texels stay put
+         const glm::vec4 world_center = inverse_view * glm::vec4(0.0f, 0.0f, -center, 1.0f);
+         const glm::vec4 light_center = light_view_ * world_center;
+         const float extent = radius * TILE_SIZE / (float)(TILE_SIZE - 2 * SCROLL_TEXELS);
+         const float step = 2.0f * extent * SCROLL_TEXELS / TILE_SIZE;
+         const glm::vec2 origin(floorf(light_center.x / step + 0.5f) * step,
+                                floorf(light_center.y / step + 0.5f) * step);
+
+         if (origin != target.origin_ || radius != target.radius_) {
+            target.cached_ = false;
+         }
+
+         target.origin_ = origin;
+         target.radius_ = radius;
+         target.split_ = split_far;
+         target.camera_.position_ = glm::vec3(world_center);
+         target.camera_.view_ = light_view_;
+         target.camera_.projection_ = glm::ortho(origin.x - extent, origin.x + extent,
+                                                 origin.y - extent, origin.y + extent,
+                                                 depth_near_, depth_far_);
+
+         const glm::mat4 view_projection = target.camera_.projection_ * target.camera_.view_;
+         target.frustum_.construct_from_view_matrix(view_projection);
+
+         // note: clip space to the texture coordinates and depth of the tile
+         const float column = (float)(index % 2);
+         const float row = (float)(index / 2);
+         glm::mat4 tile = glm::translate(glm::mat4(1.0f), glm::vec3(column * 0.5f + 0.25f, row * 0.5f + 0.25f, 0.5f));
+         tile = glm::scale(tile, glm::vec3(0.25f, 0.25f, 0.5f));
+         target.shadow_matrix_ = tile * view_projection;
+
+         split_near = split_far;
+      }
+   }
+
+   bool shadow_cascades::needs_static(uint32 index) const {
+      assert(index < CASCADE_COUNT);
+      return !caching_ || !cascades_[index].cached_;
+   }
+
+   void shadow_cascades::execute() {
+      NEON_PROFILE_SCOPE("shadow_cascades::execute");
+
+      if (!is_valid()) {
+         return;
+      }
+
+      const time start = time::now();
+      statistics_.static_updates_ = 0;
+      statistics_.tile_copies_ = 0;
+      statistics_.static_casters_ = 0;
+      statistics_.dynamic_casters_ = 0;
+
+      const auto set_tile = [](uint32 index) {
+         const int32 x = (int32)(index % 2) * TILE_SIZE;
+         const int32 y = (int32)(index / 2) * TILE_SIZE;
+         glViewport(x, y, TILE_SIZE, TILE_SIZE);
+         glScissor(x, y, TILE_SIZE, TILE_SIZE);
+      };
+
+      glDepthMask(GL_TRUE);
+      glClearDepth(1.0);
+      glEnable(GL_SCISSOR_TEST);
+      glEnable(GL_POLYGON_OFFSET_FILL);
+      glPolygonOffset(SLOPE_BIAS, CONSTANT_BIAS);
+
+      if (caching_) {
+         cache_.bind();
+         for (uint32 index = 0; index < CASCADE_COUNT; index++) {
+            cascade &target = cascades_[index];
+            if (target.cached_) {
+               continue;
+            }
+
+            set_tile(index);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            target.static_commands_.submit();
+            target.cached_ = true;
+            target.atlas_dirty_ = true;
+            statistics_.static_updates_++;
+            statistics_.static_casters_ += target.static_casters_;
+         }
+
+         // note: a tile is only copied over when the cache changed or dynamic casters were
+         //       drawn on top of it last frame, otherwise the atlas still holds the same depth
+         glBindFramebuffer(GL_READ_FRAMEBUFFER, cache_.id_);
+         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, atlas_.id_);
+         for (uint32 index = 0; index < CASCADE_COUNT; index++) {
+            cascade &target = cascades_[index];
+            if (!target.atlas_dirty_) {
+               continue;
+            }
+
+            const int32 x = (int32)(index % 2) * TILE_SIZE;
+            const int32 y = (int32)(index / 2) * TILE_SIZE;
+            set_tile(index);
+            glBlitFramebuffer(x, y, x + TILE_SIZE, y + TILE_SIZE,
+                              x, y, x + TILE_SIZE, y + TILE_SIZE,
+                              GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            statistics_.tile_copies_++;
+         }
+
+         atlas_.bind();
+         for (uint32 index = 0; index < CASCADE_COUNT; index++) {
+            cascade &target = cascades_[index];
+            set_tile(index);
+            target.dynamic_commands_.submit();
+            target.atlas_dirty_ = target.dynamic_casters_ > 0;
+            statistics_.dynamic_casters_ += target.dynamic_casters_;
+         }
+      }
+      else {
+         atlas_.bind();
+         for (uint32 index = 0; index < CASCADE_COUNT; index++) {
+            cascade &target = cascades_[index];
+            set_tile(index);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            target.static_commands_.submit();
+            target.dynamic_commands_.submit();
+            target.atlas_dirty_ = true;
+            statistics_.static_updates_++;
+            statistics_.static_casters_ += target.static_casters_;
+            statistics_.dynamic_casters_ += target.dynamic_casters_;
+         }
+      }
+
+      glDisable(GL_POLYGON_OFFSET_FILL);
+      glDisable(GL_SCISSOR_TEST);
+
+      statistics_.execute_time_ = time::now() - start;
+   }
+
+   void shadow_cascades::bind(command_buffer &commands) const {
+      static const char *matrix_names[CASCADE_COUNT] =
+      {
+         "shadow_matrices[0]",
+         "shadow_matrices[1]",
+         "shadow_matrices[2]",
+         "shadow_matrices[3]",
+      };
+
+      commands.set_uniform_vec3("light_direction", direction_);
+      commands.bind_texture(atlas_texture_, SHADOW_MAP_SLOT);
+      commands.set_uniform_int("shadow_map", SHADOW_MAP_SLOT);
+      commands.set_uniform_vec4("shadow_splits", glm::vec4(cascades_[0].split_, cascades_[1].split_, cascades_[2].split_, cascades_[3].split_));
+      for (uint32 index = 0; index < CASCADE_COUNT; index++) {
+         commands.set_uniform_mat4(matrix_names[index], cascades_[index].shadow_matrix_);
+      }
+   }
+} // !neon
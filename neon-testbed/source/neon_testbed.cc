@@ -1,7 +1,12 @@
 // neon_testbed.cc
 
 #include "neon_testbed.h"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #pragma warning(push)
 #pragma warning(disable: 4201)
@@ -18,6 +23,23 @@ namespace neon {
       return new testbed;
    }
 
+   namespace {
+      // note: three rounds over the textures of the scene, a little over 100 MB once decoded
+      const char *const STREAMED_FILES[] = {
+         "assets/sphere/earth.jpg",
+         "assets/skybox/xpos.png",
+         "assets/skybox/xneg.png",
+         "assets/skybox/ypos.png",
+         "assets/skybox/yneg.png",
+         "assets/skybox/zpos.png",
+         "assets/skybox/zneg.png",
+         "assets/heightmap/texture.png",
+         "assets/model/diffuse.png",
+      };
+      const uint32 STREAMED_FILE_COUNT = sizeof(STREAMED_FILES) / sizeof(STREAMED_FILES[0]);
+      const uint32 STREAMED_ROUNDS = 3;
+   } // !anon
+
    namespace opengl
    {
 	   GLuint create_shader(GLenum type, const char* source)
@@ -60,10 +82,368 @@ namespace neon {
    } //!opengl
 
 
+   const char *render_task_name(render_task task) {
+      static const char *names[RENDER_TASK_COUNT] =
+      {
+         "prepass",
+         "terrain",
+         "queries",
+         "model",
+         "skybox",
+      };
+
+      return task < RENDER_TASK_COUNT ? names[task] : "unknown";
+   }
+
+   opaque_pass_settings::opaque_pass_settings()
+      : depth_prepass_(false)
+      , front_to_back_(true)
+      , skybox_last_(true)
+   {
+   }
+
+   fragment_statistics::fragment_statistics()
+      : frames_(0)
+      , pixels_(0)
+      , samples_{}
+   {
+   }
+
+   gpu_frame_statistics::gpu_frame_statistics()
+      : count_(0)
+      , over_budget_(0)
+      , sum_(0.0)
+      , sum_squared_(0.0)
+      , max_(0.0)
+      , scale_sum_(0.0)
+   {
+   }
+
+   void gpu_frame_statistics::add(const time &gpu_time, const time &budget, float scale) {
+      const double milliseconds = gpu_time.as_milliseconds();
+      count_++;
+      sum_ += milliseconds;
+      sum_squared_ += milliseconds * milliseconds;
+      max_ = milliseconds > max_ ? milliseconds : max_;
+      scale_sum_ += scale;
+      if (budget > time() && gpu_time > budget) {
+         over_budget_++;
+      }
+   }
+
+   culling_statistics::culling_statistics()
+      : frames_(0)
+      , tested_(0)
+      , frustum_culled_(0)
+      , occlusion_culled_(0)
+      , queries_(0)
+      , skipped_draws_(0)
+      , conditional_draws_(0)
+   {
+   }
+
+   lighting_statistics::lighting_statistics()
+      : frames_(0)
+      , visible_(0)
+      , references_(0)
+      , max_per_cluster_(0)
+      , overflow_(0)
+   {
+   }
+
+   shadow_statistics::shadow_statistics()
+      : frames_(0)
+      , static_updates_(0)
+      , tile_copies_(0)
+      , static_casters_(0)
+      , dynamic_casters_(0)
+   {
+   }
+
+   batching_statistics::batching_statistics()
+      : frames_(0)
+      , draw_calls_(0)
+      , visible_chunks_(0)
+      , ranges_(0)
+   {
+   }
+
+   streaming_statistics::streaming_statistics()
+      : frames_(0)
+      , hitches_(0)
+      , textures_(0)
+      , bytes_(0)
+      , total_ms_(0.0)
+      , max_ms_(0.0)
+      , finished_(false)
+   {
+   }
+
+   capture_statistics::capture_statistics()
+      : frames_(0)
+      , total_ms_(0.0)
+      , max_ms_(0.0)
+   {
+   }
+
    // note: derived application class
-   testbed::testbed() : rotation_(0.0f), controller_(camera_, keyboard_, mouse_)
+   testbed::testbed() 
+      : rotation_(0.0f)
+      , controller_(camera_, keyboard_, mouse_)
+      , path_(camera_)
+      , grid_topology_(GRID_TOPOLOGY_STRIPS)
+      , grid_short_indices_(true)
+      , scene_layout_(SCENE_LAYOUT_FIELD)
+      , batching_(true)
+      , batching_requested_(false)
+      , batching_overridden_(false)
+      , texture_streaming_(TEXTURE_STREAMING_OFF)
+      , streamed_next_(0)
+      , frame_capture_(FRAME_CAPTURE_OFF)
+      , draw_calls_(0)
+      , occlusion_mode_(OCCLUSION_MODE_SOFTWARE)
+      , frustum_culled_(0)
+      , overdraw_(0.0)
+      , light_count_(512)
+      , graph_(pool_)
+      , scene_color_(INVALID_RENDER_RESOURCE)
+      , scene_depth_(INVALID_RENDER_RESOURCE)
+      , scene_output_(INVALID_RENDER_RESOURCE)
+      , gbuffer_albedo_(INVALID_RENDER_RESOURCE)
+      , gbuffer_normal_(INVALID_RENDER_RESOURCE)
+      , shading_path_(SHADING_PATH_FORWARD)
+      , msaa_samples_(1)
+      , show_profiler_(true)
+      , measures_(MEASURE_DEFAULT)
    {
    }
+
+   // note: --msaa N            scene samples per pixel (1, 2, 4 or 8)
+   //       --gpu-budget MS     scale the scene resolution to keep gpu time under MS, 0 disables
+   //       --resolution-scale S  scene resolution relative to the backbuffer, start value with a budget
+   //       --occlusion MODE    none, software (default), hardware or both
+   //       --depth-prepass on|off  lay down depth before the shaded passes (default off)
+   //       --opaque-sort on|off    draw props front to back (default on)
+   //       --skybox first|last     draw the skybox before or after the opaque geometry (default last)
+   //       --lights N          point and spot lights in the scene (default 512)
+   //       --shading forward|deferred  shade while drawing or from a g-buffer (default forward)
+   //       --shadow-cache on|off   keep static casters in a cached shadow atlas (default on)
+   //       --scene field|city      props spread over the hills or packed into city blocks (default field)
+   //       --batching on|off       merge the static props into batches at load time (default on, off with hardware occlusion,
+   //                               asking for it together with hardware occlusion is an error)
+   //       --grid strips|triangles  index terrain and sphere as strips with restarts or as triangles (default strips)
+   //       --grid-indices 16|32    index width of the grids, 16-bit ones are drawn in chunks (default 16)
+   //       --texture-streaming off|sync|pbo  stream about 100 MB of textures in while running (default off)
+   //       --capture off|png|raw   write every frame out to the save directory, png or raw rgba (default off)
+   //       --measure LIST      comma separated micro-benchmarks to run with --benchmark: recording, occlusion,
+   //                           lighting, geometry-arena, grid-meshes, program-cache, or all, none and
+   //                           default (all but program-cache)
+   bool testbed::parse_argument(int argc, char **argv, int &index) {
+      const char *argument = argv[index];
+      const auto parse_switch = [&](const char *on, const char *off, bool &value) {
+         const char *option = argv[++index];
+         if (strcmp(option, on) == 0) {
+            value = true;
+         }
+         else if (strcmp(option, off) == 0) {
+            value = false;
+         }
+         else {
+            return false;
+         }
+
+         return true;
+      };
+
+      if (strcmp(argument, "--depth-prepass") == 0 && index + 1 < argc) {
+         return parse_switch("on", "off", opaque_settings_.depth_prepass_);
+      }
+      else if (strcmp(argument, "--opaque-sort") == 0 && index + 1 < argc) {
+         return parse_switch("on", "off", opaque_settings_.front_to_back_);
+      }
+      else if (strcmp(argument, "--skybox") == 0 && index + 1 < argc) {
+         return parse_switch("last", "first", opaque_settings_.skybox_last_);
+      }
+      else if (strcmp(argument, "--shadow-cache") == 0 && index + 1 < argc) {
+         return parse_switch("on", "off", shadows_.caching_);
+      }
+      else if (strcmp(argument, "--batching") == 0 && index + 1 < argc) {
+         batching_requested_ = true;
+         return parse_switch("on", "off", batching_);
+      }
+      else if (strcmp(argument, "--grid") == 0 && index + 1 < argc) {
+         bool strips = true;
+         if (!parse_switch("strips", "triangles", strips)) {
+            return false;
+         }
+
+         grid_topology_ = strips ? GRID_TOPOLOGY_STRIPS : GRID_TOPOLOGY_TRIANGLES;
+         return true;
+      }
+      else if (strcmp(argument, "--grid-indices") == 0 && index + 1 < argc) {
+         return parse_switch("16", "32", grid_short_indices_);
+      }
+      else if (strcmp(argument, "--texture-streaming") == 0 && index + 1 < argc) {
+         const char *mode = argv[++index];
+         if (strcmp(mode, "off") == 0) {
+            texture_streaming_ = TEXTURE_STREAMING_OFF;
+         }
+         else if (strcmp(mode, "sync") == 0) {
+            texture_streaming_ = TEXTURE_STREAMING_SYNC;
+         }
+         else if (strcmp(mode, "pbo") == 0) {
+            texture_streaming_ = TEXTURE_STREAMING_PBO;
+         }
+         else {
+            return false;
+         }
+
+         return true;
+      }
+      else if (strcmp(argument, "--capture") == 0 && index + 1 < argc) {
+         const char *mode = argv[++index];
+         if (strcmp(mode, "off") == 0) {
+            frame_capture_ = FRAME_CAPTURE_OFF;
+         }
+         else if (strcmp(mode, "png") == 0) {
+            frame_capture_ = FRAME_CAPTURE_PNG;
+         }
+         else if (strcmp(mode, "raw") == 0) {
+            frame_capture_ = FRAME_CAPTURE_RAW;
+         }
+         else {
+            return false;
+         }
+
+         return true;
+      }
+      else if (strcmp(argument, "--scene") == 0 && index + 1 < argc) {
+         bool city = false;
+         if (!parse_switch("city", "field", city)) {
+            return false;
+         }
+
+         scene_layout_ = city ? SCENE_LAYOUT_CITY : SCENE_LAYOUT_FIELD;
+         return true;
+      }
+      else if (strcmp(argument, "--occlusion") == 0 && index + 1 < argc) {
+         const char *mode = argv[++index];
+         if (strcmp(mode, "none") == 0) {
+            occlusion_mode_ = OCCLUSION_MODE_NONE;
+         }
+         else if (strcmp(mode, "software") == 0) {
+            occlusion_mode_ = OCCLUSION_MODE_SOFTWARE;
+         }
+         else if (strcmp(mode, "hardware") == 0) {
+            occlusion_mode_ = OCCLUSION_MODE_HARDWARE;
+         }
+         else if (strcmp(mode, "both") == 0) {
+            occlusion_mode_ = OCCLUSION_MODE_BOTH;
+         }
+         else {
+            return false;
+         }
+
+         return true;
+      }
+
+      else if (strcmp(argument, "--shading") == 0 && index + 1 < argc) {
+         bool deferred = false;
+         if (!parse_switch("deferred", "forward", deferred)) {
+            return false;
+         }
+
+         shading_path_ = deferred ? SHADING_PATH_DEFERRED : SHADING_PATH_FORWARD;
+         return true;
+      }
+      else if (strcmp(argument, "--measure") == 0 && index + 1 < argc) {
+         static const struct {
+            const char *name_;
+            uint32 flags_;
+         } names[] =
+         {
+            { "none",           MEASURE_NONE },
+            { "default",        MEASURE_DEFAULT },
+            { "all",            MEASURE_ALL },
+            { "recording",      MEASURE_RECORDING },
+            { "occlusion",      MEASURE_OCCLUSION },
+            { "lighting",       MEASURE_LIGHTING },
+            { "geometry-arena", MEASURE_GEOMETRY_ARENA },
+            { "grid-meshes",    MEASURE_GRID_MESHES },
+            { "program-cache",  MEASURE_PROGRAM_CACHE },
+         };
+
+         measures_ = MEASURE_NONE;
+         const string list = argv[++index];
+         size_t start = 0;
+         while (start <= list.size()) {
+            size_t end = list.find(',', start);
+            if (end == string::npos) {
+               end = list.size();
+            }
+
+            const string name = list.substr(start, end - start);
+            bool found = false;
+            for (auto &entry : names) {
+               if (name == entry.name_) {
+                  measures_ |= entry.flags_;
+                  found = true;
+               }
+            }
+
+            if (!found) {
+               return false;
+            }
+
+            start = end + 1;
+         }
+
+         return true;
+      }
+      else if (strcmp(argument, "--lights") == 0 && index + 1 < argc) {
+         char *end = nullptr;
+         const long count = strtol(argv[++index], &end, 10);
+         if (*end != '\0' || count < 0 || count > (long)light_clusters::MAX_LIGHTS) {
+            return false;
+         }
+
+         light_count_ = (uint32)count;
+         return true;
+      }
+      else if (strcmp(argument, "--msaa") == 0 && index + 1 < argc) {
+         char *end = nullptr;
+         const long samples = strtol(argv[++index], &end, 10);
+         if (*end != '\0' || (samples != 1 && samples != 2 && samples != 4 && samples != 8)) {
+            return false;
+         }
+
+         msaa_samples_ = (uint32)samples;
+         return true;
+      }
+      else if (strcmp(argument, "--gpu-budget") == 0 && index + 1 < argc) {
+         char *end = nullptr;
+         const double milliseconds = strtod(argv[++index], &end);
+         if (*end != '\0' || milliseconds < 0.0) {
+            return false;
+         }
+
+         resolution_.set_target(time::from_seconds(milliseconds / 1000.0));
+         return true;
+      }
+      else if (strcmp(argument, "--resolution-scale") == 0 && index + 1 < argc) {
+         char *end = nullptr;
+         const double scale = strtod(argv[++index], &end);
+         if (*end != '\0' || scale <= 0.0 || scale > 1.0) {
+            return false;
+         }
+
+         resolution_.scale_ = (float)scale;
+         resolution_.set_limits(resolution_.min_scale_, resolution_.max_scale_);
+         return true;
+      }
+
+      return false;
+   }
    
    bool testbed::enter() 
    {
@@ -135,12 +515,15 @@ namespace neon {
 		  {0.0f, 1.0f, 1.0f, 0xff00ffff,		0.0f, 1.0}, //3
 	   };
 	   
+	   // note: a missing or unwritable cache directory only costs us the binary cache
+	   cache_.binaries_.create(file_system::get_save_directory("neon") + "shader_cache/");
+
 	   if (!vbo_.create(sizeof(vertices), vertices))
 	   {
 		   return false;
 	   }
 
-	   if (!program_.create("assets/vertex_shader.txt", "assets/fragment_shader.txt"))
+	   if (!cache_.acquire_program("assets/vertex_shader.txt", "assets/fragment_shader.txt", program_))
 	   {
 		   return false;
 	   }
@@ -150,12 +533,12 @@ namespace neon {
 	   format_.add_attribute(2, 2, GL_FLOAT, false);
 
 	   // Create texture
-	   if (!texture_.create("assets/test.png")) {
+	   if (!cache_.acquire_texture("assets/test.png", true, texture_)) {
 		   return false;
 	   }
 
 	   // Create sampler
-	   if (!sampler_.create(GL_NEAREST, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)) {
+	   if (!cache_.acquire_sampler(GL_NEAREST, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, sampler_)) {
 		   return false;
 	   }
 
@@ -179,50 +562,415 @@ namespace neon {
 	   };
 
 	   // Create text font
-	   if (!font_.create()) {
+	   if (!font_.create(cache_)) {
 		   return false;
 	   };
 
-	   if (!skybox_.create()) {
+	   if (!skybox_.create(cache_)) {
 		   return false;
 	   };
 
-	   if (!terrain_.create("assets/heightmap/heightmap.png", "assets/heightmap/texture.png")) {
+	   if (!terrain_.create(cache_, arena_, "assets/heightmap/heightmap.png", "assets/heightmap/texture.png", grid_topology_, grid_short_indices_)) {
 		   return false;
 	   }
 
-		if (!sphere_.create("assets/sphere/earth.jpg", 10, 36, 36)) {
+		if (!sphere_.create(cache_, arena_, "assets/sphere/earth.jpg", 10, 36, 36, grid_topology_, grid_short_indices_)) {
 	 	   return false;
 	    }
 
-		if (!model_.create_from_file("assets/model/Chest.FBX", "assets/model/vertex_shader.txt", "assets/model/fragment_shader.txt", "assets/model/diffuse.png")) {
+		if (!model_.create_from_file(cache_, arena_, "assets/model/Chest.FBX", "assets/lit/vertex_shader.shader", "assets/lit/fragment_shader.shader", "assets/model/diffuse.png", SHADER_FEATURE_TEXCOORD | SHADER_FEATURE_LIGHTS)) {
 			return false;
 		}
 
 		model_matrix_ = glm::translate(glm::mat4(1), glm::vec3(0, 0, -20.0f));
 		model_matrix_ = glm::scale(model_matrix_, glm::vec3(0.1f));
 
+		// note: bounds of the model in its own space, a unit sphere when there are no vertices
+		model_bounds_ = bounding_sphere(glm::vec3(0.0f), 1.0f);
+		if (model_.bounds_max_ != model_.bounds_min_) {
+			model_bounds_.set_center((model_.bounds_min_ + model_.bounds_max_) * 0.5f);
+			model_bounds_.set_radius(glm::length(model_.bounds_max_ - model_.bounds_min_) * 0.5f);
+		}
+
+		// note: a field of props on the terrain, the hills hide most of them from the fly-through.
+		//       the city packs four times as many per row and stretches them into blocks
+		const bool city = scene_layout_ == SCENE_LAYOUT_CITY;
+		const float PROP_SPACING = city ? 4.0f : 16.0f;
+		const float PROP_SCALE = 0.1f;
+		uint32 block = 0;
+		for (float z = PROP_SPACING * 0.5f; z < (float)terrain_.depth_; z += PROP_SPACING) {
+			for (float x = PROP_SPACING * 0.5f; x < (float)terrain_.width_; x += PROP_SPACING) {
+				const float height = city ? 1.0f + (float)((block++ * 7919u) % 5u) : 1.0f;
+				glm::mat4 world = glm::translate(glm::mat4(1), glm::vec3(x, terrain_.height_at(x, z), z));
+				world = glm::scale(world, glm::vec3(PROP_SCALE, PROP_SCALE * height, PROP_SCALE));
+
+				props_.push_back(world);
+				prop_bounds_.push_back(bounding_sphere(glm::vec3(world * glm::vec4(model_bounds_.center_, 1.0f)), model_bounds_.radius_ * PROP_SCALE * height));
+			}
+		}
+		visible_props_.reserve(props_.size());
+
+		// note: hardware queries test every prop on its own, merged chunks would leave them nothing to
+		//       test. batching on by default gives way and the report says so, asking for both fails
+		if (batching_ && (occlusion_mode_ == OCCLUSION_MODE_HARDWARE || occlusion_mode_ == OCCLUSION_MODE_BOTH)) {
+			if (batching_requested_) {
+				fprintf(stderr, "error: --batching on cannot be combined with --occlusion hardware|both\n");
+				return false;
+			}
+
+			fprintf(stderr, "warning: --occlusion hardware|both needs per-prop queries, static batching is turned off\n");
+			batching_ = false;
+			batching_overridden_ = true;
+		}
+
+		// note: the props never move and share the material of the model, they end up in
+		//       a single group that is culled and drawn per chunk from here on
+		if (batching_) {
+			const batch_source source = model_.as_batch_source();
+			for (auto &world : props_) {
+				batches_.add(source, world);
+			}
+
+			if (!batches_.build()) {
+				return false;
+			}
+		}
+
+		// note: props circling the model, the only shadow casters that move
+		const uint32 DYNAMIC_PROP_COUNT = 8;
+		dynamic_props_.resize(DYNAMIC_PROP_COUNT);
+		dynamic_bounds_.resize(DYNAMIC_PROP_COUNT);
+		visible_dynamic_.reserve(DYNAMIC_PROP_COUNT);
+		update_dynamic_props();
+
+		terrain_.build_occluder(8, occluder_positions_, occluder_indices_);
+
+		if (!occlusion_queries_.create(cache_, (uint32)props_.size())) {
+			return false;
+		}
+
+		if (!clusters_.create()) {
+			return false;
+		}
+
+		if (!deferred_.create(cache_)) {
+			return false;
+		}
+
+		// note: the sun comes in at an angle, the bounds cover the terrain, the model and the camera path
+		if (!shadows_.create()) {
+			return false;
+		}
+		shadows_.set_direction(glm::vec3(0.4f, -1.0f, 0.3f));
+		shadows_.set_scene_bounds(glm::vec3(-64.0f, -1.0f, -64.0f), glm::vec3((float)terrain_.width_, 16.0f, (float)terrain_.depth_));
+		create_lights(light_count_, lights_);
+
 	   camera_.set_perspective(45.0f, 16.0f / 9.0f, 0.5f, 100.0f);
+	   camera_.update();
+	   previous_camera_ = camera_;
+	   render_camera_ = camera_;
+
+	   // note: benchmark fly-through, circles the model and sweeps across the terrain.
+	   //       over the city it circles the blocks and looks down into them instead
+	   if (scene_layout_ == SCENE_LAYOUT_CITY) {
+		   path_.add_keyframe(0.0f, glm::vec3(128.0f, 20.0f, 28.0f), glm::radians(-180.0f), -0.25f);
+		   path_.add_keyframe(4.0f, glm::vec3(28.0f, 20.0f, 128.0f), glm::radians(-90.0f), -0.25f);
+		   path_.add_keyframe(8.0f, glm::vec3(128.0f, 20.0f, 228.0f), glm::radians(0.0f), -0.25f);
+		   path_.add_keyframe(12.0f, glm::vec3(228.0f, 20.0f, 128.0f), glm::radians(90.0f), -0.25f);
+		   path_.add_keyframe(16.0f, glm::vec3(128.0f, 20.0f, 28.0f), glm::radians(180.0f), -0.25f);
+	   }
+	   else {
+		   path_.add_keyframe(0.0f, glm::vec3(0.0f, 2.0f, 0.0f), 0.0f, 0.0f);
+		   path_.add_keyframe(4.0f, glm::vec3(15.0f, 4.0f, -20.0f), glm::radians(90.0f), -0.1f);
+		   path_.add_keyframe(8.0f, glm::vec3(0.0f, 6.0f, -40.0f), glm::radians(180.0f), -0.2f);
+		   path_.add_keyframe(12.0f, glm::vec3(-15.0f, 4.0f, -20.0f), glm::radians(270.0f), -0.1f);
+		   path_.add_keyframe(16.0f, glm::vec3(0.0f, 2.0f, 0.0f), glm::radians(360.0f), 0.0f);
+	   }
+
+	   // note: the scene renders at a scaled internal resolution and is stretched when presented,
+	   //       multisampled scenes are resolved into a single sampled attachment first. the
+	   //       deferred path never multisamples, the g-buffer would have to be shaded per sample
+	   const bool deferred = shading_path_ == SHADING_PATH_DEFERRED;
+	   if (deferred) {
+		   msaa_samples_ = 1;
+	   }
+
+	   int32 scene_width = 0, scene_height = 0;
+	   graph_.set_backbuffer_size(1280, 720);
+	   resolution_.apply(1280, 720, scene_width, scene_height);
+	   scene_color_ = graph_.create_attachment("scene_color", scene_width, scene_height, FRAMEBUFFER_FORMAT_RGBA8, msaa_samples_);
+	   scene_depth_ = graph_.create_attachment("scene_depth", scene_width, scene_height, FRAMEBUFFER_FORMAT_D32, msaa_samples_);
+	   if (deferred) {
+		   gbuffer_albedo_ = graph_.create_attachment("gbuffer_albedo", scene_width, scene_height, FRAMEBUFFER_FORMAT_RGBA8);
+		   gbuffer_normal_ = graph_.create_attachment("gbuffer_normal", scene_width, scene_height, FRAMEBUFFER_FORMAT_RGB10A2);
+	   }
+
+	   // note: draws into the atlas of the cascades, outside the graph. it goes first since nothing
+	   //       orders it before the scene, passes without dependencies keep the order they were added in
+	   const uint32 shadows = graph_.add_pass("shadows", [this](const render_graph &) {
+		   shadows_.execute();
+	   });
+	   graph_.set_side_effect(shadows);
+
+	   const uint32 scene = graph_.add_pass(deferred ? "gbuffer" : "scene", [this](const render_graph &) {
+		   // note: gl calls stay on this thread, buffers are replayed in task order.
+		   //       the queries task is not counted, its own occlusion queries are active then
+		   const auto submit = [this](render_task task) {
+			   gpu_profiler_.push(render_task_name(task));
+			   if (task != RENDER_TASK_QUERIES) {
+				   fragment_counter_.begin(task);
+			   }
+			   commands_[task].submit();
+			   fragment_counter_.end();
+			   gpu_profiler_.pop();
+		   };
+
+		   if (!opaque_settings_.skybox_last_) {
+			   submit(RENDER_TASK_SKYBOX);
+		   }
+
+		   for (uint32 index = 0; index < RENDER_TASK_COUNT; index++) {
+			   if (index != RENDER_TASK_SKYBOX || opaque_settings_.skybox_last_) {
+				   submit((render_task)index);
+			   }
+		   }
+	   });
+	   if (deferred) {
+		   graph_.write(scene, gbuffer_albedo_);
+		   graph_.write(scene, gbuffer_normal_);
+		   graph_.write(scene, scene_depth_);
+
+		   const uint32 lighting = graph_.add_pass("lighting", [this](const render_graph &graph) {
+			   graph.bind_texture(gbuffer_albedo_, deferred_lighting::ALBEDO_SLOT);
+			   graph.bind_texture(gbuffer_normal_, deferred_lighting::NORMAL_SLOT);
+			   graph.bind_texture(scene_depth_, deferred_lighting::DEPTH_SLOT);
+			   lighting_commands_.submit();
+		   });
+		   graph_.read(lighting, gbuffer_albedo_);
+		   graph_.read(lighting, gbuffer_normal_);
+		   graph_.read(lighting, scene_depth_);
+		   graph_.write(lighting, scene_color_);
+	   }
+	   else {
+		   graph_.write(scene, scene_color_);
+		   graph_.write(scene, scene_depth_);
+	   }
 
-	   framebuffer_format formats[] = { FRAMEBUFFER_FORMAT_RGBA8 };
+	   scene_output_ = msaa_samples_ > 1 ? graph_.resolve("scene_resolved", scene_color_) : scene_color_;
+	   graph_.present(scene_output_);
 
-	   if (!framebuffer_.create(240, 132, _countof(formats), formats, FRAMEBUFFER_FORMAT_D32)) {
+	   const uint32 overlay = graph_.add_pass("overlay", [this](const render_graph &) {
+		   overlay_commands_.submit();
+	   });
+	   graph_.write(overlay, graph_.backbuffer());
+
+	   if (!graph_.compile()) {
 		   return false;
 	   }
 
+	   if (!workers_.create(thread_pool::default_worker_count())) {
+		   return false;
+	   }
+
+	   // note: without timer queries the resolution simply stays where it started
+	   if (!gpu_timer_.create()) {
+		   resolution_.set_target(time());
+	   }
+
+	   if (gpu_profiler_.create()) {
+		   graph_.set_gpu_profiler(&gpu_profiler_);
+	   }
+
+	   // note: only costs us the fragment metrics
+	   fragment_counter_.create();
+
+	   // note: the streamed textures are only loaded, nothing draws with them
+	   if (texture_streaming_ != TEXTURE_STREAMING_OFF) {
+		   streamed_textures_.resize(STREAMED_FILE_COUNT * STREAMED_ROUNDS);
+		   if (texture_streaming_ == TEXTURE_STREAMING_PBO && !streamer_.create()) {
+			   return false;
+		   }
+	   }
+
+	   // note: encoding a frame can take longer than rendering one, two workers share the load
+	   if (frame_capture_ != FRAME_CAPTURE_OFF) {
+		   capture_directory_ = file_system::get_save_directory("neon") + "capture/";
+		   if (!file_system::create_directory(capture_directory_) || !readback_.create(2)) {
+			   return false;
+		   }
+	   }
+
+	   if (benchmark_.is_enabled()) {
+		   benchmark_.add_metric("render_graph_transient_bytes", (double)graph_.statistics_.transient_bytes_);
+		   benchmark_.add_metric("render_graph_requested_bytes", (double)graph_.statistics_.requested_bytes_);
+		   benchmark_.add_metric("batching", batching_ ? 1.0 : 0.0);
+		   benchmark_.add_metric("batching_overridden", batching_overridden_ ? 1.0 : 0.0);
+
+		   // note: how this start went, cold or warm depends on what the previous run left on disk
+		   const program_binary_cache::statistics &binaries = cache_.binaries_.statistics_;
+		   benchmark_.add_metric("program_cache_enabled", cache_.binaries_.is_enabled() ? 1.0 : 0.0);
+		   benchmark_.add_metric("program_cache_hits", binaries.hits_);
+		   benchmark_.add_metric("program_cache_misses", binaries.misses_);
+		   benchmark_.add_metric("program_cache_rejected", binaries.rejected_);
+		   benchmark_.add_metric("program_cache_load_ms", binaries.load_time_.as_milliseconds());
+		   benchmark_.add_metric("program_cache_compile_ms", binaries.compile_time_.as_milliseconds());
+
+		   if (measures_ & MEASURE_RECORDING) {
+			   measure_recording();
+		   }
+		   if (measures_ & MEASURE_OCCLUSION) {
+			   measure_occlusion();
+		   }
+		   if (measures_ & MEASURE_LIGHTING) {
+			   measure_lighting();
+		   }
+		   if (measures_ & MEASURE_GEOMETRY_ARENA) {
+			   measure_geometry_arena();
+		   }
+		   if (measures_ & MEASURE_GRID_MESHES) {
+			   measure_grid_meshes();
+		   }
+		   if (measures_ & MEASURE_PROGRAM_CACHE) {
+			   measure_program_cache();
+		   }
+
+		   const geometry_arena::statistics &arena = arena_.statistics_;
+		   benchmark_.add_metric("geometry_arenas", arena.arenas_);
+		   benchmark_.add_metric("geometry_allocations", arena.allocations_);
+		   benchmark_.add_metric("geometry_capacity_bytes", (double)arena.capacity_bytes_);
+		   benchmark_.add_metric("geometry_used_bytes", (double)arena.used_bytes_);
+		   benchmark_.add_metric("geometry_utilization", arena.utilization_);
+		   benchmark_.add_metric("geometry_fragmentation", arena.fragmentation_);
+
+		   benchmark_.add_metric("grid_strips", grid_topology_ == GRID_TOPOLOGY_STRIPS ? 1.0 : 0.0);
+		   benchmark_.add_metric("grid_short_indices", grid_short_indices_ ? 1.0 : 0.0);
+		   benchmark_.add_metric("terrain_index_bytes", (double)terrain_.grid_.index_bytes());
+		   benchmark_.add_metric("terrain_index_chunks", (double)terrain_.grid_.chunks_.size());
+		   benchmark_.add_metric("sphere_index_bytes", (double)sphere_.grid_.index_bytes());
+	   }
+
       return true;
    }
 
    void testbed::exit() {
+      workers_.destroy();
+      streamer_.destroy();
+      if (readback_.is_valid()) {
+         readback_.finish();
+         readback_.destroy();
+      }
+      for (auto &streamed : streamed_textures_) {
+         streamed.destroy();
+      }
+      streamed_textures_.clear();
+      gpu_timer_.destroy();
+      gpu_profiler_.destroy();
+      fragment_counter_.destroy();
+      clusters_.destroy();
+      deferred_.destroy(cache_);
+      shadows_.destroy();
+      batches_.destroy();
+      occlusion_queries_.destroy(cache_);
+      graph_.destroy();
+      pool_.destroy();
+      model_.destroy(cache_);
+      sphere_.destroy(cache_);
+      terrain_.destroy(cache_);
+      arena_.destroy();
+      skybox_.destroy(cache_);
+      font_.destroy(cache_);
+
+      cache_.release(program_);
+      cache_.release(texture_);
+      cache_.release(sampler_);
+      vbo_.destroy();
+
+      cache_.destroy();
    }
 
-   bool testbed::tick(const time &dt) {
+   bool testbed::update(const time &dt) {
       if (keyboard_.is_pressed(KEYCODE_ESCAPE)) {
          return false;
       }
 
+	  // note: F1 toggles the profiler summary, F2 saves a chrome://tracing capture
+	  if (keyboard_.is_pressed(KEYCODE_F1)) {
+		  show_profiler_ = !show_profiler_;
+	  }
+
+	  if (keyboard_.is_pressed(KEYCODE_F2)) {
+		  profiler::write_chrome_trace(file_system::get_save_directory("neon") + "trace.json");
+	  }
+
 	  // Update camera
-	  controller_.update(dt);
+	  benchmark_.begin(BENCHMARK_SECTION_UPDATE);
+	  {
+		  NEON_PROFILE_SCOPE("testbed::update");
+
+		  // note: keep the last state around, render interpolates between the two
+		  previous_camera_ = camera_;
+		  if (benchmark_.is_enabled()) {
+			  path_.update(dt);
+		  }
+		  else {
+			  controller_.update(dt);
+		  }
+
+		  rotation_ += (float)dt.as_seconds() * 0.5f;
+		  update_dynamic_props();
+	  }
+	  benchmark_.end(BENCHMARK_SECTION_UPDATE);
+
+	  return true;
+   }
+
+   void testbed::render(const double alpha) {
+	  render_camera_.interpolate(previous_camera_, camera_, (float)alpha);
+
+	  window::display_mode mode;
+	  if (window::get_display_mode(mode)) {
+		  graph_.set_backbuffer_size(mode.width_, mode.height_);
+	  }
+
+	  // note: the scene follows the backbuffer and the current resolution scale,
+	  //       the pool keeps the old framebuffers around until they age out
+	  int32 scene_width = 0, scene_height = 0;
+	  resolution_.apply(graph_.backbuffer_width_, graph_.backbuffer_height_, scene_width, scene_height);
+	  const render_graph::resource &scene = graph_.resources_[scene_color_];
+	  if (scene.width_ != scene_width || scene.height_ != scene_height) {
+		  graph_.set_attachment_size(scene_color_, scene_width, scene_height);
+		  graph_.set_attachment_size(scene_depth_, scene_width, scene_height);
+		  if (shading_path_ == SHADING_PATH_DEFERRED) {
+			  graph_.set_attachment_size(gbuffer_albedo_, scene_width, scene_height);
+			  graph_.set_attachment_size(gbuffer_normal_, scene_width, scene_height);
+		  }
+		  if (scene_output_ != scene_color_) {
+			  graph_.set_attachment_size(scene_output_, scene_width, scene_height);
+		  }
+	  }
+
+	  stream_textures();
+
+	  benchmark_.begin(BENCHMARK_SECTION_CULL);
+	  cull();
+	  clusters_.set_viewport(scene_width, scene_height);
+	  clusters_.assign(render_camera_, lights_.data(), (uint32)lights_.size(), workers_);
+	  shadows_.update(render_camera_);
+	  benchmark_.end(BENCHMARK_SECTION_CULL);
+
+	  clusters_.upload();
+	  benchmark_.add_timing("light_assignment", clusters_.statistics_.assign_time_.as_milliseconds());
+	  if (benchmark_.is_measuring()) {
+		  const light_clusters::statistics &statistics = clusters_.statistics_;
+		  lighting_statistics_.frames_++;
+		  lighting_statistics_.visible_ += statistics.visible_;
+		  lighting_statistics_.references_ += statistics.references_;
+		  lighting_statistics_.max_per_cluster_ = glm::max(lighting_statistics_.max_per_cluster_, statistics.max_per_cluster_);
+		  lighting_statistics_.overflow_ += statistics.overflow_;
+	  }
+
+	  benchmark_.begin(BENCHMARK_SECTION_SUBMIT);
+	  NEON_PROFILE_SCOPE("testbed::submit");
 
 	  // rotation
 	  //rotation_ += dt.as_seconds();
@@ -231,23 +979,159 @@ namespace neon {
 
 	  //  world = glm::rotate(world, rotation_, glm::vec3(0.0f, 1.0f, 0.0f));
 
-	  framebuffer_.bind();
-	  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-	  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	  char text[128] = {};
+	  snprintf(text, sizeof(text), "frame: %.3f ms  latency: %.2f ms (avg %.2f, max %.2f)  missed: %u",
+			   pacer_.statistics_.frame_time_.as_milliseconds(),
+			   pacer_.statistics_.latency_.as_milliseconds(),
+			   pacer_.statistics_.average_latency_.as_milliseconds(),
+			   pacer_.statistics_.max_latency_.as_milliseconds(),
+			   pacer_.statistics_.missed_deadlines_);
+	  font_.render_text(2.0f, 2.0f, text);
 
-	  // clear
-	  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	  if (show_profiler_) {
+		  // note: summary of the previous frame, this one is still running
+		  profiler::summarize(profile_);
 
-	  string text = "dt: " + std::to_string(dt.as_seconds());
-	  font_.render_text(2.0f, 2.0f, text);
+		  char line[128] = {};
+		  snprintf(line, sizeof(line), "render graph: %u passes (%u culled)  %u targets  %.1f KiB transient (%.1f KiB requested)",
+				   graph_.statistics_.pass_count_,
+				   graph_.statistics_.culled_pass_count_,
+				   graph_.statistics_.target_count_,
+				   graph_.statistics_.transient_bytes_ / 1024.0,
+				   graph_.statistics_.requested_bytes_ / 1024.0);
+		  font_.render_text(2.0f, 14.0f, line);
+
+		  snprintf(line, sizeof(line), "framebuffer pool: %u live (%.1f KiB)  %u allocations  %u reuses  %u evictions",
+				   pool_.statistics_.live_count_,
+				   pool_.statistics_.live_bytes_ / 1024.0,
+				   pool_.statistics_.allocations_,
+				   pool_.statistics_.reuses_,
+				   pool_.statistics_.evictions_);
+		  font_.render_text(2.0f, 26.0f, line);
+
+		  const render_graph::resource &scene = graph_.resources_[scene_color_];
+		  snprintf(line, sizeof(line), "scene: %dx%d (%.0f%%) msaa %ux  gpu: %.2f ms (budget %.2f ms)  %u resizes",
+				   scene.width_,
+				   scene.height_,
+				   resolution_.scale_ * 100.0f,
+				   msaa_samples_,
+				   gpu_time_.as_milliseconds(),
+				   resolution_.target_.as_milliseconds(),
+				   resolution_.changes_);
+		  font_.render_text(2.0f, 38.0f, line);
+
+		  snprintf(line, sizeof(line), "culling: %u/%u props visible  %u outside  %u occluded  %u/%u occluder tris  %.2f ms raster",
+				   (uint32)visible_props_.size(),
+				   (uint32)props_.size(),
+				   frustum_culled_,
+				   occlusion_.statistics_.culled_,
+				   occlusion_.statistics_.rasterized_triangles_,
+				   occlusion_.statistics_.occluder_triangles_,
+				   occlusion_.statistics_.raster_time_.as_milliseconds());
+		  font_.render_text(2.0f, 50.0f, line);
+
+		  snprintf(line, sizeof(line), "queries: %u issued  %u results  %u draws saved  %u conditional  %.3f ms readback",
+				   occlusion_queries_.statistics_.queries_,
+				   occlusion_queries_.statistics_.results_,
+				   occlusion_queries_.statistics_.skipped_draws_,
+				   occlusion_queries_.statistics_.conditional_draws_,
+				   occlusion_queries_.statistics_.readback_time_.as_milliseconds());
+		  font_.render_text(2.0f, 62.0f, line);
+
+		  snprintf(line, sizeof(line), "opaque: %s  prepass %s  front-to-back %s  skybox %s  overdraw %.2fx",
+				   shading_path_ == SHADING_PATH_DEFERRED ? "deferred" : "forward",
+				   opaque_settings_.depth_prepass_ ? "on" : "off",
+				   opaque_settings_.front_to_back_ ? "on" : "off",
+				   opaque_settings_.skybox_last_ ? "last" : "first",
+				   overdraw_);
+		  font_.render_text(2.0f, 74.0f, line);
+
+		  snprintf(line, sizeof(line), "lights: %u/%u visible  %u references  max %u per cluster  %.3f ms assign  %.3f ms upload",
+				   clusters_.statistics_.visible_,
+				   clusters_.statistics_.lights_,
+				   clusters_.statistics_.references_,
+				   clusters_.statistics_.max_per_cluster_,
+				   clusters_.statistics_.assign_time_.as_milliseconds(),
+				   clusters_.statistics_.upload_time_.as_milliseconds());
+		  font_.render_text(2.0f, 86.0f, line);
+
+		  snprintf(line, sizeof(line), "shadows: cache %s  %u/%u cascades redrawn  %u copied  %u static  %u dynamic casters  %.3f ms",
+				   shadows_.caching_ ? "on" : "off",
+				   shadows_.statistics_.static_updates_,
+				   shadow_cascades::CASCADE_COUNT,
+				   shadows_.statistics_.tile_copies_,
+				   shadows_.statistics_.static_casters_,
+				   shadows_.statistics_.dynamic_casters_,
+				   shadows_.statistics_.execute_time_.as_milliseconds());
+		  font_.render_text(2.0f, 98.0f, line);
+
+		  snprintf(line, sizeof(line), "geometry: %u arenas  %u allocations  %.1f/%.1f MiB (%.0f%%)  %u free blocks  %.0f%% fragmented",
+				   arena_.statistics_.arenas_,
+				   arena_.statistics_.allocations_,
+				   arena_.statistics_.used_bytes_ / (1024.0 * 1024.0),
+				   arena_.statistics_.capacity_bytes_ / (1024.0 * 1024.0),
+				   arena_.statistics_.utilization_ * 100.0f,
+				   arena_.statistics_.free_blocks_,
+				   arena_.statistics_.fragmentation_ * 100.0f);
+		  font_.render_text(2.0f, 122.0f, line);
+
+		  snprintf(line, sizeof(line), "batching: %s  %u draw calls  %u/%u chunks in %u ranges  %u groups  %.1f MiB",
+				   batches_.is_valid() ? "on" : "off",
+				   draw_calls_,
+				   batches_.statistics_.visible_chunks_,
+				   batches_.statistics_.chunks_,
+				   batches_.statistics_.ranges_,
+				   batches_.statistics_.groups_,
+				   (batches_.statistics_.vertex_bytes_ + batches_.statistics_.index_bytes_) / (1024.0 * 1024.0));
+		  font_.render_text(2.0f, 110.0f, line);
+
+		  float y = 134.0f;
+		  for (auto &zone : profile_) {
+			  snprintf(line, sizeof(line), "%*s%-*s %7.3f ms %3u",
+					   (int)zone.depth_ * 2, "",
+					   32 - (int)zone.depth_ * 2, zone.name_,
+					   zone.milliseconds_,
+					   zone.count_);
+			  font_.render_text(2.0f, y, line);
+			  y += 10.0f;
+		  }
+
+		  // note: gpu times trail a few frames behind, they are read back without waiting
+		  y += 10.0f;
+		  for (auto &scope : gpu_profile_) {
+			  snprintf(line, sizeof(line), "%*sgpu %-*s %7.3f ms",
+					   (int)scope.depth_ * 2, "",
+					   28 - (int)scope.depth_ * 2, scope.name_,
+					   scope.elapsed_.as_milliseconds());
+			  font_.render_text(2.0f, y, line);
+			  y += 10.0f;
+		  }
+		  if (gpu_profiler_.serialized_) {
+			  font_.render_text(2.0f, y, "gpu scopes serialized with glFinish, the driver bins passes");
+			  y += 10.0f;
+		  }
+	  }
 
-	  skybox_.render(camera_);
-	  model_.render(camera_, model_matrix_);
+	  {
+		  NEON_PROFILE_SCOPE("testbed::record");
+		  workers_.parallel_for(RENDER_TASK_COUNT, [this](uint32 index, uint32) {
+			  commands_[index].reset();
+			  record((render_task)index, commands_[index]);
+		  });
 
-	  framebuffer::unbind(1280, 720);
+		  draw_calls_ = 0;
+		  for (auto &commands : commands_) {
+			  draw_calls_ += commands.draw_count();
+		  }
+		  workers_.parallel_for(shadow_cascades::CASCADE_COUNT, [this](uint32 index, uint32) {
+			  record_shadows(index);
+		  });
 
-	  framebuffer_.blit(0, 0, 1280, 720);
+		  lighting_commands_.reset();
+		  if (shading_path_ == SHADING_PATH_DEFERRED) {
+			  deferred_.record(lighting_commands_, render_camera_, clusters_, shadows_, skybox_);
+		  }
+	  }
 
 	//  sphere_.render(camera_);
 
@@ -277,8 +1161,918 @@ namespace neon {
 	  */
 
 	  // Draw text
-	  font_.flush();
+	  overlay_commands_.reset();
+	  font_.flush(overlay_commands_);
 
-      return true;
+	  if (!graph_.compiled_ && !graph_.compile()) {
+		  assert(false);
+		  return;
+	  }
+
+	  pool_.begin_frame();
+	  gpu_timer_.begin();
+	  gpu_profiler_.begin_frame();
+	  fragment_counter_.begin_frame();
+	  graph_.execute();
+	  fragment_counter_.end_frame();
+	  gpu_profiler_.end_frame();
+	  gpu_timer_.end();
+	  capture_frame();
+
+	  benchmark_.add_timing("shadow_pass", shadows_.statistics_.execute_time_.as_milliseconds());
+	  if (benchmark_.is_measuring()) {
+		  batching_statistics_.frames_++;
+		  batching_statistics_.draw_calls_ += draw_calls_;
+		  batching_statistics_.visible_chunks_ += batches_.statistics_.visible_chunks_;
+		  batching_statistics_.ranges_ += batches_.statistics_.ranges_;
+
+		  shadow_statistics_.frames_++;
+		  shadow_statistics_.static_updates_ += shadows_.statistics_.static_updates_;
+		  shadow_statistics_.tile_copies_ += shadows_.statistics_.tile_copies_;
+		  shadow_statistics_.static_casters_ += shadows_.statistics_.static_casters_;
+		  shadow_statistics_.dynamic_casters_ += shadows_.statistics_.dynamic_casters_;
+	  }
+
+	  // note: results arrive a few frames late, the scale change applies to the next frame
+	  time gpu_time;
+	  while (gpu_timer_.read(gpu_time)) {
+		  gpu_time_ = gpu_time;
+		  resolution_.update(gpu_time);
+		  if (benchmark_.is_measuring()) {
+			  gpu_statistics_.add(gpu_time, resolution_.target_, resolution_.scale_);
+		  }
+		  benchmark_.add_timing("gpu_frame", gpu_time.as_milliseconds());
+	  }
+
+	  // note: on binning drivers the scopes nested in a pass read as ~0 ms until the profiler
+	  //       switches to serialized timing, the collapsed frames before that are not reported
+	  while (gpu_profiler_.read()) {
+		  gpu_profile_ = gpu_profiler_.results_;
+		  if (gpu_profiler_.collapsed_) {
+			  continue;
+		  }
+		  for (auto &scope : gpu_profile_) {
+			  benchmark_.add_timing(string("gpu_") + scope.name_, scope.elapsed_.as_milliseconds());
+		  }
+	  }
+
+	  // note: overdraw is every sample the shaded passes wrote over the samples on screen,
+	  //       the scene size is the current one, results are only a few frames old
+	  uint64 samples[fragment_counter::MAX_SLOTS] = {};
+	  while (fragment_counter_.read(samples)) {
+		  const uint64 pixels = (uint64)scene.width_ * scene.height_ * msaa_samples_;
+		  uint64 shaded = 0;
+		  for (uint32 index = 0; index < RENDER_TASK_COUNT; index++) {
+			  if (index != RENDER_TASK_PREPASS) {
+				  shaded += samples[index];
+			  }
+		  }
+		  overdraw_ = pixels > 0 ? (double)shaded / pixels : 0.0;
+
+		  if (benchmark_.is_measuring()) {
+			  fragment_statistics_.frames_++;
+			  fragment_statistics_.pixels_ += pixels;
+			  for (uint32 index = 0; index < RENDER_TASK_COUNT; index++) {
+				  fragment_statistics_.samples_[index] += samples[index];
+			  }
+		  }
+	  }
+
+	  // note: average cpu time per pass over the measured frames, warmup frames are dropped
+	  if (benchmark_.is_measuring()) {
+		  char name[64] = {};
+		  for (auto &pass_index : graph_.order_) {
+			  const render_graph::pass &pass = graph_.passes_[pass_index];
+			  snprintf(name, sizeof(name), "render_pass_%s_cpu_ms", pass.name_);
+			  benchmark_.add_metric(name, pass.total_cpu_time_.as_milliseconds() / pass.executions_);
+		  }
+
+		  benchmark_.add_metric("framebuffer_pool_allocations", pool_.statistics_.allocations_);
+
+		  if (culling_statistics_.tested_ > 0) {
+			  const double tested = (double)culling_statistics_.tested_;
+			  benchmark_.add_metric("culling_props", (double)props_.size());
+			  benchmark_.add_metric("culling_per_chunk", batches_.is_valid() ? 1.0 : 0.0);
+			  benchmark_.add_metric("frustum_culled_percent", 100.0 * culling_statistics_.frustum_culled_ / tested);
+			  benchmark_.add_metric("occlusion_culled_percent", 100.0 * culling_statistics_.occlusion_culled_ / tested);
+			  if (culling_statistics_.tested_ > culling_statistics_.frustum_culled_) {
+				  const double in_view = (double)(culling_statistics_.tested_ - culling_statistics_.frustum_culled_);
+				  benchmark_.add_metric("occlusion_culled_percent_in_view", 100.0 * culling_statistics_.occlusion_culled_ / in_view);
+			  }
+			  benchmark_.add_metric("occlusion_raster_ms_mean", culling_statistics_.raster_time_.as_milliseconds() / culling_statistics_.frames_);
+
+			  const double frames = (double)culling_statistics_.frames_;
+			  benchmark_.add_metric("hardware_queries_per_frame", culling_statistics_.queries_ / frames);
+			  benchmark_.add_metric("hardware_draws_saved_per_frame", culling_statistics_.skipped_draws_ / frames);
+			  benchmark_.add_metric("hardware_conditional_draws_per_frame", culling_statistics_.conditional_draws_ / frames);
+			  benchmark_.add_metric("hardware_readback_ms_mean", culling_statistics_.readback_time_.as_milliseconds() / frames);
+		  }
+
+		  if (lighting_statistics_.frames_ > 0) {
+			  const double frames = (double)lighting_statistics_.frames_;
+			  benchmark_.add_metric("lights", (double)lights_.size());
+			  benchmark_.add_metric("lights_visible_per_frame", lighting_statistics_.visible_ / frames);
+			  benchmark_.add_metric("light_references_per_frame", lighting_statistics_.references_ / frames);
+			  benchmark_.add_metric("light_max_per_cluster", lighting_statistics_.max_per_cluster_);
+			  benchmark_.add_metric("light_overflow_per_frame", lighting_statistics_.overflow_ / frames);
+		  }
+
+		  if (shadow_statistics_.frames_ > 0) {
+			  const double frames = (double)shadow_statistics_.frames_;
+			  benchmark_.add_metric("shadow_cache", shadows_.caching_ ? 1.0 : 0.0);
+			  benchmark_.add_metric("shadow_static_updates_per_frame", shadow_statistics_.static_updates_ / frames);
+			  benchmark_.add_metric("shadow_tile_copies_per_frame", shadow_statistics_.tile_copies_ / frames);
+			  benchmark_.add_metric("shadow_static_casters_per_frame", shadow_statistics_.static_casters_ / frames);
+			  benchmark_.add_metric("shadow_dynamic_casters_per_frame", shadow_statistics_.dynamic_casters_ / frames);
+		  }
+
+		  if (batching_statistics_.frames_ > 0) {
+			  const double frames = (double)batching_statistics_.frames_;
+			  benchmark_.add_metric("scene_city", scene_layout_ == SCENE_LAYOUT_CITY ? 1.0 : 0.0);
+			  benchmark_.add_metric("scene_props", (double)props_.size());
+			  benchmark_.add_metric("draw_calls_per_frame", batching_statistics_.draw_calls_ / frames);
+			  benchmark_.add_metric("static_batching", batches_.is_valid() ? 1.0 : 0.0);
+			  if (batches_.is_valid()) {
+				  benchmark_.add_metric("batch_groups", batches_.statistics_.groups_);
+				  benchmark_.add_metric("batch_chunks", batches_.statistics_.chunks_);
+				  benchmark_.add_metric("batch_bytes", (double)(batches_.statistics_.vertex_bytes_ + batches_.statistics_.index_bytes_));
+				  benchmark_.add_metric("batch_visible_chunks_per_frame", batching_statistics_.visible_chunks_ / frames);
+				  benchmark_.add_metric("batch_ranges_per_frame", batching_statistics_.ranges_ / frames);
+			  }
+		  }
+
+		  if (texture_streaming_ != TEXTURE_STREAMING_OFF) {
+			  benchmark_.add_metric("texture_streaming_pbo", texture_streaming_ == TEXTURE_STREAMING_PBO ? 1.0 : 0.0);
+			  benchmark_.add_metric("texture_stream_finished", streaming_statistics_.finished_ ? 1.0 : 0.0);
+			  benchmark_.add_metric("texture_stream_textures", streaming_statistics_.textures_);
+			  benchmark_.add_metric("texture_stream_mib", streaming_statistics_.bytes_ / (1024.0 * 1024.0));
+			  benchmark_.add_metric("texture_stream_frames", streaming_statistics_.frames_);
+			  benchmark_.add_metric("texture_stream_main_thread_ms", streaming_statistics_.total_ms_);
+			  benchmark_.add_metric("texture_stream_max_frame_ms", streaming_statistics_.max_ms_);
+			  benchmark_.add_metric("texture_stream_hitch_frames", streaming_statistics_.hitches_);
+		  }
+
+		  if (frame_capture_ != FRAME_CAPTURE_OFF && capture_statistics_.frames_ > 0) {
+			  const framebuffer_readback::statistics &readback = readback_.statistics_;
+			  benchmark_.add_metric("capture_png", frame_capture_ == FRAME_CAPTURE_PNG ? 1.0 : 0.0);
+			  benchmark_.add_metric("capture_frames", readback.completed_);
+			  benchmark_.add_metric("capture_dropped_frames", readback.dropped_);
+			  benchmark_.add_metric("capture_failed_frames", readback.failed_);
+			  benchmark_.add_metric("capture_mib", readback.read_bytes_ / (1024.0 * 1024.0));
+			  benchmark_.add_metric("capture_main_thread_ms_mean", capture_statistics_.total_ms_ / capture_statistics_.frames_);
+			  benchmark_.add_metric("capture_max_frame_ms", capture_statistics_.max_ms_);
+			  benchmark_.add_metric("capture_latency_frames_mean", readback.mapped_ > 0 ? (double)readback.latency_sum_ / readback.mapped_ : 0.0);
+			  benchmark_.add_metric("capture_latency_frames_max", readback.max_latency_);
+		  }
+
+		  benchmark_.add_metric("deferred_shading", shading_path_ == SHADING_PATH_DEFERRED ? 1.0 : 0.0);
+		  benchmark_.add_metric("depth_prepass", opaque_settings_.depth_prepass_ ? 1.0 : 0.0);
+		  benchmark_.add_metric("opaque_front_to_back", opaque_settings_.front_to_back_ ? 1.0 : 0.0);
+		  benchmark_.add_metric("skybox_last", opaque_settings_.skybox_last_ ? 1.0 : 0.0);
+		  if (fragment_statistics_.frames_ > 0) {
+			  const double frames = (double)fragment_statistics_.frames_;
+			  uint64 shaded = 0;
+			  for (uint32 index = 0; index < RENDER_TASK_COUNT; index++) {
+				  if (index == RENDER_TASK_QUERIES) {
+					  continue;
+				  }
+
+				  snprintf(name, sizeof(name), "fragments_%s_per_frame", render_task_name((render_task)index));
+				  benchmark_.add_metric(name, fragment_statistics_.samples_[index] / frames);
+				  if (index != RENDER_TASK_PREPASS) {
+					  shaded += fragment_statistics_.samples_[index];
+				  }
+			  }
+			  benchmark_.add_metric("fragments_shaded_per_frame", shaded / frames);
+			  benchmark_.add_metric("overdraw_ratio", (double)shaded / fragment_statistics_.pixels_);
+		  }
+
+		  benchmark_.add_metric("msaa_samples", msaa_samples_);
+		  benchmark_.add_metric("gpu_budget_ms", resolution_.target_.as_milliseconds());
+		  benchmark_.add_metric("resolution_changes", resolution_.changes_);
+		  if (gpu_statistics_.count_ > 0) {
+			  const double mean = gpu_statistics_.sum_ / gpu_statistics_.count_;
+			  const double variance = gpu_statistics_.sum_squared_ / gpu_statistics_.count_ - mean * mean;
+			  benchmark_.add_metric("gpu_frame_ms_mean", mean);
+			  benchmark_.add_metric("gpu_frame_ms_stddev", variance > 0.0 ? sqrt(variance) : 0.0);
+			  benchmark_.add_metric("gpu_frame_ms_max", gpu_statistics_.max_);
+			  benchmark_.add_metric("gpu_over_budget_frames", gpu_statistics_.over_budget_);
+			  benchmark_.add_metric("resolution_scale_mean", gpu_statistics_.scale_sum_ / gpu_statistics_.count_);
+		  }
+		  // note: serialized gpu_<scope> timings add up to the frame, but the frame itself runs slower for it
+		  benchmark_.add_metric("gpu_profiler_serialized", gpu_profiler_.serialized_ ? 1.0 : 0.0);
+	  }
+	  else {
+		  graph_.reset_timings();
+	  }
+
+	  benchmark_.end(BENCHMARK_SECTION_SUBMIT);
+   }
+
+   void testbed::cull() {
+	  NEON_PROFILE_SCOPE("testbed::cull");
+
+	  const glm::mat4 view_projection = render_camera_.projection_ * render_camera_.view_;
+	  frustum view;
+	  view.construct_from_view_matrix(view_projection);
+
+	  const bool software = occlusion_mode_ == OCCLUSION_MODE_SOFTWARE || occlusion_mode_ == OCCLUSION_MODE_BOTH;
+	  const bool hardware = occlusion_mode_ == OCCLUSION_MODE_HARDWARE || occlusion_mode_ == OCCLUSION_MODE_BOTH;
+
+	  occlusion_.begin(view_projection);
+	  if (software) {
+		  occlusion_.add_occluder(occluder_positions_.data(), occluder_indices_.data(), (uint32)occluder_indices_.size(), glm::mat4(1));
+		  occlusion_.rasterize(workers_);
+	  }
+
+	  // note: last frame's query results, the queries for this frame are recorded with the scene
+	  occlusion_queries_.begin_frame();
+
+	  // note: cheapest test first, only what survives the software buffer costs a query.
+	  //       batched props are culled per chunk instead, batching is off with queries
+	  visible_props_.clear();
+	  frustum_culled_ = 0;
+	  if (batches_.is_valid()) {
+		  batches_.cull(view, software ? &occlusion_ : nullptr);
+	  }
+	  for (uint32 index = 0; index < (uint32)props_.size() && !batches_.is_valid(); index++) {
+		  if (!view.is_inside(prop_bounds_[index])) {
+			  frustum_culled_++;
+			  continue;
+		  }
+
+		  if (software && !occlusion_.is_visible(prop_bounds_[index])) {
+			  continue;
+		  }
+
+		  if (hardware && !occlusion_queries_.test(index, prop_bounds_[index], render_camera_.position_)) {
+			  continue;
+		  }
+
+		  visible_props_.push_back(index);
+	  }
+
+	  visible_dynamic_.clear();
+	  for (uint32 index = 0; index < (uint32)dynamic_props_.size(); index++) {
+		  if (view.is_inside(dynamic_bounds_[index])) {
+			  visible_dynamic_.push_back(index);
+		  }
+	  }
+
+	  // note: nearest first so the depth test rejects as much of the farther props as it can
+	  if (opaque_settings_.front_to_back_) {
+		  const glm::vec3 eye = render_camera_.position_;
+		  std::sort(visible_props_.begin(), visible_props_.end(), [&](uint32 lhs, uint32 rhs) {
+			  const glm::vec3 lhs_offset = prop_bounds_[lhs].center_ - eye;
+			  const glm::vec3 rhs_offset = prop_bounds_[rhs].center_ - eye;
+			  return glm::dot(lhs_offset, lhs_offset) < glm::dot(rhs_offset, rhs_offset);
+		  });
+	  }
+
+	  // note: with static batches the chunks are what gets tested, not the props
+	  if (benchmark_.is_measuring()) {
+		  const bool batched = batches_.is_valid();
+		  culling_statistics_.frames_++;
+		  culling_statistics_.tested_ += batched ? batches_.statistics_.chunks_ : (uint32)props_.size();
+		  culling_statistics_.frustum_culled_ += batched ? batches_.statistics_.frustum_culled_chunks_ : frustum_culled_;
+		  culling_statistics_.occlusion_culled_ += occlusion_.statistics_.culled_;
+		  culling_statistics_.raster_time_ += occlusion_.statistics_.raster_time_;
+		  culling_statistics_.queries_ += occlusion_queries_.statistics_.queries_;
+		  culling_statistics_.skipped_draws_ += occlusion_queries_.statistics_.skipped_draws_;
+		  culling_statistics_.conditional_draws_ += occlusion_queries_.statistics_.conditional_draws_;
+		  culling_statistics_.readback_time_ += occlusion_queries_.statistics_.readback_time_;
+	  }
+   }
+
+   void testbed::record(render_task task, command_buffer &commands) {
+	  const bool deferred = shading_path_ == SHADING_PATH_DEFERRED;
+	  const bool hardware = occlusion_mode_ == OCCLUSION_MODE_HARDWARE || occlusion_mode_ == OCCLUSION_MODE_BOTH;
+
+	  // note: after the prepass the shaded passes only pass where depth is equal, they keep
+	  //       writing depth so the queries and anything left out of the prepass still work
+	  const bool prepass = opaque_settings_.depth_prepass_;
+	  if (prepass && (task == RENDER_TASK_TERRAIN || task == RENDER_TASK_MODEL)) {
+		  commands.set_depth_func(GL_LEQUAL);
+	  }
+
+	  switch (task) {
+		  case RENDER_TASK_PREPASS:
+		  {
+			  if (!prepass) {
+				  break;
+			  }
+
+			  // note: props waiting on this frame's query are drawn conditionally later and left out here,
+			  //       otherwise they would fill in depth before their proxy is tested
+			  commands.set_write_mask(false, true);
+			  terrain_.render_depth(commands, render_camera_);
+			  model_.render_depth(commands, render_camera_, model_matrix_);
+			  batches_.record_depth(commands, render_camera_);
+			  for (auto &index : visible_props_) {
+				  if (hardware && occlusion_queries_.nodes_[index].issued_) {
+					  continue;
+				  }
+
+				  model_.render_depth(commands, render_camera_, props_[index]);
+			  }
+			  for (auto &index : visible_dynamic_) {
+				  model_.render_depth(commands, render_camera_, dynamic_props_[index]);
+			  }
+			  commands.set_write_mask(true, true);
+		  } break;
+
+		  case RENDER_TASK_TERRAIN:
+		  {
+			  if (deferred) {
+				  terrain_.render_gbuffer(commands, render_camera_);
+			  }
+			  else {
+				  terrain_.render(commands, render_camera_, clusters_, shadows_);
+			  }
+		  } break;
+
+		  case RENDER_TASK_QUERIES:
+		  {
+			  occlusion_queries_.record(commands, render_camera_);
+		  } break;
+
+		  case RENDER_TASK_MODEL:
+		  {
+			  if (deferred) {
+				  model_.render_gbuffer(commands, render_camera_, model_matrix_);
+				  batches_.record_gbuffer(commands, render_camera_);
+			  }
+			  else {
+				  model_.render(commands, render_camera_, clusters_, model_matrix_);
+				  batches_.record(commands, render_camera_, clusters_);
+			  }
+
+			  // note: props queried this frame are drawn once the gpu knows the result
+			  for (auto &index : visible_props_) {
+				  const bool conditional = hardware && occlusion_queries_.nodes_[index].issued_;
+				  if (conditional) {
+					  commands.begin_conditional_render(occlusion_queries_.nodes_[index].query_, GL_QUERY_WAIT);
+				  }
+
+				  if (deferred) {
+					  model_.render_gbuffer(commands, render_camera_, props_[index]);
+				  }
+				  else {
+					  model_.render(commands, render_camera_, clusters_, props_[index]);
+				  }
+
+				  if (conditional) {
+					  commands.end_conditional_render();
+				  }
+			  }
+
+			  for (auto &index : visible_dynamic_) {
+				  if (deferred) {
+					  model_.render_gbuffer(commands, render_camera_, dynamic_props_[index]);
+				  }
+				  else {
+					  model_.render(commands, render_camera_, clusters_, dynamic_props_[index]);
+				  }
+			  }
+		  } break;
+
+		  case RENDER_TASK_SKYBOX:
+		  {
+			  // note: the lighting pass fills in the sky where the g-buffer stayed empty
+			  if (!deferred) {
+				  skybox_.render(commands, render_camera_);
+			  }
+		  } break;
+
+		  default:
+		  {
+			  assert(!"unknown render task");
+		  } break;
+	  }
+
+	  if (prepass && (task == RENDER_TASK_TERRAIN || task == RENDER_TASK_MODEL)) {
+		  commands.set_depth_func(GL_LESS);
+	  }
+   }
+
+   void testbed::record_shadows(uint32 cascade) {
+	  // note: static casters are only recorded when the cached tile is stale, the terrain
+	  //       is a single draw that always reaches into the tile
+	  shadow_cascades::cascade &target = shadows_.cascades_[cascade];
+	  const fps_camera &sun = target.camera_;
+
+	  if (shadows_.needs_static(cascade)) {
+		  command_buffer &commands = target.static_commands_;
+		  commands.reset();
+		  terrain_.render_depth(commands, sun);
+		  target.static_casters_ = 1;
+
+		  const bounding_sphere model_bounds(glm::vec3(model_matrix_ * glm::vec4(model_bounds_.center_, 1.0f)), model_bounds_.radius_ * 0.1f);
+		  if (target.frustum_.is_inside(model_bounds)) {
+			  model_.render_depth(commands, sun, model_matrix_);
+			  target.static_casters_++;
+		  }
+
+		  // note: batched props go out as one multi-draw of the chunks in the cascade
+		  if (batches_.is_valid()) {
+			  target.static_casters_ += batches_.record_depth(commands, sun, target.frustum_);
+		  }
+		  for (uint32 index = 0; index < (uint32)props_.size() && !batches_.is_valid(); index++) {
+			  if (target.frustum_.is_inside(prop_bounds_[index])) {
+				  model_.render_depth(commands, sun, props_[index]);
+				  target.static_casters_++;
+			  }
+		  }
+	  }
+
+	  command_buffer &commands = target.dynamic_commands_;
+	  commands.reset();
+	  target.dynamic_casters_ = 0;
+	  for (uint32 index = 0; index < (uint32)dynamic_props_.size(); index++) {
+		  if (target.frustum_.is_inside(dynamic_bounds_[index])) {
+			  model_.render_depth(commands, sun, dynamic_props_[index]);
+			  target.dynamic_casters_++;
+		  }
+	  }
+   }
+
+   void testbed::update_dynamic_props() {
+	  const glm::vec3 center(model_matrix_[3]);
+	  const float PROP_SCALE = 0.1f;
+	  const float ORBIT_RADIUS = 8.0f;
+	  for (uint32 index = 0; index < (uint32)dynamic_props_.size(); index++) {
+		  const float angle = rotation_ + glm::two_pi<float>() * index / (float)dynamic_props_.size();
+		  glm::mat4 world = glm::translate(glm::mat4(1), center + glm::vec3(cosf(angle) * ORBIT_RADIUS, 1.0f, sinf(angle) * ORBIT_RADIUS));
+		  world = glm::rotate(world, -angle, glm::vec3(0.0f, 1.0f, 0.0f));
+		  world = glm::scale(world, glm::vec3(PROP_SCALE));
+
+		  dynamic_props_[index] = world;
+		  dynamic_bounds_[index] = bounding_sphere(glm::vec3(world * glm::vec4(model_bounds_.center_, 1.0f)), model_bounds_.radius_ * PROP_SCALE);
+	  }
+   }
+
+   void testbed::stream_textures() {
+	  // note: starts with the first measured frame, the numbers cover the frames until
+	  //       the last texture went out. sync pays for reading, decoding and uploading
+	  //       one texture a frame right here, pbo only for handing out and polling
+	  if (texture_streaming_ == TEXTURE_STREAMING_OFF || streaming_statistics_.finished_) {
+		  return;
+	  }
+
+	  if (benchmark_.is_enabled() && !benchmark_.is_measuring()) {
+		  return;
+	  }
+
+	  NEON_PROFILE_SCOPE("testbed::stream_textures");
+	  const uint32 count = (uint32)streamed_textures_.size();
+	  const time start = time::now();
+	  if (texture_streaming_ == TEXTURE_STREAMING_SYNC) {
+		  dynamic_array<uint8> content;
+		  int32 width = 0, height = 0;
+		  streamed_pixels_.resize(texture_streamer::SLOT_BYTES);
+		  if (file_system::read_file_content(STREAMED_FILES[streamed_next_ % STREAMED_FILE_COUNT], content) &&
+			  texture::decode(content, true, streamed_pixels_.data(), (uint32)streamed_pixels_.size(), width, height)) {
+			  streamed_textures_[streamed_next_].create_storage(width, height, streamed_pixels_.data());
+			  streaming_statistics_.textures_++;
+			  streaming_statistics_.bytes_ += (uint64)width * height * 4;
+		  }
+
+		  streaming_statistics_.finished_ = ++streamed_next_ == count;
+	  }
+	  else {
+		  while (streamed_next_ < count) {
+			  streamer_.request(STREAMED_FILES[streamed_next_ % STREAMED_FILE_COUNT], true, streamed_textures_[streamed_next_]);
+			  streamed_next_++;
+		  }
+
+		  streamer_.update();
+		  streaming_statistics_.textures_ = streamer_.statistics_.uploaded_;
+		  streaming_statistics_.bytes_ = streamer_.statistics_.uploaded_bytes_;
+		  streaming_statistics_.finished_ = streamer_.is_idle();
+	  }
+
+	  const double elapsed = (time::now() - start).as_milliseconds();
+	  benchmark_.add_timing("texture_stream", elapsed);
+	  streaming_statistics_.frames_++;
+	  streaming_statistics_.total_ms_ += elapsed;
+	  streaming_statistics_.max_ms_ = glm::max(streaming_statistics_.max_ms_, elapsed);
+	  if (elapsed > streaming_statistics::HITCH_MS) {
+		  streaming_statistics_.hitches_++;
+	  }
+   }
+
+   void testbed::capture_frame() {
+	  // note: the backbuffer is read right after the graph presented it, the file is
+	  //       written a frame or two later by a readback worker. raw files carry the
+	  //       size in their name since there is no header
+	  if (frame_capture_ == FRAME_CAPTURE_OFF) {
+		  return;
+	  }
+
+	  if (benchmark_.is_enabled() && !benchmark_.is_measuring()) {
+		  return;
+	  }
+
+	  NEON_PROFILE_SCOPE("testbed::capture_frame");
+	  const time start = time::now();
+	  readback_.update();
+
+	  const string directory = capture_directory_;
+	  const bool png = frame_capture_ == FRAME_CAPTURE_PNG;
+	  framebuffer::read_backbuffer_async(graph_.backbuffer_width_, graph_.backbuffer_height_, readback_,
+		  [directory, png](const framebuffer_readback::frame &image) {
+		  char name[64] = {};
+		  if (png) {
+			  snprintf(name, sizeof(name), "frame_%05llu.png", (unsigned long long)image.sequence_);
+			  return framebuffer_readback::write_png(directory + name, image);
+		  }
+
+		  snprintf(name, sizeof(name), "frame_%05llu_%dx%d.rgba", (unsigned long long)image.sequence_, image.width_, image.height_);
+		  return framebuffer_readback::write_raw(directory + name, image);
+	  });
+
+	  const double elapsed = (time::now() - start).as_milliseconds();
+	  benchmark_.add_timing("frame_capture", elapsed);
+	  capture_statistics_.frames_++;
+	  capture_statistics_.total_ms_ += elapsed;
+	  capture_statistics_.max_ms_ = glm::max(capture_statistics_.max_ms_, elapsed);
+   }
+
+   void testbed::measure_recording() {
+	  // note: records the whole scene over and over on 1..N threads and reports
+	  //       recorded commands per millisecond and thread, nothing is submitted.
+	  //       the pool hands jobs to whichever slot is free, so one slot could
+	  //       run several of them; the run starts exactly N threads instead
+	  const uint32 ITERATIONS = 2000;
+	  const uint32 thread_count = workers_.worker_count() + 1;
+
+	  dynamic_array<command_buffer> buffers(thread_count);
+	  dynamic_array<uint64> recorded(thread_count);
+
+	  for (uint32 threads = 1; threads <= thread_count; threads++) {
+		  for (uint32 index = 0; index < threads; index++) {
+			  recorded[index] = 0;
+		  }
+
+		  std::atomic<uint32> ready(0);
+		  std::atomic<bool> go(false);
+		  auto record = [&](uint32 index) {
+			  command_buffer &commands = buffers[index];
+			  for (uint32 iteration = 0; iteration < ITERATIONS; iteration++) {
+				  commands.reset();
+				  skybox_.render(commands, render_camera_);
+				  terrain_.render(commands, render_camera_, clusters_, shadows_);
+				  sphere_.render(commands, render_camera_, clusters_, shadows_);
+				  model_.render(commands, render_camera_, clusters_, model_matrix_);
+				  recorded[index] += commands.command_count();
+			  }
+		  };
+
+		  // note: helpers wait for the start signal so thread creation stays out of the timing
+		  dynamic_array<std::thread> helpers;
+		  helpers.reserve(threads - 1);
+		  for (uint32 index = 1; index < threads; index++) {
+			  helpers.emplace_back([&, index] {
+				  ready++;
+				  while (!go) {
+					  std::this_thread::yield();
+				  }
+
+				  record(index);
+			  });
+		  }
+
+		  while (ready != threads - 1) {
+			  std::this_thread::yield();
+		  }
+
+		  const time start = time::now();
+		  go = true;
+		  record(0);
+		  for (auto &helper : helpers) {
+			  helper.join();
+		  }
+		  const time elapsed = time::now() - start;
+
+		  uint64 total = 0;
+		  for (uint32 index = 0; index < threads; index++) {
+			  total += recorded[index];
+		  }
+
+		  char name[64] = {};
+		  snprintf(name, sizeof(name), "command_recording_per_ms_per_thread_%ut", threads);
+		  benchmark_.add_metric(name, (double)total / elapsed.as_milliseconds() / (double)threads);
+	  }
+   }
+
+   void testbed::measure_occlusion() {
+	  // note: transforms and rasterizes the terrain occluder from above over and over
+	  //       and reports rasterized triangles per millisecond with the whole pool
+	  const uint32 ITERATIONS = 200;
+	  const glm::mat4 view = glm::lookAt(glm::vec3(-16.0f, 24.0f, -16.0f), glm::vec3(128.0f, 0.0f, 128.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	  const glm::mat4 view_projection = camera_.projection_ * view;
+
+	  occlusion_culler culler;
+	  uint64 triangles = 0;
+	  time transform_time, raster_time;
+	  for (uint32 iteration = 0; iteration < ITERATIONS; iteration++) {
+		  culler.begin(view_projection);
+		  culler.add_occluder(occluder_positions_.data(), occluder_indices_.data(), (uint32)occluder_indices_.size(), glm::mat4(1));
+		  culler.rasterize(workers_);
+
+		  triangles += culler.statistics_.rasterized_triangles_;
+		  transform_time += culler.statistics_.transform_time_;
+		  raster_time += culler.statistics_.raster_time_;
+	  }
+
+	  benchmark_.add_metric("occlusion_occluder_triangles", (double)(occluder_indices_.size() / 3));
+	  benchmark_.add_metric("occlusion_raster_triangles_per_ms", (double)triangles / raster_time.as_milliseconds());
+	  benchmark_.add_metric("occlusion_setup_triangles_per_ms", (double)triangles / transform_time.as_milliseconds());
+   }
+
+   void testbed::measure_lighting() {
+	  // note: assigns growing sets of lights from the first camera of the path over and over
+	  //       with the whole pool and reports the mean assignment time per light count
+	  const uint32 ITERATIONS = 50;
+	  const uint32 counts[] = { 64, 256, 1024, 4096 };
+
+	  light_clusters clusters;
+	  dynamic_array<light> lights;
+	  for (auto &count : counts) {
+		  create_lights(count, lights);
+
+		  time elapsed;
+		  uint64 references = 0;
+		  for (uint32 iteration = 0; iteration < ITERATIONS; iteration++) {
+			  clusters.assign(camera_, lights.data(), (uint32)lights.size(), workers_);
+			  elapsed += clusters.statistics_.assign_time_;
+			  references += clusters.statistics_.references_;
+		  }
+
+		  char name[64] = {};
+		  snprintf(name, sizeof(name), "light_assignment_ms_%u", count);
+		  benchmark_.add_metric(name, elapsed.as_milliseconds() / ITERATIONS);
+		  snprintf(name, sizeof(name), "light_references_%u", count);
+		  benchmark_.add_metric(name, (double)references / ITERATIONS);
+	  }
+   }
+
+   void testbed::measure_geometry_arena() {
+	  // note: fills a scratch arena with meshes of random size, releases every other one
+	  //       and reports how fragmented it is before and after defragmenting
+	  const uint32 MESH_COUNT = 2048;
+	  const uint32 STRIDE = sizeof(terrain::vertex);
+	  uint32 state = 0x2545f491u;
+	  const auto random = [&state](uint32 low, uint32 high) {
+		  state = state * 1664525u + 1013904223u;
+		  return low + (state >> 8) % (high - low);
+	  };
+
+	  geometry_arena arena;
+	  dynamic_array<uint8> vertices(8192 * STRIDE);
+	  dynamic_array<uint32> indices(8192 * 3);
+	  dynamic_array<geometry_handle> handles;
+	  for (uint32 index = 0; index < MESH_COUNT; index++) {
+		  handles.push_back(arena.allocate_vertices(STRIDE, random(64, 8192), vertices.data()));
+		  handles.push_back(arena.allocate_indices(random(192, 8192 * 3), indices.data()));
+	  }
+
+	  for (uint32 index = 0; index < (uint32)handles.size(); index += 4) {
+		  arena.release(handles[index]);
+		  arena.release(handles[index + 1]);
+	  }
+
+	  benchmark_.add_metric("geometry_churn_arenas_before", arena.statistics_.arenas_);
+	  benchmark_.add_metric("geometry_churn_utilization_before", arena.statistics_.utilization_);
+	  benchmark_.add_metric("geometry_churn_fragmentation_before", arena.statistics_.fragmentation_);
+	  benchmark_.add_metric("geometry_churn_free_blocks_before", arena.statistics_.free_blocks_);
+
+	  const time start = time::now();
+	  arena.defragment();
+	  glFinish();
+	  const time elapsed = time::now() - start;
+
+	  benchmark_.add_metric("geometry_churn_arenas_after", arena.statistics_.arenas_);
+	  benchmark_.add_metric("geometry_churn_utilization_after", arena.statistics_.utilization_);
+	  benchmark_.add_metric("geometry_churn_fragmentation_after", arena.statistics_.fragmentation_);
+	  benchmark_.add_metric("geometry_churn_free_blocks_after", arena.statistics_.free_blocks_);
+	  benchmark_.add_metric("geometry_churn_defragment_moves", arena.statistics_.defragment_moves_);
+	  benchmark_.add_metric("geometry_churn_defragment_mib", arena.statistics_.defragment_bytes_ / (1024.0 * 1024.0));
+	  benchmark_.add_metric("geometry_churn_defragment_ms", elapsed.as_milliseconds());
+
+	  arena.destroy();
+   }
+
+   void testbed::measure_program_cache() {
+	  // note: builds every feature permutation of the lit shaders through a binary cache in an
+	  //       empty temporary directory twice. the cold pass compiles and stores, the warm pass
+	  //       loads what the cold pass stored through a fresh cache. the directory is removed after
+	  const uint32 PERMUTATIONS = 1u << SHADER_FEATURE_COUNT;
+
+	  dynamic_array<uint8> vertex_source;
+	  dynamic_array<uint8> fragment_source;
+	  if (!file_system::read_file_content("assets/lit/vertex_shader.shader", vertex_source) ||
+		  !file_system::read_file_content("assets/lit/fragment_shader.shader", fragment_source))
+	  {
+		  return;
+	  }
+	  vertex_source.push_back(0);
+	  fragment_source.push_back(0);
+
+	  dynamic_array<string> vertex_variants(PERMUTATIONS);
+	  dynamic_array<string> fragment_variants(PERMUTATIONS);
+	  for (uint32 features = 0; features < PERMUTATIONS; features++) {
+		  vertex_variants[features] = shader_program::inject_features((const char *)vertex_source.data(), features);
+		  fragment_variants[features] = shader_program::inject_features((const char *)fragment_source.data(), features);
+	  }
+
+	  const string directory = file_system::create_temporary_directory("neon-program-cache");
+	  if (directory.empty()) {
+		  return;
+	  }
+
+	  const char *passes[] = { "cold", "warm" };
+	  for (uint32 pass = 0; pass < 2; pass++) {
+		  program_binary_cache binaries;
+		  if (!binaries.create(directory)) {
+			  break;
+		  }
+
+		  dynamic_array<shader_program> programs;
+		  programs.reserve(PERMUTATIONS);
+
+		  const time start = time::now();
+		  for (uint32 features = 0; features < PERMUTATIONS; features++) {
+			  shader_program program;
+			  if (binaries.create_program(vertex_variants[features].c_str(), fragment_variants[features].c_str(), program)) {
+				  programs.push_back(program);
+			  }
+		  }
+		  glFinish();
+		  const time elapsed = time::now() - start;
+
+		  for (auto &program : programs) {
+			  program.destroy();
+		  }
+
+		  char name[64] = {};
+		  snprintf(name, sizeof(name), "program_cache_%s_ms", passes[pass]);
+		  benchmark_.add_metric(name, elapsed.as_milliseconds());
+		  snprintf(name, sizeof(name), "program_cache_%s_hits", passes[pass]);
+		  benchmark_.add_metric(name, binaries.statistics_.hits_);
+		  snprintf(name, sizeof(name), "program_cache_%s_misses", passes[pass]);
+		  benchmark_.add_metric(name, binaries.statistics_.misses_);
+	  }
+
+	  benchmark_.add_metric("program_cache_permutations", PERMUTATIONS);
+
+	  program_binary_cache binaries;
+	  if (binaries.create(directory)) {
+		  for (uint32 features = 0; features < PERMUTATIONS; features++) {
+			  binaries.remove_program(vertex_variants[features].c_str(), fragment_variants[features].c_str());
+		  }
+	  }
+	  file_system::remove_directory(directory);
+   }
+
+   void testbed::measure_grid_meshes() {
+	  // note: draws a large flat grid from above as triangles and as strips, with 32 and 16-bit
+	  //       indices, and reports index memory, vertex shader invocations and gpu time per draw.
+	  //       invocations need the pipeline statistics query, without it they are left out
+	  const uint32 GRID_SIZE = 1024;
+	  const uint32 ITERATIONS = 8;
+	  const struct {
+		  const char *name_;
+		  grid_topology topology_;
+		  bool short_indices_;
+	  } variants[] = {
+		  { "triangles_32", GRID_TOPOLOGY_TRIANGLES, false },
+		  { "triangles_16", GRID_TOPOLOGY_TRIANGLES, true },
+		  { "strips_32", GRID_TOPOLOGY_STRIPS, false },
+		  { "strips_16", GRID_TOPOLOGY_STRIPS, true },
+	  };
+
+	  dynamic_array<glm::vec3> positions;
+	  positions.reserve(GRID_SIZE * GRID_SIZE);
+	  for (uint32 z = 0; z < GRID_SIZE; z++) {
+		  for (uint32 x = 0; x < GRID_SIZE; x++) {
+			  positions.push_back(glm::vec3((float)x, 0.0f, (float)z));
+		  }
+	  }
+
+	  geometry_arena arena;
+	  const geometry_handle vertices = arena.allocate_vertices(sizeof(glm::vec3), (uint32)positions.size(), positions.data());
+	  if (vertices == geometry_arena::INVALID_HANDLE) {
+		  return;
+	  }
+
+	  GLuint queries[2] = {};
+	  glGenQueries(2, queries);
+	  while (glGetError() != GL_NO_ERROR) {
+	  }
+	  glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS, queries[0]);
+	  const bool invocations = glGetError() == GL_NO_ERROR;
+	  if (invocations) {
+		  glEndQuery(GL_VERTEX_SHADER_INVOCATIONS);
+	  }
+
+	  const float half = GRID_SIZE * 0.5f;
+	  const glm::mat4 projection = glm::ortho(-half, half, -half, half, 1.0f, 2.0f * GRID_SIZE);
+	  const glm::mat4 view = glm::lookAt(glm::vec3(half, (float)GRID_SIZE, half), glm::vec3(half, 0.0f, half), glm::vec3(0.0f, 0.0f, -1.0f));
+
+	  char name[64] = {};
+	  command_buffer commands;
+	  for (auto &entry : variants) {
+		  grid_mesh grid;
+		  if (!grid.build(entry.topology_, entry.short_indices_, GRID_SIZE, GRID_SIZE)) {
+			  continue;
+		  }
+
+		  const uint64 index_bytes = grid.index_bytes();
+		  const uint32 index_count = grid.index_count_;
+		  geometry_handle indices = grid.upload(arena);
+		  if (indices == geometry_arena::INVALID_HANDLE) {
+			  continue;
+		  }
+
+		  commands.reset();
+		  commands.bind_program(terrain_.depth_program_);
+		  commands.set_uniform_mat4("projection", projection);
+		  commands.set_uniform_mat4("view", view);
+		  commands.set_uniform_mat4("world", glm::mat4(1));
+		  commands.set_capability(GL_DEPTH_TEST, false);
+		  commands.set_capability(GL_CULL_FACE, false);
+		  commands.set_write_mask(false, false);
+		  arena.bind(commands, vertices, indices);
+		  commands.bind_vertex_format(terrain_.depth_format_);
+		  grid.draw(commands, arena, vertices, indices);
+		  commands.set_write_mask(true, true);
+
+		  // note: the first submit pays for validation and the upload, it stays out of the numbers
+		  commands.submit();
+		  glFinish();
+
+		  glBeginQuery(GL_TIME_ELAPSED, queries[1]);
+		  if (invocations) {
+			  glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS, queries[0]);
+		  }
+		  for (uint32 iteration = 0; iteration < ITERATIONS; iteration++) {
+			  commands.submit();
+		  }
+		  if (invocations) {
+			  glEndQuery(GL_VERTEX_SHADER_INVOCATIONS);
+		  }
+		  glEndQuery(GL_TIME_ELAPSED);
+
+		  GLuint64 elapsed = 0, invoked = 0;
+		  glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &elapsed);
+		  if (invocations) {
+			  glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &invoked);
+		  }
+
+		  snprintf(name, sizeof(name), "grid_%s_index_bytes", entry.name_);
+		  benchmark_.add_metric(name, (double)index_bytes);
+		  snprintf(name, sizeof(name), "grid_%s_indices_per_quad", entry.name_);
+		  benchmark_.add_metric(name, (double)index_count / ((GRID_SIZE - 1) * (GRID_SIZE - 1)));
+		  snprintf(name, sizeof(name), "grid_%s_chunks", entry.name_);
+		  benchmark_.add_metric(name, (double)grid.chunks_.size());
+		  snprintf(name, sizeof(name), "grid_%s_gpu_ms", entry.name_);
+		  benchmark_.add_metric(name, elapsed / 1000000.0 / ITERATIONS);
+		  if (invocations) {
+			  snprintf(name, sizeof(name), "grid_%s_vertex_invocations", entry.name_);
+			  benchmark_.add_metric(name, (double)invoked / ITERATIONS);
+		  }
+
+		  arena.release(indices);
+	  }
+
+	  glDeleteQueries(2, queries);
+	  arena.destroy();
+   }
+
+   void testbed::create_lights(uint32 count, dynamic_array<light> &lights) const {
+	  // note: the same lights every run, scattered around the camera path and over the
+	  //       terrain a few units above the ground, every fourth one a spot facing down
+	  uint32 state = 0x9e3779b9u;
+	  const auto random = [&state](float low, float high) {
+		  state = state * 1664525u + 1013904223u;
+		  return low + (high - low) * ((state >> 8) * (1.0f / 16777216.0f));
+	  };
+
+	  lights.resize(count);
+	  for (uint32 index = 0; index < count; index++) {
+		  light &target = lights[index];
+		  const float x = random(-48.0f, (float)terrain_.width_);
+		  const float z = random(-64.0f, (float)terrain_.depth_);
+		  const bool above_terrain = x >= 0.0f && z >= 0.0f;
+		  target.position_ = glm::vec3(x, (above_terrain ? terrain_.height_at(x, z) : 0.0f) + random(1.0f, 6.0f), z);
+		  target.radius_ = random(4.0f, 12.0f);
+		  target.color_ = glm::vec3(random(0.2f, 1.0f), random(0.2f, 1.0f), random(0.2f, 1.0f)) * 8.0f;
+		  if (index % 4 == 3) {
+			  target.direction_ = glm::vec3(0.0f, -1.0f, 0.0f);
+			  target.cos_inner_ = cosf(glm::radians(20.0f));
+			  target.cos_outer_ = cosf(glm::radians(30.0f));
+		  }
+	  }
    }
 } // !neon
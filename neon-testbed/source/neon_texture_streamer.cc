@@ -0,0 +1,235 @@
+// neon_texture_streamer.cc
+
+#include "neon_texture_streamer.h"
+#include <neon_profiler.h>
+#include <cassert>
+
+namespace neon {
+   texture_streamer::slot::slot()
+      : buffer_(0)
+      , fence_(nullptr)
+      , pixels_(nullptr)
+      , state_(SLOT_STATE_FREE)
+      , width_(0)
+      , height_(0)
+      , failed_(false)
+   {
+   }
+
+   texture_streamer::statistics::statistics()
+      : requested_(0)
+      , uploaded_(0)
+      , failed_(0)
+      , uploaded_bytes_(0)
+   {
+   }
+
+   texture_streamer::texture_streamer()
+      : running_(false)
+   {
+   }
+
+   bool texture_streamer::create() {
+      if (is_valid()) {
+         return false;
+      }
+
+      for (auto &entry : slots_) {
+         glGenBuffers(1, &entry.buffer_);
+         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, entry.buffer_);
+         glBufferData(GL_PIXEL_UNPACK_BUFFER, SLOT_BYTES, nullptr, GL_STREAM_DRAW);
+      }
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+      if (glGetError() != GL_NO_ERROR) {
+         destroy();
+         return false;
+      }
+
+      running_ = true;
+      const uint32 thread_count = glm::min(RING_SIZE, thread_pool::default_worker_count());
+      threads_.reserve(thread_count);
+      for (uint32 index = 0; index < thread_count; index++) {
+         threads_.emplace_back(&texture_streamer::decode_loop, this);
+      }
+
+      return true;
+   }
+
+   void texture_streamer::destroy() {
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         running_ = false;
+         jobs_.clear();
+      }
+
+      wake_.notify_all();
+      for (auto &thread : threads_) {
+         thread.join();
+      }
+      threads_.clear();
+
+      for (auto &entry : slots_) {
+         if (entry.pixels_) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, entry.buffer_);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            entry.pixels_ = nullptr;
+         }
+
+         if (entry.fence_) {
+            glDeleteSync(entry.fence_);
+            entry.fence_ = nullptr;
+         }
+
+         if (entry.buffer_) {
+            glDeleteBuffers(1, &entry.buffer_);
+            entry.buffer_ = 0;
+         }
+
+         entry.state_ = SLOT_STATE_FREE;
+      }
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+      pending_.clear();
+   }
+
+   bool texture_streamer::is_valid() const {
+      return slots_[0].buffer_ != 0;
+   }
+
+   bool texture_streamer::is_idle() const {
+      for (auto &entry : slots_) {
+         if (entry.state_ != SLOT_STATE_FREE) {
+            return false;
+         }
+      }
+
+      return pending_.empty();
+   }
+
+   void texture_streamer::request(const string &filename, bool flip, texture &target) {
+      queued_request entry;
+      entry.filename_ = filename;
+      entry.flip_ = flip;
+      entry.target_ = &target;
+      pending_.push_back(entry);
+      statistics_.requested_++;
+   }
+
+   void texture_streamer::update() {
+      NEON_PROFILE_SCOPE("texture_streamer::update");
+      const time start = time::now();
+
+      // note: polled with a zero timeout, a slot that is still being read stays busy
+      for (auto &entry : slots_) {
+         if (entry.state_ != SLOT_STATE_UPLOADING) {
+            continue;
+         }
+
+         const GLenum result = glClientWaitSync(entry.fence_, 0, 0);
+         if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+            glDeleteSync(entry.fence_);
+            entry.fence_ = nullptr;
+            entry.state_ = SLOT_STATE_FREE;
+         }
+      }
+
+      // note: storage is allocated before the unpack buffer is bound, a null pointer
+      //       would read from the buffer otherwise
+      GLint bound_texture = -1;
+      for (auto &entry : slots_) {
+         if (entry.state_.load(std::memory_order_acquire) != SLOT_STATE_DECODED) {
+            continue;
+         }
+
+         if (bound_texture < 0) {
+            glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound_texture);
+         }
+
+         texture &target = *entry.request_.target_;
+         const bool valid = !entry.failed_ && target.create_storage(entry.width_, entry.height_);
+
+         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, entry.buffer_);
+         glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+         entry.pixels_ = nullptr;
+
+         if (!valid) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            entry.state_ = SLOT_STATE_FREE;
+            statistics_.failed_++;
+            continue;
+         }
+
+         glBindTexture(GL_TEXTURE_2D, target.id_);
+         glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, entry.width_, entry.height_, GL_RGBA, GL_UNSIGNED_BYTE, (const void *)0);
+         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+         entry.fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+         entry.state_ = SLOT_STATE_UPLOADING;
+         statistics_.uploaded_++;
+         statistics_.uploaded_bytes_ += (uint64)entry.width_ * entry.height_ * 4;
+      }
+
+      if (bound_texture >= 0) {
+         glBindTexture(GL_TEXTURE_2D, (GLuint)bound_texture);
+      }
+
+      // note: the whole buffer is invalidated, so mapping never waits on the previous upload
+      uint32 handed_out = 0;
+      for (uint32 index = 0; index < RING_SIZE && !pending_.empty(); index++) {
+         slot &entry = slots_[index];
+         if (entry.state_ != SLOT_STATE_FREE) {
+            continue;
+         }
+
+         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, entry.buffer_);
+         entry.pixels_ = (uint8 *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, SLOT_BYTES, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+         if (!entry.pixels_) {
+            break;
+         }
+
+         entry.request_ = pending_.front();
+         entry.failed_ = false;
+         pending_.erase(pending_.begin());
+         entry.state_ = SLOT_STATE_DECODING;
+
+         std::lock_guard<std::mutex> lock(mutex_);
+         jobs_.push_back(index);
+         handed_out++;
+      }
+
+      if (handed_out > 1) {
+         wake_.notify_all();
+      }
+      else if (handed_out > 0) {
+         wake_.notify_one();
+      }
+
+      statistics_.update_time_ = time::now() - start;
+   }
+
+   void texture_streamer::decode_loop() {
+      dynamic_array<uint8> content;
+      for (;;) {
+         uint32 index = 0;
+         {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return !running_ || !jobs_.empty(); });
+            if (!running_) {
+               return;
+            }
+
+            index = jobs_.front();
+            jobs_.erase(jobs_.begin());
+         }
+
+         // note: the main thread leaves the slot alone until it reads decoded
+         slot &entry = slots_[index];
+         assert(entry.state_ == SLOT_STATE_DECODING && entry.pixels_);
+         entry.failed_ = !file_system::read_file_content(entry.request_.filename_, content) ||
+            !texture::decode(content, entry.request_.flip_, entry.pixels_, SLOT_BYTES, entry.width_, entry.height_);
+         entry.state_.store(SLOT_STATE_DECODED, std::memory_order_release);
+      }
+   }
+} // !neon